@@ -13,12 +13,19 @@
 #include "clearpath.h"
 #include "fan.h"
 #include "hal_adc.h"
+#include "hal_motion_timer.h"
+#include "hal_profiler.h"
+#include "hal_uart.h"
 #include "hal_system_speed.h"
+#include "kinematics.h"
 #include "led_interpolator.h"
+#include "movement_queue.h"
 #include "path_interpolator.h"
 #include "sensors.h"
 #include "shutter_release.h"
 #include "status.h"
+#include "telemetry.h"
+#include "trajectory_capture.h"
 
 #include "configuration.h"
 
@@ -47,7 +54,17 @@ app_background( void )
 {
     //rate limit less important background processes
     AppTaskCommunication_rx_tick();
+    telemetry_process();
+
+    uint32_t start = hal_profiler_start();
     hal_adc_tick();
+    hal_profiler_stop( HAL_PROFILER_ADC, start );
+
+#ifdef MOTION_PRECOMPILE
+    start = hal_profiler_start();
+    path_interpolator_compile();
+    hal_profiler_stop( HAL_PROFILER_PATH_INTERPOLATOR, start );
+#endif
 
     if( timer_ms_is_expired( &button_timer ) )
     {
@@ -67,7 +84,10 @@ app_background( void )
 
     if( timer_ms_is_expired( &fan_timer ) )
     {
+        start = hal_profiler_start();
         fan_process();
+        hal_profiler_stop( HAL_PROFILER_FAN, start );
+
         timer_ms_start( &fan_timer, FAN_EVALUATE_TIME );
     }
 
@@ -81,20 +101,49 @@ app_background( void )
 
         config_set_cpu_load( hal_system_speed_get_load() );
         config_set_cpu_clock( hal_system_speed_get_speed() );    // todo only update this value if it changes
+        config_set_irq_masked_cycles( hal_system_speed_get_masked_cycles( true ) );
         config_update_task_statistics();
+        config_update_profiler_statistics();
+        config_update_event_pool_statistics();
+
+        HalMotionTimerStats_t motion_loop;
+        hal_motion_timer_get_statistics( &motion_loop, true );
+        config_set_motion_loop_statistics( &motion_loop );
+
+        KinematicsTiming_t kinematics_timing;
+        kinematics_get_timing( &kinematics_timing, true );
+        config_set_kinematics_timing( &kinematics_timing );
+
+        MovementQueueStats_t movement_queue_stats;
+        movement_queue_get_statistics( &movement_queue_stats, true );
+        config_set_movement_queue_statistics( &movement_queue_stats );
+
+        for( HalUartPort_t port = 0; port < HAL_UART_NUM_PORTS; port++ )
+        {
+            HalUartStats_t uart_stats;
+            hal_uart_get_statistics( port, &uart_stats, true );
+            config_set_uart_statistics( port, &uart_stats );
+        }
+
+        TrajectoryCaptureStatus_t capture_status;
+        trajectory_capture_get_status( &capture_status );
+        config_set_capture_status( &capture_status );
 
         timer_ms_start( &adc_timer, BACKGROUND_ADC_AVG_POLL_MS );
     }
 
     shutter_process();
-    led_interpolator_process();
 
-    //process any running movements and allow servo drivers to process commands
-    path_interpolator_process();
+    start = hal_profiler_start();
+    led_interpolator_process();
+    hal_profiler_stop( HAL_PROFILER_LED_INTERPOLATOR, start );
 
+    // Movements are evaluated by the motion timer, servo drivers supervise homing and faults
     for( ClearpathServoInstance_t servo = _CLEARPATH_1; servo < _NUMBER_CLEARPATH_SERVOS; servo++ )
     {
+        start = hal_profiler_start();
         servo_process( servo );
+        hal_profiler_stop( HAL_PROFILER_SERVO + servo, start );
     }
 }
 
@@ -19,6 +19,9 @@ extern "C" {
 //! Manufacturer name
 #define MANUFACTURER_NAME "Scott Rapson"
 
+//! Solve queued moves into joint setpoints from the background loop, so the motion loop only replays them
+//#define MOTION_PRECOMPILE
+
 /* -------------------------------------------------------------------------- */
 /* --- Tick Timer Conversion Macros                                       --- */
 /* -------------------------------------------------------------------------- */
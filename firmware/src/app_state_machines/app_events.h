@@ -48,15 +48,6 @@ typedef struct ButtonPressedEvent__
 
 /* -------------------------------------------------------------------------- */
 
-/** Motion command */
-typedef struct MotionPlannerEvent__
-{
-    StateEvent super;    // Encapsulated event reference
-    Movement_t move;     // Movement details
-} MotionPlannerEvent;
-
-/* -------------------------------------------------------------------------- */
-
 /** Lighting command */
 typedef struct LedPlannerEvent__
 {
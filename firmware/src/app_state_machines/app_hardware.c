@@ -6,12 +6,15 @@
 #include "hal_flashmem.h"
 #include "hal_gpio.h"
 #include "hal_hard_ic.h"
+#include "hal_motion_timer.h"
 #include "hal_reset.h"
+#include "hal_stepper.h"
 #include "hal_system_speed.h"
 #include "hal_systick.h"
 #include "hal_uart.h"
 #include "hal_watchdog.h"
 
+#include "app_times.h"
 #include "buzzer.h"
 #include "clearpath.h"
 #include "configuration.h"
@@ -48,6 +51,8 @@ app_hardware_init( void )
 
     hal_adc_init();
     hal_hard_ic_init();
+    hal_stepper_init();
+    hal_motion_timer_init( MOTION_LOOP_RATE_HZ );
 
     configuration_init();
 
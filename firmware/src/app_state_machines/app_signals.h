@@ -38,7 +38,6 @@ enum AppSignals
     TRACKED_EXTERNAL_SERVO_REQUEST,
 #endif
     TRACKED_TARGET_REQUEST,
-    MOVEMENT_REQUEST,
 
     /* Servo Signals */
     MECHANISM_START,
@@ -55,8 +54,7 @@ enum AppSignals
 
     MOTION_QUEUE_START,
     MOTION_QUEUE_START_SYNC,
-    MOTION_QUEUE_ADD,      // Provide movement information for queue processing
-    MOTION_QUEUE_CLEAR,    // empty out pending movements
+    MOTION_QUEUE_CLEAR,    // pending movements were flushed from the movement queue, stop taking them
 
     PATHING_STARTED,     // started executing a move
     PATHING_COMPLETE,    // finished moving along a provided profile path
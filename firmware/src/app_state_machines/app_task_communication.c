@@ -12,9 +12,21 @@
 #include "app_task_communication.h"
 #include "configuration.h"
 #include "hal_uart.h"
+#include "hal_usb_cdc.h"
+#include "telemetry.h"
 
 #include "electricui.h"
 
+/* ----- Private Types ------------------------------------------------------ */
+
+// Links serviced by the RX drain, in round-robin order
+typedef struct
+{
+    uint8_t       link;
+    HalUartPort_t port;      // UART links only, USB has a single device
+    bool          active;    // set once the port has been brought up
+} CommunicationRxLink_t;
+
 /* ----- Private Function Definitions --------------------------------------- */
 
 PRIVATE void AppTaskCommunicationConstructor( AppTaskCommunication *me );
@@ -29,9 +41,17 @@ PRIVATE void AppTaskCommunication_tx_put_module( uint8_t *c, uint16_t length );
 
 PRIVATE void AppTaskCommunication_tx_put_usb( uint8_t *c, uint16_t length );
 
+PRIVATE void AppTaskCommunication_telemetry_send( uint8_t link, const char *id );
+
 PRIVATE void AppTaskCommunication_rx_callback_uart( HalUartPort_t port, uint8_t c );
 
-PRIVATE void AppTaskCommunication_rx_callback_cdc( uint8_t c );
+PRIVATE void AppTaskCommunication_rx_link_enable( uint8_t link );
+
+PRIVATE uint32_t AppTaskCommunication_rx_link_peek( const CommunicationRxLink_t *rx, const uint8_t **data );
+
+PRIVATE void AppTaskCommunication_rx_link_consume( const CommunicationRxLink_t *rx, uint32_t length );
+
+PRIVATE uint32_t AppTaskCommunication_rx_link_available( const CommunicationRxLink_t *rx );
 
 PRIVATE STATE AppTaskCommunication_main( AppTaskCommunication *me, const StateEvent *e );
 
@@ -53,6 +73,15 @@ enum
     LINK_USB
 } EUI_LINK_NAMES;
 
+PRIVATE CommunicationRxLink_t rx_links[] = {
+    { .link = LINK_MODULE, .port = HAL_UART_PORT_MODULE },
+    { .link = LINK_INTERNAL, .port = HAL_UART_PORT_INTERNAL },
+    { .link = LINK_EXTERNAL, .port = HAL_UART_PORT_EXTERNAL },
+    { .link = LINK_USB },
+};
+
+PRIVATE uint8_t rx_link_next = 0;    // link that goes first on the next drain
+
 eui_interface_t communication_interface[] = {
     EUI_INTERFACE_CB( &AppTaskCommunication_tx_put_module, &AppTaskCommunication_eui_callback_module ),
     EUI_INTERFACE_CB( &AppTaskCommunication_tx_put_internal, &AppTaskCommunication_eui_callback_internal ),
@@ -134,20 +163,26 @@ PRIVATE STATE AppTaskCommunication_electric_ui( AppTaskCommunication *me,
             {
                 case INTERFACE_UART_MODULE:
                     hal_uart_init( HAL_UART_PORT_MODULE );
+                    AppTaskCommunication_rx_link_enable( LINK_MODULE );
+                    telemetry_link_enable( LINK_MODULE, MODULE_BAUD / 10, &AppTaskCommunication_telemetry_send );
                     break;
 
                 case INTERFACE_UART_INTERNAL:
                     hal_uart_init( HAL_UART_PORT_INTERNAL );
+                    AppTaskCommunication_rx_link_enable( LINK_INTERNAL );
+                    telemetry_link_enable( LINK_INTERNAL, INTERNAL_BAUD / 10, &AppTaskCommunication_telemetry_send );
                     break;
 
                 case INTERFACE_UART_EXTERNAL:
                     hal_uart_init( HAL_UART_PORT_EXTERNAL );
+                    AppTaskCommunication_rx_link_enable( LINK_EXTERNAL );
+                    telemetry_link_enable( LINK_EXTERNAL, EXTERNAL_BAUD / 10, &AppTaskCommunication_telemetry_send );
                     break;
 
                 case INTERFACE_USB_EXTERNAL:
-                    //todo init cdc here
-                    //todo setup callback to AppTaskCommunication_rx_callback_cdc
-
+                    hal_usb_cdc_init();
+                    AppTaskCommunication_rx_link_enable( LINK_USB );
+                    telemetry_link_enable( LINK_USB, USB_CDC_BYTES_PER_S, &AppTaskCommunication_telemetry_send );
                     break;
             }
 
@@ -170,23 +205,36 @@ PRIVATE void
 AppTaskCommunication_tx_put_external( uint8_t *c, uint16_t length )
 {
     hal_uart_write( HAL_UART_PORT_EXTERNAL, c, length );
+    telemetry_link_charge( LINK_EXTERNAL, length );
 }
 
 PRIVATE void
 AppTaskCommunication_tx_put_internal( uint8_t *c, uint16_t length )
 {
     hal_uart_write( HAL_UART_PORT_INTERNAL, c, length );
+    telemetry_link_charge( LINK_INTERNAL, length );
 }
 
 PRIVATE void
 AppTaskCommunication_tx_put_module( uint8_t *c, uint16_t length )
 {
     hal_uart_write( HAL_UART_PORT_MODULE, c, length );
+    telemetry_link_charge( LINK_MODULE, length );
 }
 
 PRIVATE void
 AppTaskCommunication_tx_put_usb( uint8_t *c, uint16_t length )
 {
+    hal_usb_cdc_write( c, length );
+    telemetry_link_charge( LINK_USB, length );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+AppTaskCommunication_telemetry_send( uint8_t link, const char *id )
+{
+    eui_send_tracked_on( id, &communication_interface[link] );
 }
 
 /* -------------------------------------------------------------------------- */
@@ -214,18 +262,114 @@ AppTaskCommunication_rx_callback_uart( HalUartPort_t port, uint8_t c )
 }
 
 PRIVATE void
-AppTaskCommunication_rx_callback_cdc( uint8_t c )
+AppTaskCommunication_rx_link_enable( uint8_t link )
 {
-    eui_parse( c, &communication_interface[LINK_USB] );
+    for( uint8_t i = 0; i < DIM( rx_links ); i++ )
+    {
+        if( rx_links[i].link == link )
+        {
+            rx_links[i].active = true;
+        }
+    }
+}
+
+PRIVATE uint32_t
+AppTaskCommunication_rx_link_peek( const CommunicationRxLink_t *rx, const uint8_t **data )
+{
+    if( rx->link == LINK_USB )
+    {
+        return hal_usb_cdc_rx_peek_linear( data );
+    }
+
+    return hal_uart_rx_peek_linear( rx->port, data );
 }
 
+PRIVATE void
+AppTaskCommunication_rx_link_consume( const CommunicationRxLink_t *rx, uint32_t length )
+{
+    if( rx->link == LINK_USB )
+    {
+        hal_usb_cdc_rx_consume( length );
+    }
+    else
+    {
+        hal_uart_rx_consume( rx->port, length );
+    }
+}
+
+PRIVATE uint32_t
+AppTaskCommunication_rx_link_available( const CommunicationRxLink_t *rx )
+{
+    if( rx->link == LINK_USB )
+    {
+        return hal_usb_cdc_rx_data_available();
+    }
+
+    return hal_uart_rx_data_available( rx->port );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Parse received bytes straight out of each link's RX FIFO. Links take turns
+// a slice at a time so a busy link can't starve the others, and the total is
+// capped so a burst of traffic can't hold up the rest of the background loop.
 PUBLIC void
 AppTaskCommunication_rx_tick( void )
 {
-    while( hal_uart_rx_data_available( HAL_UART_PORT_MODULE ) )
+    uint32_t budget = COMM_RX_BUDGET_BYTES;
+    bool     pending = true;
+
+    while( budget && pending )
+    {
+        pending = false;
+
+        for( uint8_t i = 0; i < DIM( rx_links ) && budget; i++ )
+        {
+            CommunicationRxLink_t *rx = &rx_links[( rx_link_next + i ) % DIM( rx_links )];
+
+            if( !rx->active )
+            {
+                continue;
+            }
+
+            const uint8_t *data;
+            uint32_t       length = AppTaskCommunication_rx_link_peek( rx, &data );
+            uint32_t       slice  = MIN( length, MIN( budget, COMM_RX_SLICE_BYTES ) );
+
+            eui_interface_t *interface = &communication_interface[rx->link];
+
+            for( uint32_t b = 0; b < slice; b++ )
+            {
+                eui_parse( data[b], interface );
+            }
+
+            AppTaskCommunication_rx_link_consume( rx, slice );
+            budget -= slice;
+
+            if( slice )
+            {
+                telemetry_link_heard( rx->link );
+            }
+
+            // More waiting, either past the slice or wrapped to the start of the fifo
+            if( AppTaskCommunication_rx_link_available( rx ) )
+            {
+                pending = true;
+            }
+        }
+    }
+
+    // Whatever the budget left behind is most likely an upload, let it be
+    // answered before those links are sent any more telemetry
+    for( uint8_t i = 0; i < DIM( rx_links ); i++ )
     {
-        eui_parse( hal_uart_rx_get( HAL_UART_PORT_MODULE ), &communication_interface[LINK_MODULE] );
+        if( rx_links[i].active && AppTaskCommunication_rx_link_available( &rx_links[i] ) )
+        {
+            telemetry_link_defer( rx_links[i].link );
+        }
     }
+
+    rx_link_next = (uint8_t)( ( rx_link_next + 1 ) % DIM( rx_links ) );
 }
 
 /* -------------------------------------------------------------------------- */
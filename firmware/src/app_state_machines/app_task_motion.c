@@ -14,7 +14,9 @@
 
 #include "clearpath.h"
 #include "kinematics.h"
+#include "motion_planner.h"
 #include "motion_types.h"
+#include "movement_queue.h"
 #include "path_interpolator.h"
 
 #include "configuration.h"
@@ -34,7 +36,7 @@ PRIVATE STATE AppTaskMotion_recovery( AppTaskMotion *me, const StateEvent *e );
 
 PRIVATE void AppTaskMotion_commit_queued_move( AppTaskMotion *me );
 PRIVATE void AppTaskMotion_clear_queue( AppTaskMotion *me );
-PRIVATE void AppTaskMotion_add_event_to_queue( AppTaskMotion *me, const StateEvent *e );
+PRIVATE void AppTaskMotion_stop_after_flush( AppTaskMotion *me );
 
 typedef enum
 {
@@ -51,9 +53,7 @@ typedef enum
 PUBLIC StateTask *
 appTaskMotionCreate( AppTaskMotion *me,
                      StateEvent *   eventQueueData[],
-                     const uint8_t  eventQueueSize,
-                     StateEvent *   movementQueue[],
-                     const uint8_t  movementQueueSize )
+                     const uint8_t  eventQueueSize )
 {
     // Clear all task data
     memset( me, 0, sizeof( AppTaskMotion ) );
@@ -61,12 +61,12 @@ appTaskMotionCreate( AppTaskMotion *me,
     // Initialise State Machine State
     AppTaskMotionConstructor( me );
 
-    /* Initialise State Machine Task */
+    /* Initialise State Machine Task, movements wait in the movement queue rather than a request queue */
     return stateTaskCreate( (StateTask *)me,
                             eventQueueData,
                             eventQueueSize,
-                            movementQueue,
-                            movementQueueSize );
+                            0,
+                            0 );
 }
 
 /* ----- Private Functions -------------------------------------------------- */
@@ -85,7 +85,6 @@ PRIVATE void AppTaskMotion_initial( AppTaskMotion *me, const StateEvent *e __att
     eventSubscribe( (StateTask *)me, MOTION_PREPARE );
     eventSubscribe( (StateTask *)me, MOTION_EMERGENCY );
 
-    eventSubscribe( (StateTask *)me, MOTION_QUEUE_ADD );
     eventSubscribe( (StateTask *)me, MOTION_QUEUE_CLEAR );
     eventSubscribe( (StateTask *)me, MOTION_QUEUE_START );
     eventSubscribe( (StateTask *)me, MOTION_QUEUE_START_SYNC );
@@ -93,6 +92,7 @@ PRIVATE void AppTaskMotion_initial( AppTaskMotion *me, const StateEvent *e __att
     eventSubscribe( (StateTask *)me, PATHING_COMPLETE );
 
     kinematics_init();
+    movement_queue_init();
     path_interpolator_init();
     config_set_motion_state( TASKSTATE_MOTION_INITIAL );
 
@@ -107,6 +107,7 @@ PRIVATE STATE AppTaskMotion_main( AppTaskMotion *me, const StateEvent *e )
     {
         case STATE_ENTRY_SIGNAL:
             config_set_motion_state( TASKSTATE_MOTION_MAIN );
+            movement_queue_accept( false );
 
             return 0;
 
@@ -139,6 +140,9 @@ PRIVATE STATE AppTaskMotion_home( AppTaskMotion *me, const StateEvent *e )
 
             config_set_motion_state( TASKSTATE_MOTION_HOME );
 
+            // Movements can be queued from here on, they wait until the queue is started
+            movement_queue_accept( true );
+
             //check the motors every 500ms to see if they are homed
             eventTimerStartEvery( &me->timer1,
                                   (StateTask *)me,
@@ -183,10 +187,6 @@ PRIVATE STATE AppTaskMotion_home( AppTaskMotion *me, const StateEvent *e )
 
             return 0;
 
-        case MOTION_QUEUE_ADD:
-            AppTaskMotion_add_event_to_queue( me, e );
-            return 0;
-
         case MOTION_EMERGENCY:
             STATE_TRAN( AppTaskMotion_recovery );
             return 0;
@@ -233,29 +233,25 @@ PRIVATE STATE AppTaskMotion_inactive( AppTaskMotion *me, const StateEvent *e )
             }
             return 0;
 
-        case MOTION_QUEUE_ADD:
-            AppTaskMotion_add_event_to_queue( me, e );
+        case MOTION_QUEUE_START:
+            STATE_TRAN( AppTaskMotion_active );
             return 0;
 
         case MOTION_QUEUE_CLEAR:
-            AppTaskMotion_clear_queue( me );
-            return 0;
-
-        case MOTION_QUEUE_START:
-            STATE_TRAN( AppTaskMotion_active );
+            // Moves loaded before an earlier clear can still be running
+            AppTaskMotion_stop_after_flush( me );
             return 0;
 
         case MOTION_QUEUE_START_SYNC: {
             // Check that the ID we got the sync event for matches the current queue head ID
             // TODO support sync events on ID's which aren't the current head
             //      consider searching/ditching events until ID matches?
-            StateEvent *pendingMotion = eventQueuePeek( &me->super.requestQueue );
+            Movement_t *pendingMotion = movement_queue_peek( 0 );
 
             if( pendingMotion )
             {
-                MotionPlannerEvent *ape          = (MotionPlannerEvent *)pendingMotion;
-                uint16_t            id_in_queue  = ( (Movement_t *)&ape->move )->identifier;
-                uint16_t            id_requested = ( (BarrierSyncEvent *)e )->id;
+                uint16_t id_in_queue  = pendingMotion->identifier;
+                uint16_t id_requested = ( (BarrierSyncEvent *)e )->id;
 
                 if( id_in_queue == id_requested )
                 {
@@ -310,23 +306,10 @@ PRIVATE STATE AppTaskMotion_active( AppTaskMotion *me, const StateEvent *e )
         case PATHING_COMPLETE: {
             // the pathing engine completed movement execution,
             // run another event, or go back to inactive to wait for new instructions
-            if( eventQueueUsed( &me->super.requestQueue ) )
+            if( movement_queue_used() )
             {
-                StateEvent *next = eventQueuePeek( &me->super.requestQueue );
-                ASSERT( next );
-
-                MotionPlannerEvent *ape       = (MotionPlannerEvent *)next;
-                Movement_t *        next_move = &ape->move;
-
-                if( next_move->duration )
-                {
-                    // add an item to the queue
-                    stateTaskPostReservedEvent( STATE_STEP1_SIGNAL );
-                }
-                else
-                {
-                    STATE_TRAN( AppTaskMotion_inactive );
-                }
+                // add an item to the queue
+                stateTaskPostReservedEvent( STATE_STEP1_SIGNAL );
             }
             else
             {
@@ -336,12 +319,10 @@ PRIVATE STATE AppTaskMotion_active( AppTaskMotion *me, const StateEvent *e )
             return 0;
         }
 
-        case MOTION_QUEUE_ADD:
-            AppTaskMotion_add_event_to_queue( me, e );
-            return 0;
-
         case MOTION_QUEUE_CLEAR:
-            AppTaskMotion_clear_queue( me );
+            // The queue was flushed by whoever published the clear, movements committed
+            // since then are kept for the next start
+            AppTaskMotion_stop_after_flush( me );
             STATE_TRAN( AppTaskMotion_inactive );
             return 0;
 
@@ -363,6 +344,7 @@ PRIVATE STATE AppTaskMotion_recovery( AppTaskMotion *me, const StateEvent *e )
     switch( e->signal )
     {
         case STATE_ENTRY_SIGNAL:
+            movement_queue_accept( false );
 
             // Disable the servo motors
             for( ClearpathServoInstance_t servo = _CLEARPATH_1; servo < _NUMBER_CLEARPATH_SERVOS; servo++ )
@@ -430,82 +412,57 @@ PRIVATE STATE AppTaskMotion_recovery( AppTaskMotion *me, const StateEvent *e )
 
 PRIVATE void AppTaskMotion_commit_queued_move( AppTaskMotion *me )
 {
-    // Check for pending events in the queue, and the pathing engine is able to accept one
-    if( path_interpolator_is_ready_for_next()
-        && eventQueueUsed( &me->super.requestQueue ) )
+    // Check for pending moves in the queue, and the pathing engine is able to accept one
+    if( path_interpolator_is_ready_for_next() && movement_queue_used() )
     {
-        // Grab the next event off the queue
-        StateEvent *next = eventQueueGet( &me->super.requestQueue );
-        ASSERT( next );
+        Movement_t *    lookahead[PLANNER_LOOKAHEAD_DEPTH] = { 0 };
+        MotionProfile_t profile                            = { 0 };
+        uint8_t         lookahead_count                    = 0;
 
-        MotionPlannerEvent *mpe       = (MotionPlannerEvent *)next;
-        Movement_t *        next_move = &mpe->move;
+        // Nothing in flight, so planning starts from rest at the effector's position
+        if( path_interpolator_is_idle() )
+        {
+            motion_planner_reset( path_interpolator_get_global_position() );
+        }
 
-        if( next_move->duration )
+        // Gather the next move and those queued behind it so the planner can blend the junctions
+        while( lookahead_count < PLANNER_LOOKAHEAD_DEPTH )
         {
-            // Pass this valid move to the pathing engine, and start it
-            path_interpolator_set_next( next_move );
-            path_interpolator_start();
+            Movement_t *queued = movement_queue_peek( lookahead_count );
 
-            eventPoolGarbageCollect( (StateEvent *)next );    // Remove it from the queue
+            if( !queued )
+            {
+                break;
+            }
+
+            lookahead[lookahead_count++] = queued;
         }
-    }
 
-    // Tell the UI the new queue depth after pulling a move from it
-    config_set_motion_queue_depth( eventQueueUsed( &me->super.requestQueue ) );
+        motion_planner_plan( lookahead, lookahead_count, &profile );
+
+        // Pass this valid move to the pathing engine, and start it.
+        // The interpolator runs it from the queue's slot and releases it when done
+        path_interpolator_set_next( movement_queue_take(), &profile );
+        path_interpolator_start();
+    }
 }
 
 /* -------------------------------------------------------------------------- */
 
 PRIVATE void AppTaskMotion_clear_queue( AppTaskMotion *me )
 {
-    // Empty the queue
-    StateEvent *next = eventQueueGet( &me->super.requestQueue );
-    while( next )
-    {
-        eventPoolGarbageCollect( (StateEvent *)next );
-        next = eventQueueGet( &me->super.requestQueue );
-    }
-
-    //update UI with queue content count
-    config_set_motion_queue_depth( eventQueueUsed( &me->super.requestQueue ) );
+    // Empty the queue, the depth is reported to the UI as it changes
+    movement_queue_flush();
 }
 
 /* -------------------------------------------------------------------------- */
 
-PRIVATE void AppTaskMotion_add_event_to_queue( AppTaskMotion *me, const StateEvent *e )
+PRIVATE void AppTaskMotion_stop_after_flush( AppTaskMotion *me )
 {
-    //already in motion, so add this one to the queue
-    MotionPlannerEvent *mpe = (MotionPlannerEvent *)e;
-
-    ASSERT( mpe->move.duration != 0 );
-
-    // Add the movement request to the queue if we have room
-    uint8_t queue_usage = eventQueueUsed( &me->super.requestQueue );
-    if( queue_usage <= MOVEMENT_QUEUE_DEPTH_MAX )
-    {
-        int32_t speed = cartesian_move_speed( &mpe->move );
-
-        if( speed < EFFECTOR_SPEED_LIMIT )
-        {
-            eventQueuePutFIFO( &me->super.requestQueue, (StateEvent *)e );
-        }
-        else
-        {
-            config_report_error( "Requested illegal speed" );
-        }
-    }
-    else
-    {
-        //queue full, clearly the input motion processor isn't abiding by the spec.
-        config_report_error( "Motion Queue Full" );
-
-        //shutdown
-        eventPublish( EVENT_NEW( StateEvent, MOTION_ERROR ) );
-        STATE_TRAN( AppTaskMotion_recovery );
-    }
-
-    config_set_motion_queue_depth( eventQueueUsed( &me->super.requestQueue ) );
+    // The loaded moves were planned to blend into the ones just dropped, so bring the
+    // effector to rest at the end of them, and plan whatever comes next from rest
+    path_interpolator_stop_after_loaded();
+    motion_planner_halt();
 }
 
 /* ----- End ---------------------------------------------------------------- */
@@ -39,9 +39,7 @@ struct AppTaskMotion
 PUBLIC StateTask *
 appTaskMotionCreate( AppTaskMotion *me,
                      StateEvent *   eventQueueData[],
-                     const uint8_t  eventQueueSize,
-                     StateEvent *   movementQueue[],
-                     const uint8_t  movementQueueSize );
+                     const uint8_t  eventQueueSize );
 
 /* ----- End ---------------------------------------------------------------- */
 
@@ -18,6 +18,7 @@
 #include "buzzer.h"
 #include "configuration.h"
 #include "demonstration.h"
+#include "movement_queue.h"
 #include "path_interpolator.h"
 #include "sensors.h"
 #include "shutter_release.h"
@@ -77,7 +78,6 @@ PRIVATE void AppTaskSupervisor_initial( AppTaskSupervisor *me,
     eventSubscribe( (StateTask *)me, MECHANISM_STOP );
     eventSubscribe( (StateTask *)me, MECHANISM_REHOME );
 
-    eventSubscribe( (StateTask *)me, MOVEMENT_REQUEST );
     eventSubscribe( (StateTask *)me, TRACKED_TARGET_REQUEST );
 #ifdef EXPANSION_SERVO
     eventSubscribe( (StateTask *)me, TRACKED_EXTERNAL_SERVO_REQUEST );
@@ -423,32 +423,25 @@ PRIVATE STATE AppTaskSupervisor_armed_event( AppTaskSupervisor *me,
                     BarrierSyncEvent *motor_sync = EVENT_NEW( BarrierSyncEvent, MOTION_QUEUE_START_SYNC );
                     BarrierSyncEvent *led_sync   = EVENT_NEW( BarrierSyncEvent, LED_QUEUE_START_SYNC );
 
-                    motor_sync->id = inbound_sync->id;
-                    led_sync->id   = inbound_sync->id;
+                    // Both queues start together or neither does
+                    if( motor_sync && led_sync )
+                    {
+                        motor_sync->id = inbound_sync->id;
+                        led_sync->id   = inbound_sync->id;
 
-                    eventPublish( (StateEvent *)motor_sync );
-                    eventPublish( (StateEvent *)led_sync );
+                        eventPublish( (StateEvent *)motor_sync );
+                        eventPublish( (StateEvent *)led_sync );
+                    }
+                    else
+                    {
+                        EVENT_DELETE( motor_sync );
+                        EVENT_DELETE( led_sync );
+                    }
                 }
             }
             return 0;
         }
 
-        case MOVEMENT_REQUEST: {
-            //catch the inbound movement event
-            MotionPlannerEvent *mpe = (MotionPlannerEvent *)e;
-
-            // Create event to pass event for motion handler
-            MotionPlannerEvent *motion_request = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
-
-            if( motion_request )
-            {
-                // copy the movement into the new event for the motion handler.
-                memcpy( &motion_request->move, &mpe->move, sizeof( Movement_t ) );
-                eventPublish( (StateEvent *)motion_request );
-            }
-            return 0;
-        }
-
         case CAMERA_CAPTURE: {
             CameraShutterEvent *trigger = (CameraShutterEvent *)e;
 
@@ -524,25 +517,6 @@ PRIVATE STATE AppTaskSupervisor_armed_manual( AppTaskSupervisor *me,
             AppTaskSupervisorPublishRehomeEvent();
             return 0;
 
-        case MOVEMENT_REQUEST: {
-            //catch the inbound movement event
-            MotionPlannerEvent *mpe = (MotionPlannerEvent *)e;
-
-            // Create event to pass event for motion handler
-            MotionPlannerEvent *motion_request = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
-
-            if( motion_request )
-            {
-                // copy the movement into the new event for the motion handler.
-                memcpy( &motion_request->move, &mpe->move, sizeof( Movement_t ) );
-                eventPublish( (StateEvent *)motion_request );
-
-                eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
-            }
-
-            return 0;
-        }
-
         case MODE_TRACK:
             me->selected_control_mode = CONTROL_TRACK;
             STATE_TRAN( AppTaskSupervisor_armed_change_mode );
@@ -609,43 +583,47 @@ PRIVATE STATE AppTaskSupervisor_armed_track( AppTaskSupervisor *me,
                     if( !path_interpolator_get_move_done() )
                     {
                         path_interpolator_stop();
+                        movement_queue_flush();
                         eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_CLEAR ) );
                         was_moving = true;
                     }
 
-                    // Create the line which will get us to the target
-                    MotionPlannerEvent *motev = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
-                    motev->move.type          = _LINE;
-                    motev->move.ref           = _POS_ABSOLUTE;
-                    motev->move.duration      = required_duration;
-                    motev->move.num_pts       = 2;
-                    motev->move.identifier    = 0;
-
-                    motev->move.points[0].x = current.x;
-                    motev->move.points[0].y = current.y;
-                    motev->move.points[0].z = current.z;
-
-                    motev->move.points[1].x = target.x;
-                    motev->move.points[1].y = target.y;
-                    motev->move.points[1].z = target.z;
+                    // Create the line which will get us to the target, written straight into the queue
+                    Movement_t *move = movement_queue_reserve();
 
-                    KinematicsSolution_t shaping = SOLUTION_ERROR;
-
-                    // Don't ease-in if we were already in motion
-                    if( was_moving )
-                    {
-                        shaping = cartesian_plan_smoothed_line( &motev->move, 0.0f, 0.001f );
-                    }
-                    else
-                    {
-                        shaping = cartesian_plan_smoothed_line( &motev->move, 0.001f, 0.001f );
-                    }
-
-                    // Convert the line to a acceleration-damped line, and send it to the planner
-                    if( shaping == SOLUTION_VALID )
+                    if( move )
                     {
-                        eventPublish( (StateEvent *)motev );
-                        eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
+                        move->type       = _LINE;
+                        move->ref        = _POS_ABSOLUTE;
+                        move->duration   = required_duration;
+                        move->num_pts    = 2;
+                        move->identifier = 0;
+
+                        move->points[0].x = current.x;
+                        move->points[0].y = current.y;
+                        move->points[0].z = current.z;
+
+                        move->points[1].x = target.x;
+                        move->points[1].y = target.y;
+                        move->points[1].z = target.z;
+
+                        KinematicsSolution_t shaping = SOLUTION_ERROR;
+
+                        // Don't ease-in if we were already in motion
+                        if( was_moving )
+                        {
+                            shaping = cartesian_plan_smoothed_line( move, 0.0f, 0.001f );
+                        }
+                        else
+                        {
+                            shaping = cartesian_plan_smoothed_line( move, 0.001f, 0.001f );
+                        }
+
+                        // Convert the line to a acceleration-damped line, and send it to the planner
+                        if( shaping == SOLUTION_VALID && movement_queue_commit( move ) )
+                        {
+                            eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
+                        }
                     }
 
                 }
@@ -790,6 +768,7 @@ PRIVATE STATE AppTaskSupervisor_armed_change_mode( AppTaskSupervisor *me,
             config_set_control_mode( CONTROL_CHANGING );
 
             //empty out the queues
+            movement_queue_flush();
             eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_CLEAR ) );
             eventPublish( EVENT_NEW( StateEvent, LED_CLEAR_QUEUE ) );
 
@@ -837,17 +816,22 @@ PRIVATE STATE AppTaskSupervisor_armed_change_mode( AppTaskSupervisor *me,
             else
             {
                 //request a move to 0,0,0
-                MotionPlannerEvent *motev = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
-                motev->move.type          = _POINT_TRANSIT;
-                motev->move.ref           = _POS_ABSOLUTE;
-                motev->move.identifier    = 0;
-                motev->move.duration      = 800;
-                motev->move.num_pts       = 1;
-                motev->move.points[0].x   = 0;
-                motev->move.points[0].y   = 0;
-                motev->move.points[0].z   = 0;
-
-                eventPublish( (StateEvent *)motev );
+                Movement_t *move = movement_queue_reserve();
+
+                if( move )
+                {
+                    move->type        = _POINT_TRANSIT;
+                    move->ref         = _POS_ABSOLUTE;
+                    move->identifier  = 0;
+                    move->duration    = 800;
+                    move->num_pts     = 1;
+                    move->points[0].x = 0;
+                    move->points[0].y = 0;
+                    move->points[0].z = 0;
+
+                    movement_queue_commit( move );
+                }
+
                 eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
             }
 
@@ -891,17 +875,22 @@ PRIVATE STATE AppTaskSupervisor_armed_change_mode( AppTaskSupervisor *me,
                 if( path_interpolator_get_move_done() )
                 {
                     //request a move to 0,0,0
-                    MotionPlannerEvent *motev = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
-                    motev->move.type          = _POINT_TRANSIT;
-                    motev->move.ref           = _POS_ABSOLUTE;
-                    motev->move.identifier    = 0;
-                    motev->move.duration      = 800;
-                    motev->move.num_pts       = 1;
-                    motev->move.points[0].x   = 0;
-                    motev->move.points[0].y   = 0;
-                    motev->move.points[0].z   = 0;
-
-                    eventPublish( (StateEvent *)motev );
+                    Movement_t *move = movement_queue_reserve();
+
+                    if( move )
+                    {
+                        move->type        = _POINT_TRANSIT;
+                        move->ref         = _POS_ABSOLUTE;
+                        move->identifier  = 0;
+                        move->duration    = 800;
+                        move->num_pts     = 1;
+                        move->points[0].x = 0;
+                        move->points[0].y = 0;
+                        move->points[0].z = 0;
+
+                        movement_queue_commit( move );
+                    }
+
                     eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
                 }
             }
@@ -960,6 +949,7 @@ PRIVATE STATE AppTaskSupervisor_disarm_graceful( AppTaskSupervisor *me,
             config_set_control_mode( me->selected_control_mode );
 
             //empty out the queues
+            movement_queue_flush();
             eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_CLEAR ) );
             eventPublish( EVENT_NEW( StateEvent, LED_CLEAR_QUEUE ) );
 
@@ -979,20 +969,24 @@ PRIVATE STATE AppTaskSupervisor_disarm_graceful( AppTaskSupervisor *me,
 
         case STATE_STEP1_SIGNAL: {
             //request a move to 0,0,0
-            MotionPlannerEvent *motev = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
+            Movement_t *move = movement_queue_reserve();
 
-            //transit to starting position
-            motev->move.type       = _POINT_TRANSIT;
-            motev->move.ref        = _POS_ABSOLUTE;
-            motev->move.duration   = 1500;
-            motev->move.num_pts    = 1;
-            motev->move.identifier = 0;
-
-            motev->move.points[0].x = 0;
-            motev->move.points[0].y = 0;
-            motev->move.points[0].z = 0;
+            if( move )
+            {
+                //transit to starting position
+                move->type       = _POINT_TRANSIT;
+                move->ref        = _POS_ABSOLUTE;
+                move->duration   = 1500;
+                move->num_pts    = 1;
+                move->identifier = 0;
+
+                move->points[0].x = 0;
+                move->points[0].y = 0;
+                move->points[0].z = 0;
+
+                movement_queue_commit( move );
+            }
 
-            eventPublish( (StateEvent *)motev );
             eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
 
             return 0;
@@ -1038,21 +1032,27 @@ PRIVATE STATE AppTaskSupervisor_disarm_graceful( AppTaskSupervisor *me,
 // Tell the motion handler to clear queue, queue a new move to home, and start the move
 PRIVATE void AppTaskSupervisorPublishRehomeEvent( void )
 {
+    movement_queue_flush();
     eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_CLEAR ) );
 
     //request a move to 0,0,0
-    MotionPlannerEvent *motev = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
-    motev->move.type          = _POINT_TRANSIT;
-    motev->move.ref           = _POS_ABSOLUTE;
-    motev->move.duration      = 1500;
-    motev->move.identifier    = 0;
-    motev->move.num_pts       = 1;
-
-    motev->move.points[0].x = 0;
-    motev->move.points[0].y = 0;
-    motev->move.points[0].z = 0;
-
-    eventPublish( (StateEvent *)motev );
+    Movement_t *move = movement_queue_reserve();
+
+    if( move )
+    {
+        move->type       = _POINT_TRANSIT;
+        move->ref        = _POS_ABSOLUTE;
+        move->duration   = 1500;
+        move->identifier = 0;
+        move->num_pts    = 1;
+
+        move->points[0].x = 0;
+        move->points[0].y = 0;
+        move->points[0].z = 0;
+
+        movement_queue_commit( move );
+    }
+
     eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
 }
 
@@ -24,7 +24,11 @@
 
 #include "button.h"
 #include "hal_button.h"
+#include "hal_motion_timer.h"
+#include "hal_profiler.h"
+#include "hal_soft_irq.h"
 #include "hal_systick.h"
+#include "path_interpolator.h"
 
 /* -------------------------------------------------------------------------- */
 
@@ -35,7 +39,7 @@ DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
 // ~~~ Event Pool Types ~~~
 
 /** Up to three distinct storage pools. */
-EventPool eventPool[3];
+EventPool eventPool[EVENT_POOL_MAX];
 
 /** @note: Select the following typedefs as approximately the largest
  *         within their group of small, medium and large structures.
@@ -44,12 +48,12 @@ EventPool eventPool[3];
  */
 typedef ButtonPressedEvent EventsSmallType;
 typedef ButtonEvent        EventsMediumType;
-typedef MotionPlannerEvent EventsLargeType;
+typedef LightingPlannerEvent EventsLargeType;
 
 // ~~~ Event Pool Storage ~~~
 EventsSmallType  eventsSmall[10];     //  __attribute__ ((section (".ccmram")))
 EventsMediumType eventsMedium[15];    //  __attribute__ ((section (".ccmram")))
-EventsLargeType __attribute__( ( section( ".ccmram" ) ) ) eventsLarge[400];
+EventsLargeType __attribute__( ( section( ".ccmram" ) ) ) eventsLarge[LED_QUEUE_DEPTH_MAX + 20];    // queued fades, plus tracking and manual LED requests in flight
 
 // ~~~ Event Subscription Data ~~~
 EventSubscribers eventSubscriberList[STATE_MAX_SIGNAL];
@@ -59,9 +63,11 @@ EventSubscribers eventSubscriberList[STATE_MAX_SIGNAL];
 AppTaskCommunication appTaskCommunication;
 StateEvent *         appTaskCommunicationEventQueue[10];
 
+AppTaskCommunication appTaskCommunicationUsb;
+StateEvent *         appTaskCommunicationUsbEventQueue[10];
+
 AppTaskMotion appTaskMotion;
-StateEvent *  appTaskMotionEventQueue[MOVEMENT_QUEUE_DEPTH_MAX];
-StateEvent *  appTaskMotionQueue[150];
+StateEvent *  appTaskMotionEventQueue[20];
 
 AppTaskLed  appTaskLed;
 StateEvent *appTaskLedEventQueue[LED_QUEUE_DEPTH_MAX];
@@ -75,6 +81,37 @@ StateEvent *      appTaskSupervisorEventQueue[20];
 PRIVATE StateTasker_t mainTasker;
 PUBLIC StateTask *mainTaskTable[TASK_MAX];
 
+#if STATE_TASKER_PREEMPTIVE
+
+// The tasker is safe to preempt, the application isn't yet. These are shared
+// between tasks at different priorities without any protection:
+//  - movement_queue_reserve() and commit(), from both links and the supervisor
+//  - eui_send_tracked() from task context, frames on one link can interleave
+//  - the configuration globals, written by one task and sent by another
+//  - the path compiler, rewound by the motion task under the background loop
+#error "STATE_TASKER_PREEMPTIVE is unaudited, see the list in app_tasks.c"
+
+// Task interrupts sit below every hardware interrupt (the lowest is at 8),
+// higher task ids preempt lower ones
+#define APP_TASK_IRQ_PRIORITY( id ) ( 15U - ( id ) )
+
+#endif
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+app_tasks_profile( uint8_t id, uint32_t cycles );
+
+#if STATE_TASKER_PREEMPTIVE
+
+PRIVATE void
+app_tasks_activate( uint8_t id );
+
+PRIVATE void
+app_tasks_preempt( uint8_t channel );
+
+#endif
+
 /* ----- Public Functions --------------------------------------------------- */
 
 PUBLIC
@@ -83,6 +120,14 @@ void app_tasks_init( void )
     /* ~~~ Tasker Handling Initialisation ~~~ */
     stateTaskerInit( &mainTasker, mainTaskTable, TASK_MAX );
 
+    REQUIRE( TASK_MAX - 1 <= HAL_PROFILER_TASKS );
+    stateTaskerSetProfileHook( &mainTasker, app_tasks_profile );
+
+#if STATE_TASKER_PREEMPTIVE
+    // Posts made while the tasks start stay pending until the interrupts are enabled below
+    stateTaskerSetActivateHook( &mainTasker, app_tasks_activate );
+#endif
+
     /* ~~~ Dynamic Event Pools Initialisation ~~~ */
     eventPoolInit( eventPool,
                    DIM( eventPool ) );
@@ -123,12 +168,18 @@ void app_tasks_init( void )
     stateTaskerAddTask( &mainTasker, t, TASK_COMMUNICATION, "Comms" );
     stateTaskerStartTask( &mainTasker, t );
 
+    t = appTaskCommunicationCreate( &appTaskCommunicationUsb,
+                                    appTaskCommunicationUsbEventQueue,
+                                    DIM( appTaskCommunicationUsbEventQueue ),
+                                    INTERFACE_USB_EXTERNAL );
+
+    stateTaskerAddTask( &mainTasker, t, TASK_COMMUNICATION_USB, "CommsUSB" );
+    stateTaskerStartTask( &mainTasker, t );
+
     //Handle motion controls
     t = appTaskMotionCreate( &appTaskMotion,
                              appTaskMotionEventQueue,
-                             DIM( appTaskMotionEventQueue ),
-                             appTaskMotionQueue,
-                             DIM( appTaskMotionQueue ) );
+                             DIM( appTaskMotionEventQueue ) );
 
     stateTaskerAddTask( &mainTasker, t, TASK_MOTION, "Movement" );
     stateTaskerStartTask( &mainTasker, t );
@@ -152,6 +203,16 @@ void app_tasks_init( void )
     stateTaskerStartTask( &mainTasker, t );
 
     hal_systick_hook( 1, eventTimerTick );
+    hal_motion_timer_hook( path_interpolator_process );
+
+#if STATE_TASKER_PREEMPTIVE
+    REQUIRE( TASK_MAX - 1 <= HAL_SOFT_IRQ_CHANNELS );
+
+    for( uint8_t id = 1; id < TASK_MAX; id++ )
+    {
+        hal_soft_irq_hook( id - 1, APP_TASK_IRQ_PRIORITY( id ), app_tasks_preempt );
+    }
+#endif
 }
 
 /* -------------------------------------------------------------------------- */
@@ -191,4 +252,38 @@ app_task_clear_statistics( void )
     stateTaskerClearStatistics( &mainTasker );
 }
 
+/* ----- Private Functions -------------------------------------------------- */
+
+/** Time taken by a task to handle an event */
+
+PRIVATE void
+app_tasks_profile( uint8_t id, uint32_t cycles )
+{
+    hal_profiler_record( HAL_PROFILER_DISPATCH + id - 1, cycles );
+}
+
+#if STATE_TASKER_PREEMPTIVE
+
+/* -------------------------------------------------------------------------- */
+
+/** A task has events waiting, request its interrupt */
+
+PRIVATE void
+app_tasks_activate( uint8_t id )
+{
+    hal_soft_irq_pend( id - 1 );
+}
+
+/* -------------------------------------------------------------------------- */
+
+/** Task interrupt, runs the task's events to completion */
+
+PRIVATE void
+app_tasks_preempt( uint8_t channel )
+{
+    stateTaskerRunTask( &mainTasker, mainTaskTable[channel + 1] );
+}
+
+#endif
+
 /* ----- End ---------------------------------------------------------------- */
@@ -31,11 +31,25 @@ enum SystemDefines
     BACKGROUND_RATE_BUZZER_MS  = 10U,     // 100Hz
     BACKGROUND_ADC_AVG_POLL_MS = 100U,    //  10Hz
 
-    MOVEMENT_QUEUE_DEPTH_MAX = 150U,    // movement events in the queue
+    MOVEMENT_QUEUE_DEPTH_MAX = 150U,    // movements waiting for the planner
+    MOVEMENT_QUEUE_IN_FLIGHT = 2U,      // movements held by the path interpolator while they run
     LED_QUEUE_DEPTH_MAX      = 250U,    // LED animations in the queue
 
-    EFFECTOR_SPEED_LIMIT    = 350U,    // mm/second
-    SPEED_SAMPLE_RESOLUTION = 15U,     // number of samples to sum across line
+    MOTION_LOOP_RATE_HZ = 1000U,    // fixed rate path evaluation, 1-4kHz
+
+    EFFECTOR_SPEED_LIMIT        = 350U,     // mm/second
+    EFFECTOR_ACCELERATION_LIMIT = 2000U,    // mm/second^2, also applies to centripetal acceleration on curves
+
+    PLANNER_LOOKAHEAD_DEPTH       = 16U,    // queued movements considered when planning junction speeds
+    PLANNER_JUNCTION_DEVIATION_UM = 50U,    // microns the effector may cut a corner by at speed
+    PLANNER_JOINT_SAMPLES         = 8U,     // points along each move checked for shoulder speed
+
+    MOTION_SETPOINT_DEPTH = 256U,    // precompiled motion loop ticks buffered ahead, power of two
+    MOTION_COMPILE_BATCH  = 16U,     // setpoints solved per background loop pass
+
+    WORKSPACE_GRID_PITCH_MM        = 10U,    // xy size of a reachable envelope cell
+    WORKSPACE_Z_PITCH_MM           = 5U,     // height between the reachability samples in each cell
+    WORKSPACE_JOINT_MARGIN_DECIDEG = 5U,     // reachable points keep every shoulder this far inside its limits, home is ~3 deg from the limit
 };
 
 /* -------------------------------------------------------------------------- */
@@ -45,6 +59,50 @@ enum CommunicationDefines
     MODULE_BAUD   = 500000,
     INTERNAL_BAUD = 115200,
     EXTERNAL_BAUD = 115200,
+
+    UART_TX_BUFFER_BYTES = 1024U,    // transmit ring per UART, DMA sends straight out of it
+
+    USB_CDC_TX_BUFFER_BYTES = 1024U,    // transmit ring for the USB serial link, packets are copied from it into the endpoint fifo
+    USB_CDC_RX_BUFFER_BYTES = 512U,     // receive ring for the USB serial link, the host is NAKed when it can't hold another packet
+
+    COMM_RX_BUDGET_BYTES = 512U,    // received bytes parsed per background pass, across all links
+    COMM_RX_SLICE_BYTES  = 64U,     // bytes one link may parse before the next link gets a turn
+
+    USB_CDC_BYTES_PER_S = 100000U,    // nominal USB serial throughput, well under full speed
+
+    FLOW_CREDIT_GRANT_STEP = 16U,    // credits freed before the host is sent a fresh grant without asking
+
+    MOVEMENT_BATCH_BYTES         = 240U,    // record bytes in one bulk upload, header + records must fit PAYLOAD_SIZE_MAX
+    MOVEMENT_BATCH_RECORDS_MAX   = 16U,     // movements carried by one bulk upload
+    MOVEMENT_BATCH_RESEND_WINDOW = 8U,      // streamed batches behind the last one treated as resends, must cover the host's batches in flight
+};
+
+/* -------------------------------------------------------------------------- */
+
+enum TelemetryDefines
+{
+    TELEMETRY_FAST_MS    = 50U,      // motion state, position and queue depths
+    TELEMETRY_NORMAL_MS  = 100U,     // servo and LED outputs
+    TELEMETRY_SLOW_MS    = 1000U,    // temperatures, cooling and system statistics
+    TELEMETRY_REFRESH_MS = 5000U,    // every channel is sent this often, changed or not
+
+    TELEMETRY_HOST_TIMEOUT_MS = 3000U,    // quiet this long and the host is assumed gone from a link
+
+    TELEMETRY_LINKS_MAX          = 4U,
+    TELEMETRY_CHANNELS_MAX       = 32U,     // one bit each in the per link pending mask
+    TELEMETRY_SHADOW_BYTES       = 1536U,    // copies of every channel as last published
+    TELEMETRY_LINK_SHARE_PERCENT = 25U,      // of a link's bandwidth telemetry may use
+    TELEMETRY_BURST_BYTES        = 768U,     // budget a quiet link can save up, covers the largest channel ('prof')
+    TELEMETRY_PACKET_OVERHEAD    = 10U,      // eUI header, CRC and framing bytes around the ID and payload
+};
+
+/* -------------------------------------------------------------------------- */
+
+enum TrajectoryCaptureDefines
+{
+    TRAJECTORY_CAPTURE_DEPTH = 1024U,    // samples held for the host, power of two, ~1s at the full motion loop rate
+    TRAJECTORY_BLOCK_SAMPLES = 8U,       // samples carried by one capture block, the block must fit an eUI payload
+    TRAJECTORY_DIVIDER_MAX   = 100U,     // motion loop ticks per sample at the slowest capture rate
 };
 
 /* -------------------------------------------------------------------------- */
@@ -147,7 +205,9 @@ enum ServoDefines
 
     //Clearpath will filter pulses shorter than 1us
     //ULN2303 NPN driver has rise time of ~5ns, fall of ~10nsec
-    SERVO_PULSE_DURATION_US = 10U,
+    //Step pulses are one stepper timer tick wide (20us at 50kHz)
+    SERVO_STEP_RATE_MAX_HZ = 20000U,    // ~3 rev/sec, under the stepper tick limit of 25kHz
+    SERVO_SPEED_LIMIT_DPS  = 720U,      // degrees/sec the planner allows any shoulder to turn at
 
     //Error evaluation parameters
     SERVO_IDLE_POWER_ALERT_W = 40U,
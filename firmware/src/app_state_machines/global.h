@@ -119,6 +119,16 @@ typedef union    ///< Allow mapping int16 to uint16
 #define PERMIT()
 #endif
 
+//! \def CRITICAL_SECTION_CYCLES
+/// DWT cycle counter, used to time how long critical sections keep
+/// interrupts masked. See hal_system_speed_get_masked_cycles.
+#ifdef STM32F429xx
+#define CRITICAL_SECTION_CYCLES ( *(volatile uint32_t *)0xE0001004UL )
+
+extern uint32_t critical_section_entered;
+extern uint32_t critical_section_cycles_max;
+#endif
+
 //! \def CRITICAL_SECTION_START()
 /// Save the current interrupt state and then disable interrupts to
 /// enter a critical region of code.
@@ -130,7 +140,8 @@ typedef union    ///< Allow mapping int16 to uint16
 
 //! \def CRITICAL_SECTION_START()
 /// Save the current interrupt state and then disable interrupts to
-/// enter a critical region of code.
+/// enter a critical region of code. The outermost section notes the
+/// cycle counter so the time spent masked can be measured.
 #ifdef STM32F429xx
 #define CRITICAL_SECTION_START()              \
         do {                                  \
@@ -139,6 +150,10 @@ typedef union    ///< Allow mapping int16 to uint16
           "CPSID I\n\t"                       \
           "STRB R0, %[output]"                \
           : [output] "=m" (cpuSR) :: "r0");   \
+          if( !cpuSR )                        \
+          {                                   \
+            critical_section_entered = CRITICAL_SECTION_CYCLES; \
+          }                                   \
         } while(0)
 #else
 #define CRITICAL_SECTION_START()
@@ -150,6 +165,14 @@ typedef union    ///< Allow mapping int16 to uint16
 #ifdef STM32F429xx
 #define CRITICAL_SECTION_END()               \
         do{                                   \
+          if( !cpuSR )                        \
+          {                                   \
+            uint32_t masked_ = CRITICAL_SECTION_CYCLES - critical_section_entered; \
+            if( masked_ > critical_section_cycles_max ) \
+            {                                 \
+              critical_section_cycles_max = masked_; \
+            }                                 \
+          }                                   \
           asm (                               \
           "ldrb r0, %[input]\n\t"             \
           "msr PRIMASK,r0;\n\t"               \
@@ -7,9 +7,9 @@
 #include "clearpath.h"
 #include "sensors.h"
 
-#include "hal_delay.h"
 #include "hal_gpio.h"
 #include "hal_hard_ic.h"
+#include "hal_stepper.h"
 #include "hal_systick.h"
 
 #include "app_signals.h"
@@ -19,7 +19,6 @@
 #include "global.h"
 #include "qassert.h"
 #include "simple_state_machine.h"
-#include "status.h"
 
 /* ----- Defines ------------------------------------------------------------ */
 
@@ -126,12 +125,21 @@ PRIVATE int16_t convert_angle_steps( float kinematics_shoulder_angle );
 
 PRIVATE float convert_steps_angle( int16_t steps );
 
+PRIVATE void servo_post_target( ClearpathServoInstance_t servo );
+
 /* ----- Public Functions --------------------------------------------------- */
 
 PUBLIC void
 servo_init( ClearpathServoInstance_t servo )
 {
     memset( &clearpath[servo], 0, sizeof( Servo_t ) );
+
+    // Step pulses are generated by the timer driven stepper, which counts
+    // positive steps when driving clockwise
+    hal_stepper_configure( servo,
+                           ServoHardwareMap[servo].pin_step,
+                           ServoHardwareMap[servo].pin_direction,
+                           SERVO_DIR_CW );
 }
 
 /* -------------------------------------------------------------------------- */
@@ -165,6 +173,7 @@ servo_set_target_angle_limited( ClearpathServoInstance_t servo, float angle_degr
     if( angle_degrees > ( SERVO_MIN_ANGLE * -1 ) && angle_degrees < SERVO_MAX_ANGLE )
     {
         me->angle_target_steps = convert_angle_steps( angle_degrees );
+        servo_post_target( servo );
     }
 }
 
@@ -179,6 +188,32 @@ servo_set_target_angle_raw( ClearpathServoInstance_t servo, float angle_degrees
 
     const uint32_t steps_per_degree = ( 400 / SERVO_ANGLE_PER_REV );
    me->angle_target_steps = steps_per_degree * angle_degrees;
+   servo_post_target( servo );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Converts a kinematics angle into servo steps, false when the angle is outside the legal range
+PUBLIC bool
+servo_angle_to_steps( float angle_degrees, int16_t *steps )
+{
+    *steps = convert_angle_steps( angle_degrees );
+
+    return ( angle_degrees > ( SERVO_MIN_ANGLE * -1 ) && angle_degrees < SERVO_MAX_ANGLE );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Sets a target already converted and checked by servo_angle_to_steps
+PUBLIC void
+servo_set_target_steps( ClearpathServoInstance_t servo, int16_t steps )
+{
+    Servo_t *me = &clearpath[servo];
+
+    config_motor_target_angle( servo, convert_steps_angle( steps ) - SERVO_MIN_ANGLE );
+
+    me->angle_target_steps = steps;
+    servo_post_target( servo );
 }
 
 /* -------------------------------------------------------------------------- */
@@ -220,6 +255,32 @@ servo_get_servo_did_error( ClearpathServoInstance_t servo )
     return ( me->currentState == SERVO_STATE_ERROR_RECOVERY || me->previousState == SERVO_STATE_ERROR_RECOVERY || me->nextState == SERVO_STATE_ERROR_RECOVERY );
 }
 
+// Torque the servo reports over HLFB, -100% to 100% of rated with the arming trim removed
+PUBLIC float
+servo_get_feedback_percent( ClearpathServoInstance_t servo )
+{
+    return servo_get_hlfb_percent_corrected( servo );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Hand the target to the step generator, spreading the steps across one motion loop period
+PRIVATE void
+servo_post_target( ClearpathServoInstance_t servo )
+{
+    Servo_t *me = &clearpath[servo];
+
+    if( !servo_get_servo_ok( servo ) )
+    {
+        return;
+    }
+
+    int32_t  step_difference = me->angle_target_steps - hal_stepper_get_position( servo );
+    uint32_t step_rate       = (uint32_t)( ( step_difference < 0 ) ? -step_difference : step_difference ) * MOTION_LOOP_RATE_HZ;
+
+    hal_stepper_set_target( servo, me->angle_target_steps, MIN( step_rate, SERVO_STEP_RATE_MAX_HZ ) );
+}
+
 /* -------------------------------------------------------------------------- */
 
 // Returns uncorrected servo feedback torque as a percentage from -100% to 100% of rated capability
@@ -257,13 +318,15 @@ servo_process( ClearpathServoInstance_t servo )
     float servo_power    = sensors_servo_W( ServoHardwareMap[servo].adc_current );
     float servo_feedback = servo_get_hlfb_percent_corrected( servo );
 
+    // Pulses are emitted in the background, pick up the progress so far
+    me->angle_current_steps = hal_stepper_get_position( servo );
+
     switch( me->currentState )
     {
         case SERVO_STATE_INACTIVE:
             STATE_ENTRY_ACTION
             hal_gpio_write_pin( ServoHardwareMap[servo].pin_enable, SERVO_DISABLE );
-            hal_gpio_write_pin( ServoHardwareMap[servo].pin_step, false );
-            hal_gpio_write_pin( ServoHardwareMap[servo].pin_direction, false );
+            hal_stepper_stop( servo );
             me->enabled = SERVO_DISABLE;
 
             STATE_TRANSITION_TEST
@@ -282,8 +345,7 @@ servo_process( ClearpathServoInstance_t servo )
             STATE_ENTRY_ACTION
 
             hal_gpio_write_pin( ServoHardwareMap[servo].pin_enable, SERVO_DISABLE );
-            hal_gpio_write_pin( ServoHardwareMap[servo].pin_step, false );
-            hal_gpio_write_pin( ServoHardwareMap[servo].pin_direction, false );
+            hal_stepper_stop( servo );
 
             me->enabled = SERVO_DISABLE;
             me->timer   = hal_systick_get_ms();
@@ -446,6 +508,7 @@ servo_process( ClearpathServoInstance_t servo )
                 if( ( hal_systick_get_ms() - me->timer ) > SERVO_HOMING_SIMILARITY_MS )
                 {
                     me->angle_current_steps = convert_angle_steps( -42.0f );
+                    hal_stepper_set_position( servo, me->angle_current_steps );
                     config_motor_target_angle( servo, -42.0f );    // update UI with angles before a target is sent in
 
                     me->angle_target_steps = me->angle_current_steps;
@@ -544,46 +607,8 @@ servo_process( ClearpathServoInstance_t servo )
             STATE_ENTRY_ACTION
 
             STATE_TRANSITION_TEST
-            int16_t step_difference = me->angle_current_steps - me->angle_target_steps;
-            int8_t  step_direction  = 0;
-
-            // Command rotation to move towards the target position
-            if( step_difference != 0 )
-            {
-                // Command the target direction
-                if( me->angle_current_steps < me->angle_target_steps )
-                {
-                    hal_gpio_write_pin( ServoHardwareMap[servo].pin_direction, SERVO_DIR_CW );
-                    step_direction = -1;
-                }
-                else
-                {
-                    hal_gpio_write_pin( ServoHardwareMap[servo].pin_direction, SERVO_DIR_CCW );
-                    step_direction = 1;
-                }
-
-                uint16_t pulses_needed = step_difference * step_direction;
-
-                if( pulses_needed > 8 )
-                {
-                    pulses_needed = 8;
-                    status_yellow( true );    // visual debugging aid to see when speed limits are hit
-                }
-                else
-                {
-                    status_yellow( false );
-                }
-
-                for( uint16_t pulses = 0; pulses < pulses_needed; pulses++ )
-                {
-                    hal_gpio_toggle_pin( ServoHardwareMap[servo].pin_step );
-                    hal_delay_us( SERVO_PULSE_DURATION_US );
-                    hal_gpio_toggle_pin( ServoHardwareMap[servo].pin_step );
-                    hal_delay_us( SERVO_PULSE_DURATION_US );
-                    me->angle_current_steps = me->angle_current_steps + ( step_direction * -1 );
-                }
-            }
-            else
+            // Targets are posted to the stepper as they arrive, wait for it to catch up
+            if( me->angle_current_steps == me->angle_target_steps )
             {
                 STATE_NEXT( SERVO_STATE_IDLE );
             }
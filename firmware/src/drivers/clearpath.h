@@ -45,6 +45,12 @@ servo_set_target_angle_limited( ClearpathServoInstance_t servo, float angle_degr
 PUBLIC void
 servo_set_target_angle_raw( ClearpathServoInstance_t servo, float angle_degrees );
 
+PUBLIC bool
+servo_angle_to_steps( float angle_degrees, int16_t *steps );
+
+PUBLIC void
+servo_set_target_steps( ClearpathServoInstance_t servo, int16_t steps );
+
 PUBLIC float
 servo_get_current_angle( ClearpathServoInstance_t servo );
 
@@ -57,6 +63,9 @@ servo_get_servo_ok( ClearpathServoInstance_t servo );
 PUBLIC bool
 servo_get_servo_did_error( ClearpathServoInstance_t servo );
 
+PUBLIC float
+servo_get_feedback_percent( ClearpathServoInstance_t servo );
+
 /* -------------------------------------------------------------------------- */
 
 PUBLIC void
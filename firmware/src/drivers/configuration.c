@@ -1,3 +1,5 @@
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* ----- Local Includes ----------------------------------------------------- */
@@ -6,6 +8,7 @@
 #include "electricui.h"
 
 #include "app_task_ids.h"
+#include "app_task_supervisor.h"
 #include "app_tasks.h"
 
 #include "app_events.h"
@@ -13,9 +16,19 @@
 #include "app_times.h"
 #include "app_version.h"
 #include "buzzer.h"
+#include "event_pool.h"
 #include "event_subscribe.h"
 #include "hal_flashmem.h"
+#include "hal_motion_timer.h"
 #include "hal_uuid.h"
+#include "id_hash.h"
+#include "movement_batch.h"
+#include "movement_queue.h"
+#include "qassert.h"
+#include "telemetry.h"
+#include "trajectory_capture.h"
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
 
 typedef struct
 {
@@ -27,6 +40,8 @@ typedef struct
     uint8_t cpu_clock;    //speed in Mhz
 
     float input_voltage;    //voltage
+
+    uint32_t irq_masked_cycles;    //longest critical section since last update
 } SystemData_t;
 
 typedef struct
@@ -54,9 +69,24 @@ typedef struct
     uint8_t  queue_max;
     uint32_t waiting_max;
     uint32_t burst_max;
+    uint32_t latency_max;     // cycles from ready to dispatch
+    uint32_t dispatch_max;    // cycles spent in a single dispatch
+    uint32_t dropped;         // interrupt posts lost to a full ring or event queue
     char     name[12];    // human readable taskname set during app_tasks setup
 } Task_Info_t;
 
+// Event pool usage since start up, for sizing the pools from field data
+typedef struct
+{
+    uint16_t event_size;    // bytes per event
+    uint16_t total;         // events in the pool
+    uint16_t free;
+    uint16_t free_min;      // low-water mark
+    uint16_t largest;       // biggest event allocated from the pool, bytes
+    uint16_t reserved;      // keeps failed aligned
+    uint32_t failed;        // allocations that found the pool empty
+} Event_Pool_Info_t;
+
 typedef struct
 {
     // Dimensions used in the IK/FK calculations
@@ -113,6 +143,13 @@ typedef struct
     uint8_t lighting;
 } QueueDepths_t;
 
+// Items the host may send before it has to wait for another grant
+typedef struct
+{
+    uint8_t movements;
+    uint8_t lighting;
+} FlowCredits_t;
+
 typedef struct
 {
     uint8_t enabled;
@@ -155,10 +192,16 @@ typedef struct
     int16_t balance_total;
 } LedSettings_t;
 
-SystemData_t     sys_stats;
-BuildInfo_t      fw_info;
-Task_Info_t      task_info[TASK_MAX] = { 0 };
-KinematicsInfo_t mechanical_info;
+SystemData_t          sys_stats;
+HalMotionTimerStats_t motion_loop_stats;
+KinematicsTiming_t    kinematics_timing;
+MovementQueueStats_t  movement_queue_stats;
+HalUartStats_t        uart_stats[HAL_UART_NUM_PORTS];
+BuildInfo_t           fw_info;
+Task_Info_t           task_info[TASK_MAX] = { 0 };
+HalProfilerStats_t    profiler_stats[HAL_PROFILER_PROBES];
+Event_Pool_Info_t     event_pool_info[EVENT_POOL_MAX];
+KinematicsInfo_t      mechanical_info;
 
 FanData_t  fan_stats;
 FanCurve_t fan_curve[] = {
@@ -173,6 +216,8 @@ TempData_t temp_sensors;
 
 SystemStates_t sys_states;
 QueueDepths_t  queue_data;
+FlowCredits_t  flow_credits;
+FlowCredits_t  flow_credits_granted;    // last grant, lowered as the host spends it
 
 MotionData_t motion_global;
 #ifdef EXPANSION_SERVO
@@ -186,6 +231,19 @@ MotorData_t  motion_servo[3];
 PowerCalibration_t power_trims;
 
 Movement_t       motion_inbound;
+MovementBatch_t    motion_batch_inbound;
+MovementBatchAck_t motion_batch_ack;
+bool               batch_seen          = false;    // a batch has been accepted since boot or the last queue clear
+uint16_t           batch_last_sequence = 0;
+uint8_t            batch_last_count    = 0;        // movements carried by the last accepted batch
+uint8_t            batch_last_accepted = 0;        // of which were queued, a streamed resend carries on from here
+
+// A bulk upload is parsed from one inbound payload, the build raises eUI's limit to fit it
+_Static_assert( sizeof( MovementBatch_t ) <= PAYLOAD_SIZE_MAX, "MovementBatch_t is larger than an eUI payload" );
+
+// The task table goes out as one tracked variable
+_Static_assert( sizeof( task_info ) <= PAYLOAD_SIZE_MAX, "task_info is larger than an eUI payload" );
+
 CartesianPoint_t current_position;    //global position of end effector in cartesian space
 CartesianPoint_t target_position;
 
@@ -194,6 +252,11 @@ LedControl_t  rgb_manual_control;
 LedSettings_t rgb_led_settings;
 Fade_t        light_fade_inbound;
 
+TrajectoryCaptureArm_t    capture_arm;
+TrajectoryCaptureStatus_t capture_status;
+TrajectoryBlock_t         capture_block;
+uint16_t                  capture_request = 0;    // block sequence the host wants next
+
 float z_rotation = 0;
 
 char device_nickname[16] = "Zaphod Beeblebot";
@@ -205,16 +268,28 @@ PRIVATE void emergency_stop_cb( void );
 PRIVATE void home_mech_cb( void );
 PRIVATE void execute_motion_queue( void );
 PRIVATE void clear_all_queue( void );
-PRIVATE void tracked_position_event( void );
+PRIVATE void sync_begin_queues( void );
+
+// Handlers for tracked variables the UI writes, given the received payload length
+PRIVATE void mode_request_event( uint16_t length );
+PRIVATE void tracked_position_event( uint16_t length );
 #ifdef EXPANSION_SERVO
-PRIVATE void tracked_external_servo_request( void );
+PRIVATE void tracked_external_servo_request( uint16_t length );
 #endif
-
-PRIVATE void rgb_manual_led_event( void );
-PRIVATE void movement_generate_event( void );
-PRIVATE void lighting_generate_event( void );
-PRIVATE void sync_begin_queues( void );
-PRIVATE void trigger_camera_capture( void );
+PRIVATE void rgb_manual_led_event( uint16_t length );
+PRIVATE void movement_generate_event( uint16_t length );
+PRIVATE void movement_batch_event( uint16_t length );
+PRIVATE MovementBatchStatus_t movement_batch_order( const MovementBatch_t *batch, uint8_t *skip );
+PRIVATE void flow_credits_refresh( void );
+PRIVATE void flow_credits_grant_freed( void );
+PRIVATE uint8_t flow_credits_free( uint8_t task_id, uint16_t capacity, uint8_t queued );
+PRIVATE void lighting_generate_event( uint16_t length );
+PRIVATE void trigger_camera_capture( uint16_t length );
+PRIVATE void capture_arm_event( uint16_t length );
+PRIVATE void capture_block_event( uint16_t length );
+
+PRIVATE bool movement_from_host_allowed( void );
+PRIVATE void movement_enqueue( Movement_t *slot );
 
 PRIVATE void configuration_wipe( void );
 uint16_t     sync_id_val  = 0;
@@ -223,6 +298,14 @@ uint8_t      mode_request = 0;
 uint32_t camera_shutter_duration_ms = 0;
 
 eui_message_t ui_variables[] = {
+    // Streamed inbound buffers first, the library finds variables by walking this list
+    EUI_CUSTOM( "inmvb", motion_batch_inbound ),
+    EUI_CUSTOM( "inmv", motion_inbound ),
+    EUI_CUSTOM( "inlt", light_fade_inbound ),
+    EUI_INT32_ARRAY( "tpos", target_position ),
+    EUI_CUSTOM_RO( "mvack", motion_batch_ack ),
+    EUI_CUSTOM_RO( "crdt", flow_credits ),
+
     // Higher level system setup information
     EUI_CHAR_ARRAY_RO( "name", device_nickname ),
     EUI_CHAR_ARRAY_RO( "reset_type", reset_cause ),
@@ -230,6 +313,13 @@ eui_message_t ui_variables[] = {
     EUI_CUSTOM( "super", sys_states ),
     EUI_CUSTOM( "fwb", fw_info ),
     EUI_CUSTOM( "tasks", task_info ),
+    EUI_CUSTOM_RO( "prof", profiler_stats ),
+    EUI_CUSTOM_RO( "pools", event_pool_info ),
+    EUI_FUNC( "profclr", hal_profiler_clear ),
+    EUI_CUSTOM_RO( "mloop", motion_loop_stats ),
+    EUI_CUSTOM_RO( "ik", kinematics_timing ),
+    EUI_CUSTOM_RO( "mvq", movement_queue_stats ),
+    EUI_CUSTOM_RO( "uart", uart_stats ),
     EUI_CUSTOM_RO( "kinematics", mechanical_info ),
 
     // Temperature and cooling system
@@ -251,18 +341,20 @@ eui_message_t ui_variables[] = {
     EUI_CUSTOM( "hsv", rgb_manual_control ),
     EUI_CUSTOM( "ledset", rgb_led_settings ),
 
-    //inbound movement buffer and 'add to queue' callback
-    EUI_CUSTOM( "inlt", light_fade_inbound ),
-    EUI_CUSTOM( "inmv", motion_inbound ),
-
     EUI_FUNC( "stmv", execute_motion_queue ),
     EUI_FUNC( "clmv", clear_all_queue ),
     EUI_FUNC( "sync", sync_begin_queues ),
     EUI_UINT16( "syncid", sync_id_val ),
 
-    EUI_INT32_ARRAY( "tpos", target_position ),
     EUI_INT32_ARRAY_RO( "cpos", current_position ),
 
+    // Trajectory capture, armed by move ID and read back a block at a time
+    EUI_CUSTOM( "capt", capture_arm ),
+    EUI_UINT16( "capnx", capture_request ),
+    EUI_CUSTOM_RO( "capblk", capture_block ),
+    EUI_CUSTOM_RO( "capst", capture_status ),
+    EUI_FUNC( "capstp", trajectory_capture_stop ),
+
 #ifdef EXPANSION_SERVO
     EUI_FLOAT( "exp_ang", external_servo_angle_target),
 #endif
@@ -284,6 +376,77 @@ eui_message_t ui_variables[] = {
     EUI_FUNC( "wipe", configuration_wipe ),
 };
 
+/* -------------------------------------------------------------------------- */
+
+typedef struct
+{
+    const char *id;
+    void ( *handler )( uint16_t length );
+    bool requires_data;    // only fire when the packet carried a payload
+} TrackedHandler_t;
+
+PRIVATE const TrackedHandler_t tracked_handlers[] = {
+    { "inmvb", movement_batch_event, true },
+    { "inmv", movement_generate_event, true },
+    { "inlt", lighting_generate_event, true },
+    { "tpos", tracked_position_event, true },
+    { "req_mode", mode_request_event, false },
+#ifdef EXPANSION_SERVO
+    { "exp_ang", tracked_external_servo_request, true },
+#endif
+    { "hsv", rgb_manual_led_event, true },
+    { "ledset", rgb_manual_led_event, true },
+    { "capture", trigger_camera_capture, true },
+    { "capt", capture_arm_event, true },
+    { "capnx", capture_block_event, true },
+};
+
+// Message ID to tracked_handlers index, built once at init
+PRIVATE IdHash_t tracked_hash;
+
+PRIVATE void                    tracked_hash_build( void );
+PRIVATE const TrackedHandler_t *tracked_hash_find( const char *id );
+
+/* -------------------------------------------------------------------------- */
+
+// Smallest changes worth publishing before the periodic refresh
+#define TELEMETRY_POSITION_STEP_UM   50
+#define TELEMETRY_TEMPERATURE_STEP_C 0.5f
+#define TELEMETRY_VOLTAGE_STEP_V     0.1f
+#define TELEMETRY_CPU_LOAD_STEP      2
+#define TELEMETRY_FAN_STEP_RPM       30
+#define TELEMETRY_SERVO_FEEDBACK     10    // tenths of a percent
+#define TELEMETRY_SERVO_POWER_W      1.0f
+#define TELEMETRY_SERVO_ANGLE_DEG    0.1f
+
+PRIVATE bool telemetry_position_changed( const void *live, const void *published );
+PRIVATE bool telemetry_sys_changed( const void *live, const void *published );
+PRIVATE bool telemetry_temp_changed( const void *live, const void *published );
+PRIVATE bool telemetry_fan_changed( const void *live, const void *published );
+PRIVATE bool telemetry_servo_changed( const void *live, const void *published );
+
+// Status variables pushed to the UI, in priority order within each rate.
+// Upload replies ('mvack', 'crdt') are sent as soon as they're ready instead.
+PRIVATE const TelemetryChannel_t telemetry_channels[] = {
+    { "super", &sys_states, sizeof( sys_states ), TELEMETRY_RATE_FAST, 0 },
+    { "moStat", &motion_global, sizeof( motion_global ), TELEMETRY_RATE_FAST, 0 },
+    { "queue", &queue_data, sizeof( queue_data ), TELEMETRY_RATE_FAST, 0 },
+    { "cpos", &current_position, sizeof( current_position ), TELEMETRY_RATE_FAST, telemetry_position_changed },
+    { "servo", &motion_servo, sizeof( motion_servo ), TELEMETRY_RATE_NORMAL, telemetry_servo_changed },
+    { "rgb", &rgb_led_drive, sizeof( rgb_led_drive ), TELEMETRY_RATE_NORMAL, 0 },
+    { "sys", &sys_stats, sizeof( sys_stats ), TELEMETRY_RATE_SLOW, telemetry_sys_changed },
+    { "temp", &temp_sensors, sizeof( temp_sensors ), TELEMETRY_RATE_SLOW, telemetry_temp_changed },
+    { "fan", &fan_stats, sizeof( fan_stats ), TELEMETRY_RATE_SLOW, telemetry_fan_changed },
+    { "tasks", &task_info, sizeof( task_info ), TELEMETRY_RATE_SLOW, 0 },
+    { "prof", &profiler_stats, sizeof( profiler_stats ), TELEMETRY_RATE_SLOW, 0 },
+    { "pools", &event_pool_info, sizeof( event_pool_info ), TELEMETRY_RATE_SLOW, 0 },
+    { "mloop", &motion_loop_stats, sizeof( motion_loop_stats ), TELEMETRY_RATE_SLOW, 0 },
+    { "ik", &kinematics_timing, sizeof( kinematics_timing ), TELEMETRY_RATE_SLOW, 0 },
+    { "mvq", &movement_queue_stats, sizeof( movement_queue_stats ), TELEMETRY_RATE_SLOW, 0 },
+    { "uart", &uart_stats, sizeof( uart_stats ), TELEMETRY_RATE_SLOW, 0 },
+    { "capst", &capture_status, sizeof( capture_status ), TELEMETRY_RATE_NORMAL, 0 },
+};
+
 /* ----- Public Functions --------------------------------------------------- */
 
 PUBLIC void
@@ -292,6 +455,8 @@ configuration_init( void )
     //perform any setup here if needed
     configuration_set_defaults();
 
+    telemetry_init( telemetry_channels, DIM( telemetry_channels ) );
+
     // Load settings from flash memory
     //    configuration_load();
 }
@@ -355,6 +520,7 @@ PUBLIC void
 configuration_electric_setup( void )
 {
     EUI_TRACK( ui_variables );
+    tracked_hash_build();
     eui_setup_identifier( (char *)HAL_UUID, 12 );    //header byte is 96-bit, therefore 12-bytes
 }
 
@@ -367,70 +533,14 @@ configuration_eui_callback( uint8_t link, eui_interface_t *interface, uint8_t me
         case EUI_CB_TRACKED: {
             // UI received a tracked message ID and has completed processing
             eui_header_t header  = interface->packet.header;
-            void *       payload = interface->packet.data_in;
             uint8_t *    name_rx = interface->packet.id_in;
 
-            // See if the inbound packet name matches our intended variable
-            if( strcmp( (char *)name_rx, "req_mode" ) == 0 )
-            {
-
-                // Fire an event to the supervisor to change mode
-                switch( mode_request )
-                {
-                    case CONTROL_NONE:
-                        // TODO allow UI to request a no-mode setting?
-                        break;
-                    case CONTROL_MANUAL:
-                        eventPublish( EVENT_NEW( StateEvent, MODE_MANUAL ) );
-                        break;
-                    case CONTROL_EVENT:
-                        eventPublish( EVENT_NEW( StateEvent, MODE_EVENT ) );
-                        break;
-                    case CONTROL_DEMO:
-                        eventPublish( EVENT_NEW( StateEvent, MODE_DEMO ) );
-                        break;
-                    case CONTROL_TRACK:
-                        eventPublish( EVENT_NEW( StateEvent, MODE_TRACK ) );
-                        break;
-
-                    default:
-                        // Punish an incorrect attempt at mode changes with E-STOP
-                        eventPublish( EVENT_NEW( StateEvent, MOTION_EMERGENCY ) );
-                        break;
-                }
-            }
-
-            if( strcmp( (char *)name_rx, "inmv" ) == 0 && header.data_len )
-            {
-                movement_generate_event();
-            }
-
-            if( strcmp( (char *)name_rx, "inlt" ) == 0 && header.data_len )
-            {
-                lighting_generate_event();
-            }
-
-            if( strcmp( (char *)name_rx, "tpos" ) == 0 && header.data_len )
-            {
-                tracked_position_event();
-            }
+            // One hash and a confirming compare, rather than testing every handler name
+            const TrackedHandler_t *tracked = tracked_hash_find( (char *)name_rx );
 
-#ifdef EXPANSION_SERVO
-            if( strcmp( (char *)name_rx, "exp_ang" ) == 0 && header.data_len )
-            {
-                tracked_external_servo_request();
-            }
-#endif
-            
-            if( ( strcmp( (char *)name_rx, "hsv" ) == 0 || strcmp( (char *)name_rx, "ledset" ) == 0 )
-                && header.data_len )
+            if( tracked && ( header.data_len || !tracked->requires_data ) )
             {
-                rgb_manual_led_event();
-            }
-
-            if( strcmp( (char *)name_rx, "capture" ) == 0 && header.data_len )
-            {
-                trigger_camera_capture();
+                tracked->handler( header.data_len );
             }
 
             break;
@@ -491,6 +601,12 @@ config_set_cpu_clock( uint32_t clock )
     sys_stats.cpu_clock = clock / 1000000;    //convert to Mhz
 }
 
+PUBLIC void
+config_set_irq_masked_cycles( uint32_t cycles )
+{
+    sys_stats.irq_masked_cycles = cycles;
+}
+
 PUBLIC void
 config_update_task_statistics( void )
 {
@@ -499,12 +615,15 @@ config_update_task_statistics( void )
         StateTask *t = app_task_by_id( id );
         if( t )
         {
-            task_info[id].id          = t->id;
-            task_info[id].ready       = t->ready;
-            task_info[id].queue_used  = t->eventQueue.used;
-            task_info[id].queue_max   = t->eventQueue.max;
-            task_info[id].waiting_max = t->waiting_max;
-            task_info[id].burst_max   = t->burst_max;
+            task_info[id].id           = t->id;
+            task_info[id].ready        = t->ready;
+            task_info[id].queue_used   = t->eventQueue.used;
+            task_info[id].queue_max    = t->eventQueue.max;
+            task_info[id].waiting_max  = t->waiting_max;
+            task_info[id].burst_max    = t->burst_max;
+            task_info[id].latency_max  = t->latency_max;
+            task_info[id].dispatch_max = t->dispatch_max;
+            task_info[id].dropped      = t->dropped + t->interruptQueue.dropped;
 
             memset( &task_info[id].name, 0, sizeof( task_info[0].name ) );
             strcpy( (char *)&task_info[id].name, t->name );
@@ -513,6 +632,71 @@ config_update_task_statistics( void )
     //app_task_clear_statistics();
 }
 
+PUBLIC void
+config_update_profiler_statistics( void )
+{
+    hal_profiler_get_statistics( profiler_stats );
+}
+
+PUBLIC void
+config_update_event_pool_statistics( void )
+{
+    for( uint8_t pool = 0; pool < EVENT_POOL_MAX; pool++ )
+    {
+        EventPoolStatistics stats;
+
+        if( eventPoolGetStatistics( pool + 1, &stats ) )
+        {
+            event_pool_info[pool].event_size = stats.eventSize;
+            event_pool_info[pool].total      = stats.totalEvents;
+            event_pool_info[pool].free       = stats.freeEvents;
+            event_pool_info[pool].free_min   = stats.minimumEvents;
+            event_pool_info[pool].largest    = stats.largestEvent;
+            event_pool_info[pool].failed     = stats.failedEvents;
+        }
+    }
+}
+
+PUBLIC void
+config_set_motion_loop_statistics( HalMotionTimerStats_t *stats )
+{
+    memcpy( &motion_loop_stats, stats, sizeof( HalMotionTimerStats_t ) );
+}
+
+PUBLIC void
+config_set_kinematics_timing( KinematicsTiming_t *timing )
+{
+    memcpy( &kinematics_timing, timing, sizeof( KinematicsTiming_t ) );
+}
+
+PUBLIC void
+config_set_movement_queue_statistics( MovementQueueStats_t *stats )
+{
+    memcpy( &movement_queue_stats, stats, sizeof( MovementQueueStats_t ) );
+}
+
+PUBLIC void
+config_set_capture_status( TrajectoryCaptureStatus_t *status )
+{
+    memcpy( &capture_status, status, sizeof( TrajectoryCaptureStatus_t ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+config_set_uart_statistics( HalUartPort_t port, HalUartStats_t *stats )
+{
+    // Counters were cleared as they were read, keep a running total for the UI
+    HalUartStats_t *total = &uart_stats[port];
+
+    total->tx_bytes += stats->tx_bytes;
+    total->tx_dropped += stats->tx_dropped;
+    total->tx_dropped_bytes += stats->tx_dropped_bytes;
+    total->tx_backpressure += stats->tx_backpressure;
+    total->tx_peak_used = stats->tx_peak_used;
+    total->tx_capacity  = stats->tx_capacity;
+}
+
 
 /* -------------------------------------------------------------------------- */
 
@@ -540,14 +724,12 @@ config_set_main_state( uint8_t state )
 {
     sys_states.supervisor = state;
     sys_states.motors     = motion_servo[0].enabled || motion_servo[1].enabled || motion_servo[2].enabled;
-    eui_send_tracked( "super" );
 }
 
 PUBLIC void
 config_set_control_mode( uint8_t mode )
 {
     sys_states.control_mode = mode;
-    eui_send_tracked( "super" );
 }
 
 /* -------------------------------------------------------------------------- */
@@ -696,7 +878,7 @@ PUBLIC void
 config_set_motion_queue_depth( uint8_t utilisation )
 {
     queue_data.movements = utilisation;
-    //    eui_send_tracked("queue");
+    flow_credits_grant_freed();
 }
 
 PUBLIC float
@@ -776,11 +958,19 @@ config_set_led_values( uint16_t red, uint16_t green, uint16_t blue )
     rgb_led_drive.blue  = blue;
 }
 
+PUBLIC void
+config_get_led_values( uint16_t *red, uint16_t *green, uint16_t *blue )
+{
+    *red   = rgb_led_drive.red;
+    *green = rgb_led_drive.green;
+    *blue  = rgb_led_drive.blue;
+}
+
 PUBLIC void
 config_set_led_queue_depth( uint8_t utilisation )
 {
     queue_data.lighting = utilisation;
-    //    eui_send_tracked("queue");
+    flow_credits_grant_freed();
 }
 
 PUBLIC void
@@ -807,7 +997,7 @@ config_get_led_manual( float *h, float *s, float *l, uint8_t *en )
 }
 
 PRIVATE void
-rgb_manual_led_event()
+rgb_manual_led_event( uint16_t length )
 {
     LightingManualEvent *colour_request = EVENT_NEW( LightingManualEvent, LED_MANUAL_SET );
 
@@ -824,6 +1014,133 @@ rgb_manual_led_event()
 
 /* ----- Private Functions -------------------------------------------------- */
 
+PRIVATE void
+tracked_hash_build( void )
+{
+    idHashInit( &tracked_hash );
+
+    for( uint8_t i = 0; i < DIM( tracked_handlers ); i++ )
+    {
+        // Fails once the table is half full, ID_HASH_SLOTS needs raising
+        bool inserted = idHashInsert( &tracked_hash, tracked_handlers[i].id, i );
+
+        ENSURE( inserted );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE const TrackedHandler_t *
+tracked_hash_find( const char *id )
+{
+    int16_t index = idHashFind( &tracked_hash, id );
+
+    return ( index == ID_HASH_NOT_FOUND ) ? 0 : &tracked_handlers[index];
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+telemetry_position_changed( const void *live, const void *published )
+{
+    const CartesianPoint_t *now  = live;
+    const CartesianPoint_t *sent = published;
+
+    return abs( now->x - sent->x ) >= TELEMETRY_POSITION_STEP_UM
+           || abs( now->y - sent->y ) >= TELEMETRY_POSITION_STEP_UM
+           || abs( now->z - sent->z ) >= TELEMETRY_POSITION_STEP_UM;
+}
+
+PRIVATE bool
+telemetry_sys_changed( const void *live, const void *published )
+{
+    const SystemData_t *now  = live;
+    const SystemData_t *sent = published;
+
+    return now->sensors_enable != sent->sensors_enable
+           || now->module_enable != sent->module_enable
+           || now->cpu_clock != sent->cpu_clock
+           || abs( now->cpu_load - sent->cpu_load ) >= TELEMETRY_CPU_LOAD_STEP
+           || fabsf( now->input_voltage - sent->input_voltage ) >= TELEMETRY_VOLTAGE_STEP_V;
+}
+
+PRIVATE bool
+telemetry_temp_changed( const void *live, const void *published )
+{
+    const TempData_t *now  = live;
+    const TempData_t *sent = published;
+
+    return fabsf( now->pcb_ambient - sent->pcb_ambient ) >= TELEMETRY_TEMPERATURE_STEP_C
+           || fabsf( now->pcb_regulator - sent->pcb_regulator ) >= TELEMETRY_TEMPERATURE_STEP_C
+           || fabsf( now->external_probe - sent->external_probe ) >= TELEMETRY_TEMPERATURE_STEP_C
+           || fabsf( now->cpu_temp - sent->cpu_temp ) >= TELEMETRY_TEMPERATURE_STEP_C;
+}
+
+PRIVATE bool
+telemetry_fan_changed( const void *live, const void *published )
+{
+    const FanData_t *now  = live;
+    const FanData_t *sent = published;
+
+    return now->state != sent->state
+           || now->setpoint_percentage != sent->setpoint_percentage
+           || abs( now->speed_rpm - sent->speed_rpm ) >= TELEMETRY_FAN_STEP_RPM;
+}
+
+PRIVATE bool
+telemetry_servo_changed( const void *live, const void *published )
+{
+    const MotorData_t *now  = live;
+    const MotorData_t *sent = published;
+
+    for( uint8_t servo = 0; servo < DIM( motion_servo ); servo++ )
+    {
+        if( now[servo].enabled != sent[servo].enabled
+            || now[servo].state != sent[servo].state
+            || abs( now[servo].feedback - sent[servo].feedback ) >= TELEMETRY_SERVO_FEEDBACK
+            || fabsf( now[servo].power - sent[servo].power ) >= TELEMETRY_SERVO_POWER_W
+            || fabsf( now[servo].target_angle - sent[servo].target_angle ) >= TELEMETRY_SERVO_ANGLE_DEG )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+mode_request_event( uint16_t length )
+{
+    // Fire an event to the supervisor to change mode
+    switch( mode_request )
+    {
+        case CONTROL_NONE:
+            // TODO allow UI to request a no-mode setting?
+            break;
+        case CONTROL_MANUAL:
+            eventPublish( EVENT_NEW( StateEvent, MODE_MANUAL ) );
+            break;
+        case CONTROL_EVENT:
+            eventPublish( EVENT_NEW( StateEvent, MODE_EVENT ) );
+            break;
+        case CONTROL_DEMO:
+            eventPublish( EVENT_NEW( StateEvent, MODE_DEMO ) );
+            break;
+        case CONTROL_TRACK:
+            eventPublish( EVENT_NEW( StateEvent, MODE_TRACK ) );
+            break;
+
+        default:
+            // Punish an incorrect attempt at mode changes with E-STOP
+            eventPublish( EVENT_NEW( StateEvent, MOTION_EMERGENCY ) );
+            break;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
 PRIVATE void start_mech_cb( void )
 {
     eventPublish( EVENT_NEW( StateEvent, MECHANISM_START ) );
@@ -852,18 +1169,214 @@ PRIVATE void home_mech_cb( void )
 
 /* -------------------------------------------------------------------------- */
 
-PRIVATE void movement_generate_event( void )
+PRIVATE void movement_generate_event( uint16_t length )
+{
+    Movement_t *slot = NULL;
+
+    if( !movement_from_host_allowed() )
+    {
+        config_report_error( "Movement needs event or manual mode" );
+    }
+    else if( ( slot = movement_queue_reserve() ) )
+    {
+        memcpy( slot, &motion_inbound, sizeof( Movement_t ) );
+        movement_enqueue( slot );
+    }
+    else
+    {
+        //queue full, clearly the input motion processor isn't abiding by the spec.
+        config_report_error( "Motion Queue Full" );
+        eventPublish( EVENT_NEW( StateEvent, MOTION_ERROR ) );
+    }
+
+    memset( &motion_inbound, 0, sizeof( motion_inbound ) );
+}
+
+// The event and manual modes run movements from the host, the others generate their own
+PRIVATE bool movement_from_host_allowed( void )
+{
+    return sys_states.supervisor == SUPERVISOR_ARMED
+           && ( sys_states.control_mode == CONTROL_EVENT || sys_states.control_mode == CONTROL_MANUAL );
+}
+
+// Queue a movement written into a reserved slot, manual mode runs it straight away
+PRIVATE void movement_enqueue( Movement_t *slot )
+{
+    if( movement_queue_commit( slot ) && sys_states.control_mode == CONTROL_MANUAL )
+    {
+        eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Queue every movement in a bulk upload and answer with one acknowledgement.
+// The batch is checked as a whole first so a corrupt upload queues nothing,
+// and a resend of the last accepted sequence (lost ack) isn't queued twice.
+// Outside the modes which take movements the batch is refused without touching
+// the sequence tracking, so the same batch can be sent again once armed.
+// Records are decoded straight into the movement queue's slots.
+PRIVATE void movement_batch_event( uint16_t length )
+{
+    MovementBatchStatus_t status   = movement_batch_validate( &motion_batch_inbound, length );
+    uint8_t               skip     = 0;
+    uint8_t               accepted = 0;
+
+    if( status == BATCH_ACCEPTED && !movement_from_host_allowed() )
+    {
+        config_report_error( "Movement needs event or manual mode" );
+        status = BATCH_REFUSED;
+    }
+
+    if( status == BATCH_ACCEPTED )
+    {
+        status = movement_batch_order( &motion_batch_inbound, &skip );
+    }
+
+    if( status == BATCH_ACCEPTED )
+    {
+        MovementBatchReader_t reader;
+        Movement_t            discard;
+
+        movement_batch_reader_init( &reader );
+        accepted = skip;
+
+        for( uint8_t index = 0; index < motion_batch_inbound.count; index++ )
+        {
+            Movement_t *slot = &discard;
+
+            // Records queued by an earlier send of this batch are decoded to move the reader along
+            if( index >= skip )
+            {
+                slot = movement_queue_reserve();
+
+                if( !slot )
+                {
+                    status = BATCH_QUEUE_FULL;
+                    break;
+                }
+            }
+
+            // The batch was validated, every record decodes
+            movement_batch_read( &motion_batch_inbound, &reader, slot );
+
+            if( index < skip )
+            {
+                continue;
+            }
+
+            // A movement failing its checks is reported and consumed, a resend won't retry it
+            if( slot != &discard )
+            {
+                movement_enqueue( slot );
+            }
+
+            accepted++;
+        }
+
+        batch_seen          = true;
+        batch_last_sequence = motion_batch_inbound.sequence;
+        batch_last_count    = motion_batch_inbound.count;
+        batch_last_accepted = accepted;
+    }
+
+    // Every ack is also a grant, the host tops the queues up against it
+    flow_credits_refresh();
+    flow_credits_granted = flow_credits;
+
+    motion_batch_ack.sequence         = motion_batch_inbound.sequence;
+    motion_batch_ack.status           = status;
+    motion_batch_ack.accepted         = accepted;
+    motion_batch_ack.movement_credits = flow_credits.movements;
+    motion_batch_ack.lighting_credits = flow_credits.lighting;
+    eui_send_tracked( "mvack" );
+
+    memset( &motion_batch_inbound, 0, sizeof( motion_batch_inbound ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Where a valid batch fits against the last accepted one. A plain upload is
+// only refused when it repeats the last sequence. A streamed batch has to
+// follow the last one, recent sequences are resends after a lost ack, and a
+// resend of a batch the queue filled part way through skips what was queued.
+PRIVATE MovementBatchStatus_t movement_batch_order( const MovementBatch_t *batch, uint8_t *skip )
+{
+    uint16_t behind   = (uint16_t)( batch_last_sequence - batch->sequence );
+    bool     complete = ( batch_last_accepted >= batch_last_count );
+
+    *skip = 0;
+
+    if( !batch_seen )
+    {
+        return BATCH_ACCEPTED;
+    }
+
+    if( !( batch->format & BATCH_STREAMED ) )
+    {
+        return ( behind == 0 ) ? BATCH_DUPLICATE : BATCH_ACCEPTED;
+    }
+
+    if( behind == 0 && !complete )
+    {
+        *skip = batch_last_accepted;
+        return BATCH_ACCEPTED;
+    }
+
+    if( behind < MOVEMENT_BATCH_RESEND_WINDOW )
+    {
+        return BATCH_DUPLICATE;
+    }
+
+    if( batch->sequence == (uint16_t)( batch_last_sequence + 1 ) && complete )
+    {
+        return BATCH_ACCEPTED;
+    }
+
+    return BATCH_OUT_OF_ORDER;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Free space in a task's request queue, less the requests already posted to
+// the task and not yet moved into it. Other events waiting on the task are
+// counted too, which only ever errs towards fewer credits.
+PRIVATE uint8_t flow_credits_free( uint8_t task_id, uint16_t capacity, uint8_t queued )
 {
-    MotionPlannerEvent *motion_request = EVENT_NEW( MotionPlannerEvent, MOVEMENT_REQUEST );
+    StateTask *task    = app_task_by_id( task_id );
+    uint16_t   pending = task ? eventQueueUsed( &task->eventQueue ) : 0;
+    uint16_t   used    = queued + pending;
+
+    return (uint8_t)( ( used < capacity ) ? capacity - used : 0 );
+}
 
-    if( motion_request )
+PRIVATE void flow_credits_refresh( void )
+{
+    // Movements go straight into their queue, there's nothing waiting on the task to count
+    flow_credits.movements = (uint8_t)MIN( movement_queue_free(), UINT8_MAX );
+    flow_credits.lighting  = flow_credits_free( TASK_LIGHTING, LED_QUEUE_DEPTH_MAX, queue_data.lighting );
+}
+
+// Called as the queues change. Credits the host spent are taken off the last
+// grant, and once enough have been freed by the queues draining a new grant
+// is pushed so a sender with nothing in flight isn't left waiting.
+PRIVATE void flow_credits_grant_freed( void )
+{
+    flow_credits_refresh();
+
+    flow_credits_granted.movements = MIN( flow_credits_granted.movements, flow_credits.movements );
+    flow_credits_granted.lighting  = MIN( flow_credits_granted.lighting, flow_credits.lighting );
+
+    if( flow_credits.movements >= flow_credits_granted.movements + FLOW_CREDIT_GRANT_STEP
+        || flow_credits.lighting >= flow_credits_granted.lighting + FLOW_CREDIT_GRANT_STEP )
     {
-        memcpy( &motion_request->move, &motion_inbound, sizeof( motion_inbound ) );
-        eventPublish( (StateEvent *)motion_request );
-        memset( &motion_inbound, 0, sizeof( motion_inbound ) );
+        flow_credits_granted = flow_credits;
+        eui_send_tracked( "crdt" );
     }
 }
 
+/* -------------------------------------------------------------------------- */
+
 PRIVATE void execute_motion_queue( void )
 {
     eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_START ) );
@@ -871,11 +1384,15 @@ PRIVATE void execute_motion_queue( void )
 
 PRIVATE void clear_all_queue( void )
 {
+    // Nothing is left queued, so a stream may start again from any sequence
+    batch_seen = false;
+
+    movement_queue_flush();
     eventPublish( EVENT_NEW( StateEvent, MOTION_QUEUE_CLEAR ) );
     eventPublish( EVENT_NEW( StateEvent, LED_CLEAR_QUEUE ) );
 }
 
-PRIVATE void tracked_position_event( void )
+PRIVATE void tracked_position_event( uint16_t length )
 {
     TrackedPositionRequestEvent *position_request = EVENT_NEW( TrackedPositionRequestEvent, TRACKED_TARGET_REQUEST );
 
@@ -888,7 +1405,7 @@ PRIVATE void tracked_position_event( void )
 }
 
 #ifdef EXPANSION_SERVO
-PRIVATE void tracked_external_servo_request( void )
+PRIVATE void tracked_external_servo_request( uint16_t length )
 {
     ExpansionServoRequestEvent *angle_request = EVENT_NEW( ExpansionServoRequestEvent, TRACKED_EXTERNAL_SERVO_REQUEST );
 
@@ -903,7 +1420,7 @@ PRIVATE void tracked_external_servo_request( void )
 
 /* -------------------------------------------------------------------------- */
 
-PRIVATE void lighting_generate_event( void )
+PRIVATE void lighting_generate_event( uint16_t length )
 {
     LightingPlannerEvent *lighting_request = EVENT_NEW( LightingPlannerEvent, LED_QUEUE_ADD );
 
@@ -931,7 +1448,7 @@ PRIVATE void sync_begin_queues( void )
 
 /* -------------------------------------------------------------------------- */
 PRIVATE void
-trigger_camera_capture( void )
+trigger_camera_capture( uint16_t length )
 {
     CameraShutterEvent *trigger = EVENT_NEW( CameraShutterEvent, CAMERA_CAPTURE );
 
@@ -943,4 +1460,30 @@ trigger_camera_capture( void )
     }
 }
 
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+capture_arm_event( uint16_t length )
+{
+    if( length != sizeof( TrajectoryCaptureArm_t ) )
+    {
+        return;
+    }
+
+    trajectory_capture_arm( &capture_arm );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// The host asks for each block by sequence, asking for the next one releases the
+// samples it already has and a repeated request covers a lost reply
+PRIVATE void
+capture_block_event( uint16_t length )
+{
+    (void)length;
+
+    trajectory_capture_read_block( capture_request, &capture_block );
+    eui_send_tracked( "capblk" );
+}
+
 /* ----- End ---------------------------------------------------------------- */
@@ -10,7 +10,13 @@ extern "C" {
 /* ----- Local Includes ----------------------------------------------------- */
 
 #include "global.h"
+#include "hal_motion_timer.h"
+#include "hal_profiler.h"
+#include "hal_uart.h"
+#include "kinematics.h"
 #include "motion_types.h"
+#include "movement_queue.h"
+#include "trajectory_capture.h"
 #include <electricui.h>
 
 /* ----- Defines ------------------------------------------------------------ */
@@ -82,9 +88,33 @@ config_set_cpu_load( uint8_t percent );
 PUBLIC void
 config_set_cpu_clock( uint32_t clock );
 
+PUBLIC void
+config_set_irq_masked_cycles( uint32_t cycles );
+
 PUBLIC void
 config_update_task_statistics( void );
 
+PUBLIC void
+config_update_profiler_statistics( void );
+
+PUBLIC void
+config_update_event_pool_statistics( void );
+
+PUBLIC void
+config_set_motion_loop_statistics( HalMotionTimerStats_t *stats );
+
+PUBLIC void
+config_set_kinematics_timing( KinematicsTiming_t *timing );
+
+PUBLIC void
+config_set_capture_status( TrajectoryCaptureStatus_t *status );
+
+PUBLIC void
+config_set_movement_queue_statistics( MovementQueueStats_t *stats );
+
+PUBLIC void
+config_set_uart_statistics( HalUartPort_t port, HalUartStats_t *stats );
+
 /* -------------------------------------------------------------------------- */
 
 PUBLIC void
@@ -206,6 +236,9 @@ config_set_led_status( uint8_t status );
 PUBLIC void
 config_set_led_values( uint16_t red, uint16_t green, uint16_t blue );
 
+PUBLIC void
+config_get_led_values( uint16_t *red, uint16_t *green, uint16_t *blue );
+
 PUBLIC void
 config_get_led_manual( float *h, float *s, float *l, uint8_t *en );
 
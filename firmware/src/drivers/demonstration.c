@@ -6,6 +6,7 @@
 
 #include "demonstration.h"
 #include "motion_types.h"
+#include "movement_queue.h"
 
 #include "app_events.h"
 #include "app_signals.h"
@@ -266,14 +267,14 @@ demonstration_emit_event( uint8_t sequence )
 
     if( sequence <= DIM( demo_one ) )
     {
-        // Generate the event
-        MotionPlannerEvent *motion_request = EVENT_NEW( MotionPlannerEvent, MOTION_QUEUE_ADD );
+        // Write the move straight into the movement queue
+        Movement_t *move = movement_queue_reserve();
 
-        if( motion_request )
+        if( move )
         {
-            memcpy( &motion_request->move, &demo_one[sequence], sizeof( Movement_t ) );
-            motion_request->move.identifier = sequence;    // set the ID of the move, as the demo array doesn't have any
-            eventPublish( (StateEvent *)motion_request );
+            memcpy( move, &demo_one[sequence], sizeof( Movement_t ) );
+            move->identifier = sequence;    // set the ID of the move, as the demo array doesn't have any
+            movement_queue_commit( move );
         }
     }
 }
@@ -1,80 +1,243 @@
 /* ----- System Includes ---------------------------------------------------- */
 #define _USE_MATH_DEFINES
+#include <float.h>
 #include <math.h>
+#include <string.h>
 
 /* ----- Local Includes ----------------------------------------------------- */
+#include "app_times.h"
 #include "configuration.h"
 #include "global.h"
+#include "hal_system_speed.h"
 #include "kinematics.h"
 #include "motion_types.h"
+#include "qassert.h"
 
 /* ----- Defines ------------------------------------------------------------ */
 
-//position offset between kinematics space and cartesian user-space
-CartesianPoint_t offset_position = {
-    x : 0,
-    y : 0,
-    z : MM_TO_MICRONS( 190 )
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+// Trig constants for the 120 degree arm spacing
+#define SIN120 ( 0.8660254f )
+#define COS120 ( -0.5f )
+#define SIN30  ( 0.5f )
+#define TAN60  ( 1.7320508f )
+#define TAN30  ( 0.5773503f )
+
+#define DEG_TO_RAD ( (float)M_PI / 180.0f )
+
+// Cylindrical bounds on the user-space movement volume
+#define VOLUME_RADIUS_MM 225
+#define VOLUME_Z_MIN_MM  0
+#define VOLUME_Z_MAX_MM  200
+
+// The reachable envelope is stored as a z range per square xy cell across the cylinder's diameter
+#define ENVELOPE_CELLS     ( ( 2 * VOLUME_RADIUS_MM ) / WORKSPACE_GRID_PITCH_MM )
+#define ENVELOPE_Z_SAMPLES ( ( ( VOLUME_Z_MAX_MM - VOLUME_Z_MIN_MM ) / WORKSPACE_Z_PITCH_MM ) + 1 )
+#define ENVELOPE_Z( sample ) ( MM_TO_MICRONS( VOLUME_Z_MIN_MM ) + (int32_t)( sample ) * MM_TO_MICRONS( WORKSPACE_Z_PITCH_MM ) )
+
+/* ----- Private Variables -------------------------------------------------- */
+
+// Mapping between the cartesian user-space and the kinematics domain
+typedef struct
+{
+    CartesianPoint_t offset;    // position offset between kinematics space and cartesian user-space
+
+    // Constrain motion to the practical parts of the movement volume
+    int32_t z_max;
+    int32_t z_min;
+    int32_t radius;
+
+    // Rotate the cartesian co-ordinate space
+    int8_t flip_x;
+    int8_t flip_y;
+    int8_t flip_z;
+} KinematicsFrame_t;
+
+// Delta geometry, and the terms derived from it once at init
+typedef struct
+{
+    float f;     // radius of motor shafts on base
+    float rf;    // base joint to elbow joint distance
+    float re;    // elbow joint to end affector joint
+    float e;     // end effector joint radius
+
+    float t;             // ( f - e ) * tan30 / 2, used by the FK
+    float base_y;        // motor shaft position in each arm's plane, -f/2 * tan30
+    float effector_y;    // effector joint offset in each arm's plane, e/2 * tan30
+    float arm_terms;     // rf^2 - re^2 - base_y^2, constant part of the IK plane equation
+} KinematicsGeometry_t;
+
+PRIVATE const KinematicsFrame_t frame = {
+    .offset = { .x = 0, .y = 0, .z = MM_TO_MICRONS( 190 ) },
+    .z_max  = MM_TO_MICRONS( VOLUME_Z_MAX_MM ),
+    .z_min  = MM_TO_MICRONS( VOLUME_Z_MIN_MM ),
+    .radius = MM_TO_MICRONS( VOLUME_RADIUS_MM ),
+    .flip_x = 1,
+    .flip_y = 1,
+    .flip_z = -1,
 };
 
-// Constrain motion to the practical parts of the movement volume
-int32_t z_max = MM_TO_MICRONS( 200 );
-int32_t z_min = MM_TO_MICRONS( 0 );
+PRIVATE KinematicsGeometry_t geometry = {
+    .f  = MM_TO_MICRONS( 50.0f ),
+    .rf = MM_TO_MICRONS( 180.0f ),
+    .re = MM_TO_MICRONS( 340.0f ),
+    .e  = MM_TO_MICRONS( 34.0f ),
+};
 
-int32_t radius = MM_TO_MICRONS( 225 );
+// Contiguous run of reachable z samples, empty when low > high
+typedef struct
+{
+    uint8_t z_low;
+    uint8_t z_high;
+} EnvelopeSpan_t;
 
-// Rotate the cartesian co-ordinate space
-int8_t flip_x = 1;
-int8_t flip_y = 1;
-int8_t flip_z = -1;
+// Built at init, indexed by [x][y] cell from the negative corner of the cylinder's bounding square
+PRIVATE EnvelopeSpan_t envelope[ENVELOPE_CELLS][ENVELOPE_CELLS];
 
-// Delta geometry defines
-float f  = MM_TO_MICRONS( 50.0f );     // radius of motor shafts on base
-float rf = MM_TO_MICRONS( 180.0f );    // base joint to elbow joint distance
-float re = MM_TO_MICRONS( 340.0f );    // elbow joint to end affector joint
-float e  = MM_TO_MICRONS( 34.0f );     // end effector joint radius
+// User rotation around Z, looked up by each caller so the motion ISR and
+// task context never share a half updated pair
+typedef struct
+{
+    float cos;
+    float sin;
+} KinematicsRotation_t;
 
-// cache common trig constants
-float sqrt3;
-float sin120;
-float sin30;
-float cos120;
-float tan60;
-float tan30;
+PRIVATE KinematicsTiming_t solve_timing;
 
-float deg_to_rad;
+PRIVATE void
+kinematics_rotation( KinematicsRotation_t *rotation );
 
-// Cache common calculations
-float t;
+PRIVATE void
+kinematics_rotate_z( const KinematicsRotation_t *rotation, CartesianPoint_t *point );
 
-/* ----- Private Variables -------------------------------------------------- */
+PRIVATE void
+kinematics_clamp_volume( CartesianPoint_t *point );
+
+PRIVATE void
+kinematics_to_mechanism_frame( const KinematicsRotation_t *rotation, CartesianPoint_t *point );
+
+PRIVATE void
+kinematics_offset_to_mechanism( CartesianPoint_t *point );
+
+PRIVATE void
+kinematics_build_envelope( void );
+
+PRIVATE EnvelopeSpan_t
+kinematics_column_span( int32_t x, int32_t y );
+
+PRIVATE const EnvelopeSpan_t *
+kinematics_envelope_lookup( int32_t x, int32_t y );
+
+PRIVATE KinematicsSolution_t
+kinematics_solve_arms( const CartesianPoint_t *point, JointAngles_t *output );
 
 PRIVATE KinematicsSolution_t
 delta_angle_plane_calc( float x0, float y0, float z0, float *theta );
 
-PRIVATE void
-kinematics_clamp_volume( CartesianPoint_t *point );
+PRIVATE KinematicsSolution_t
+delta_rate_plane_calc( float x0, float y0, float z0, float dx, float dy, float dz, float *rate );
 
 /* ----- Public Functions --------------------------------------------------- */
 
 PUBLIC void
 kinematics_init( void )
 {
-    // calculate/cache common trig constants
-    sqrt3  = sqrt( 3.0f );
-    sin120 = sqrt3 / 2.0f;
-    sin30  = 0.5f;
-    cos120 = -0.5f;
-    tan60  = sqrt3;
-    tan30  = 1 / sqrt3;
-
-    //cache common calculations
-    deg_to_rad = M_PI / 180.0f;
-    t          = ( f - e ) * tan30 / 2;
-
-    config_set_kinematics_mechanism_info( f, rf, re, e );
-    config_set_kinematics_limits( radius, z_min, z_max );
-    config_set_kinematics_flips( flip_x, flip_y, flip_z );
+    // Cache the geometry terms the solvers would otherwise recalculate per arm
+    geometry.t          = ( geometry.f - geometry.e ) * TAN30 / 2.0f;
+    geometry.base_y     = -0.5f * TAN30 * geometry.f;
+    geometry.effector_y = 0.5f * TAN30 * geometry.e;
+    geometry.arm_terms  = geometry.rf * geometry.rf - geometry.re * geometry.re - geometry.base_y * geometry.base_y;
+
+    kinematics_build_envelope();
+
+    config_set_kinematics_mechanism_info( geometry.f, geometry.rf, geometry.re, geometry.e );
+    config_set_kinematics_limits( frame.radius, frame.z_min, frame.z_max );
+    config_set_kinematics_flips( frame.flip_x, frame.flip_y, frame.flip_z );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+kinematics_get_timing( KinematicsTiming_t *timing, bool clear_peaks )
+{
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    memcpy( timing, &solve_timing, sizeof( KinematicsTiming_t ) );
+    if( clear_peaks )
+    {
+        solve_timing.cycles_max = 0;
+    }
+    CRITICAL_SECTION_END();
+}
+
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Check a user-space point against the reachable envelope without solving the IK.
+ *
+ * The point has to be inside the cylindrical volume, and inside the z range of
+ * its envelope cell, where every arm solves with some margin to the joint limits.
+ */
+
+PUBLIC bool
+kinematics_point_reachable( CartesianPoint_t point )
+{
+    KinematicsRotation_t rotation;
+
+    kinematics_rotation( &rotation );
+    kinematics_rotate_z( &rotation, &point );
+
+    if( point.z < frame.z_min || point.z > frame.z_max )
+    {
+        return false;
+    }
+
+    float distance2 = (float)point.x * (float)point.x + (float)point.y * (float)point.y;
+    float radius2   = (float)frame.radius * (float)frame.radius;
+
+    if( distance2 > radius2 )
+    {
+        return false;
+    }
+
+    const EnvelopeSpan_t *span = kinematics_envelope_lookup( point.x, point.y );
+
+    return ( span->z_low <= span->z_high
+             && point.z >= ENVELOPE_Z( span->z_low )
+             && point.z <= ENVELOPE_Z( span->z_high ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Look up the user configured rotation, the trig is skipped when there isn't one
+PRIVATE void
+kinematics_rotation( KinematicsRotation_t *rotation )
+{
+    float degrees = config_get_rotation_z();
+
+    if( degrees == 0.0f )
+    {
+        rotation->cos = 1.0f;
+        rotation->sin = 0.0f;
+        return;
+    }
+
+    rotation->cos = cosf( degrees * DEG_TO_RAD );
+    rotation->sin = sinf( degrees * DEG_TO_RAD );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Rotate around the Z axis
+PRIVATE void
+kinematics_rotate_z( const KinematicsRotation_t *rotation, CartesianPoint_t *point )
+{
+    float x = (float)point->x;
+    float y = (float)point->y;
+
+    point->x = x * rotation->cos - y * rotation->sin;
+    point->y = x * rotation->sin + y * rotation->cos;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -89,34 +252,224 @@ kinematics_init( void )
  * - if the point is within a naiive diamond area contained within the circle, exit
  * - perform a pythagorean distance check against the radius
  * - Calculate a scalar to clamp illegal positions to the circle radius
+ *
+ * The height is then clamped to the reachable span of the point's envelope cell.
+ * Cells with no reachable span are left to the IK solver to reject.
  */
 
 PRIVATE void
 kinematics_clamp_volume( CartesianPoint_t *point )
 {
     // Check 'height' is within the bounds
-    point->z = CLAMP( point->z, z_min, z_max );
+    point->z = CLAMP( point->z, frame.z_min, frame.z_max );
 
     uint32_t dx = abs( point->x );    // if using off-center circle, use abs(x - center_x)
     uint32_t dy = abs( point->y );
 
     // Quickly check if the point is outside the radius-sized diamond area inside the circle
-    if( ( dx + dy ) >= radius )
+    if( ( dx + dy ) >= frame.radius )
     {
         // Calculate and compare the distance properly
         float distance2 = (float)dx * (float)dx + (float)dy * (float)dy;
-        float radius2   = (float)radius * (float)radius;
+        float radius2   = (float)frame.radius * (float)frame.radius;
 
         // Clamp position within the circle's radius
         if( distance2 >= radius2 )    // Pythagorean distance check
         {
-            float scale_factor = radius2 / distance2;
+            float scale_factor = sqrtf( radius2 / distance2 );
             point->x *= scale_factor;
             point->y *= scale_factor;
         }
     }
 
-    // TODO consider conical volume restrictions to maximise usable area
+    const EnvelopeSpan_t *span = kinematics_envelope_lookup( point->x, point->y );
+
+    if( span->z_low <= span->z_high )
+    {
+        point->z = CLAMP( point->z, ENVELOPE_Z( span->z_low ), ENVELOPE_Z( span->z_high ) );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Find the envelope cell containing a user-space xy position, positions outside the grid use the edge cells
+PRIVATE const EnvelopeSpan_t *
+kinematics_envelope_lookup( int32_t x, int32_t y )
+{
+    int32_t cell_x = ( x + frame.radius ) / MM_TO_MICRONS( WORKSPACE_GRID_PITCH_MM );
+    int32_t cell_y = ( y + frame.radius ) / MM_TO_MICRONS( WORKSPACE_GRID_PITCH_MM );
+
+    cell_x = CLAMP( cell_x, 0, ENVELOPE_CELLS - 1 );
+    cell_y = CLAMP( cell_y, 0, ENVELOPE_CELLS - 1 );
+
+    return &envelope[cell_x][cell_y];
+}
+
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Build the reachable envelope from the geometry and joint limits.
+ *
+ * Each cell corner is a column of z samples, which are solved and checked for
+ * margin to the servo limits. A cell's span is the overlap of its four corner
+ * spans, so every sampled height in a cell is reachable from all of its corners.
+ *
+ * Only two rows of corner spans are held while walking the grid.
+ */
+
+PRIVATE void
+kinematics_build_envelope( void )
+{
+    EnvelopeSpan_t corners_previous[ENVELOPE_CELLS + 1];
+    EnvelopeSpan_t corners_next[ENVELOPE_CELLS + 1];
+
+    for( uint16_t cx = 0; cx <= ENVELOPE_CELLS; cx++ )
+    {
+        int32_t x = MM_TO_MICRONS( cx * WORKSPACE_GRID_PITCH_MM ) - frame.radius;
+
+        for( uint16_t cy = 0; cy <= ENVELOPE_CELLS; cy++ )
+        {
+            int32_t y = MM_TO_MICRONS( cy * WORKSPACE_GRID_PITCH_MM ) - frame.radius;
+
+            corners_next[cy] = kinematics_column_span( x, y );
+        }
+
+        if( cx > 0 )
+        {
+            for( uint16_t cy = 0; cy < ENVELOPE_CELLS; cy++ )
+            {
+                EnvelopeSpan_t *cell = &envelope[cx - 1][cy];
+
+                cell->z_low  = MAX( MAX( corners_previous[cy].z_low, corners_previous[cy + 1].z_low ),
+                                    MAX( corners_next[cy].z_low, corners_next[cy + 1].z_low ) );
+                cell->z_high = MIN( MIN( corners_previous[cy].z_high, corners_previous[cy + 1].z_high ),
+                                    MIN( corners_next[cy].z_high, corners_next[cy + 1].z_high ) );
+            }
+        }
+
+        memcpy( corners_previous, corners_next, sizeof( corners_previous ) );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Find the longest run of reachable z samples in a column at a user-space xy position
+PRIVATE EnvelopeSpan_t
+kinematics_column_span( int32_t x, int32_t y )
+{
+    EnvelopeSpan_t span = { .z_low = 1, .z_high = 0 };
+
+    // Corners well outside the cylinder only border cells that get clamped away from them
+    float distance2 = (float)x * (float)x + (float)y * (float)y;
+    float reach     = (float)frame.radius + MM_TO_MICRONS( 1.5f * WORKSPACE_GRID_PITCH_MM );
+
+    if( distance2 > reach * reach )
+    {
+        return span;
+    }
+
+    const float margin    = WORKSPACE_JOINT_MARGIN_DECIDEG / 10.0f;
+    const float angle_min = -(float)SERVO_MIN_ANGLE + margin;
+    const float angle_max = (float)SERVO_MAX_ANGLE - margin;
+
+    uint8_t run_start  = 0;
+    uint8_t run_count  = 0;
+    uint8_t best_count = 0;
+
+    for( uint8_t sample = 0; sample < ENVELOPE_Z_SAMPLES; sample++ )
+    {
+        CartesianPoint_t point  = { .x = x, .y = y, .z = ENVELOPE_Z( sample ) };
+        JointAngles_t    angles = { 0 };
+
+        kinematics_offset_to_mechanism( &point );
+
+        bool reachable = ( kinematics_solve_arms( &point, &angles ) == SOLUTION_VALID )
+                         && angles.a1 >= angle_min && angles.a1 <= angle_max
+                         && angles.a2 >= angle_min && angles.a2 <= angle_max
+                         && angles.a3 >= angle_min && angles.a3 <= angle_max;
+
+        if( reachable )
+        {
+            if( run_count == 0 )
+            {
+                run_start = sample;
+            }
+
+            run_count++;
+
+            if( run_count > best_count )
+            {
+                best_count  = run_count;
+                span.z_low  = run_start;
+                span.z_high = sample;
+            }
+        }
+        else
+        {
+            run_count = 0;
+        }
+    }
+
+    return span;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Move a user-space point into the frame the arm solver works in
+PRIVATE void
+kinematics_to_mechanism_frame( const KinematicsRotation_t *rotation, CartesianPoint_t *point )
+{
+    // Apply an optional rotation around the Z axis
+    kinematics_rotate_z( rotation, point );
+
+    // Limit attempts at out-of-bounds positions
+    kinematics_clamp_volume( point );
+
+    kinematics_offset_to_mechanism( point );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Offset the work-area position frame into the kinematics domain position
+PRIVATE void
+kinematics_offset_to_mechanism( CartesianPoint_t *point )
+{
+    point->x = ( point->x + frame.offset.x ) * frame.flip_x;
+    point->y = ( point->y + frame.offset.y ) * frame.flip_y;
+    point->z = ( point->z + frame.offset.z ) * frame.flip_z;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Solve each arm in its own plane, for a point already in the mechanism frame
+PRIVATE KinematicsSolution_t
+kinematics_solve_arms( const CartesianPoint_t *point, JointAngles_t *output )
+{
+    float x = (float)point->x;
+    float y = (float)point->y;
+    float z = (float)point->z;
+
+    KinematicsSolution_t status = delta_angle_plane_calc( x, y, z, &output->a1 );
+
+    if( status == SOLUTION_VALID )
+    {
+        // Rotate +120 degrees
+        status = delta_angle_plane_calc( x * COS120 + y * SIN120,
+                                         y * COS120 - x * SIN120,
+                                         z,
+                                         &output->a2 );
+    }
+
+    if( status == SOLUTION_VALID )
+    {
+        // Rotate -120 degrees
+        status = delta_angle_plane_calc( x * COS120 - y * SIN120,
+                                         y * COS120 + x * SIN120,
+                                         z,
+                                         &output->a3 );
+    }
+
+    return status;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -135,36 +488,121 @@ kinematics_clamp_volume( CartesianPoint_t *point )
 PUBLIC KinematicsSolution_t
 kinematics_point_to_angle( CartesianPoint_t input, JointAngles_t *output )
 {
-    // Apply an optional rotation around the Z axis
-    cartesian_point_rotate_around_z( &input, config_get_rotation_z() );
+    uint32_t             cycles_start = hal_system_speed_get_cycles();
+    KinematicsRotation_t rotation;
 
-    // Limit attempts at out-of-bounds positions
-    kinematics_clamp_volume( &input );
+    kinematics_rotation( &rotation );
+    kinematics_to_mechanism_frame( &rotation, &input );
+
+    KinematicsSolution_t status = kinematics_solve_arms( &input, output );
+
+    uint32_t cycles_used = hal_system_speed_get_cycles() - cycles_start;
+
+    solve_timing.cycles = cycles_used;
+    solve_timing.solves++;
+    if( status != SOLUTION_VALID )
+    {
+        solve_timing.unsolved++;
+    }
+    if( cycles_used > solve_timing.cycles_max )
+    {
+        solve_timing.cycles_max = cycles_used;
+    }
+
+    return status;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Solve a contiguous run of points, writing the angles into the matching index of output.
+ *
+ * The user rotation is looked up once for the whole run into a local, and
+ * nothing here touches the per-tick timing stats, so it's safe to call from
+ * task context while the motion ISR is solving.
+ *
+ * Stops at the first point without a solution.
+ * Returns the number of leading points solved, count when all of them are valid.
+ */
+
+PUBLIC size_t
+kinematics_solve_batch( const CartesianPoint_t *input, JointAngles_t *output, size_t count )
+{
+    REQUIRE( input );
+    REQUIRE( output );
+
+    KinematicsRotation_t rotation;
+
+    kinematics_rotation( &rotation );
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        CartesianPoint_t point = input[i];
+
+        kinematics_to_mechanism_frame( &rotation, &point );
+
+        if( kinematics_solve_arms( &point, &output[i] ) != SOLUTION_VALID )
+        {
+            return i;
+        }
+    }
+
+    return count;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Accept a position and a small displacement from it, write the resulting change
+ * in each motor angle (degrees) into the provided pointer.
+ *
+ * This is the inverse Jacobian of the delta, solved per arm in closed form.
+ * Each arm keeps the distance from its elbow to the effector joint fixed, so
+ * differentiating |E - J|^2 = re^2 gives (E - J).dE = (E - J).(dJ/dtheta) dtheta
+ *
+ * The displacement goes through the same rotation and flips as the IK position.
+ * Returns an error when the position is unreachable or an arm is singular.
+ */
+
+PUBLIC KinematicsSolution_t
+kinematics_point_to_angle_delta( CartesianPoint_t input, CartesianPoint_t delta, JointAngles_t *output )
+{
+    KinematicsRotation_t rotation;
+
+    kinematics_rotation( &rotation );
+    kinematics_to_mechanism_frame( &rotation, &input );
+
+    // The displacement only needs the rotation and flips, not the clamp and offset
+    kinematics_rotate_z( &rotation, &delta );
 
-    // Offset the work-area position frame into the kinematics domain position
-    input.x = ( input.x + offset_position.x ) * flip_x;
-    input.y = ( input.y + offset_position.y ) * flip_y;
-    input.z = ( input.z + offset_position.z ) * flip_z;
+    delta.x *= frame.flip_x;
+    delta.y *= frame.flip_y;
+    delta.z *= frame.flip_z;
 
-    // Perform kinematics calculations
-    uint8_t status = delta_angle_plane_calc( input.x, input.y, input.z, &output->a1 );
+    KinematicsSolution_t status = delta_rate_plane_calc( input.x, input.y, input.z, delta.x, delta.y, delta.z, &output->a1 );
 
     if( status == SOLUTION_VALID )
     {
         // Rotate +120 degrees
-        status = delta_angle_plane_calc( input.x * cos120 + input.y * sin120,
-                                         input.y * cos120 - input.x * sin120,
-                                         input.z,
-                                         &output->a2 );
+        status = delta_rate_plane_calc( input.x * COS120 + input.y * SIN120,
+                                        input.y * COS120 - input.x * SIN120,
+                                        input.z,
+                                        delta.x * COS120 + delta.y * SIN120,
+                                        delta.y * COS120 - delta.x * SIN120,
+                                        delta.z,
+                                        &output->a2 );
     }
 
     if( status == SOLUTION_VALID )
     {
         // Rotate -120 degrees
-        status = delta_angle_plane_calc( input.x * cos120 - input.y * sin120,
-                                         input.y * cos120 + input.x * sin120,
-                                         input.z,
-                                         &output->a3 );
+        status = delta_rate_plane_calc( input.x * COS120 - input.y * SIN120,
+                                        input.y * COS120 + input.x * SIN120,
+                                        input.z,
+                                        delta.x * COS120 - delta.y * SIN120,
+                                        delta.y * COS120 + delta.x * SIN120,
+                                        delta.z,
+                                        &output->a3 );
     }
 
     return status;
@@ -183,20 +621,25 @@ kinematics_point_to_angle( CartesianPoint_t input, JointAngles_t *output )
 PUBLIC KinematicsSolution_t
 kinematics_angle_to_point( JointAngles_t input, CartesianPoint_t *output )
 {
-    input.a1 *= deg_to_rad;
-    input.a2 *= deg_to_rad;
-    input.a3 *= deg_to_rad;
+    // Work in mm, the squared and quartic terms overflow a float in microns
+    float t  = geometry.t / 1000.0f;
+    float rf = geometry.rf / 1000.0f;
+    float re = geometry.re / 1000.0f;
 
-    float y1 = -( t + rf * cos( input.a1 ) );
-    float z1 = -rf * sin( input.a1 );
+    input.a1 *= DEG_TO_RAD;
+    input.a2 *= DEG_TO_RAD;
+    input.a3 *= DEG_TO_RAD;
 
-    float y2 = ( t + rf * cos( input.a2 ) ) * sin30;
-    float x2 = y2 * tan60;
-    float z2 = -rf * sin( input.a2 );
+    float y1 = -( t + rf * cosf( input.a1 ) );
+    float z1 = -rf * sinf( input.a1 );
 
-    float y3 = ( t + rf * cos( input.a3 ) ) * sin30;
-    float x3 = -y3 * tan60;
-    float z3 = -rf * sin( input.a3 );
+    float y2 = ( t + rf * cosf( input.a2 ) ) * SIN30;
+    float x2 = y2 * TAN60;
+    float z2 = -rf * sinf( input.a2 );
+
+    float y3 = ( t + rf * cosf( input.a3 ) ) * SIN30;
+    float x3 = -y3 * TAN60;
+    float z3 = -rf * sinf( input.a3 );
 
     float dnm = ( y2 - y1 ) * x3 - ( y3 - y1 ) * x2;
 
@@ -225,9 +668,11 @@ kinematics_angle_to_point( JointAngles_t input, CartesianPoint_t *output )
         return SOLUTION_ERROR;
     }
 
-    output->z = -(float)0.5f * ( b + sqrt( d ) ) / a;
-    output->x = ( a1 * output->z + b1 ) / dnm;
-    output->y = ( a2 * output->z + b2 ) / dnm;
+    float z = -(float)0.5f * ( b + sqrtf( d ) ) / a;
+
+    output->x = MM_TO_MICRONS( ( a1 * z + b1 ) / dnm );
+    output->y = MM_TO_MICRONS( ( a2 * z + b2 ) / dnm );
+    output->z = MM_TO_MICRONS( z );
 
     //todo correct the FK returned co-ordinates to undo the translations made in the IK stage
 
@@ -240,11 +685,12 @@ kinematics_angle_to_point( JointAngles_t input, CartesianPoint_t *output )
 PRIVATE KinematicsSolution_t
 delta_angle_plane_calc( float x0, float y0, float z0, float *theta )
 {
-    float y1 = -0.5f * 0.57735f * f;    // f/2 * tg 30
-    y0 -= 0.5f * 0.57735f * e;          // Shift center to edge
+    float y1 = geometry.base_y;
+    float rf = geometry.rf;
+    y0 -= geometry.effector_y;    // Shift center to edge
 
     // z = a + b*y
-    float a = ( x0 * x0 + y0 * y0 + z0 * z0 + rf * rf - re * re - y1 * y1 ) / ( 2.0f * z0 );
+    float a = ( x0 * x0 + y0 * y0 + z0 * z0 + geometry.arm_terms ) / ( 2.0f * z0 );
     float b = ( y1 - y0 ) / z0;
 
     // Discriminant
@@ -255,10 +701,54 @@ delta_angle_plane_calc( float x0, float y0, float z0, float *theta )
         return SOLUTION_ERROR;
     }
 
-    float yj = ( y1 - a * b - sqrt( d ) ) / ( b * b + 1 );    // choose the outer point
+    float yj = ( y1 - a * b - sqrtf( d ) ) / ( b * b + 1 );    // choose the outer point
     float zj = a + b * yj;
 
-    *theta = 180.0f * atan( -zj / ( y1 - yj ) ) / M_PI + ( ( yj > y1 ) ? 180.0f : 0.0f );
+    // atan2 covers the yj > y1 case in one call, keep the output in the same -90 to 270 range as before
+    float angle = atan2f( -zj, y1 - yj ) / DEG_TO_RAD;
+    *theta      = ( angle < -90.0f ) ? angle + 360.0f : angle;
+
+    return SOLUTION_VALID;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// helper function, calculates the change in theta1 (for YZ-pane) for a small effector displacement
+PRIVATE KinematicsSolution_t
+delta_rate_plane_calc( float x0, float y0, float z0, float dx, float dy, float dz, float *rate )
+{
+    float theta = 0.0f;
+
+    if( delta_angle_plane_calc( x0, y0, z0, &theta ) != SOLUTION_VALID )
+    {
+        return SOLUTION_ERROR;
+    }
+
+    float y1 = geometry.base_y;
+    float rf = geometry.rf;
+    y0 -= geometry.effector_y;    // Shift center to edge
+
+    // Elbow position, and its motion for a change in theta
+    float theta_rad = theta * DEG_TO_RAD;
+    float sin_theta = sinf( theta_rad );
+    float cos_theta = cosf( theta_rad );
+
+    float yj = y1 - rf * cos_theta;
+    float zj = -rf * sin_theta;
+
+    // Forearm vector from the elbow to the effector joint
+    float ey = y0 - yj;
+    float ez = z0 - zj;
+
+    float denominator = ey * rf * sin_theta - ez * rf * cos_theta;
+
+    // Forearm is in line with the bicep's direction of travel
+    if( fabsf( denominator ) < FLT_EPSILON * rf * geometry.re )
+    {
+        return SOLUTION_ERROR;
+    }
+
+    *rate = ( x0 * dx + ey * dy + ez * dz ) / denominator / DEG_TO_RAD;
 
     return SOLUTION_VALID;
 }
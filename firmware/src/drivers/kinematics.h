@@ -10,6 +10,14 @@
 
 /* ----- Types ------------------------------------------------------------- */
 
+typedef struct
+{
+    uint32_t cycles;        // CPU cycles used by the most recent IK solve
+    uint32_t cycles_max;    // worst IK solve since last clear
+    uint32_t solves;        // IK solves since boot
+    uint32_t unsolved;      // solves since boot that found no solution
+} KinematicsTiming_t;
+
 /* ----- Public Functions --------------------------------------------------- */
 
 PUBLIC void
@@ -17,14 +25,43 @@ kinematics_init( void );
 
 /* -------------------------------------------------------------------------- */
 
+/** Copy out the DWT cycle counts for the IK solver, optionally resetting the peak */
+
+PUBLIC void
+kinematics_get_timing( KinematicsTiming_t *timing, bool clear_peaks );
+
+/* -------------------------------------------------------------------------- */
+
+/** Single lookup against the reachable envelope built at init, for validating moves before they run */
+
+PUBLIC bool
+kinematics_point_reachable( CartesianPoint_t point );
+
+/* -------------------------------------------------------------------------- */
+
 PUBLIC KinematicsSolution_t
 kinematics_point_to_angle( CartesianPoint_t input, JointAngles_t *output );
 
 /* -------------------------------------------------------------------------- */
 
+/** Solve count points into the matching output angles, for whole-path checks and planning.
+ *  Returns how many leading points were solved, count when all of them are valid. */
+
+PUBLIC size_t
+kinematics_solve_batch( const CartesianPoint_t *input, JointAngles_t *output, size_t count );
+
+/* -------------------------------------------------------------------------- */
+
 PUBLIC KinematicsSolution_t
 kinematics_angle_to_point( JointAngles_t input, CartesianPoint_t *output );
 
 /* -------------------------------------------------------------------------- */
 
+/** Motor angle changes (degrees) for a small displacement of the effector at a position */
+
+PUBLIC KinematicsSolution_t
+kinematics_point_to_angle_delta( CartesianPoint_t input, CartesianPoint_t delta, JointAngles_t *output );
+
+/* -------------------------------------------------------------------------- */
+
 #endif /* KINEMATICS_H */
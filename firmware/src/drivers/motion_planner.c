@@ -0,0 +1,557 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "motion_planner.h"
+
+#include "app_times.h"
+#include "global.h"
+#include "kinematics.h"
+#include "motion_types.h"
+#include "qassert.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+// Moves shorter than this are treated as a dwell in place
+#define PLANNER_MIN_LENGTH_MM 0.001f
+
+/*
+ * The planner runs when a move is handed to the path interpolator. It resolves
+ * the move and the queued moves behind it into lengths and start/end tangents,
+ * then limits the speed at each junction using the junction deviation model:
+ * the effector rounds the corner on an arc which deviates no more than
+ * PLANNER_JUNCTION_DEVIATION_UM from the corner, at the centripetal limit.
+ *
+ * Each move also gets a speed cap, from the effector limit, the centripetal
+ * acceleration through its tightest bend, and the shoulder speed the delta's
+ * Jacobian needs along the path, which only bites towards the workspace edge.
+ *
+ * A backward pass from a stop at the end of the look-ahead window gives the
+ * fastest speed the next move can exit at while still being able to stop in
+ * time. The committed move then gets a trapezoidal profile which fits its
+ * requested duration, or is stretched if the acceleration limit can't do it.
+ */
+
+typedef struct
+{
+    float x;
+    float y;
+    float z;
+} PlannerVector_t;
+
+typedef struct
+{
+    float length;            // mm
+    float speed_limit;       // mm/s cap from the effector limit and the tightest bend in the path
+    float speed_nominal;     // mm/s average speed requested by the move duration
+    float speed_junction;    // mm/s limit at the junction into this move
+    float speed_entry;       // mm/s planned entry speed
+} PlannerBlock_t;
+
+typedef struct
+{
+    CartesianPoint_t end_position;      // where the last planned move finishes
+    PlannerVector_t  exit_direction;    // unit direction the last planned move finishes with
+    float            exit_speed;        // mm/s the last planned move finishes with
+} PlannerState_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE PlannerState_t planner_state;
+PRIVATE PlannerBlock_t blocks[PLANNER_LOOKAHEAD_DEPTH];
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE bool
+motion_planner_direction( CartesianPoint_t *from, CartesianPoint_t *to, PlannerVector_t *direction );
+
+PRIVATE void
+motion_planner_tangents( Movement_t *move, PlannerVector_t *start, PlannerVector_t *end );
+
+PRIVATE float
+motion_planner_junction_speed( PlannerVector_t *exit, PlannerVector_t *entry, float acceleration );
+
+PRIVATE float
+motion_planner_joint_ratio( Movement_t *move );
+
+PRIVATE void
+motion_planner_sample( const MotionProfile_t *profile, float time_s, float *distance, float *speed );
+
+PRIVATE void
+motion_planner_build_profile( MotionProfile_t *profile,
+                              float            length,
+                              float            speed_entry,
+                              float            speed_exit,
+                              float            speed_limit,
+                              float            duration,
+                              float            acceleration );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+motion_planner_reset( CartesianPoint_t position )
+{
+    memset( &planner_state, 0, sizeof( planner_state ) );
+    planner_state.end_position = position;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+motion_planner_halt( void )
+{
+    // No exit direction means the junction into the next move is taken from rest
+    memset( &planner_state.exit_direction, 0, sizeof( PlannerVector_t ) );
+    planner_state.exit_speed = 0.0f;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+motion_planner_plan( Movement_t *moves[], uint8_t count, MotionProfile_t *profile )
+{
+    REQUIRE( moves );
+    REQUIRE( moves[0] );
+    REQUIRE( count );
+    REQUIRE( profile );
+
+    float              acceleration  = EFFECTOR_ACCELERATION_LIMIT;
+    Movement_t         resolved      = { 0 };
+    CartesianPoint_t   origin        = planner_state.end_position;
+    PlannerVector_t    previous_exit = planner_state.exit_direction;
+    PlannerVector_t    first_exit    = { 0 };
+    CartesianPoint_t   first_end     = { 0 };
+    PlannerVector_t    entry_tangent = { 0 };
+    PlannerVector_t    exit_tangent  = { 0 };
+    ArcLengthTable_t   first_path    = { 0 };
+    MovementAnalysis_t analysis      = { 0 };
+
+    count = MIN( count, PLANNER_LOOKAHEAD_DEPTH );
+
+    // Resolve each move against the end of the one before it, then find its length and junction limit
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        PlannerBlock_t *block = &blocks[i];
+
+        memcpy( &resolved, moves[i], sizeof( Movement_t ) );
+        cartesian_move_apply_origin( &resolved, &origin );
+
+        if( i == 0 )
+        {
+            // The committed move is evaluated by distance along the path
+            cartesian_move_build_arc_table( &resolved, &first_path );
+        }
+
+        cartesian_move_analyse( &resolved, &analysis );
+        block->length = (float)analysis.length / 1000.0f;
+
+        // Centripetal acceleration v^2 * k through the tightest bend also has to respect the limit
+        block->speed_limit = EFFECTOR_SPEED_LIMIT;
+        if( analysis.curvature_peak > 0.0f )
+        {
+            block->speed_limit = MIN( block->speed_limit, sqrtf( acceleration / analysis.curvature_peak ) );
+        }
+
+        // Shoulder speed per unit of effector speed climbs towards the edge of the workspace
+        float joint_ratio = motion_planner_joint_ratio( &resolved );
+        if( joint_ratio > 0.0f )
+        {
+            block->speed_limit = MIN( block->speed_limit, SERVO_SPEED_LIMIT_DPS / joint_ratio );
+        }
+
+        if( block->length > PLANNER_MIN_LENGTH_MM && resolved.duration )
+        {
+            motion_planner_tangents( &resolved, &entry_tangent, &exit_tangent );
+            block->speed_nominal = MIN( block->length * 1000.0f / resolved.duration, block->speed_limit );
+        }
+        else
+        {
+            // A dwell has no direction, so the effector has to come to a stop either side of it
+            memset( &entry_tangent, 0, sizeof( PlannerVector_t ) );
+            memset( &exit_tangent, 0, sizeof( PlannerVector_t ) );
+            block->speed_nominal = 0.0f;
+        }
+
+        block->speed_junction = motion_planner_junction_speed( &previous_exit, &entry_tangent, acceleration );
+
+        origin        = *cartesian_move_end_point( &resolved );
+        previous_exit = exit_tangent;
+
+        if( i == 0 )
+        {
+            first_end  = origin;
+            first_exit = exit_tangent;
+        }
+    }
+
+    // Backward pass, assuming the effector needs to stop at the end of the look-ahead window
+    float speed_exit = 0.0f;
+
+    for( uint8_t i = count - 1; i >= 1; i-- )
+    {
+        PlannerBlock_t *block = &blocks[i];
+
+        float entry = MIN( block->speed_nominal, blocks[i - 1].speed_nominal );
+        entry       = MIN( entry, block->speed_junction );
+        entry       = MIN( entry, sqrtf( speed_exit * speed_exit + 2.0f * acceleration * block->length ) );
+
+        block->speed_entry = entry;
+        speed_exit         = entry;
+    }
+
+    // Forward pass for the committed move, the entry speed was fixed when the previous move was planned.
+    // The exit is never raised above what the next move can enter at, a move too short to shed
+    // its entry speed brakes harder instead, see motion_planner_build_profile()
+    float speed_entry = planner_state.exit_speed;
+    float length      = blocks[0].length;
+
+    speed_exit = MIN( speed_exit, sqrtf( speed_entry * speed_entry + 2.0f * acceleration * length ) );
+
+    motion_planner_build_profile( profile,
+                                  length,
+                                  speed_entry,
+                                  speed_exit,
+                                  blocks[0].speed_limit,
+                                  (float)moves[0]->duration / 1000.0f,
+                                  acceleration );
+
+    memcpy( &profile->path, &first_path, sizeof( ArcLengthTable_t ) );
+
+    // The next move picks up where this one leaves off
+    planner_state.end_position   = first_end;
+    planner_state.exit_direction = first_exit;
+    planner_state.exit_speed     = profile->speed_exit;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Called from the motion loop interrupt, so keep this to simple arithmetic
+PUBLIC float
+motion_planner_progress( MotionProfile_t *profile, float time_s )
+{
+    // Ramps are timed from the last replan
+    float time_ramp = time_s - profile->time_offset;
+
+    if( time_ramp >= profile->duration )
+    {
+        return 1.0f;
+    }
+
+    // Dwells and zero length moves just run out the clock
+    if( profile->length <= PLANNER_MIN_LENGTH_MM )
+    {
+        return time_s / profile->duration;
+    }
+
+    float distance = 0.0f;
+    float speed    = 0.0f;
+
+    motion_planner_sample( profile, time_ramp, &distance, &speed );
+
+    return MIN( ( profile->distance_offset + distance ) / profile->length, 1.0f );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+motion_planner_replan_stop( const MotionProfile_t *profile, float time_s, MotionProfile_t *replanned )
+{
+    REQUIRE( profile );
+    REQUIRE( replanned );
+
+    // Dwells, and moves which already finish at rest, stop without any help
+    if( profile->length <= PLANNER_MIN_LENGTH_MM || profile->speed_exit <= 0.0f )
+    {
+        return false;
+    }
+
+    float time_ramp = MAX( time_s - profile->time_offset, 0.0f );
+    float distance  = 0.0f;
+    float speed     = 0.0f;
+
+    if( time_ramp >= profile->duration )
+    {
+        // Already at the end point
+        return false;
+    }
+
+    motion_planner_sample( profile, time_ramp, &distance, &speed );
+
+    float distance_done = profile->distance_offset + distance;
+    float remaining     = profile->length - distance_done;
+
+    if( remaining <= PLANNER_MIN_LENGTH_MM )
+    {
+        return false;
+    }
+
+    // Carry on from the current speed without going faster than originally planned, then ramp down to rest
+    motion_planner_build_profile( replanned,
+                                  remaining,
+                                  speed,
+                                  0.0f,
+                                  MAX( profile->speed_cruise, speed ),
+                                  0.0f,
+                                  profile->acceleration );
+
+    memcpy( &replanned->path, &profile->path, sizeof( ArcLengthTable_t ) );
+
+    replanned->length          = profile->length;
+    replanned->time_offset     = MAX( time_s, profile->time_offset );
+    replanned->distance_offset = distance_done;
+
+    return true;
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// Unit vector from one point to another, false if the points are coincident
+PRIVATE bool
+motion_planner_direction( CartesianPoint_t *from, CartesianPoint_t *to, PlannerVector_t *direction )
+{
+    float dx = (float)( to->x - from->x );
+    float dy = (float)( to->y - from->y );
+    float dz = (float)( to->z - from->z );
+
+    float magnitude = sqrtf( dx * dx + dy * dy + dz * dz );
+
+    if( magnitude < 1.0f )
+    {
+        memset( direction, 0, sizeof( PlannerVector_t ) );
+        return false;
+    }
+
+    direction->x = dx / magnitude;
+    direction->y = dy / magnitude;
+    direction->z = dz / magnitude;
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Direction of travel at the start and end of a (resolved) movement
+PRIVATE void
+motion_planner_tangents( Movement_t *move, PlannerVector_t *start, PlannerVector_t *end )
+{
+    CartesianPoint_t *p           = move->points;
+    CartesianPoint_t *point_start = &p[_LINE_START];
+    CartesianPoint_t *point_end   = cartesian_move_end_point( move );
+    bool              start_ok    = false;
+    bool              end_ok      = false;
+
+    switch( move->type )
+    {
+        case _CATMULL_SPLINE:
+            point_start = &p[_CATMULL_START];
+            start_ok    = motion_planner_direction( &p[_CATMULL_CONTROL_A], &p[_CATMULL_END], start );
+            end_ok      = motion_planner_direction( &p[_CATMULL_START], &p[_CATMULL_CONTROL_B], end );
+            break;
+
+        case _BEZIER_QUADRATIC:
+            start_ok = motion_planner_direction( &p[_QUADRATIC_START], &p[_QUADRATIC_CONTROL], start );
+            end_ok   = motion_planner_direction( &p[_QUADRATIC_CONTROL], &p[_QUADRATIC_END], end );
+            break;
+
+        case _BEZIER_CUBIC:
+            start_ok = motion_planner_direction( &p[_CUBIC_START], &p[_CUBIC_CONTROL_A], start );
+            end_ok   = motion_planner_direction( &p[_CUBIC_CONTROL_B], &p[_CUBIC_END], end );
+            break;
+
+        case _POINT_TRANSIT:
+        case _LINE:
+        default:
+            break;
+    }
+
+    // Lines, and curves with a control point sitting on an end point, use the chord
+    if( !start_ok )
+    {
+        motion_planner_direction( point_start, point_end, start );
+    }
+
+    if( !end_ok )
+    {
+        motion_planner_direction( point_start, point_end, end );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Worst case shoulder rotation per mm of effector travel, sampled along a (resolved) movement
+PRIVATE float
+motion_planner_joint_ratio( Movement_t *move )
+{
+    CartesianPoint_t sample_a    = { 0, 0, 0 };
+    CartesianPoint_t sample_b    = { 0, 0, 0 };
+    JointAngles_t    angle_delta = { 0, 0, 0 };
+    float            ratio_peak  = 0.0f;
+
+    cartesian_point_on_move( move, 0.0f, &sample_a );
+
+    for( uint32_t i = 1; i <= PLANNER_JOINT_SAMPLES; i++ )
+    {
+        cartesian_point_on_move( move, (float)i / PLANNER_JOINT_SAMPLES, &sample_b );
+
+        CartesianPoint_t delta = { 0, 0, 0 };
+        delta.x                = sample_b.x - sample_a.x;
+        delta.y                = sample_b.y - sample_a.y;
+        delta.z                = sample_b.z - sample_a.z;
+
+        float distance = sqrtf( (float)delta.x * delta.x + (float)delta.y * delta.y + (float)delta.z * delta.z );
+
+        if( distance >= 1.0f
+            && kinematics_point_to_angle_delta( sample_a, delta, &angle_delta ) == SOLUTION_VALID )
+        {
+            float angle_peak = MAX( fabsf( angle_delta.a1 ), MAX( fabsf( angle_delta.a2 ), fabsf( angle_delta.a3 ) ) );
+
+            // degrees per micron to degrees per mm
+            ratio_peak = MAX( ratio_peak, angle_peak * 1000.0f / distance );
+        }
+
+        sample_a = sample_b;
+    }
+
+    return ratio_peak;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Distance (mm) and speed (mm/s) time_s after the start of the profile's ramps
+PRIVATE void
+motion_planner_sample( const MotionProfile_t *profile, float time_s, float *distance, float *speed )
+{
+    if( time_s < profile->time_accel )
+    {
+        *speed    = profile->speed_entry + profile->acceleration * time_s;
+        *distance = ( profile->speed_entry + 0.5f * profile->acceleration * time_s ) * time_s;
+    }
+    else if( time_s < profile->time_accel + profile->time_cruise )
+    {
+        *speed    = profile->speed_cruise;
+        *distance = profile->distance_accel + profile->speed_cruise * ( time_s - profile->time_accel );
+    }
+    else
+    {
+        float time_decel = MIN( time_s - profile->time_accel - profile->time_cruise, profile->time_decel );
+
+        *speed    = profile->speed_cruise - profile->deceleration * time_decel;
+        *distance = profile->distance_accel
+                    + profile->distance_cruise
+                    + ( profile->speed_cruise - 0.5f * profile->deceleration * time_decel ) * time_decel;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE float
+motion_planner_junction_speed( PlannerVector_t *exit, PlannerVector_t *entry, float acceleration )
+{
+    float dot_exit  = exit->x * exit->x + exit->y * exit->y + exit->z * exit->z;
+    float dot_entry = entry->x * entry->x + entry->y * entry->y + entry->z * entry->z;
+
+    // Starting from rest, or either side is a dwell
+    if( dot_exit < 0.5f || dot_entry < 0.5f )
+    {
+        return 0.0f;
+    }
+
+    // Cosine of the angle between the incoming and outgoing paths
+    float cos_theta = -( exit->x * entry->x + exit->y * entry->y + exit->z * entry->z );
+
+    if( cos_theta > 0.999999f )
+    {
+        // Full reversal
+        return 0.0f;
+    }
+
+    if( cos_theta < -0.999999f )
+    {
+        // Straight through, only the segment speeds apply
+        return FLT_MAX;
+    }
+
+    float sin_theta_d2 = sqrtf( 0.5f * ( 1.0f - cos_theta ) );
+    float deviation_mm = (float)PLANNER_JUNCTION_DEVIATION_UM / 1000.0f;
+
+    return sqrtf( acceleration * deviation_mm * sin_theta_d2 / ( 1.0f - sin_theta_d2 ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+motion_planner_build_profile( MotionProfile_t *profile,
+                              float            length,
+                              float            speed_entry,
+                              float            speed_exit,
+                              float            speed_limit,
+                              float            duration,
+                              float            acceleration )
+{
+    memset( profile, 0, sizeof( MotionProfile_t ) );
+
+    profile->length       = length;
+    profile->acceleration = acceleration;
+
+    if( length <= PLANNER_MIN_LENGTH_MM )
+    {
+        // Hold position for the requested time
+        profile->duration = duration;
+        return;
+    }
+
+    // A move too short to shed its entry speed down to the exit brakes harder than the limit,
+    // overshooting the junction into the next move would be worse
+    float deceleration = acceleration;
+
+    if( speed_entry * speed_entry - speed_exit * speed_exit > 2.0f * acceleration * length )
+    {
+        deceleration = ( speed_entry * speed_entry - speed_exit * speed_exit ) / ( 2.0f * length );
+    }
+
+    profile->deceleration = deceleration;
+
+    // Highest speed reachable with a triangular profile between the entry and exit speeds
+    float speed_peak = sqrtf( ( 2.0f * acceleration * deceleration * length
+                                + deceleration * speed_entry * speed_entry
+                                + acceleration * speed_exit * speed_exit )
+                              / ( acceleration + deceleration ) );
+
+    // Cruise speed which covers the length in exactly the requested duration,
+    // from 2vc^2 - 2(v0 + v1 + aT)vc + (2aL + v0^2 + v1^2) = 0
+    float b            = speed_entry + speed_exit + acceleration * duration;
+    float discriminant = b * b - 2.0f * ( 2.0f * acceleration * length + speed_entry * speed_entry + speed_exit * speed_exit );
+    float speed_cruise = speed_peak;
+
+    if( discriminant >= 0.0f )
+    {
+        speed_cruise = 0.5f * ( b - sqrtf( discriminant ) );
+    }
+
+    // When the acceleration limit can't meet the duration, the move is stretched
+    speed_cruise = MIN( speed_cruise, speed_peak );
+    speed_cruise = MIN( speed_cruise, speed_limit );
+    speed_cruise = MAX( speed_cruise, MAX( speed_entry, speed_exit ) );
+
+    profile->speed_entry  = speed_entry;
+    profile->speed_cruise = speed_cruise;
+    profile->speed_exit   = speed_exit;
+
+    profile->time_accel     = ( speed_cruise - speed_entry ) / acceleration;
+    profile->time_decel     = ( speed_cruise - speed_exit ) / deceleration;
+    profile->distance_accel = 0.5f * ( speed_entry + speed_cruise ) * profile->time_accel;
+
+    float distance_decel     = 0.5f * ( speed_cruise + speed_exit ) * profile->time_decel;
+    profile->distance_cruise = MAX( length - profile->distance_accel - distance_decel, 0.0f );
+    profile->time_cruise     = ( speed_cruise > 0.0f ) ? profile->distance_cruise / speed_cruise : 0.0f;
+
+    profile->duration = profile->time_accel + profile->time_cruise + profile->time_decel;
+}
+
+/* ----- End ---------------------------------------------------------------- */
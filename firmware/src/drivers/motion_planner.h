@@ -0,0 +1,79 @@
+#ifndef MOTION_PLANNER_H
+#define MOTION_PLANNER_H
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+#include "motion_types.h"
+
+/* ----- Types ------------------------------------------------------------- */
+
+// Trapezoidal speed profile for a single movement, in mm and seconds
+typedef struct
+{
+    float length;             // path length of the move, mm
+    float acceleration;       // mm/s^2 used for the ramps
+
+    float speed_entry;        // mm/s at the start of the move
+    float speed_cruise;       // mm/s during the constant speed section
+    float speed_exit;         // mm/s at the end of the move
+
+    float time_accel;         // seconds spent ramping from entry to cruise
+    float time_cruise;        // seconds spent at cruise
+    float time_decel;         // seconds spent ramping from cruise to exit
+    float distance_accel;     // mm covered while accelerating
+    float distance_cruise;    // mm covered at cruise
+
+    float duration;           // seconds for the whole move, from time_offset
+    float deceleration;       // mm/s^2 used for the ramp down to exit, only above acceleration to meet a lower exit
+
+    float time_offset;        // seconds into the move the ramps start from, non-zero once replanned
+    float distance_offset;    // mm covered before time_offset
+
+    ArcLengthTable_t path;    // maps distance along the move to the curve parameter
+} MotionProfile_t;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/** Forget the planned exit speed, the next move starts from rest at position */
+
+PUBLIC void
+motion_planner_reset( CartesianPoint_t position );
+
+/* -------------------------------------------------------------------------- */
+
+/** The moves planned after the last one handed out were dropped, so the next
+ *  move starts from rest where the last one finishes */
+
+PUBLIC void
+motion_planner_halt( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Plan the speed profile for moves[0], using the following moves as look-ahead.
+ *  Junction speeds are limited by the angle between segments, and the requested
+ *  duration is treated as a minimum so moves are only ever stretched. */
+
+PUBLIC void
+motion_planner_plan( Movement_t *moves[], uint8_t count, MotionProfile_t *profile );
+
+/* -------------------------------------------------------------------------- */
+
+/** Convert time since the move started (seconds) into 0.0 to 1.0 of the path */
+
+PUBLIC float
+motion_planner_progress( MotionProfile_t *profile, float time_s );
+
+/* -------------------------------------------------------------------------- */
+
+/** Plan a copy of a profile which comes to rest at the move's end, keeping the
+ *  position and speed it has at time_s (seconds since the move started). Used
+ *  when the moves it was going to blend into are dropped while it is loaded.
+ *  Returns false, leaving replanned untouched, if the move stops without help. */
+
+PUBLIC bool
+motion_planner_replan_stop( const MotionProfile_t *profile, float time_s, MotionProfile_t *replanned );
+
+/* -------------------------------------------------------------------------- */
+
+#endif /* MOTION_PLANNER_H */
@@ -12,6 +12,45 @@
 
 /* ----- Defines ------------------------------------------------------------ */
 
+// Curve samples taken when building an arc length table, before it's resampled down
+#define ARC_LENGTH_BUILD_SAMPLES 64U
+
+// Curve length integration stops refining when successive estimates agree this closely
+#define ARC_LENGTH_QUADRATURE_TOLERANCE_UM  1.0f
+#define ARC_LENGTH_QUADRATURE_INTERVALS_MAX 16U
+
+// Peak curvature is found on an even scan of the curve, then refined around the tightest sample
+#define CURVATURE_SCAN_SAMPLES 32U
+#define CURVATURE_REFINE_STEPS 12U
+
+// Derivative of a curve with respect to its parameter, d(t) = a + b*t + c*t^2 per axis
+typedef struct
+{
+    float a[3];
+    float b[3];
+    float c[3];
+} CurveDerivative_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+// 5-point Gauss-Legendre nodes and weights on [-1, 1]
+PRIVATE const float gauss_legendre_nodes[5]   = { -0.9061798459f, -0.5384693101f, 0.0f, 0.5384693101f, 0.9061798459f };
+PRIVATE const float gauss_legendre_weights[5] = { 0.2369268851f, 0.4786286705f, 0.5688888889f, 0.4786286705f, 0.2369268851f };
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE bool
+cartesian_curve_derivative( Movement_t *movement, CurveDerivative_t *derivative );
+
+PRIVATE float
+cartesian_curve_quadrature( CurveDerivative_t *derivative, uint32_t intervals );
+
+PRIVATE float
+cartesian_curve_curvature( CurveDerivative_t *derivative, float t );
+
+PRIVATE float
+cartesian_curve_curvature_peak( CurveDerivative_t *derivative );
+
 /* -------------------------------------------------------------------------- */
 
 /* ----- Public Functions --------------------------------------------------- */
@@ -51,12 +90,14 @@ cartesian_find_point_on_line( CartesianPoint_t *a, CartesianPoint_t *b, Cartesia
 PUBLIC void
 cartesian_point_rotate_around_z( CartesianPoint_t *a, float degrees )
 {
-    float radians = degrees * M_PI / 180.0f;
-    float cos_w   = cos( radians );
-    float sin_w   = sin( radians );
-
-    a->x = a->x * cos_w - a->y * sin_w;
-    a->y = a->x * sin_w + a->y * cos_w;
+    float radians = degrees * (float)M_PI / 180.0f;
+    float cos_w   = cosf( radians );
+    float sin_w   = sinf( radians );
+    float x       = (float)a->x;
+    float y       = (float)a->y;
+
+    a->x = x * cos_w - y * sin_w;
+    a->y = x * sin_w + y * cos_w;
     // a->z = a->z;     // we are rotating around z, so not needed
 }
 
@@ -66,68 +107,245 @@ cartesian_point_rotate_around_z( CartesianPoint_t *a, float degrees )
 PUBLIC int32_t
 cartesian_move_distance( Movement_t *movement )
 {
-    int32_t distance = 0;
+    MovementAnalysis_t analysis = { 0 };
+
+    cartesian_move_analyse( movement, &analysis );
 
-    if( movement )
+    return analysis.length;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Find the path length and tightest curvature of a movement.
+//
+// Curves are integrated as the length of their derivative with 5-point Gauss-Legendre
+// quadrature, doubling the number of intervals until the estimate stops changing.
+// The derivatives of all the supported curves are quadratics in t, so they're
+// reduced to coefficients once and each node costs a handful of multiplies.
+// The quadrature nodes can straddle a tight turn, so curvature gets its own search.
+PUBLIC void
+cartesian_move_analyse( Movement_t *movement, MovementAnalysis_t *analysis )
+{
+    analysis->length         = 0;
+    analysis->curvature_peak = 0.0f;
+
+    if( !movement )
     {
-        if( movement->ref == _POINT_TRANSIT || movement->ref == _LINE )
+        return;
+    }
+
+    if( movement->type == _POINT_TRANSIT || movement->type == _LINE )
+    {
+        // straight line 3D distance
+        analysis->length = cartesian_distance_between( &movement->points[0], &movement->points[1] );
+        return;
+    }
+
+    CurveDerivative_t derivative = { 0 };
+
+    if( !cartesian_curve_derivative( movement, &derivative ) )
+    {
+        return;
+    }
+
+    float length_previous = cartesian_curve_quadrature( &derivative, 1U );
+    float length          = length_previous;
+
+    for( uint32_t intervals = 2U; intervals <= ARC_LENGTH_QUADRATURE_INTERVALS_MAX; intervals *= 2U )
+    {
+        length = cartesian_curve_quadrature( &derivative, intervals );
+
+        if( fabsf( length - length_previous ) < ARC_LENGTH_QUADRATURE_TOLERANCE_UM )
         {
-            // straight line 3D distance
-            distance = cartesian_distance_between( &movement->points[0], &movement->points[1] );
+            break;
         }
-        else
+
+        length_previous = length;
+    }
+
+    analysis->length         = (int32_t)( length + 0.5f );
+    analysis->curvature_peak = cartesian_curve_curvature_peak( &derivative ) * 1000.0f;    // per micron to per mm
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Resolve a movement against the position it will start from.
+// Relative moves are offset by the origin, and transits become a line from the origin
+PUBLIC void
+cartesian_move_apply_origin( Movement_t *movement, CartesianPoint_t *origin )
+{
+    //apply current position to a relative movement
+    if( movement->ref == _POS_RELATIVE )
+    {
+        for( uint8_t i = 0; i < movement->num_pts; i++ )
         {
-            uint32_t         distance_sum   = 0;
-            CartesianPoint_t sample_point   = { 0, 0, 0 };
-            CartesianPoint_t previous_point = { 0, 0, 0 };
+            movement->points[i].x += origin->x;
+            movement->points[i].y += origin->y;
+            movement->points[i].z += origin->z;
+        }
+    }
 
-            // Copy the curve start point as the previous point, as first sample is non-zero
-            memcpy( &previous_point, &movement->points[0], sizeof( CartesianPoint_t ) );
+    // A transit move is from current position to point 1, so overwrite 0 with current position,
+    // and then reuse a normal line movement
+    if( movement->type == _POINT_TRANSIT )
+    {
+        if( movement->num_pts == 1 )
+        {
+            movement->points[1].x = movement->points[0].x;
+            movement->points[1].y = movement->points[0].y;
+            movement->points[1].z = movement->points[0].z;
+            movement->num_pts     = 2;
+        }
 
-            // iteratively sum over a series of sampled positions
-            for( uint32_t i = 1; i < SPEED_SAMPLE_RESOLUTION; i++ )
-            {
-                // convert the step into a 0-1 float for 'percentage across line' input
-                float sample_t = (float)i / SPEED_SAMPLE_RESOLUTION;
+        movement->points[0].x = origin->x;
+        movement->points[0].y = origin->y;
+        movement->points[0].z = origin->z;
+    }
+}
 
-                // sample the position of the effector using the relevant interp processor
-                switch( movement->type )
-                {
+/* -------------------------------------------------------------------------- */
 
-                    case _BEZIER_QUADRATIC:
-                        cartesian_point_on_quadratic_bezier( movement->points, movement->num_pts, sample_t,
-                                                             &sample_point );
+// Returns the point where a (resolved) movement finishes
+PUBLIC CartesianPoint_t *
+cartesian_move_end_point( Movement_t *movement )
+{
+    switch( movement->type )
+    {
+        case _CATMULL_SPLINE:
+            return &movement->points[_CATMULL_END];
 
-                        break;
+        case _BEZIER_QUADRATIC:
+            return &movement->points[_QUADRATIC_END];
 
-                    case _BEZIER_CUBIC:
-                        cartesian_point_on_cubic_bezier( movement->points, movement->num_pts, sample_t, &sample_point );
-                        break;
+        case _BEZIER_CUBIC:
+            return &movement->points[_CUBIC_END];
 
-                    case _CATMULL_SPLINE:
-                        cartesian_point_on_catmull_spline( movement->points, movement->num_pts, sample_t, &sample_point );
-                        break;
+        case _POINT_TRANSIT:
+        case _LINE:
+        default:
+            return &movement->points[_LINE_END];
+    }
+}
 
-                    case _POINT_TRANSIT:
-                    case _LINE:
-                        // these shouldn't be solved by slice-summation
-                        break;
-                }
+/* -------------------------------------------------------------------------- */
 
-                // calculate distance between the previous sample and this sample
-                int32_t dist = cartesian_distance_between( &previous_point, &sample_point );
+// Evaluate a (resolved) movement at a 0.0-1.0 curve parameter
+PUBLIC KinematicsSolution_t
+cartesian_point_on_move( Movement_t *movement, float pos_weight, CartesianPoint_t *output )
+{
+    switch( movement->type )
+    {
+        case _POINT_TRANSIT:
+        case _LINE:
+            return cartesian_point_on_line( movement->points, movement->num_pts, pos_weight, output );
 
-                // add to the running distance sum
-                distance_sum += dist;
+        case _CATMULL_SPLINE:
+            return cartesian_point_on_catmull_spline( movement->points, movement->num_pts, pos_weight, output );
 
-                // this sample will be used as the previous point in the next loop
-                memcpy( &previous_point, &sample_point, sizeof( CartesianPoint_t ) );
-            }
+        case _BEZIER_QUADRATIC:
+            return cartesian_point_on_quadratic_bezier( movement->points, movement->num_pts, pos_weight, output );
+
+        case _BEZIER_CUBIC:
+            return cartesian_point_on_cubic_bezier( movement->points, movement->num_pts, pos_weight, output );
+
+        default:
+            return SOLUTION_ERROR;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Curves don't move evenly with their parameter, so sample the cumulative length
+// and invert it into the parameter found at evenly spaced distances along the path.
+// Lines are already uniform and get an identity table.
+PUBLIC void
+cartesian_move_build_arc_table( Movement_t *movement, ArcLengthTable_t *table )
+{
+    float            distance[ARC_LENGTH_BUILD_SAMPLES + 1] = { 0 };
+    CartesianPoint_t previous                               = { 0, 0, 0 };
+    CartesianPoint_t sample                                 = { 0, 0, 0 };
+
+    bool is_line  = ( movement->type == _POINT_TRANSIT || movement->type == _LINE );
+    table->length = 0.0f;
+
+    if( !is_line )
+    {
+        cartesian_point_on_move( movement, 0.0f, &previous );
+
+        for( uint32_t i = 1; i <= ARC_LENGTH_BUILD_SAMPLES; i++ )
+        {
+            cartesian_point_on_move( movement, (float)i / ARC_LENGTH_BUILD_SAMPLES, &sample );
+
+            float delta_x = (float)( sample.x - previous.x );
+            float delta_y = (float)( sample.y - previous.y );
+            float delta_z = (float)( sample.z - previous.z );
+
+            distance[i] = distance[i - 1] + sqrtf( delta_x * delta_x + delta_y * delta_y + delta_z * delta_z );
+            previous    = sample;
         }
+
+        table->length = distance[ARC_LENGTH_BUILD_SAMPLES];
+    }
+    else
+    {
+        table->length = (float)cartesian_distance_between( &movement->points[_LINE_START], &movement->points[_LINE_END] );
     }
 
-    return distance;
+    // Lines, and curves too short to matter, map distance straight onto the parameter
+    if( is_line || table->length < 1.0f )
+    {
+        for( uint32_t i = 0; i < ARC_LENGTH_TABLE_SIZE; i++ )
+        {
+            table->parameter[i] = (float)i / ( ARC_LENGTH_TABLE_SIZE - 1 );
+        }
+        return;
+    }
+
+    // Walk the samples once, finding the parameter where each evenly spaced distance falls
+    uint32_t sample_index = 0;
+
+    table->parameter[0]                         = 0.0f;
+    table->parameter[ARC_LENGTH_TABLE_SIZE - 1] = 1.0f;
+
+    for( uint32_t i = 1; i < ARC_LENGTH_TABLE_SIZE - 1; i++ )
+    {
+        float target = table->length * (float)i / ( ARC_LENGTH_TABLE_SIZE - 1 );
+
+        while( sample_index < ARC_LENGTH_BUILD_SAMPLES - 1 && distance[sample_index + 1] < target )
+        {
+            sample_index++;
+        }
+
+        float span      = distance[sample_index + 1] - distance[sample_index];
+        float remainder = ( span > 0.0f ) ? ( target - distance[sample_index] ) / span : 0.0f;
+
+        table->parameter[i] = ( (float)sample_index + remainder ) / ARC_LENGTH_BUILD_SAMPLES;
+    }
 }
+
+/* -------------------------------------------------------------------------- */
+
+// Convert a 0.0-1.0 fraction of the path length into the curve parameter, cheap enough for the motion loop
+PUBLIC float
+cartesian_arc_table_lookup( ArcLengthTable_t *table, float distance_weight )
+{
+    if( distance_weight <= 0.0f )
+    {
+        return 0.0f;
+    }
+
+    if( distance_weight >= 1.0f )
+    {
+        return 1.0f;
+    }
+
+    float    position  = distance_weight * ( ARC_LENGTH_TABLE_SIZE - 1 );
+    uint32_t index     = (uint32_t)position;
+    float    remainder = position - (float)index;
+
+    return table->parameter[index] + remainder * ( table->parameter[index + 1] - table->parameter[index] );
+}
+
 /* -------------------------------------------------------------------------- */
 
 int32_t cartesian_distance_between( CartesianPoint_t *a, CartesianPoint_t *b )
@@ -408,4 +626,175 @@ cartesian_point_on_spiral( CartesianPoint_t *p, size_t points, float pos_weight,
     return SOLUTION_VALID;
 }
 
+/* ----- Private Functions -------------------------------------------------- */
+
+// Reduce a curve's control points to the coefficients of its derivative
+PRIVATE bool
+cartesian_curve_derivative( Movement_t *movement, CurveDerivative_t *derivative )
+{
+    float points[MOVEMENT_POINTS_COUNT][3];
+
+    for( uint8_t i = 0; i < MOVEMENT_POINTS_COUNT; i++ )
+    {
+        points[i][0] = (float)movement->points[i].x;
+        points[i][1] = (float)movement->points[i].y;
+        points[i][2] = (float)movement->points[i].z;
+    }
+
+    for( uint8_t axis = 0; axis < 3; axis++ )
+    {
+        float p0 = points[0][axis];
+        float p1 = points[1][axis];
+        float p2 = points[2][axis];
+        float p3 = points[3][axis];
+
+        switch( movement->type )
+        {
+            case _BEZIER_QUADRATIC:
+                // B'(t) = 2(P1 - P0) + 2(P2 - 2P1 + P0)t
+                derivative->a[axis] = 2.0f * ( p1 - p0 );
+                derivative->b[axis] = 2.0f * ( p2 - 2.0f * p1 + p0 );
+                derivative->c[axis] = 0.0f;
+                break;
+
+            case _BEZIER_CUBIC:
+                // B'(t) = 3(P1 - P0) + 6(P2 - 2P1 + P0)t + 3(P3 - 3P2 + 3P1 - P0)t^2
+                derivative->a[axis] = 3.0f * ( p1 - p0 );
+                derivative->b[axis] = 6.0f * ( p2 - 2.0f * p1 + p0 );
+                derivative->c[axis] = 3.0f * ( p3 - 3.0f * p2 + 3.0f * p1 - p0 );
+                break;
+
+            case _CATMULL_SPLINE:
+                // Differentiated from the matrix form in cartesian_point_on_catmull_spline()
+                derivative->a[axis] = 0.5f * ( p2 - p0 );
+                derivative->b[axis] = 2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3;
+                derivative->c[axis] = 1.5f * ( -p0 + 3.0f * p1 - 3.0f * p2 + p3 );
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Integrate |d(t)| over 0-1 split into even intervals
+PRIVATE float
+cartesian_curve_quadrature( CurveDerivative_t *derivative, uint32_t intervals )
+{
+    float width  = 1.0f / (float)intervals;
+    float length = 0.0f;
+
+    for( uint32_t i = 0; i < intervals; i++ )
+    {
+        float centre = ( (float)i + 0.5f ) * width;
+
+        for( uint8_t n = 0; n < 5; n++ )
+        {
+            float t = centre + 0.5f * width * gauss_legendre_nodes[n];
+
+            float velocity[3];
+
+            for( uint8_t axis = 0; axis < 3; axis++ )
+            {
+                velocity[axis] = derivative->a[axis] + ( derivative->b[axis] + derivative->c[axis] * t ) * t;
+            }
+
+            float speed = sqrtf( velocity[0] * velocity[0] + velocity[1] * velocity[1] + velocity[2] * velocity[2] );
+
+            length += gauss_legendre_weights[n] * speed * 0.5f * width;
+        }
+    }
+
+    return length;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Curvature k = |d' x d''| / |d'|^3 at parameter t, in 1/micron
+PRIVATE float
+cartesian_curve_curvature( CurveDerivative_t *derivative, float t )
+{
+    float velocity[3];
+    float accel[3];
+
+    for( uint8_t axis = 0; axis < 3; axis++ )
+    {
+        velocity[axis] = derivative->a[axis] + ( derivative->b[axis] + derivative->c[axis] * t ) * t;
+        accel[axis]    = derivative->b[axis] + 2.0f * derivative->c[axis] * t;
+    }
+
+    float speed_sq = velocity[0] * velocity[0] + velocity[1] * velocity[1] + velocity[2] * velocity[2];
+    float speed    = sqrtf( speed_sq );
+
+    // The curve stalls here, a cusp has no useful curvature to plan against
+    if( speed <= 1.0f )
+    {
+        return 0.0f;
+    }
+
+    float cross_x = velocity[1] * accel[2] - velocity[2] * accel[1];
+    float cross_y = velocity[2] * accel[0] - velocity[0] * accel[2];
+    float cross_z = velocity[0] * accel[1] - velocity[1] * accel[0];
+
+    return sqrtf( cross_x * cross_x + cross_y * cross_y + cross_z * cross_z ) / ( speed_sq * speed );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Scan the curve evenly including both ends, then golden section search the spans
+// either side of the tightest sample so a narrow turn between samples isn't missed
+PRIVATE float
+cartesian_curve_curvature_peak( CurveDerivative_t *derivative )
+{
+    float    peak       = 0.0f;
+    uint32_t peak_index = 0;
+
+    for( uint32_t i = 0; i <= CURVATURE_SCAN_SAMPLES; i++ )
+    {
+        float curvature = cartesian_curve_curvature( derivative, (float)i / CURVATURE_SCAN_SAMPLES );
+
+        if( curvature > peak )
+        {
+            peak       = curvature;
+            peak_index = i;
+        }
+    }
+
+    const float ratio = 0.6180339887f;
+
+    float lower = (float)( peak_index > 0 ? peak_index - 1 : 0 ) / CURVATURE_SCAN_SAMPLES;
+    float upper = (float)MIN( peak_index + 1, CURVATURE_SCAN_SAMPLES ) / CURVATURE_SCAN_SAMPLES;
+    float left  = upper - ratio * ( upper - lower );
+    float right = lower + ratio * ( upper - lower );
+
+    float curvature_left  = cartesian_curve_curvature( derivative, left );
+    float curvature_right = cartesian_curve_curvature( derivative, right );
+
+    for( uint32_t i = 0; i < CURVATURE_REFINE_STEPS; i++ )
+    {
+        if( curvature_left > curvature_right )
+        {
+            upper           = right;
+            right           = left;
+            curvature_right = curvature_left;
+            left            = upper - ratio * ( upper - lower );
+            curvature_left  = cartesian_curve_curvature( derivative, left );
+        }
+        else
+        {
+            lower           = left;
+            left            = right;
+            curvature_left  = curvature_right;
+            right           = lower + ratio * ( upper - lower );
+            curvature_right = cartesian_curve_curvature( derivative, right );
+        }
+    }
+
+    return MAX( peak, MAX( curvature_left, curvature_right ) );
+}
+
 /* ----- End ---------------------------------------------------------------- */
@@ -94,6 +94,22 @@ typedef struct
     CartesianPoint_t  points[MOVEMENT_POINTS_COUNT];    // array of 3d points
 } Movement_t;
 
+// Curve parameter at evenly spaced distances along a movement, so a fraction
+// of the path length can be turned into the parameter for the curve evaluators
+#define ARC_LENGTH_TABLE_SIZE 33
+
+typedef struct
+{
+    float length;                              // microns along the path
+    float parameter[ARC_LENGTH_TABLE_SIZE];    // curve parameter at i/(SIZE-1) of the length
+} ArcLengthTable_t;
+
+typedef struct
+{
+    int32_t length;            // microns along the path
+    float   curvature_peak;    // 1/mm at the tightest point of the path
+} MovementAnalysis_t;
+
 typedef uint32_t mm_per_second_t;
 typedef uint32_t micron_per_millisecond_t;
 
@@ -105,6 +121,24 @@ cartesian_move_speed( Movement_t *movement );
 PUBLIC int32_t
 cartesian_move_distance( Movement_t *movement );
 
+PUBLIC void
+cartesian_move_analyse( Movement_t *movement, MovementAnalysis_t *analysis );
+
+PUBLIC void
+cartesian_move_apply_origin( Movement_t *movement, CartesianPoint_t *origin );
+
+PUBLIC CartesianPoint_t *
+cartesian_move_end_point( Movement_t *movement );
+
+PUBLIC KinematicsSolution_t
+cartesian_point_on_move( Movement_t *movement, float pos_weight, CartesianPoint_t *output );
+
+PUBLIC void
+cartesian_move_build_arc_table( Movement_t *movement, ArcLengthTable_t *table );
+
+PUBLIC float
+cartesian_arc_table_lookup( ArcLengthTable_t *table, float distance_weight );
+
 PUBLIC void
 cartesian_point_rotate_around_z( CartesianPoint_t *a, float degrees );
 
@@ -0,0 +1,291 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "crc16.h"
+#include "movement_batch.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define RECORD_HEADER_BYTES 6U
+#define RECORD_POINT_BYTES  ( 3U * sizeof( int32_t ) )
+
+#define DELTA_TYPE_MASK  0x07U
+#define DELTA_COUNT_MASK 0x18U
+#define DELTA_COUNT_POS  3U
+#define DELTA_REF_MASK   0x20U
+
+#define VARINT_BYTES_MAX 5U    // 32-bit values, 7 bits per byte
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE bool
+read_fixed_record( const MovementBatch_t *batch, MovementBatchReader_t *reader, Movement_t *movement );
+
+PRIVATE bool
+read_delta_record( const MovementBatch_t *batch, MovementBatchReader_t *reader, Movement_t *movement );
+
+PRIVATE bool
+read_varint( const MovementBatch_t *batch, uint16_t *offset, uint32_t *value );
+
+PRIVATE bool
+read_zigzag( const MovementBatch_t *batch, uint16_t *offset, int32_t *value );
+
+PRIVATE uint16_t
+read_u16( const uint8_t *bytes );
+
+PRIVATE int32_t
+read_i32( const uint8_t *bytes );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC MovementBatchStatus_t
+movement_batch_validate( const MovementBatch_t *batch, uint16_t received )
+{
+    if( received < MOVEMENT_BATCH_HEADER_BYTES
+        || ( batch->format & BATCH_FORMAT_MASK ) > BATCH_FORMAT_DELTA
+        || batch->length > MOVEMENT_BATCH_BYTES
+        || received < MOVEMENT_BATCH_HEADER_BYTES + batch->length
+        || batch->count == 0
+        || batch->count > MOVEMENT_BATCH_RECORDS_MAX )
+    {
+        return BATCH_MALFORMED;
+    }
+
+    if( crc16Update( CRC16_INIT, batch->records, batch->length ) != batch->crc )
+    {
+        return BATCH_CRC_ERROR;
+    }
+
+    // Walk the records so a bad one rejects the whole batch before any are queued
+    MovementBatchReader_t reader;
+    Movement_t            scratch;
+    uint8_t               decoded = 0;
+
+    movement_batch_reader_init( &reader );
+
+    while( movement_batch_read( batch, &reader, &scratch ) )
+    {
+        decoded++;
+    }
+
+    if( decoded != batch->count || reader.offset != batch->length )
+    {
+        return BATCH_MALFORMED;
+    }
+
+    return BATCH_ACCEPTED;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+movement_batch_reader_init( MovementBatchReader_t *reader )
+{
+    memset( reader, 0, sizeof( MovementBatchReader_t ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+movement_batch_read( const MovementBatch_t *batch, MovementBatchReader_t *reader, Movement_t *movement )
+{
+    if( reader->offset >= batch->length )
+    {
+        return false;
+    }
+
+    memset( movement, 0, sizeof( Movement_t ) );
+
+    bool delta   = ( ( batch->format & BATCH_FORMAT_MASK ) == BATCH_FORMAT_DELTA );
+    bool decoded = delta ? read_delta_record( batch, reader, movement )
+                         : read_fixed_record( batch, reader, movement );
+
+    if( decoded )
+    {
+        reader->identifier = movement->identifier;
+        reader->last       = movement->points[movement->num_pts - 1];
+    }
+
+    return decoded;
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE bool
+read_fixed_record( const MovementBatch_t *batch, MovementBatchReader_t *reader, Movement_t *movement )
+{
+    uint16_t remaining = (uint16_t)( batch->length - reader->offset );
+
+    if( remaining < RECORD_HEADER_BYTES )
+    {
+        return false;
+    }
+
+    const uint8_t *record  = &batch->records[reader->offset];
+    uint8_t        type    = record[0] & 0x0F;
+    uint8_t        ref     = record[0] >> 4;
+    uint8_t        num_pts = record[1];
+
+    if( type > _BEZIER_CUBIC
+        || ref > _POS_RELATIVE
+        || num_pts == 0
+        || num_pts > MOVEMENT_POINTS_COUNT
+        || remaining < RECORD_HEADER_BYTES + num_pts * RECORD_POINT_BYTES )
+    {
+        return false;
+    }
+
+    movement->type       = (MotionAdjective_t)type;
+    movement->ref        = (MotionReference_t)ref;
+    movement->num_pts    = num_pts;
+    movement->identifier = read_u16( &record[2] );
+    movement->duration   = read_u16( &record[4] );
+
+    const uint8_t *point = &record[RECORD_HEADER_BYTES];
+
+    for( uint8_t i = 0; i < num_pts; i++ )
+    {
+        movement->points[i].x = read_i32( &point[0] );
+        movement->points[i].y = read_i32( &point[4] );
+        movement->points[i].z = read_i32( &point[8] );
+        point += RECORD_POINT_BYTES;
+    }
+
+    reader->offset = (uint16_t)( reader->offset + RECORD_HEADER_BYTES + num_pts * RECORD_POINT_BYTES );
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+read_delta_record( const MovementBatch_t *batch, MovementBatchReader_t *reader, Movement_t *movement )
+{
+    uint16_t offset = reader->offset;
+    uint8_t  header = batch->records[offset++];
+    uint8_t  type   = header & DELTA_TYPE_MASK;
+    uint32_t identifier;
+    uint32_t duration;
+
+    if( type > _BEZIER_CUBIC )
+    {
+        return false;
+    }
+
+    movement->type    = (MotionAdjective_t)type;
+    movement->ref     = ( header & DELTA_REF_MASK ) ? _POS_RELATIVE : _POS_ABSOLUTE;
+    movement->num_pts = (uint16_t)( ( ( header & DELTA_COUNT_MASK ) >> DELTA_COUNT_POS ) + 1 );
+
+    if( header & BATCH_DELTA_NEXT_ID )
+    {
+        identifier = (uint16_t)( reader->identifier + 1 );
+    }
+    else if( !read_varint( batch, &offset, &identifier ) || identifier > UINT16_MAX )
+    {
+        return false;
+    }
+
+    if( !read_varint( batch, &offset, &duration ) || duration > UINT16_MAX )
+    {
+        return false;
+    }
+
+    movement->identifier = (uint16_t)identifier;
+    movement->duration   = (uint16_t)duration;
+
+    CartesianPoint_t previous = reader->last;
+    uint8_t          first    = 0;
+
+    if( header & BATCH_DELTA_CHAINED )
+    {
+        movement->points[0] = reader->last;
+        first               = 1;
+    }
+
+    for( uint8_t i = first; i < movement->num_pts; i++ )
+    {
+        int32_t dx, dy, dz;
+
+        if( !read_zigzag( batch, &offset, &dx )
+            || !read_zigzag( batch, &offset, &dy )
+            || !read_zigzag( batch, &offset, &dz ) )
+        {
+            return false;
+        }
+
+        // Wrapping sums, the encoder produced the deltas with wrapping differences
+        movement->points[i].x = (int32_t)( (uint32_t)previous.x + (uint32_t)dx );
+        movement->points[i].y = (int32_t)( (uint32_t)previous.y + (uint32_t)dy );
+        movement->points[i].z = (int32_t)( (uint32_t)previous.z + (uint32_t)dz );
+        previous              = movement->points[i];
+    }
+
+    reader->offset = offset;
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Little-endian base-128, 7 bits per byte with the top bit set on all but the last
+PRIVATE bool
+read_varint( const MovementBatch_t *batch, uint16_t *offset, uint32_t *value )
+{
+    uint32_t result = 0;
+
+    for( uint8_t i = 0; i < VARINT_BYTES_MAX && *offset < batch->length; i++ )
+    {
+        uint8_t byte = batch->records[( *offset )++];
+        result |= (uint32_t)( byte & 0x7F ) << ( 7 * i );
+
+        if( !( byte & 0x80 ) )
+        {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Signed values interleaved 0, -1, 1, -2... so small deltas of either sign stay short
+PRIVATE bool
+read_zigzag( const MovementBatch_t *batch, uint16_t *offset, int32_t *value )
+{
+    uint32_t raw;
+
+    if( !read_varint( batch, offset, &raw ) )
+    {
+        return false;
+    }
+
+    *value = (int32_t)( ( raw >> 1 ) ^ ( 0U - ( raw & 1U ) ) );
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE uint16_t
+read_u16( const uint8_t *bytes )
+{
+    return (uint16_t)( bytes[0] | ( bytes[1] << 8 ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE int32_t
+read_i32( const uint8_t *bytes )
+{
+    return (int32_t)( (uint32_t)bytes[0]
+                      | ( (uint32_t)bytes[1] << 8 )
+                      | ( (uint32_t)bytes[2] << 16 )
+                      | ( (uint32_t)bytes[3] << 24 ) );
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,118 @@
+#ifndef MOVEMENT_BATCH_H
+#define MOVEMENT_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "app_times.h"
+#include "global.h"
+#include "motion_types.h"
+
+/* ----- Types -------------------------------------------------------------- */
+
+typedef enum
+{
+    BATCH_FORMAT_FIXED = 0,    // records carry full int32 points
+    BATCH_FORMAT_DELTA,        // records carry varint deltas against the previous point
+} MovementBatchFormat_t;
+
+// The low bits of format hold the MovementBatchFormat_t. BATCH_STREAMED is set
+// by a sender that keeps several batches in flight, the batch is only queued
+// when it directly follows the last one so a lost upload can't reorder moves.
+#define BATCH_FORMAT_MASK 0x0FU
+#define BATCH_STREAMED    0x80U
+
+// Bulk movement upload as written by the UI. The CRC covers length bytes of
+// records, packed back to back. A BATCH_FORMAT_FIXED record is
+//   u8 type | ref << 4, u8 num_pts, u16 identifier, u16 duration,
+//   num_pts * { i32 x, i32 y, i32 z }
+// little-endian.
+//
+// A BATCH_FORMAT_DELTA record is
+//   u8 type | ( num_pts - 1 ) << 3 | ref << 5 | BATCH_DELTA_CHAINED | BATCH_DELTA_NEXT_ID,
+//   varint identifier (omitted with BATCH_DELTA_NEXT_ID),
+//   varint duration,
+//   num_pts * zig-zag varint { dx, dy, dz } (first point omitted with BATCH_DELTA_CHAINED)
+// Each point is the difference from the point before it in the batch, the
+// first point of the batch is relative to zero. A chained record starts at
+// the final point of the previous record, a NEXT_ID record is numbered one
+// after it.
+#define BATCH_DELTA_CHAINED 0x40U
+#define BATCH_DELTA_NEXT_ID 0x80U
+
+// Decoding state carried from one record to the next
+typedef struct
+{
+    uint16_t         offset;        // first byte of the next record
+    uint16_t         identifier;    // identifier of the previous record
+    CartesianPoint_t last;          // final point of the previous record
+} MovementBatchReader_t;
+
+typedef struct
+{
+    uint16_t sequence;                         // incremented by the sender for every new batch
+    uint16_t crc;                              // CRC-16/CCITT-FALSE of the record bytes
+    uint16_t length;                           // used bytes in records
+    uint8_t  count;                            // movements in records
+    uint8_t  format;                           // MovementBatchFormat_t | BATCH_STREAMED
+    uint8_t  records[MOVEMENT_BATCH_BYTES];    // packed movement records
+} MovementBatch_t;
+
+#define MOVEMENT_BATCH_HEADER_BYTES ( sizeof( MovementBatch_t ) - MOVEMENT_BATCH_BYTES )
+
+typedef enum
+{
+    BATCH_ACCEPTED = 0,    // every movement was queued
+    BATCH_DUPLICATE,       // sequence already accepted, nothing queued again
+    BATCH_CRC_ERROR,       // record bytes don't match the CRC, nothing queued
+    BATCH_MALFORMED,       // header or records don't decode, nothing queued
+    BATCH_QUEUE_FULL,      // only the first 'accepted' movements were queued
+    BATCH_OUT_OF_ORDER,    // streamed batch doesn't follow the last one, nothing queued
+    BATCH_REFUSED,         // not armed in a mode which takes movements, nothing queued or tracked
+} MovementBatchStatus_t;
+
+// Single reply to a bulk upload
+typedef struct
+{
+    uint16_t sequence;            // sequence of the batch being acknowledged
+    uint8_t  status;              // MovementBatchStatus_t
+    uint8_t  accepted;            // movements queued from this batch, including earlier sends of it
+    uint8_t  movement_credits;    // movements that can be sent once this batch is added
+    uint8_t  lighting_credits;    // lighting fades that can be sent
+} MovementBatchAck_t;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/** Check the CRC and that the records decode into exactly count movements.
+ *  received is the number of bytes the link wrote into the batch. */
+
+PUBLIC MovementBatchStatus_t
+movement_batch_validate( const MovementBatch_t *batch, uint16_t received );
+
+/* -------------------------------------------------------------------------- */
+
+/** Start reading a batch from its first record */
+
+PUBLIC void
+movement_batch_reader_init( MovementBatchReader_t *reader );
+
+/* -------------------------------------------------------------------------- */
+
+/** Decode the next record into movement and advance the reader.
+ *  Returns false when no complete record remains. */
+
+PUBLIC bool
+movement_batch_read( const MovementBatch_t *batch, MovementBatchReader_t *reader, Movement_t *movement );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOVEMENT_BATCH_H */
@@ -0,0 +1,330 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "movement_queue.h"
+
+#include "app_times.h"
+#include "configuration.h"
+#include "hal_system_speed.h"
+#include "kinematics.h"
+#include "qassert.h"
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+/* ----- Defines ------------------------------------------------------------ */
+
+// One slot is always left empty so a full ring can be told apart from an empty one
+#define MOVEMENT_QUEUE_SLOTS ( MOVEMENT_QUEUE_DEPTH_MAX + MOVEMENT_QUEUE_IN_FLIGHT + 1U )
+
+/* ----- Private Types ------------------------------------------------------ */
+
+// Slots from tail to next are held by the path interpolator, from next to
+// head they're committed and waiting, and the slot at head is being written
+typedef struct
+{
+    uint16_t          head;    // slot the producers write next, main loop only
+    uint16_t          next;    // oldest committed movement, main loop only
+    volatile uint16_t tail;    // oldest movement the motion loop hasn't released
+
+    bool     accept;
+    uint32_t reserved_at;    // cycle counter when the slot at head was handed out
+
+    MovementQueueStats_t stats;
+} MovementQueue_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE MovementQueue_t queue;
+
+// Only read and written by the CPU, so it can live in core coupled memory
+PRIVATE Movement_t __attribute__( ( section( ".ccmram" ) ) ) slots[MOVEMENT_QUEUE_SLOTS];
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint16_t
+movement_queue_advance( uint16_t index, uint16_t count );
+
+PRIVATE uint16_t
+movement_queue_distance( uint16_t from, uint16_t to );
+
+PRIVATE bool
+movement_queue_legal( Movement_t *move );
+
+PRIVATE bool
+movement_queue_reachable( Movement_t *move );
+
+PRIVATE void
+movement_queue_report( void );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+movement_queue_init( void )
+{
+    memset( &queue, 0, sizeof( queue ) );
+    memset( &slots, 0, sizeof( slots ) );
+
+    queue.stats.slot_bytes = sizeof( Movement_t );
+    queue.stats.capacity   = MOVEMENT_QUEUE_DEPTH_MAX;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+movement_queue_accept( bool accept )
+{
+    queue.accept = accept;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC Movement_t *
+movement_queue_reserve( void )
+{
+    MovementQueue_t *q = &queue;
+
+    uint16_t held = movement_queue_distance( q->tail, q->head );
+
+    if( !q->accept || movement_queue_used() >= MOVEMENT_QUEUE_DEPTH_MAX || held >= MOVEMENT_QUEUE_SLOTS - 1U )
+    {
+        q->stats.refused++;
+        return NULL;
+    }
+
+    q->reserved_at = hal_system_speed_get_cycles();
+
+    return &slots[q->head];
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+movement_queue_commit( Movement_t *slot )
+{
+    MovementQueue_t *q = &queue;
+
+    REQUIRE( slot == &slots[q->head] );
+
+    if( !movement_queue_legal( slot ) )
+    {
+        q->stats.refused++;
+        return false;
+    }
+
+    q->head = movement_queue_advance( q->head, 1U );
+
+    uint32_t cycles_used = hal_system_speed_get_cycles() - q->reserved_at;
+    uint16_t used        = movement_queue_used();
+
+    q->stats.enqueue_cycles     = cycles_used;
+    q->stats.enqueue_cycles_max = MAX( q->stats.enqueue_cycles_max, cycles_used );
+    q->stats.queued_max         = MAX( q->stats.queued_max, used );
+    q->stats.enqueued++;
+
+    movement_queue_report();
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC Movement_t *
+movement_queue_peek( uint16_t offset )
+{
+    if( offset >= movement_queue_used() )
+    {
+        return NULL;
+    }
+
+    return &slots[movement_queue_advance( queue.next, offset )];
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC Movement_t *
+movement_queue_take( void )
+{
+    Movement_t *move = movement_queue_peek( 0 );
+
+    if( move )
+    {
+        queue.next = movement_queue_advance( queue.next, 1U );
+        movement_queue_report();
+    }
+
+    return move;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Runs from the motion loop interrupt
+PUBLIC void
+movement_queue_release( Movement_t *movement )
+{
+    if( !movement )
+    {
+        return;
+    }
+
+    uint16_t index = (uint16_t)( movement - slots );
+
+    ASSERT( index < MOVEMENT_QUEUE_SLOTS );
+
+    queue.tail = movement_queue_advance( index, 1U );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+movement_queue_flush( void )
+{
+    queue.head = queue.next;
+    movement_queue_report();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+movement_queue_release_all( void )
+{
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    queue.tail = queue.next;
+    CRITICAL_SECTION_END();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint16_t
+movement_queue_used( void )
+{
+    return movement_queue_distance( queue.next, queue.head );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint16_t
+movement_queue_free( void )
+{
+    // The in flight slots are spare, moves the interpolator holds never block the producers
+    return MOVEMENT_QUEUE_DEPTH_MAX - movement_queue_used();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+movement_queue_get_statistics( MovementQueueStats_t *stats, bool clear_peaks )
+{
+    MovementQueue_t *q = &queue;
+
+    q->stats.queued = movement_queue_used();
+    memcpy( stats, &q->stats, sizeof( MovementQueueStats_t ) );
+
+    if( clear_peaks )
+    {
+        q->stats.queued_max         = q->stats.queued;
+        q->stats.enqueue_cycles_max = 0;
+    }
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint16_t
+movement_queue_advance( uint16_t index, uint16_t count )
+{
+    return ( index + count ) % MOVEMENT_QUEUE_SLOTS;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE uint16_t
+movement_queue_distance( uint16_t from, uint16_t to )
+{
+    return ( to + MOVEMENT_QUEUE_SLOTS - from ) % MOVEMENT_QUEUE_SLOTS;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+movement_queue_legal( Movement_t *move )
+{
+    // Host data is copied in as-is, nothing may index the points until the shape is known good
+    if( move->num_pts < 1 || move->num_pts > MOVEMENT_POINTS_COUNT )
+    {
+        config_report_error( "Requested illegal point count" );
+        return false;
+    }
+
+    if( (uint32_t)move->type > _BEZIER_CUBIC || (uint32_t)move->ref > _POS_RELATIVE )
+    {
+        config_report_error( "Requested illegal movement type" );
+        return false;
+    }
+
+    if( !move->duration )
+    {
+        config_report_error( "Requested zero duration" );
+        return false;
+    }
+
+    if( cartesian_move_speed( move ) >= EFFECTOR_SPEED_LIMIT )
+    {
+        config_report_error( "Requested illegal speed" );
+        return false;
+    }
+
+    if( !movement_queue_reachable( move ) )
+    {
+        config_report_error( "Requested unreachable position" );
+        return false;
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+movement_queue_reachable( Movement_t *move )
+{
+    // Relative moves depend on where the effector will be, so they're left to the IK clamp
+    if( move->ref != _POS_ABSOLUTE )
+    {
+        return true;
+    }
+
+    // Transits start wherever the effector is, only the destination is known now
+    if( move->type == _POINT_TRANSIT )
+    {
+        return kinematics_point_reachable( move->points[move->num_pts - 1] );
+    }
+
+    // Check the points along the path against the envelope, the end points are included
+    for( uint8_t i = 0; i <= PLANNER_JOINT_SAMPLES; i++ )
+    {
+        CartesianPoint_t point = { 0, 0, 0 };
+
+        cartesian_point_on_move( move, (float)i / PLANNER_JOINT_SAMPLES, &point );
+
+        if( !kinematics_point_reachable( point ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Tell the UI the queue depth, which also tops up the host's movement credits
+PRIVATE void
+movement_queue_report( void )
+{
+    config_set_motion_queue_depth( movement_queue_used() );
+}
+
+/* ----- End ---------------------------------------------------------------- */
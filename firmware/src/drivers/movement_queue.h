@@ -0,0 +1,127 @@
+#ifndef MOVEMENT_QUEUE_H
+#define MOVEMENT_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+#include "motion_types.h"
+
+/* ----- Types -------------------------------------------------------------- */
+
+typedef struct
+{
+    uint16_t slot_bytes;            // RAM each queued movement occupies
+    uint16_t capacity;              // movements that may be waiting for the planner
+    uint16_t queued;                // movements waiting for the planner
+    uint16_t queued_max;            // deepest the queue has been since last clear
+    uint32_t enqueue_cycles;        // CPU cycles to write and check the most recent movement
+    uint32_t enqueue_cycles_max;    // worst enqueue since last clear
+    uint32_t enqueued;              // movements queued since boot
+    uint32_t refused;               // movements turned away, queue full or failing checks
+} MovementQueueStats_t;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/*
+ * Movements waiting to run, stored in place from the moment they're written
+ * until the motion loop has finished with them.
+ *
+ * Producers (comms, supervisor, demonstration) reserve a slot, write the
+ * movement straight into it and commit it. The motion task takes committed
+ * movements in order and hands the slot to the path interpolator, which
+ * releases it from the motion loop once the move is done. Everything but the
+ * release runs from the main loop.
+ */
+
+PUBLIC void
+movement_queue_init( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** The motion task opens the queue while the mechanism can run movements,
+ *  reservations fail while it's closed */
+
+PUBLIC void
+movement_queue_accept( bool accept );
+
+/* -------------------------------------------------------------------------- */
+
+/** Slot to write the next movement into, NULL when full or closed. Nothing
+ *  is queued until the slot is committed. */
+
+PUBLIC Movement_t *
+movement_queue_reserve( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Queue the movement written into the reserved slot, once it passes the speed
+ *  and reachability checks. Refused movements are reported to the UI. */
+
+PUBLIC bool
+movement_queue_commit( Movement_t *slot );
+
+/* -------------------------------------------------------------------------- */
+
+/** Committed movement offset places behind the next to run, NULL past the end */
+
+PUBLIC Movement_t *
+movement_queue_peek( uint16_t offset );
+
+/* -------------------------------------------------------------------------- */
+
+/** Take the next movement for the path interpolator, which releases it */
+
+PUBLIC Movement_t *
+movement_queue_take( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** The motion loop has finished with a taken movement, called in take order */
+
+PUBLIC void
+movement_queue_release( Movement_t *movement );
+
+/* -------------------------------------------------------------------------- */
+
+/** Discard everything committed and not yet taken */
+
+PUBLIC void
+movement_queue_flush( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** The path interpolator dropped every movement it held */
+
+PUBLIC void
+movement_queue_release_all( void );
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint16_t
+movement_queue_used( void );
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint16_t
+movement_queue_free( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Copy out the queue statistics, optionally resetting the peaks */
+
+PUBLIC void
+movement_queue_get_statistics( MovementQueueStats_t *stats, bool clear_peaks );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOVEMENT_QUEUE_H */
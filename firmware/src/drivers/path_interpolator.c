@@ -1,6 +1,7 @@
 /* ----- System Includes ---------------------------------------------------- */
 
 #include <float.h>
+#include <stddef.h>
 #include <string.h>
 
 /* ----- Local Includes ----------------------------------------------------- */
@@ -9,6 +10,7 @@
 
 #include "app_events.h"
 #include "app_signals.h"
+#include "app_times.h"
 #include "event_subscribe.h"
 #include "global.h"
 #include "simple_state_machine.h"
@@ -18,8 +20,16 @@
 #include "clearpath.h"
 #include "configuration.h"
 #include "kinematics.h"
+#include "motion_planner.h"
 #include "motion_types.h"
+#include "movement_queue.h"
 #include "status.h"
+#include "trajectory_capture.h"
+
+#include "atomic.h"
+#include "qassert.h"
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
 
 /* ----- Defines ------------------------------------------------------------ */
 
@@ -36,28 +46,88 @@ typedef struct
     PlanningState_t currentState;
     PlanningState_t nextState;
 
-    Movement_t move_a;    // copy of the current movement
-    Movement_t move_b;    // copy of the current movement
+    Movement_t *    move_a;       // movement queue slot being run, NULL when empty
+    Movement_t *    move_b;       // movement queue slot after it
+    MotionProfile_t profile_a;    // speed profile planned for move_a
+    MotionProfile_t profile_b;    // speed profile planned for move_b
 
     bool     enable;                   //if the planner is enabled
     uint32_t movement_started;         // timestamp the start point
     uint32_t movement_est_complete;    // timestamp the predicted end point
+    uint32_t movement_ticks;           // motion loop ticks since the move started
     float    progress_percent;         // calculated progress
 
     CartesianPoint_t effector_position;    //position of the end effector (used for relative moves)
 
+    bool compiled_a;    // move_a has all of its setpoints in the ring
+    bool compiled_b;    // move_b has all of its setpoints in the ring
+
 } MotionPlanner_t;
 
+#ifdef MOTION_PRECOMPILE
+
+typedef enum
+{
+    SETPOINT_LAST  = ( 1U << 0U ),    // final setpoint of a move
+    SETPOINT_FAULT = ( 1U << 1U ),    // the move couldn't be solved, hold the arms where they are
+} PathSetpointFlags_t;
+
+// A single motion loop tick, solved ahead of time
+typedef struct
+{
+    int16_t          steps[3];    // shoulder targets in servo steps
+    uint8_t          progress;    // percentage through the move, for the UI
+    uint8_t          flags;       // PathSetpointFlags_t
+    CartesianPoint_t position;    // effector position the steps were solved for
+} PathSetpoint_t;
+
+// Single producer (background compile) and single consumer (motion loop) ring of setpoints
+typedef struct
+{
+    PathSetpoint_t    entries[MOTION_SETPOINT_DEPTH];
+    volatile uint16_t head;    // next entry the compiler writes
+    volatile uint16_t tail;    // next entry the motion loop replays
+
+    Movement_t *     move;          // slot being compiled, NULL when waiting for one
+    MotionProfile_t *profile;       // profile for that slot
+    bool *           compiled;      // flag to set in the planner once the move is done
+    bool *           previous;      // compiled flag of the slot compiled before this one
+    uint32_t         ticks;         // motion loop ticks compiled so far for the move
+    uint16_t         move_start;    // ring index of the move's first setpoint
+
+    CartesianPoint_t origin;      // where the effector is when the move starts
+    CartesianPoint_t position;    // where the last compiled setpoint leaves the effector
+} PathCompiler_t;
+
+#endif
+
 /* ----- Private Variables -------------------------------------------------- */
 
 PRIVATE MotionPlanner_t planner;
 
+PRIVATE bool path_interpolator_step( Movement_t *move, MotionProfile_t *profile );
 PRIVATE void path_interpolator_premove_transforms( Movement_t *move );
-PRIVATE void path_interpolator_execute_move( Movement_t *move, float percentage );
-PRIVATE void path_interpolator_calculate_percentage( uint16_t move_duration );
+
+#ifndef MOTION_PRECOMPILE
+PRIVATE void path_interpolator_execute_move( Movement_t *move, MotionProfile_t *profile, float percentage );
+PRIVATE void path_interpolator_calculate_percentage( MotionProfile_t *profile );
+#else
+PRIVATE PathCompiler_t compiler;
+
+PRIVATE bool path_interpolator_compile_select( void );
+PRIVATE void path_interpolator_compile_fault( void );
+PRIVATE bool path_interpolator_replay_setpoint( Movement_t *move );
+#endif
+
+// Raised instead when the pool is empty, so the notifications can't be lost.
+// Static events aren't reference counted, and a second publish while one is
+// still queued just overwrites the id with the newer move
+PRIVATE BarrierSyncEvent pathing_started_fallback  = { { PATHING_STARTED, { 0, 0 } }, 0 };
+PRIVATE BarrierSyncEvent pathing_complete_fallback = { { PATHING_COMPLETE, { 0, 0 } }, 0 };
 
 PRIVATE void path_interpolator_notify_pathing_started( uint16_t move_id );
 PRIVATE void path_interpolator_notify_pathing_complete( uint16_t move_id );
+PRIVATE void path_interpolator_notify( BarrierSyncEvent *fallback, uint16_t move_id );
 
 /* ----- Public Functions --------------------------------------------------- */
 
@@ -65,26 +135,157 @@ PUBLIC void
 path_interpolator_init( void )
 {
     memset( &planner, 0, sizeof( planner ) );
+    trajectory_capture_init();
+
+#ifdef MOTION_PRECOMPILE
+    memset( &compiler, 0, sizeof( compiler ) );
+#endif
 }
 
 /* -------------------------------------------------------------------------- */
 
 PUBLIC void
-path_interpolator_set_next( Movement_t *movement_to_process )
+path_interpolator_set_next( Movement_t *movement_to_process, MotionProfile_t *profile )
 {
     MotionPlanner_t *me                   = &planner;
-    Movement_t *     movement_insert_slot = { 0 };    // allows us to put the new move into whichever slot is available
+    Movement_t **    movement_insert_slot = { 0 };    // allows us to put the new move into whichever slot is available
+    MotionProfile_t *profile_insert_slot  = { 0 };
+
+    // The motion loop ISR picks up a slot as soon as it points at a movement
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
 
-    if( me->move_a.duration == 0 )
+    if( !me->move_a )
     {
         movement_insert_slot = &me->move_a;
+        profile_insert_slot  = &me->profile_a;
     }
-    else if( me->move_b.duration == 0 )
+    else if( !me->move_b )
     {
         movement_insert_slot = &me->move_b;
+        profile_insert_slot  = &me->profile_b;
+    }
+
+    ASSERT( movement_insert_slot );
+
+    // The movement stays in the queue's slot, it's released once the move is done
+    memcpy( profile_insert_slot, profile, sizeof( MotionProfile_t ) );
+    *movement_insert_slot = movement_to_process;
+
+    CRITICAL_SECTION_END();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+path_interpolator_stop_after_loaded( void )
+{
+    MotionPlanner_t *me       = &planner;
+    Movement_t **    slot     = NULL;
+    Movement_t *     move     = NULL;
+    MotionProfile_t *profile  = NULL;
+    bool *           compiled = NULL;
+    PlanningState_t  state    = PLANNER_OFF;
+    float            time_s   = 0.0f;
+    MotionProfile_t  stop     = { 0 };
+
+    // Only picking the move and where it has got to is done masked, the stop profile is built with the motion loop running
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+
+    // With both slots loaded, the one the motion loop isn't on runs last. A runs first from off
+    bool last_is_a = ( me->move_a && !me->move_b )
+                     || ( me->move_a && me->move_b && me->currentState == PLANNER_EXECUTE_B );
+
+    if( last_is_a )
+    {
+        slot     = &me->move_a;
+        move     = me->move_a;
+        profile  = &me->profile_a;
+        compiled = &me->compiled_a;
+        state    = PLANNER_EXECUTE_A;
+    }
+    else if( me->move_b )
+    {
+        slot     = &me->move_b;
+        move     = me->move_b;
+        profile  = &me->profile_b;
+        compiled = &me->compiled_b;
+        state    = PLANNER_EXECUTE_B;
+    }
+
+    if( !move )
+    {
+        CRITICAL_SECTION_END();
+        return;
+    }
+
+#ifndef MOTION_PRECOMPILE
+    (void)compiled;
+
+    // Only part way through once the state's entry action has run
+    if( me->currentState == state && me->previousState == state )
+    {
+        time_s = (float)me->movement_ticks / MOTION_LOOP_RATE_HZ;
+    }
+#else
+    PathCompiler_t *c = &compiler;
+    (void)state;
+
+    if( *compiled || c->move == move )
+    {
+        PathSetpoint_t *newest = &c->entries[( c->head - 1U ) & ( MOTION_SETPOINT_DEPTH - 1U )];
+
+        // A move which faulted already ends holding the arms
+        if( *compiled && ( newest->flags & SETPOINT_FAULT ) )
+        {
+            CRITICAL_SECTION_END();
+            return;
+        }
+
+        // Setpoints the motion loop hasn't replayed yet are dropped and compiled again from the new profile
+        uint16_t pending = ( c->head - c->tail ) & ( MOTION_SETPOINT_DEPTH - 1U );
+        uint16_t dropped = (uint16_t)MIN( pending, c->ticks );
+
+        c->head  = ( c->head - dropped ) & ( MOTION_SETPOINT_DEPTH - 1U );
+        c->ticks = c->ticks - dropped;
+
+        if( c->ticks )
+        {
+            c->position = c->entries[( c->head - 1U ) & ( MOTION_SETPOINT_DEPTH - 1U )].position;
+        }
+        else
+        {
+            c->position = c->origin;
+        }
+
+        c->move     = move;
+        c->profile  = profile;
+        c->compiled = compiled;
+        *compiled   = false;
+        time_s      = (float)c->ticks / MOTION_LOOP_RATE_HZ;
+    }
+#endif
+
+    CRITICAL_SECTION_END();
+
+    // Profiles are only written from task context, so this one can be read unmasked
+    if( !motion_planner_replan_stop( profile, time_s, &stop ) )
+    {
+        return;
+    }
+
+    // The motion loop may have ticked on the old profile meanwhile. Both profiles agree on position and speed at time_s,
+    // so picking up the new one a few ticks late barely moves the setpoint. A move which finished meanwhile is left alone
+    CRITICAL_SECTION_START();
+
+    if( *slot == move )
+    {
+        // The arc length table is unchanged, only the speed profile fields ahead of it (path is the last member) are swapped
+        memcpy( profile, &stop, offsetof( MotionProfile_t, path ) );
     }
 
-    memcpy( movement_insert_slot, movement_to_process, sizeof( Movement_t ) );
+    CRITICAL_SECTION_END();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -92,13 +293,23 @@ path_interpolator_set_next( Movement_t *movement_to_process )
 PUBLIC bool
 path_interpolator_is_ready_for_next( void )
 {
-    bool slot_a_ready = ( planner.move_a.duration == 0 );
-    bool slot_b_ready = ( planner.move_b.duration == 0 );
+    bool slot_a_ready = ( planner.move_a == NULL );
+    bool slot_b_ready = ( planner.move_b == NULL );
     return ( slot_a_ready || slot_b_ready );
 }
 
 /* -------------------------------------------------------------------------- */
 
+PUBLIC bool
+path_interpolator_is_idle( void )
+{
+    bool slot_a_ready = ( planner.move_a == NULL );
+    bool slot_b_ready = ( planner.move_b == NULL );
+    return ( slot_a_ready && slot_b_ready );
+}
+
+/* -------------------------------------------------------------------------- */
+
 PUBLIC float
 path_interpolator_get_progress( void )
 {
@@ -115,31 +326,37 @@ path_interpolator_get_move_done( void )
 
 /* -------------------------------------------------------------------------- */
 
+#ifndef MOTION_PRECOMPILE
+
 PRIVATE void
-path_interpolator_calculate_percentage( uint16_t move_duration )
+path_interpolator_calculate_percentage( MotionProfile_t *profile )
 {
     MotionPlanner_t *me = &planner;
 
     // calculate current target completion based on time elapsed
-    // time remaining is the allotted duration - time used (start to now), divide by the duration to get 0.0->1.0 progress
-    uint32_t time_used = hal_systick_get_ms() - me->movement_started;
+    // the fixed rate motion loop counts its own ticks, so progress has sub-ms resolution and doesn't jitter
+    me->movement_ticks++;
+    float time_used = (float)me->movement_ticks / MOTION_LOOP_RATE_HZ;
 
-    if( move_duration )
-    {
-        me->progress_percent = (float)( time_used ) / move_duration;
-    }
-    else
-    {
-        me->progress_percent = 0;
-    }
+    // the planned speed profile maps time to distance along the path
+    me->progress_percent = motion_planner_progress( profile, time_used );
 }
 
+#endif
+
 /* -------------------------------------------------------------------------- */
 
 PUBLIC CartesianPoint_t
 path_interpolator_get_global_position( void )
 {
-    return planner.effector_position;
+    CartesianPoint_t position;
+
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    position = planner.effector_position;
+    CRITICAL_SECTION_END();
+
+    return position;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -162,8 +379,27 @@ path_interpolator_stop( void )
     me->enable = false;
 
     // Wipe out the moves currently loaded into the queue
-    memset( &me->move_a, 0, sizeof( Movement_t ) );
-    memset( &me->move_b, 0, sizeof( Movement_t ) );
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    me->move_a = NULL;
+    me->move_b = NULL;
+    movement_queue_release_all();
+    memset( &me->profile_a, 0, sizeof( MotionProfile_t ) );
+    memset( &me->profile_b, 0, sizeof( MotionProfile_t ) );
+    me->compiled_a = false;
+    me->compiled_b = false;
+
+#ifdef MOTION_PRECOMPILE
+    // Setpoints solved for the discarded moves are no longer wanted
+    compiler.head     = 0;
+    compiler.tail     = 0;
+    compiler.move     = NULL;
+    compiler.previous = NULL;
+#endif
+    CRITICAL_SECTION_END();
+
+    // The stop move was wiped with the queue, keep what was captured of it
+    trajectory_capture_stop();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -174,11 +410,104 @@ path_interpolator_set_home( void )
     planner.effector_position.x = 0;
     planner.effector_position.y = 0;
     planner.effector_position.z = 0;
+
     config_set_position( planner.effector_position.x, planner.effector_position.y, planner.effector_position.z );
 }
 
 /* -------------------------------------------------------------------------- */
 
+#ifdef MOTION_PRECOMPILE
+
+/*
+ * Solve the loaded moves into setpoints ahead of the motion loop.
+ *
+ * Runs from the background loop, a few ticks of motion per call, until the ring
+ * is full or there's nothing left to compile. Moves are compiled in the order the
+ * motion loop runs the slots, and a move is only marked compiled once its last
+ * setpoint is in the ring.
+ */
+
+PUBLIC void
+path_interpolator_compile( void )
+{
+    PathCompiler_t *c = &compiler;
+
+    if( !c->move && !path_interpolator_compile_select() )
+    {
+        return;
+    }
+
+    CartesianPoint_t targets[MOTION_COMPILE_BATCH];
+    JointAngles_t    angles[MOTION_COMPILE_BATCH];
+    uint8_t          progress[MOTION_COMPILE_BATCH];
+
+    // One entry is always left empty so a full ring can be told apart from an empty one
+    uint16_t space = ( c->tail - c->head - 1U ) & ( MOTION_SETPOINT_DEPTH - 1U );
+    uint16_t count = 0;
+    bool     last  = false;
+
+    while( count < MIN( space, MOTION_COMPILE_BATCH ) && !last )
+    {
+        // Same timing as the live loop, the first setpoint is one tick into the move
+        c->ticks++;
+        float percentage = motion_planner_progress( c->profile, (float)c->ticks / MOTION_LOOP_RATE_HZ );
+
+        if( percentage >= 1.0f - FLT_EPSILON )
+        {
+            // Land exactly on the end point so the next move continues from it
+            percentage = 1.0f;
+            last       = true;
+        }
+
+        float pos_weight = cartesian_arc_table_lookup( &c->profile->path, percentage );
+        cartesian_point_on_move( c->move, pos_weight, &targets[count] );
+        progress[count] = (uint8_t)( percentage * 100 );
+        count++;
+    }
+
+    size_t solved = kinematics_solve_batch( targets, angles, count );
+
+    for( uint16_t i = 0; i < solved; i++ )
+    {
+        PathSetpoint_t *setpoint = &c->entries[c->head];
+
+        bool legal = servo_angle_to_steps( angles[i].a1, &setpoint->steps[_CLEARPATH_1] );
+        legal &= servo_angle_to_steps( angles[i].a2, &setpoint->steps[_CLEARPATH_2] );
+        legal &= servo_angle_to_steps( angles[i].a3, &setpoint->steps[_CLEARPATH_3] );
+
+        if( !legal )
+        {
+            solved = i;
+            break;
+        }
+
+        setpoint->progress = progress[i];
+        setpoint->flags    = ( last && i == count - 1U ) ? SETPOINT_LAST : 0U;
+        setpoint->position = targets[i];
+
+        // The entry has to be complete before the motion loop can see it
+        atomicBarrier();
+        c->head     = ( c->head + 1U ) & ( MOTION_SETPOINT_DEPTH - 1U );
+        c->position = targets[i];
+    }
+
+    if( solved < count )
+    {
+        path_interpolator_compile_fault();
+    }
+    else if( last )
+    {
+        *c->compiled = true;
+        c->previous  = c->compiled;
+        c->move      = NULL;
+    }
+}
+
+#endif
+
+/* -------------------------------------------------------------------------- */
+
+// Runs from the fixed rate motion timer interrupt
 PUBLIC void
 path_interpolator_process( void )
 {
@@ -192,11 +521,11 @@ path_interpolator_process( void )
             STATE_TRANSITION_TEST
             if( planner.enable )
             {
-                if( me->move_a.duration )
+                if( me->move_a )
                 {
                     STATE_NEXT( PLANNER_EXECUTE_A );
                 }
-                else if( me->move_b.duration )
+                else if( me->move_b )
                 {
                     STATE_NEXT( PLANNER_EXECUTE_B );
                 }
@@ -208,22 +537,26 @@ path_interpolator_process( void )
         case PLANNER_EXECUTE_A:
             STATE_ENTRY_ACTION
             config_set_pathing_status( me->currentState );
-            path_interpolator_notify_pathing_started( me->move_a.identifier );
 
-            path_interpolator_premove_transforms( &me->move_a );
+            // The slot may have been emptied by a stop since this state was chosen
+            if( me->move_a )
+            {
+                path_interpolator_notify_pathing_started( me->move_a->identifier );
+                path_interpolator_premove_transforms( me->move_a );
+            }
+
             me->movement_started      = hal_systick_get_ms();
-            me->movement_est_complete = me->movement_started + me->move_a.duration;
+            me->movement_est_complete = me->movement_started + (uint32_t)( me->profile_a.duration * 1000.0f );
+            me->movement_ticks        = 0;
             me->progress_percent      = 0;
             STATE_TRANSITION_TEST
-            path_interpolator_calculate_percentage( me->move_a.duration );
-
-            if( !planner.enable || !me->move_a.duration )
+            if( !planner.enable || !me->move_a )
             {
                 STATE_NEXT( PLANNER_OFF );
             }
-            else if( path_interpolator_get_move_done() )
+            else if( path_interpolator_step( me->move_a, &me->profile_a ) )
             {
-                if( me->move_b.duration )
+                if( me->move_b )
                 {
                     STATE_NEXT( PLANNER_EXECUTE_B );
                 }
@@ -232,37 +565,39 @@ path_interpolator_process( void )
                     STATE_NEXT( PLANNER_OFF );
                 }
 
-                path_interpolator_notify_pathing_complete( me->move_a.identifier );
-            }
-            else
-            {
-                path_interpolator_execute_move( &me->move_a, me->progress_percent );
+                path_interpolator_notify_pathing_complete( me->move_a->identifier );
             }
 
             STATE_EXIT_ACTION
-            memset( &me->move_a, 0, sizeof( Movement_t ) );
+            movement_queue_release( me->move_a );
+            me->move_a     = NULL;
+            me->compiled_a = false;
             STATE_END
             break;
 
         case PLANNER_EXECUTE_B:
             STATE_ENTRY_ACTION
             config_set_pathing_status( me->currentState );
-            path_interpolator_notify_pathing_started( me->move_b.identifier );
 
-            path_interpolator_premove_transforms( &me->move_b );
+            // The slot may have been emptied by a stop since this state was chosen
+            if( me->move_b )
+            {
+                path_interpolator_notify_pathing_started( me->move_b->identifier );
+                path_interpolator_premove_transforms( me->move_b );
+            }
+
             me->movement_started      = hal_systick_get_ms();
-            me->movement_est_complete = me->movement_started + me->move_b.duration;
+            me->movement_est_complete = me->movement_started + (uint32_t)( me->profile_b.duration * 1000.0f );
+            me->movement_ticks        = 0;
             me->progress_percent      = 0;
             STATE_TRANSITION_TEST
-            path_interpolator_calculate_percentage( me->move_b.duration );
-
-            if( !planner.enable || !me->move_b.duration )
+            if( !planner.enable || !me->move_b )
             {
                 STATE_NEXT( PLANNER_OFF );
             }
-            else if( path_interpolator_get_move_done() )
+            else if( path_interpolator_step( me->move_b, &me->profile_b ) )
             {
-                if( me->move_a.duration )
+                if( me->move_a )
                 {
                     STATE_NEXT( PLANNER_EXECUTE_A );
                 }
@@ -271,115 +606,248 @@ path_interpolator_process( void )
                     STATE_NEXT( PLANNER_OFF );
                 }
 
-                path_interpolator_notify_pathing_complete( me->move_b.identifier );
-            }
-            else
-            {
-                path_interpolator_execute_move( &me->move_b, me->progress_percent );
+                path_interpolator_notify_pathing_complete( me->move_b->identifier );
             }
 
             STATE_EXIT_ACTION
-            memset( &me->move_b, 0, sizeof( Movement_t ) );
+            movement_queue_release( me->move_b );
+            me->move_b     = NULL;
+            me->compiled_b = false;
             STATE_END
             break;
     }
 }
 
+// Run one motion loop tick of a move, returns true once the move has reached its end point
+PRIVATE bool
+path_interpolator_step( Movement_t *move, MotionProfile_t *profile )
+{
+    bool done = false;
+
+#ifdef MOTION_PRECOMPILE
+    (void)profile;
+    done = path_interpolator_replay_setpoint( move );
+#else
+    path_interpolator_calculate_percentage( profile );
+
+    // Land exactly on the end point so the next move continues from it
+    done = path_interpolator_get_move_done();
+    path_interpolator_execute_move( move, profile, done ? 1.0f : planner.progress_percent );
+#endif
+
+    trajectory_capture_sample( &planner.effector_position, planner.progress_percent, done );
+
+    return done;
+}
+
 PRIVATE void
 path_interpolator_premove_transforms( Movement_t *move )
 {
-    //apply current position to a relative movement
-    if( move->ref == _POS_RELATIVE )
+#ifdef MOTION_PRECOMPILE
+    // The compiler applied the origin when it solved the move
+    (void)move;
+#else
+    // Relative and transit moves start from wherever the effector currently is
+    cartesian_move_apply_origin( move, &planner.effector_position );
+#endif
+}
+
+#ifndef MOTION_PRECOMPILE
+
+PRIVATE void
+path_interpolator_execute_move( Movement_t *move, MotionProfile_t *profile, float percentage )
+{
+    CartesianPoint_t target       = { 0, 0, 0 };    //target position in cartesian space
+    JointAngles_t    angle_target = { 0, 0, 0 };    //target motor shaft angle in degrees
+
+    // percentage is distance along the path, look up the curve parameter which lands there
+    float pos_weight = cartesian_arc_table_lookup( &profile->path, percentage );
+
+    //TODO an invalid movement should be considered a motion error
+    cartesian_point_on_move( move, pos_weight, &target );
+
+    // Calculate a motor angle solution for the cartesian position, and ask the motors to please move there.
+    // Without a solution the arms hold their last target, moving some of them would drag the effector off the path.
+    // The position stays where the arms are, so relative moves keep their true origin. The kinematics count the miss.
+    if( kinematics_point_to_angle( target, &angle_target ) == SOLUTION_VALID )
     {
-        for( uint8_t i = 0; i < move->num_pts; i++ )
-        {
-            move->points[i].x += planner.effector_position.x;
-            move->points[i].y += planner.effector_position.y;
-            move->points[i].z += planner.effector_position.z;
-        }
+        servo_set_target_angle_limited( _CLEARPATH_1, angle_target.a1 );
+        servo_set_target_angle_limited( _CLEARPATH_2, angle_target.a2 );
+        servo_set_target_angle_limited( _CLEARPATH_3, angle_target.a3 );
+
+        config_set_position( target.x, target.y, target.z );
+        memcpy( &planner.effector_position, &target, sizeof( CartesianPoint_t ) );
     }
 
-    // A transit move is from current position to point 1, so overwrite 0 with current position,
-    // and then reuse a normal line movement
-    if( move->type == _POINT_TRANSIT )
+    // Update the config/UI data based on these actions
+    config_set_movement_data( move->identifier, move->type, ( uint8_t )( percentage * 100 ) );
+}
+
+#else
+
+// Pick the next loaded slot to compile, in the order the motion loop will run them
+PRIVATE bool
+path_interpolator_compile_select( void )
+{
+    MotionPlanner_t *me = &planner;
+    PathCompiler_t * c  = &compiler;
+
+    bool ready_a = me->move_a && !me->compiled_a;
+    bool ready_b = me->move_b && !me->compiled_b;
+
+    // The slot after the previous move comes first, otherwise whichever is waiting
+    if( ready_a && ( !ready_b || c->previous != &me->compiled_a ) )
     {
-        if( move->num_pts == 1 )
-        {
-            move->points[1].x = move->points[0].x;
-            move->points[1].y = move->points[0].y;
-            move->points[1].z = move->points[0].z;
-            move->num_pts     = 2;
-        }
+        c->move     = me->move_a;
+        c->profile  = &me->profile_a;
+        c->compiled = &me->compiled_a;
+    }
+    else if( ready_b )
+    {
+        c->move     = me->move_b;
+        c->profile  = &me->profile_b;
+        c->compiled = &me->compiled_b;
+    }
+    else
+    {
+        return false;
+    }
 
-        move->points[0].x = planner.effector_position.x;
-        move->points[0].y = planner.effector_position.y;
-        move->points[0].z = planner.effector_position.z;
+    // Nothing in flight, so the move starts from wherever the effector was left
+    if( me->currentState == PLANNER_OFF && c->head == c->tail )
+    {
+        c->position = path_interpolator_get_global_position();
     }
+
+    // Relative and transit moves start from wherever the previous move ends
+    c->origin = c->position;
+    cartesian_move_apply_origin( c->move, &c->origin );
+
+    c->ticks      = 0;
+    c->move_start = c->head;
+
+    return true;
 }
 
+/* -------------------------------------------------------------------------- */
+
+/*
+ * A point in the move couldn't be solved, or needs a shoulder past its limits.
+ *
+ * When the motion loop hasn't reached the move yet, its setpoints are dropped so
+ * it never starts. Either way the move ends on a fault setpoint which holds the
+ * arms, and the motion error stops the queue.
+ */
+
 PRIVATE void
-path_interpolator_execute_move( Movement_t *move, float percentage )
+path_interpolator_compile_fault( void )
 {
-    CartesianPoint_t target       = { 0, 0, 0 };    //target position in cartesian space
-    JointAngles_t    angle_target = { 0, 0, 0 };    //target motor shaft angle in degrees
+    PathCompiler_t *c = &compiler;
+
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    uint16_t pending  = ( c->head - c->tail ) & ( MOTION_SETPOINT_DEPTH - 1U );
+    uint16_t compiled = ( c->head - c->move_start ) & ( MOTION_SETPOINT_DEPTH - 1U );
 
-    switch( move->type )
+    if( pending >= compiled )
     {
-        case _POINT_TRANSIT:
-            cartesian_point_on_line( move->points, move->num_pts, percentage, &target );
-            break;
+        c->head     = c->move_start;
+        c->position = c->origin;
+    }
+    else if( ( ( c->head + 1U ) & ( MOTION_SETPOINT_DEPTH - 1U ) ) == c->tail )
+    {
+        // The ring is full, the fault replaces the newest setpoint
+        c->head = ( c->head - 1U ) & ( MOTION_SETPOINT_DEPTH - 1U );
+    }
+    CRITICAL_SECTION_END();
 
-        case _LINE:
-            cartesian_point_on_line( move->points, move->num_pts, percentage, &target );
-            break;
+    PathSetpoint_t *setpoint = &c->entries[c->head];
 
-        case _CATMULL_SPLINE:
-            cartesian_point_on_catmull_spline( move->points, move->num_pts, percentage, &target );
-            break;
+    memset( setpoint, 0, sizeof( PathSetpoint_t ) );
+    setpoint->flags    = SETPOINT_LAST | SETPOINT_FAULT;
+    setpoint->position = c->position;
 
-        case _BEZIER_QUADRATIC:
-            cartesian_point_on_quadratic_bezier( move->points, move->num_pts, percentage, &target );
-            break;
+    atomicBarrier();
+    c->head = ( c->head + 1U ) & ( MOTION_SETPOINT_DEPTH - 1U );
 
-        case _BEZIER_CUBIC:
-            cartesian_point_on_cubic_bezier( move->points, move->num_pts, percentage, &target );
-            break;
-        default:
-            //TODO this should be considered a motion error
+    *c->compiled = true;
+    c->previous  = c->compiled;
+    c->move      = NULL;
 
-            break;
+    config_report_error( "Unreachable point in movement" );
+    eventPublish( EVENT_NEW( StateEvent, MOTION_ERROR ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Post the next compiled setpoint to the servos, returns true when it was the move's last
+PRIVATE bool
+path_interpolator_replay_setpoint( Movement_t *move )
+{
+    MotionPlanner_t *me = &planner;
+    PathCompiler_t * c  = &compiler;
+
+    // The compiler fell behind, hold the arms and pick up the move where it left off
+    if( c->tail == c->head )
+    {
+        return false;
     }
 
-    // Calculate a motor angle solution for the cartesian position
-    kinematics_point_to_angle( target, &angle_target );
+    PathSetpoint_t *setpoint = &c->entries[c->tail];
 
-    // Ask the motors to please move there
-    servo_set_target_angle_limited( _CLEARPATH_1, angle_target.a1 );
-    servo_set_target_angle_limited( _CLEARPATH_2, angle_target.a2 );
-    servo_set_target_angle_limited( _CLEARPATH_3, angle_target.a3 );
+    if( !( setpoint->flags & SETPOINT_FAULT ) )
+    {
+        servo_set_target_steps( _CLEARPATH_1, setpoint->steps[_CLEARPATH_1] );
+        servo_set_target_steps( _CLEARPATH_2, setpoint->steps[_CLEARPATH_2] );
+        servo_set_target_steps( _CLEARPATH_3, setpoint->steps[_CLEARPATH_3] );
+    }
 
-    // Update the config/UI data based on these actions
-    config_set_position( target.x, target.y, target.z );
-    memcpy( &planner.effector_position, &target, sizeof( CartesianPoint_t ) );
-    config_set_movement_data( move->identifier, move->type, ( uint8_t )( percentage * 100 ) );
+    bool last = ( setpoint->flags & SETPOINT_LAST );
+
+    me->effector_position = setpoint->position;
+    me->progress_percent  = ( last ) ? 1.0f : setpoint->progress / 100.0f;
+
+    config_set_position( setpoint->position.x, setpoint->position.y, setpoint->position.z );
+    config_set_movement_data( move->identifier, move->type, setpoint->progress );
+
+    c->tail = ( c->tail + 1U ) & ( MOTION_SETPOINT_DEPTH - 1U );
+
+    return last;
 }
 
+#endif
+
+/* -------------------------------------------------------------------------- */
+
 PRIVATE void
 path_interpolator_notify_pathing_started( uint16_t move_id )
 {
-    BarrierSyncEvent *barrier_ev = EVENT_NEW( BarrierSyncEvent, PATHING_STARTED );
-    uint16_t          publish_id = move_id;
-
-    memcpy( &barrier_ev->id, &publish_id, sizeof( move_id ) );
-    eventPublish( (StateEvent *)barrier_ev );
+    trajectory_capture_move_started( move_id );
+    path_interpolator_notify( &pathing_started_fallback, move_id );
 }
 
 PRIVATE void
 path_interpolator_notify_pathing_complete( uint16_t move_id )
 {
-    BarrierSyncEvent *barrier_ev = EVENT_NEW( BarrierSyncEvent, PATHING_COMPLETE );
+    // The motion task only commits the next queued move when this arrives
+    path_interpolator_notify( &pathing_complete_fallback, move_id );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Runs in the motion interrupt. An empty pool is already counted against the
+// pool's failed allocations, the static event keeps the motion task going
+PRIVATE void
+path_interpolator_notify( BarrierSyncEvent *fallback, uint16_t move_id )
+{
+    BarrierSyncEvent *barrier_ev = EVENT_NEW( BarrierSyncEvent, fallback->super.signal );
     uint16_t          publish_id = move_id;
 
+    if( !barrier_ev )
+    {
+        barrier_ev = fallback;
+    }
+
     memcpy( &barrier_ev->id, &publish_id, sizeof( move_id ) );
     eventPublish( (StateEvent *)barrier_ev );
 }
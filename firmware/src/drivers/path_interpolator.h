@@ -3,7 +3,9 @@
 
 /* ----- Local Includes ----------------------------------------------------- */
 
+#include "app_config.h"
 #include "global.h"
+#include <motion_planner.h>
 #include <motion_types.h>
 
 /* ----- Defines ------------------------------------------------------------ */
@@ -17,13 +19,38 @@ path_interpolator_init( void );
 
 /* -------------------------------------------------------------------------- */
 
+/** Evaluate the active movement and post servo targets. Called at
+ *  MOTION_LOOP_RATE_HZ from the motion timer interrupt. */
+
 PUBLIC void
 path_interpolator_process( void );
 
 /* -------------------------------------------------------------------------- */
 
+#ifdef MOTION_PRECOMPILE
+
+/** Solve loaded movements into joint setpoints ahead of the motion loop.
+ *  Called from the background loop, does a bounded amount of work per call. */
+
+PUBLIC void
+path_interpolator_compile( void );
+
+#endif
+
+/* -------------------------------------------------------------------------- */
+
+/** Load a movement and the speed profile planned for it into a free slot */
+
 PUBLIC void
-path_interpolator_set_next( Movement_t *movement_to_process );
+path_interpolator_set_next( Movement_t *movement_to_process, MotionProfile_t *profile );
+
+/* -------------------------------------------------------------------------- */
+
+/** The queue behind the loaded moves was flushed, replan the last loaded move
+ *  so the effector comes to rest at its end instead of at its planned exit speed */
+
+PUBLIC void
+path_interpolator_stop_after_loaded( void );
 
 /* -------------------------------------------------------------------------- */
 
@@ -32,6 +59,13 @@ path_interpolator_is_ready_for_next( void );
 
 /* -------------------------------------------------------------------------- */
 
+/** True when neither slot holds a movement, the effector is at rest */
+
+PUBLIC bool
+path_interpolator_is_idle( void );
+
+/* -------------------------------------------------------------------------- */
+
 PUBLIC float
 path_interpolator_get_progress( void );
 
@@ -0,0 +1,302 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "telemetry.h"
+
+#include "app_times.h"
+#include "hal_systick.h"
+#include "qassert.h"
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+/* ----- Private Types ------------------------------------------------------ */
+
+typedef struct
+{
+    TelemetrySend_t send;            // 0 until the link is enabled
+    uint32_t        rate;            // budget refill, bytes per second
+    int32_t         budget;          // milli-bytes that may be sent now, negative once overspent
+    uint32_t        heard_ms;        // when the host last sent anything
+    bool            connected;       // heard from within TELEMETRY_HOST_TIMEOUT_MS
+    bool            deferred;        // upload bytes waiting, skip this pass
+    uint32_t        pending;         // channels waiting to be sent, bit per channel
+} TelemetryLink_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE const TelemetryChannel_t *channels;
+PRIVATE uint8_t                   channel_count;
+PRIVATE uint16_t                  shadow_offset[TELEMETRY_CHANNELS_MAX];
+PRIVATE uint8_t                   shadow[TELEMETRY_SHADOW_BYTES];
+PRIVATE uint32_t                  channels_in_rate[TELEMETRY_RATE_COUNT];
+
+PRIVATE TelemetryLink_t links[TELEMETRY_LINKS_MAX];
+
+PRIVATE const uint16_t rate_period_ms[TELEMETRY_RATE_COUNT] = {
+    TELEMETRY_FAST_MS,
+    TELEMETRY_NORMAL_MS,
+    TELEMETRY_SLOW_MS,
+};
+
+PRIVATE uint32_t rate_due_ms[TELEMETRY_RATE_COUNT];
+PRIVATE uint32_t refresh_due_ms;
+PRIVATE uint32_t last_process_ms;
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint32_t
+telemetry_sample( uint32_t due );
+
+PRIVATE void
+telemetry_publish( TelemetryLink_t *link, uint8_t link_id );
+
+PRIVATE int32_t
+telemetry_cost( const TelemetryChannel_t *channel );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+telemetry_init( const TelemetryChannel_t *table, uint8_t count )
+{
+    REQUIRE( count <= TELEMETRY_CHANNELS_MAX );
+
+    uint16_t offset = 0;
+
+    channels      = table;
+    channel_count = count;
+
+    memset( channels_in_rate, 0, sizeof( channels_in_rate ) );
+
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        REQUIRE( table[i].rate < TELEMETRY_RATE_COUNT );
+        REQUIRE( telemetry_cost( &table[i] ) <= (int32_t)TELEMETRY_BURST_BYTES * 1000 );    // or it could never be sent
+
+        shadow_offset[i] = offset;
+        offset += table[i].size;
+
+        channels_in_rate[table[i].rate] |= ( 1UL << i );
+    }
+
+    ENSURE( offset <= TELEMETRY_SHADOW_BYTES );
+
+    uint32_t now = hal_systick_get_ms();
+
+    for( uint8_t rate = 0; rate < TELEMETRY_RATE_COUNT; rate++ )
+    {
+        rate_due_ms[rate] = now;
+    }
+
+    refresh_due_ms  = now;
+    last_process_ms = now;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+telemetry_link_enable( uint8_t link, uint32_t bytes_per_second, TelemetrySend_t send )
+{
+    REQUIRE( link < TELEMETRY_LINKS_MAX );
+
+    links[link].send   = send;
+    links[link].rate   = ( bytes_per_second * TELEMETRY_LINK_SHARE_PERCENT ) / 100U;
+    links[link].budget = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+telemetry_link_heard( uint8_t link )
+{
+    REQUIRE( link < TELEMETRY_LINKS_MAX );
+
+    TelemetryLink_t *state = &links[link];
+
+    // A host that just (re)appeared has missed everything, start it off in full
+    if( !state->connected )
+    {
+        state->pending = ( channel_count < 32U ) ? ( 1UL << channel_count ) - 1U : UINT32_MAX;
+    }
+
+    state->heard_ms  = hal_systick_get_ms();
+    state->connected = true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+telemetry_link_charge( uint8_t link, uint16_t bytes )
+{
+    REQUIRE( link < TELEMETRY_LINKS_MAX );
+
+    links[link].budget -= (int32_t)bytes * 1000;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+telemetry_link_defer( uint8_t link )
+{
+    REQUIRE( link < TELEMETRY_LINKS_MAX );
+
+    links[link].deferred = true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+telemetry_process( void )
+{
+    if( !channels )
+    {
+        return;
+    }
+
+    uint32_t now     = hal_systick_get_ms();
+    uint32_t elapsed = now - last_process_ms;
+    uint32_t due     = 0;
+
+    last_process_ms = now;
+
+    for( uint8_t rate = 0; rate < TELEMETRY_RATE_COUNT; rate++ )
+    {
+        if( (int32_t)( now - rate_due_ms[rate] ) >= 0 )
+        {
+            due |= channels_in_rate[rate];
+            rate_due_ms[rate] = now + rate_period_ms[rate];
+        }
+    }
+
+    uint32_t changed = telemetry_sample( due );
+
+    // Values that drifted under their threshold, or sends a host missed, are
+    // caught up by a periodic resend of everything
+    if( (int32_t)( now - refresh_due_ms ) >= 0 )
+    {
+        changed        = ( channel_count < 32U ) ? ( 1UL << channel_count ) - 1U : UINT32_MAX;
+        refresh_due_ms = now + TELEMETRY_REFRESH_MS;
+    }
+
+    for( uint8_t id = 0; id < TELEMETRY_LINKS_MAX; id++ )
+    {
+        TelemetryLink_t *link = &links[id];
+
+        if( !link->send )
+        {
+            continue;
+        }
+
+        // Refill in milli-bytes so short passes still earn a fraction of a byte.
+        // A long gap between passes, like a stalled main loop, only counts
+        // for as long as the budget takes to fill, so it can't overflow
+        int32_t  limit     = (int32_t)TELEMETRY_BURST_BYTES * 1000;
+        uint32_t refill_ms = 0;
+
+        if( link->rate )
+        {
+            refill_ms = MIN( elapsed, (uint32_t)( limit - link->budget ) / link->rate + 1U );
+        }
+
+        link->budget = MIN( link->budget + (int32_t)( refill_ms * link->rate ), limit );
+
+        if( link->connected && now - link->heard_ms > TELEMETRY_HOST_TIMEOUT_MS )
+        {
+            link->connected = false;
+            link->pending   = 0;
+        }
+
+        if( !link->connected )
+        {
+            continue;
+        }
+
+        link->pending |= changed;
+
+        if( !link->deferred )
+        {
+            telemetry_publish( link, id );
+        }
+
+        link->deferred = false;
+    }
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// Compare the due channels against what was last published, returning those
+// that moved past their threshold. Their published copy is brought up to
+// date, so small changes accumulate until they're worth a send.
+PRIVATE uint32_t
+telemetry_sample( uint32_t due )
+{
+    uint32_t changed = 0;
+
+    for( uint8_t i = 0; i < channel_count; i++ )
+    {
+        if( !( due & ( 1UL << i ) ) )
+        {
+            continue;
+        }
+
+        const TelemetryChannel_t *channel   = &channels[i];
+        uint8_t *                 published = &shadow[shadow_offset[i]];
+
+        bool moved = channel->changed ? channel->changed( channel->data, published )
+                                      : memcmp( channel->data, published, channel->size ) != 0;
+
+        if( moved )
+        {
+            memcpy( published, channel->data, channel->size );
+            changed |= ( 1UL << i );
+        }
+    }
+
+    return changed;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Send pending channels, faster rate classes first, until the link's budget
+// runs out. Whatever doesn't fit stays pending for the next pass.
+PRIVATE void
+telemetry_publish( TelemetryLink_t *link, uint8_t link_id )
+{
+    for( uint8_t rate = 0; rate < TELEMETRY_RATE_COUNT; rate++ )
+    {
+        uint32_t waiting = link->pending & channels_in_rate[rate];
+
+        for( uint8_t i = 0; waiting && i < channel_count; i++ )
+        {
+            if( !( waiting & ( 1UL << i ) ) )
+            {
+                continue;
+            }
+
+            if( link->budget < telemetry_cost( &channels[i] ) )
+            {
+                return;
+            }
+
+            // The link's write charges the budget for what actually went out
+            link->send( link_id, channels[i].id );
+
+            link->pending &= ~( 1UL << i );
+            waiting &= ~( 1UL << i );
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE int32_t
+telemetry_cost( const TelemetryChannel_t *channel )
+{
+    uint32_t bytes = TELEMETRY_PACKET_OVERHEAD + strlen( channel->id ) + channel->size;
+
+    return (int32_t)bytes * 1000;
+}
+
+/* ----- End ---------------------------------------------------------------- */
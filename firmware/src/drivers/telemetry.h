@@ -0,0 +1,95 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Types -------------------------------------------------------------- */
+
+typedef enum
+{
+    TELEMETRY_RATE_FAST = 0,    // TELEMETRY_FAST_MS
+    TELEMETRY_RATE_NORMAL,      // TELEMETRY_NORMAL_MS
+    TELEMETRY_RATE_SLOW,        // TELEMETRY_SLOW_MS
+    TELEMETRY_RATE_COUNT,
+} TelemetryRate_t;
+
+// True when the live value has moved far enough from the last published copy
+// to be worth sending again
+typedef bool ( *TelemetryChanged_t )( const void *live, const void *published );
+
+// A tracked variable the scheduler publishes
+typedef struct
+{
+    const char *       id;         // tracked eUI message ID
+    const void *       data;       // the variable behind the ID
+    uint16_t           size;
+    TelemetryRate_t    rate;       // fastest it is checked and sent at
+    TelemetryChanged_t changed;    // change threshold, 0 sends on any difference
+} TelemetryChannel_t;
+
+// Writes the tracked variable id out of a link
+typedef void ( *TelemetrySend_t )( uint8_t link, const char *id );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/** Publish the channels in order of rate class, earlier channels first within
+ *  a class. The table must outlive the scheduler. */
+
+PUBLIC void
+telemetry_init( const TelemetryChannel_t *channels, uint8_t count );
+
+/* -------------------------------------------------------------------------- */
+
+/** Allow telemetry on a link, inside TELEMETRY_LINK_SHARE_PERCENT of the
+ *  bytes_per_second the link can carry */
+
+PUBLIC void
+telemetry_link_enable( uint8_t link, uint32_t bytes_per_second, TelemetrySend_t send );
+
+/* -------------------------------------------------------------------------- */
+
+/** Bytes arrived on the link, so a host is listening. A host that has been
+ *  quiet for TELEMETRY_HOST_TIMEOUT_MS is sent everything again when heard. */
+
+PUBLIC void
+telemetry_link_heard( uint8_t link );
+
+/* -------------------------------------------------------------------------- */
+
+/** Count bytes written to the link against its budget. Called for all
+ *  traffic, so replies to uploads leave less room for telemetry. */
+
+PUBLIC void
+telemetry_link_charge( uint8_t link, uint16_t bytes );
+
+/* -------------------------------------------------------------------------- */
+
+/** Received bytes are still waiting to be parsed, hold telemetry back on the
+ *  link for this pass so the upload is answered first */
+
+PUBLIC void
+telemetry_link_defer( uint8_t link );
+
+/* -------------------------------------------------------------------------- */
+
+/** Check the channels that are due and send what changed, run from the
+ *  background loop after received bytes have been parsed */
+
+PUBLIC void
+telemetry_process( void );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
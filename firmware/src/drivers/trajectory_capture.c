@@ -0,0 +1,291 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "trajectory_capture.h"
+
+#include "app_times.h"
+#include "clearpath.h"
+#include "configuration.h"
+#include "hal_stepper.h"
+#include "qassert.h"
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+/* ----- Private Types ------------------------------------------------------ */
+
+// Single producer (motion loop) and single consumer (host reads) ring of samples
+typedef struct
+{
+    TrajectorySample_t entries[TRAJECTORY_CAPTURE_DEPTH];
+    volatile uint16_t  head;    // next entry the motion loop writes
+    volatile uint16_t  tail;    // oldest entry the host hasn't released
+
+    volatile TrajectoryCaptureState_t state;
+
+    uint16_t start_id;
+    uint16_t stop_id;
+    uint8_t  divider;      // motion loop ticks per sample
+    uint8_t  countdown;    // ticks to skip before the next sample
+    uint8_t  flags;        // TrajectorySampleFlags_t for the next sample taken
+    bool     stop_move;    // the move running is the stop move
+    uint32_t tick;         // motion loop ticks since recording started
+    uint32_t captured;
+    uint32_t dropped;
+
+    bool     block_valid;       // a block has been read since arming
+    uint16_t block_sequence;    // sequence of the last block read
+    uint8_t  block_count;       // samples it carried, released when the next sequence is asked for
+    uint32_t block_first;       // capture tick of its first sample
+} TrajectoryCapture_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE TrajectoryCapture_t capture;
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint16_t
+trajectory_capture_waiting( void );
+
+PRIVATE void
+trajectory_capture_fill( TrajectoryBlock_t *block );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_init( void )
+{
+    memset( &capture, 0, sizeof( capture ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_arm( const TrajectoryCaptureArm_t *arm )
+{
+    TrajectoryCapture_t *c = &capture;
+
+    REQUIRE( arm );
+
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+
+    c->head           = 0;
+    c->tail           = 0;
+    c->start_id       = arm->start_id;
+    c->stop_id        = arm->stop_id;
+    c->divider        = CLAMP( arm->divider, 1U, TRAJECTORY_DIVIDER_MAX );
+    c->countdown      = 0;
+    c->flags          = 0;
+    c->stop_move      = false;
+    c->tick           = 0;
+    c->captured       = 0;
+    c->dropped        = 0;
+    c->block_valid    = false;
+    c->block_sequence = 0;
+    c->block_count    = 0;
+    c->block_first    = 0;
+    c->state          = CAPTURE_ARMED;
+
+    CRITICAL_SECTION_END();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_stop( void )
+{
+    TrajectoryCapture_t *c = &capture;
+
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+
+    if( c->state == CAPTURE_ARMED )
+    {
+        c->state = CAPTURE_IDLE;
+    }
+    else if( c->state == CAPTURE_RECORDING )
+    {
+        c->state = CAPTURE_DONE;
+    }
+
+    CRITICAL_SECTION_END();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_move_started( uint16_t move_id )
+{
+    TrajectoryCapture_t *c = &capture;
+
+    if( c->state == CAPTURE_ARMED && move_id == c->start_id )
+    {
+        c->state     = CAPTURE_RECORDING;
+        c->countdown = 0;
+    }
+
+    if( c->state == CAPTURE_RECORDING )
+    {
+        c->flags |= CAPTURE_SAMPLE_MOVE_START;
+        c->stop_move = ( move_id == c->stop_id );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_sample( const CartesianPoint_t *target, float progress, bool move_done )
+{
+    TrajectoryCapture_t *c = &capture;
+
+    if( c->state != CAPTURE_RECORDING )
+    {
+        return;
+    }
+
+    bool     last = move_done && c->stop_move;
+    uint32_t tick = c->tick++;
+
+    // The final tick is always kept so the capture ends on the stop move's end point
+    if( c->countdown && !last )
+    {
+        c->countdown--;
+        return;
+    }
+
+    c->countdown = c->divider - 1U;
+    c->captured++;
+
+    if( last )
+    {
+        c->flags |= CAPTURE_SAMPLE_LAST;
+        c->state  = CAPTURE_DONE;
+    }
+
+    uint16_t next = ( c->head + 1U ) & ( TRAJECTORY_CAPTURE_DEPTH - 1U );
+
+    // Held samples are never overwritten, the host decides how far behind it can fall
+    if( next == c->tail )
+    {
+        c->dropped++;
+        return;
+    }
+
+    TrajectorySample_t *sample = &c->entries[c->head];
+    uint16_t            red, green, blue;
+
+    config_get_led_values( &red, &green, &blue );
+
+    sample->target   = *target;
+    sample->tick     = (uint16_t)tick;
+    sample->progress = ( uint8_t )( CLAMP( progress, 0.0f, 1.0f ) * 100.0f );
+    sample->rgb[0]   = red >> 8U;
+    sample->rgb[1]   = green >> 8U;
+    sample->rgb[2]   = blue >> 8U;
+    sample->flags    = c->flags;
+
+    for( uint8_t servo = _CLEARPATH_1; servo <= _CLEARPATH_3; servo++ )
+    {
+        float feedback = servo_get_feedback_percent( servo );
+
+        sample->steps[servo]    = (int16_t)hal_stepper_get_position( servo );
+        sample->feedback[servo] = (int8_t)CLAMP( feedback, -100.0f, 100.0f );
+
+        if( !servo_get_servo_ok( servo ) )
+        {
+            sample->flags |= CAPTURE_SAMPLE_SERVO_OFF;
+        }
+    }
+
+    c->flags = 0;
+    c->head  = next;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+trajectory_capture_read_block( uint16_t sequence, TrajectoryBlock_t *block )
+{
+    TrajectoryCapture_t *c = &capture;
+
+    REQUIRE( block );
+
+    bool repeat = c->block_valid && sequence == c->block_sequence;
+    bool next   = c->block_valid ? sequence == ( uint16_t )( c->block_sequence + 1U ) : sequence == 0;
+
+    if( next )
+    {
+        // The host has the previous block, its samples can be written over
+        c->tail = ( c->tail + c->block_count ) & ( TRAJECTORY_CAPTURE_DEPTH - 1U );
+
+        c->block_valid    = true;
+        c->block_sequence = sequence;
+        c->block_count    = MIN( trajectory_capture_waiting(), TRAJECTORY_BLOCK_SAMPLES );
+
+        // Samples only carry the low bits of their tick, unwrap against the last block
+        if( c->block_count )
+        {
+            uint16_t low   = c->entries[c->tail].tick;
+            c->block_first = c->block_first + ( uint16_t )( low - (uint16_t)c->block_first );
+        }
+    }
+
+    // A host that lost track is sent the current block again, its sequence
+    // tells the host where to carry on from
+    trajectory_capture_fill( block );
+
+    return repeat || next;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_get_status( TrajectoryCaptureStatus_t *status )
+{
+    TrajectoryCapture_t *c = &capture;
+
+    status->state    = c->state;
+    status->divider  = c->divider;
+    status->start_id = c->start_id;
+    status->stop_id  = c->stop_id;
+    status->waiting  = trajectory_capture_waiting();
+    status->captured = c->captured;
+    status->dropped  = c->dropped;
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint16_t
+trajectory_capture_waiting( void )
+{
+    return ( capture.head - capture.tail ) & ( TRAJECTORY_CAPTURE_DEPTH - 1U );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Copy the current block's samples out of the ring, which may wrap part way
+PRIVATE void
+trajectory_capture_fill( TrajectoryBlock_t *block )
+{
+    TrajectoryCapture_t *c = &capture;
+
+    memset( block, 0, sizeof( TrajectoryBlock_t ) );
+
+    block->sequence = c->block_sequence;
+    block->count    = c->block_count;
+    block->state    = c->state;
+    block->first    = c->block_first;
+
+    for( uint8_t i = 0; i < c->block_count; i++ )
+    {
+        uint16_t index = ( c->tail + i ) & ( TRAJECTORY_CAPTURE_DEPTH - 1U );
+
+        block->samples[i] = c->entries[index];
+    }
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,129 @@
+#ifndef TRAJECTORY_CAPTURE_H
+#define TRAJECTORY_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "app_times.h"
+#include "global.h"
+#include "motion_types.h"
+
+/* ----- Types -------------------------------------------------------------- */
+
+typedef enum
+{
+    CAPTURE_IDLE = 0,      // nothing armed
+    CAPTURE_ARMED,         // waiting for the start move
+    CAPTURE_RECORDING,     // sampling every divider motion loop ticks
+    CAPTURE_DONE,          // stop move completed, samples held until read or re-armed
+} TrajectoryCaptureState_t;
+
+typedef enum
+{
+    CAPTURE_SAMPLE_MOVE_START = ( 1U << 0U ),    // first tick of a move
+    CAPTURE_SAMPLE_LAST       = ( 1U << 1U ),    // final tick of the capture
+    CAPTURE_SAMPLE_SERVO_OFF  = ( 1U << 2U ),    // a servo wasn't enabled and following its target
+} TrajectorySampleFlags_t;
+
+// What the arm was told to do and did during one sampled motion loop tick
+typedef struct
+{
+    CartesianPoint_t target;         // effector position the tick solved for, microns
+    uint16_t         tick;           // motion loop ticks since the capture started, wraps
+    int16_t          steps[3];       // step pulses emitted to each shoulder servo
+    int8_t           feedback[3];    // HLFB torque of each servo, percent of rated
+    uint8_t          rgb[3];         // LED drive, high byte of the 16-bit output
+    uint8_t          progress;       // percentage through the current move
+    uint8_t          flags;          // TrajectorySampleFlags_t
+} TrajectorySample_t;
+
+// Host arms a capture with this
+typedef struct
+{
+    uint16_t start_id;    // recording starts with the first tick of this move
+    uint16_t stop_id;     // and ends with the last tick of this one
+    uint16_t divider;     // motion loop ticks per sample, 0 or 1 for every tick
+} TrajectoryCaptureArm_t;
+
+typedef struct
+{
+    uint8_t  state;       // TrajectoryCaptureState_t
+    uint8_t  divider;
+    uint16_t start_id;
+    uint16_t stop_id;
+    uint16_t waiting;     // samples held that the host hasn't read
+    uint32_t captured;    // samples taken since the capture was armed
+    uint32_t dropped;     // samples lost because the host fell behind
+} TrajectoryCaptureStatus_t;
+
+// Consecutive samples read out of the capture. A block is resent until the
+// host asks for the sequence after it.
+typedef struct
+{
+    uint16_t           sequence;    // 0 is the first block after arming
+    uint8_t            count;       // valid samples, 0 when there's nothing new yet
+    uint8_t            state;       // TrajectoryCaptureState_t when the block was read
+    uint32_t           first;       // capture tick of samples[0], untruncated
+    TrajectorySample_t samples[TRAJECTORY_BLOCK_SAMPLES];
+} TrajectoryBlock_t;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_init( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Discard any held samples and wait for the start move */
+
+PUBLIC void
+trajectory_capture_arm( const TrajectoryCaptureArm_t *arm );
+
+/* -------------------------------------------------------------------------- */
+
+/** End a capture early, samples already taken are kept for the host */
+
+PUBLIC void
+trajectory_capture_stop( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Called by the motion loop as each move begins */
+
+PUBLIC void
+trajectory_capture_move_started( uint16_t move_id );
+
+/* -------------------------------------------------------------------------- */
+
+/** Record the tick the motion loop just ran, when a capture is recording.
+ *  The capture ends once move_done is set during the stop move. */
+
+PUBLIC void
+trajectory_capture_sample( const CartesianPoint_t *target, float progress, bool move_done );
+
+/* -------------------------------------------------------------------------- */
+
+/** Fill block with the requested sequence. Asking for the sequence after the
+ *  last block read releases its samples, asking for the same one again
+ *  repeats it. Any other sequence repeats the last block and returns false. */
+
+PUBLIC bool
+trajectory_capture_read_block( uint16_t sequence, TrajectoryBlock_t *block );
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+trajectory_capture_get_status( TrajectoryCaptureStatus_t *status );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRAJECTORY_CAPTURE_H */
@@ -9,6 +9,7 @@
 #include "stm32f4xx_ll_dma.h"
 
 #include "hal_adc.h"
+#include "hal_profiler.h"
 
 #include "app_config.h"
 #include "average_short.h"
@@ -341,6 +342,8 @@ void ADC_IRQHandler( void )
 
 void DMA2_Stream0_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     // DMA half transfer caused the DMA interruption
     if( LL_DMA_IsActiveFlag_HT0( DMA2 ) == 1 )
     {
@@ -392,6 +395,8 @@ void DMA2_Stream0_IRQHandler( void )
         // TODO Handle adc DMA errors?
         asm( "nop" );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_ADC, start );
 }
 
 /* ----- End ---------------------------------------------------------------- */
@@ -125,6 +125,8 @@ const HalGpioDef_t HalGpioHardwareMap[] = {
     /* --- USB --- */
     [_USB_PWR_EN]   = { .mode = MODE_INPUT, .port = PORT_A, .pin = PIN_9, .initial = 0 },
     [_USB_ID_SPARE] = { .mode = MODE_INPUT, .port = PORT_A, .pin = PIN_10, .initial = 0 },
+    [_USB_DM]       = { .mode = MODE_AF_PP, .port = PORT_A, .pin = PIN_11, .initial = 0 },
+    [_USB_DP]       = { .mode = MODE_AF_PP, .port = PORT_A, .pin = PIN_12, .initial = 0 },
 
     /* --- SERVO IO --- */
     [_SERVO_1_A]             = { .mode = MODE_OUT_PP, .port = PORT_C, .pin = PIN_8, .initial = 0 },
@@ -282,6 +284,19 @@ hal_gpio_toggle_pin( HalGpioPortPin_t gpio_port_pin_nr )
 
 /* -------------------------------------------------------------------------- */
 
+/** @brief Get the BSRR register and pin mask. Write mask to set, mask << 16 to reset */
+
+PUBLIC void
+hal_gpio_get_bsrr( HalGpioPortPin_t gpio_port_pin_nr, volatile uint32_t **bsrr, uint32_t *mask )
+{
+    const HalGpioDef_t *m = &HalGpioHardwareMap[gpio_port_pin_nr];
+
+    *bsrr = &hal_gpio_mcu_port( m->port )->BSRR;
+    *mask = hal_gpio_mcu_pin( m->pin );
+}
+
+/* -------------------------------------------------------------------------- */
+
 /** @brief Disable the I/O pin */
 
 PUBLIC void
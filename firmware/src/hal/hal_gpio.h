@@ -86,6 +86,8 @@ typedef enum
     /* --- USB --- */
     _USB_PWR_EN,
     _USB_ID_SPARE,
+    _USB_DM,
+    _USB_DP,
 
     /* --- SERVO IO --- */
     _SERVO_1_A,
@@ -166,6 +168,14 @@ hal_gpio_toggle_pin( HalGpioPortPin_t gpio_port_pin_nr );
 
 /* -------------------------------------------------------------------------- */
 
+/** Resolve the pin's bit set/reset register and pin mask, for drivers which
+ *  need to drive an output from an ISR without the table lookups */
+
+PUBLIC void
+hal_gpio_get_bsrr( HalGpioPortPin_t gpio_port_pin_nr, volatile uint32_t **bsrr, uint32_t *mask );
+
+/* -------------------------------------------------------------------------- */
+
 /** Disable pin */
 
 PUBLIC void
@@ -0,0 +1,142 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_tim.h"
+
+#include "hal_motion_timer.h"
+#include "hal_profiler.h"
+#include "qassert.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+// TIM6 is a basic timer on APB1, 42MHz bus with the x2 timer multiplier
+#define MOTION_TIM_CLOCK     84000000UL
+#define MOTION_TIM_COUNT_CLK 1000000UL    // 1us resolution for the period
+
+/* ----- Variables ---------------------------------------------------------- */
+
+PRIVATE volatile voidMotionTickFuncPtr motion_hook = NULL;
+
+PRIVATE uint16_t          motion_rate_hz;
+PRIVATE uint32_t          cycles_per_us;
+PRIVATE volatile uint32_t cycles_last;
+PRIVATE volatile uint32_t cycles_max;
+PRIVATE volatile uint32_t tick_count;
+PRIVATE volatile uint32_t overrun_count;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+hal_motion_timer_init( uint16_t rate_hz )
+{
+    REQUIRE( rate_hz >= 100U && rate_hz <= 10000U );
+
+    motion_rate_hz = rate_hz;
+    cycles_per_us  = SystemCoreClock / 1000000UL;
+    cycles_last    = 0;
+    cycles_max     = 0;
+    tick_count     = 0;
+    overrun_count  = 0;
+
+    LL_APB1_GRP1_EnableClock( LL_APB1_GRP1_PERIPH_TIM6 );
+
+    // Above the comms and input capture handlers, below the step generator
+    NVIC_SetPriority( TIM6_DAC_IRQn, NVIC_EncodePriority( NVIC_GetPriorityGrouping(), 3, 0 ) );
+    NVIC_EnableIRQ( TIM6_DAC_IRQn );
+
+    LL_TIM_SetPrescaler( TIM6, ( MOTION_TIM_CLOCK / MOTION_TIM_COUNT_CLK ) - 1U );
+    LL_TIM_SetCounterMode( TIM6, LL_TIM_COUNTERMODE_UP );
+    LL_TIM_SetAutoReload( TIM6, ( MOTION_TIM_COUNT_CLK / rate_hz ) - 1U );
+    LL_TIM_EnableARRPreload( TIM6 );
+    LL_TIM_GenerateEvent_UPDATE( TIM6 );
+    LL_TIM_ClearFlag_UPDATE( TIM6 );
+
+    LL_TIM_EnableIT_UPDATE( TIM6 );
+    LL_TIM_EnableCounter( TIM6 );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_motion_timer_hook( voidMotionTickFuncPtr hookfunc )
+{
+    motion_hook = hookfunc;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint16_t
+hal_motion_timer_get_rate( void )
+{
+    return motion_rate_hz;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_motion_timer_get_statistics( HalMotionTimerStats_t *stats, bool clear_peaks )
+{
+    REQUIRE( stats );
+
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    uint32_t last   = cycles_last;
+    uint32_t peak   = cycles_max;
+    stats->ticks    = tick_count;
+    stats->overruns = overrun_count;
+    if( clear_peaks )
+    {
+        cycles_max = 0;
+    }
+    CRITICAL_SECTION_END();
+
+    uint32_t period_us = 1000000UL / motion_rate_hz;
+
+    stats->rate_hz     = motion_rate_hz;
+    stats->exec_us     = last / cycles_per_us;
+    stats->exec_us_max = peak / cycles_per_us;
+    stats->load        = ( stats->exec_us_max * 100U ) / period_us;
+}
+
+/* ----- Interrupts --------------------------------------------------------- */
+
+void TIM6_DAC_IRQHandler( void )
+{
+    if( LL_TIM_IsActiveFlag_UPDATE( TIM6 ) )
+    {
+        LL_TIM_ClearFlag_UPDATE( TIM6 );
+
+        uint32_t cycles_start = DWT->CYCCNT;
+
+        if( motion_hook )
+        {
+            motion_hook();
+        }
+
+        uint32_t cycles_used = DWT->CYCCNT - cycles_start;
+
+        hal_profiler_record( HAL_PROFILER_IRQ_MOTION, cycles_used );
+
+        cycles_last = cycles_used;
+        if( cycles_used > cycles_max )
+        {
+            cycles_max = cycles_used;
+        }
+
+        tick_count++;
+
+        // The next period elapsed while this tick was still running
+        if( LL_TIM_IsActiveFlag_UPDATE( TIM6 ) )
+        {
+            overrun_count++;
+        }
+    }
+}
+
+/* ----- End ---------------------------------------------------------------- */
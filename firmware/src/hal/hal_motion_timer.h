@@ -0,0 +1,66 @@
+#ifndef HAL_MOTION_TIMER_H
+#define HAL_MOTION_TIMER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Types ------------------------------------------------------------- */
+
+typedef void ( *voidMotionTickFuncPtr )( void );
+
+typedef struct
+{
+    uint16_t rate_hz;        // configured tick rate
+    uint16_t exec_us;        // execution time of the most recent tick
+    uint16_t exec_us_max;    // worst execution time since last clear
+    uint16_t load;           // percentage of the tick period used by the worst tick
+    uint32_t ticks;          // ticks run since init
+    uint32_t overruns;       // ticks where the next period elapsed before the handler returned
+} HalMotionTimerStats_t;
+
+/* ----- Public Functions -------------------------------------------------- */
+
+/** Setup the fixed rate motion control timer. Supports 100Hz to 10kHz */
+
+PUBLIC void
+hal_motion_timer_init( uint16_t rate_hz );
+
+/* -------------------------------------------------------------------------- */
+
+/** Set the function run on every tick, from interrupt context */
+
+PUBLIC void
+hal_motion_timer_hook( voidMotionTickFuncPtr hookfunc );
+
+/* -------------------------------------------------------------------------- */
+
+/** Get the tick rate the loop was configured for */
+
+PUBLIC uint16_t
+hal_motion_timer_get_rate( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Copy out the timing statistics, optionally resetting the peak values */
+
+PUBLIC void
+hal_motion_timer_get_statistics( HalMotionTimerStats_t *stats, bool clear_peaks );
+
+/* -------------------------------------------------------------------------- */
+
+void TIM6_DAC_IRQHandler( void );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_MOTION_TIMER_H */
@@ -0,0 +1,138 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "stm32f4xx.h"
+
+#include "hal_profiler.h"
+#include "qassert.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+/* ----- Private Types ------------------------------------------------------ */
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;    // for the mean, 32 bits would wrap after ~25s of a busy probe
+    uint32_t histogram[HAL_PROFILER_BUCKETS];
+} ProfilerProbe_t;
+
+/* ----- Variables ---------------------------------------------------------- */
+
+PRIVATE ProfilerProbe_t probes[HAL_PROFILER_PROBES];
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint8_t
+hal_profiler_bucket( uint32_t cycles );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC uint32_t
+hal_profiler_start( void )
+{
+    return DWT->CYCCNT;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_profiler_stop( HalProfilerProbe_t probe, uint32_t start )
+{
+    hal_profiler_record( probe, DWT->CYCCNT - start );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_profiler_record( HalProfilerProbe_t probe, uint32_t cycles )
+{
+    REQUIRE( probe < HAL_PROFILER_PROBES );
+
+    ProfilerProbe_t *p = &probes[probe];
+
+    if( p->count == 0 || cycles < p->min )
+    {
+        p->min = cycles;
+    }
+
+    if( cycles > p->max )
+    {
+        p->max = cycles;
+    }
+
+    p->count++;
+    p->total += cycles;
+    p->histogram[hal_profiler_bucket( cycles )]++;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_profiler_get_statistics( HalProfilerStats_t *stats )
+{
+    REQUIRE( stats );
+
+    for( uint8_t i = 0; i < HAL_PROFILER_PROBES; i++ )
+    {
+        ProfilerProbe_t copy;
+
+        // One probe at a time, to keep interrupts masked only briefly
+        CRITICAL_SECTION_VAR();
+        CRITICAL_SECTION_START();
+        memcpy( &copy, &probes[i], sizeof( ProfilerProbe_t ) );
+        CRITICAL_SECTION_END();
+
+        stats[i].count = copy.count;
+        stats[i].min   = copy.min;
+        stats[i].mean  = ( copy.count ) ? (uint32_t)( copy.total / copy.count ) : 0;
+        stats[i].max   = copy.max;
+
+        for( uint8_t bucket = 0; bucket < HAL_PROFILER_BUCKETS; bucket++ )
+        {
+            stats[i].histogram[bucket] = (uint16_t)MIN( copy.histogram[bucket], UINT16_MAX );
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_profiler_clear( void )
+{
+    for( uint8_t i = 0; i < HAL_PROFILER_PROBES; i++ )
+    {
+        CRITICAL_SECTION_VAR();
+        CRITICAL_SECTION_START();
+        memset( &probes[i], 0, sizeof( ProfilerProbe_t ) );
+        CRITICAL_SECTION_END();
+    }
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// Buckets are a factor of four wide, so every two bits of magnitude above
+// 256 cycles move up a bucket
+PRIVATE uint8_t
+hal_profiler_bucket( uint32_t cycles )
+{
+    uint32_t scaled = cycles >> 8U;
+
+    if( scaled == 0 )
+    {
+        return 0;
+    }
+
+    uint8_t bits = (uint8_t)( 32U - (uint8_t)__builtin_clz( scaled ) );
+
+    return (uint8_t)MIN( ( bits + 1U ) / 2U, HAL_PROFILER_BUCKETS - 1U );
+}
+
+/* ----- End ---------------------------------------------------------------- */
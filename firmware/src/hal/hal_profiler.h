@@ -0,0 +1,100 @@
+#ifndef HAL_PROFILER_H
+#define HAL_PROFILER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define HAL_PROFILER_TASKS   5    // dispatch probes, one per task id from 1
+#define HAL_PROFILER_SERVOS  4    // servo_process probes, one per servo
+#define HAL_PROFILER_BUCKETS 8    // histogram buckets, see HalProfilerStats_t
+
+/* ----- Types ------------------------------------------------------------- */
+
+/* Each probe must only be recorded from contexts that can't preempt each
+ * other, so an interrupt probe is shared only by handlers at the same
+ * preemption level. Interrupt times include any higher priority handler
+ * that preempted them. */
+
+typedef enum
+{
+    HAL_PROFILER_DISPATCH = 0,    // hsmDispatch of task id 1, see HAL_PROFILER_TASKS
+
+    HAL_PROFILER_ADC = HAL_PROFILER_DISPATCH + HAL_PROFILER_TASKS,    // background jobs
+    HAL_PROFILER_FAN,
+    HAL_PROFILER_LED_INTERPOLATOR,
+    HAL_PROFILER_PATH_INTERPOLATOR,
+    HAL_PROFILER_SERVO,    // servo 1, see HAL_PROFILER_SERVOS
+
+    HAL_PROFILER_IRQ_SYSTICK = HAL_PROFILER_SERVO + HAL_PROFILER_SERVOS,    // interrupts
+    HAL_PROFILER_IRQ_STEPPER,
+    HAL_PROFILER_IRQ_ADC,
+    HAL_PROFILER_IRQ_MOTION,
+    HAL_PROFILER_IRQ_UART,
+    HAL_PROFILER_IRQ_USB,
+    HAL_PROFILER_IRQ_CAPTURE,
+
+    HAL_PROFILER_PROBES
+} HalProfilerProbe_t;
+
+// Histogram bucket n counts runs under 256 << 2n cycles, the last bucket
+// counts everything longer. At 168MHz that spans 1.5us to 6.2ms.
+typedef struct
+{
+    uint32_t count;                              // runs since last clear
+    uint32_t min;                                // cycles, 0 until the first run
+    uint32_t mean;
+    uint32_t max;
+    uint16_t histogram[HAL_PROFILER_BUCKETS];    // saturates at UINT16_MAX
+} HalProfilerStats_t;
+
+/* ----- Public Functions -------------------------------------------------- */
+
+/** Read the cycle counter at the start of the section being profiled */
+
+PUBLIC uint32_t
+hal_profiler_start( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Account the cycles since start against the probe. Safe from interrupts. */
+
+PUBLIC void
+hal_profiler_stop( HalProfilerProbe_t probe, uint32_t start );
+
+/* -------------------------------------------------------------------------- */
+
+/** Account an already measured number of cycles against the probe */
+
+PUBLIC void
+hal_profiler_record( HalProfilerProbe_t probe, uint32_t cycles );
+
+/* -------------------------------------------------------------------------- */
+
+/** Copy out HAL_PROFILER_PROBES entries, accumulated since the last clear */
+
+PUBLIC void
+hal_profiler_get_statistics( HalProfilerStats_t *stats );
+
+/* -------------------------------------------------------------------------- */
+
+/** Restart all the probes */
+
+PUBLIC void
+hal_profiler_clear( void );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_PROFILER_H */
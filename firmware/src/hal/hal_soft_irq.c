@@ -0,0 +1,104 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "stm32f4xx.h"
+
+#include "hal_soft_irq.h"
+#include "qassert.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+/* ----- Variables ---------------------------------------------------------- */
+
+// The CAN peripherals stay clocked off, so nothing but a pend raises these
+PRIVATE const IRQn_Type soft_irq_vectors[HAL_SOFT_IRQ_CHANNELS] = {
+    CAN1_TX_IRQn,
+    CAN1_RX0_IRQn,
+    CAN1_RX1_IRQn,
+    CAN1_SCE_IRQn,
+    CAN2_TX_IRQn,
+    CAN2_RX0_IRQn,
+};
+
+PRIVATE volatile voidSoftIrqFuncPtr soft_irq_hooks[HAL_SOFT_IRQ_CHANNELS] = { NULL };
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+hal_soft_irq_run( uint8_t channel );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+hal_soft_irq_hook( uint8_t channel, uint8_t preempt_priority, voidSoftIrqFuncPtr func )
+{
+    REQUIRE( channel < HAL_SOFT_IRQ_CHANNELS );
+    REQUIRE( func );
+
+    IRQn_Type irq = soft_irq_vectors[channel];
+
+    soft_irq_hooks[channel] = func;
+
+    NVIC_SetPriority( irq, NVIC_EncodePriority( NVIC_GetPriorityGrouping(), preempt_priority, 0 ) );
+    NVIC_EnableIRQ( irq );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_soft_irq_pend( uint8_t channel )
+{
+    REQUIRE( channel < HAL_SOFT_IRQ_CHANNELS );
+
+    NVIC_SetPendingIRQ( soft_irq_vectors[channel] );
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+hal_soft_irq_run( uint8_t channel )
+{
+    voidSoftIrqFuncPtr func = soft_irq_hooks[channel];
+
+    if( func )
+    {
+        func( channel );
+    }
+}
+
+/* ----- Interrupts --------------------------------------------------------- */
+
+void CAN1_TX_IRQHandler( void )
+{
+    hal_soft_irq_run( 0 );
+}
+
+void CAN1_RX0_IRQHandler( void )
+{
+    hal_soft_irq_run( 1 );
+}
+
+void CAN1_RX1_IRQHandler( void )
+{
+    hal_soft_irq_run( 2 );
+}
+
+void CAN1_SCE_IRQHandler( void )
+{
+    hal_soft_irq_run( 3 );
+}
+
+void CAN2_TX_IRQHandler( void )
+{
+    hal_soft_irq_run( 4 );
+}
+
+void CAN2_RX0_IRQHandler( void )
+{
+    hal_soft_irq_run( 5 );
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,56 @@
+#ifndef HAL_SOFT_IRQ_H
+#define HAL_SOFT_IRQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+/* The interrupt vectors of the unused CAN peripherals are borrowed, so the
+ * number of channels is limited to the vectors available */
+#define HAL_SOFT_IRQ_CHANNELS 6
+
+/* ----- Types ------------------------------------------------------------- */
+
+typedef void ( *voidSoftIrqFuncPtr )( uint8_t channel );
+
+/* ----- Public Functions -------------------------------------------------- */
+
+/** Run func from an interrupt at the given NVIC preemption priority whenever
+ *  the channel is pended. A pend made before the hook is set is kept and runs
+ *  as soon as the channel is enabled. */
+
+PUBLIC void
+hal_soft_irq_hook( uint8_t channel, uint8_t preempt_priority, voidSoftIrqFuncPtr func );
+
+/* -------------------------------------------------------------------------- */
+
+/** Request the channel's interrupt, from any context. Runs once however often
+ *  it is pended before it gets to run. */
+
+PUBLIC void
+hal_soft_irq_pend( uint8_t channel );
+
+/* -------------------------------------------------------------------------- */
+
+void CAN1_TX_IRQHandler( void );
+void CAN1_RX0_IRQHandler( void );
+void CAN1_RX1_IRQHandler( void );
+void CAN1_SCE_IRQHandler( void );
+void CAN2_TX_IRQHandler( void );
+void CAN2_RX0_IRQHandler( void );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_SOFT_IRQ_H */
@@ -0,0 +1,265 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_tim.h"
+
+#include "hal_gpio.h"
+#include "hal_profiler.h"
+#include "hal_stepper.h"
+#include "qassert.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+// TIM7 is a basic timer on APB1, 42MHz bus with the x2 timer multiplier
+#define STEPPER_TIM_CLOCK 84000000UL
+
+/*
+ * Each channel runs a 32-bit phase accumulator (DDA). Every tick the rate
+ * increment is added, and an overflow emits one step pulse. The pulse is
+ * released on the following tick, which also limits the rate to TICK_HZ/2.
+ *
+ * A direction change is written one tick before the next step edge to
+ * respect the servo's direction setup time.
+ */
+
+/* ----- Variables ---------------------------------------------------------- */
+
+typedef struct
+{
+    volatile uint32_t *step_bsrr;
+    volatile uint32_t *dir_bsrr;
+    uint32_t           step_mask;
+    uint32_t           dir_mask;
+    bool               dir_positive;
+    bool               configured;
+
+    volatile int32_t  position;
+    volatile int32_t  target;
+    volatile uint32_t increment;
+    uint32_t          phase;
+    uint32_t          rate_hz;
+    int8_t            direction;
+    bool              pulse_high;
+} HalStepper_t;
+
+PRIVATE HalStepper_t stepper[HAL_STEPPER_NUM_CHANNELS];
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+hal_stepper_write_direction( HalStepper_t *s, int8_t direction );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+hal_stepper_init( void )
+{
+    memset( &stepper, 0, sizeof( stepper ) );
+
+    LL_APB1_GRP1_EnableClock( LL_APB1_GRP1_PERIPH_TIM7 );
+
+    // Pulse timing is more important than UART or input capture servicing
+    NVIC_SetPriority( TIM7_IRQn, NVIC_EncodePriority( NVIC_GetPriorityGrouping(), 2, 0 ) );
+    NVIC_EnableIRQ( TIM7_IRQn );
+
+    LL_TIM_SetPrescaler( TIM7, 0 );
+    LL_TIM_SetCounterMode( TIM7, LL_TIM_COUNTERMODE_UP );
+    LL_TIM_SetAutoReload( TIM7, ( STEPPER_TIM_CLOCK / HAL_STEPPER_TICK_HZ ) - 1U );
+    LL_TIM_EnableARRPreload( TIM7 );
+    LL_TIM_GenerateEvent_UPDATE( TIM7 );
+    LL_TIM_ClearFlag_UPDATE( TIM7 );
+
+    LL_TIM_EnableIT_UPDATE( TIM7 );
+
+    // The counter is only started while a channel has steps remaining
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_stepper_configure( uint8_t          channel,
+                       HalGpioPortPin_t pin_step,
+                       HalGpioPortPin_t pin_direction,
+                       bool             dir_positive )
+{
+    REQUIRE( channel < HAL_STEPPER_NUM_CHANNELS );
+    HalStepper_t *s = &stepper[channel];
+
+    hal_gpio_get_bsrr( pin_step, &s->step_bsrr, &s->step_mask );
+    hal_gpio_get_bsrr( pin_direction, &s->dir_bsrr, &s->dir_mask );
+    s->dir_positive = dir_positive;
+
+    s->position   = 0;
+    s->target     = 0;
+    s->increment  = 0;
+    s->phase      = 0;
+    s->rate_hz    = 0;
+    s->pulse_high = false;
+
+    *s->step_bsrr = s->step_mask << 16U;
+    hal_stepper_write_direction( s, 1 );
+
+    s->configured = true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_stepper_set_target( uint8_t channel, int32_t target_steps, uint32_t rate_hz )
+{
+    REQUIRE( channel < HAL_STEPPER_NUM_CHANNELS );
+    HalStepper_t *s = &stepper[channel];
+
+    rate_hz = MIN( rate_hz, HAL_STEPPER_RATE_MAX_HZ );
+
+    // Only pay for the 64-bit divide when the rate actually changes
+    if( rate_hz != s->rate_hz )
+    {
+        s->rate_hz   = rate_hz;
+        s->increment = (uint32_t)( ( (uint64_t)rate_hz << 32U ) / HAL_STEPPER_TICK_HZ );
+    }
+
+    s->target = target_steps;
+
+    if( s->target != s->position )
+    {
+        LL_TIM_EnableCounter( TIM7 );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_stepper_set_position( uint8_t channel, int32_t position_steps )
+{
+    REQUIRE( channel < HAL_STEPPER_NUM_CHANNELS );
+    HalStepper_t *s = &stepper[channel];
+
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    s->position = position_steps;
+    s->target   = position_steps;
+    s->phase    = 0;
+    CRITICAL_SECTION_END();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC int32_t
+hal_stepper_get_position( uint8_t channel )
+{
+    REQUIRE( channel < HAL_STEPPER_NUM_CHANNELS );
+    return stepper[channel].position;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+hal_stepper_get_done( uint8_t channel )
+{
+    REQUIRE( channel < HAL_STEPPER_NUM_CHANNELS );
+    return ( stepper[channel].position == stepper[channel].target );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_stepper_stop( uint8_t channel )
+{
+    REQUIRE( channel < HAL_STEPPER_NUM_CHANNELS );
+    HalStepper_t *s = &stepper[channel];
+
+    CRITICAL_SECTION_VAR();
+    CRITICAL_SECTION_START();
+    s->target = s->position;
+    s->phase  = 0;
+    CRITICAL_SECTION_END();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+hal_stepper_write_direction( HalStepper_t *s, int8_t direction )
+{
+    bool level = ( direction > 0 ) ? s->dir_positive : !s->dir_positive;
+
+    *s->dir_bsrr = ( level ) ? s->dir_mask : ( s->dir_mask << 16U );
+    s->direction = direction;
+}
+
+/* ----- Interrupts --------------------------------------------------------- */
+
+void TIM7_IRQHandler( void )
+{
+    uint32_t start = hal_profiler_start();
+
+    if( LL_TIM_IsActiveFlag_UPDATE( TIM7 ) )
+    {
+        LL_TIM_ClearFlag_UPDATE( TIM7 );
+
+        bool busy = false;
+
+        for( uint8_t i = 0; i < HAL_STEPPER_NUM_CHANNELS; i++ )
+        {
+            HalStepper_t *s = &stepper[i];
+
+            if( !s->configured )
+            {
+                continue;
+            }
+
+            // Release the pulse raised on the previous tick
+            if( s->pulse_high )
+            {
+                *s->step_bsrr = s->step_mask << 16U;
+                s->pulse_high = false;
+                busy          = true;
+            }
+
+            int32_t remaining = s->target - s->position;
+
+            if( remaining == 0 )
+            {
+                s->phase = 0;
+                continue;
+            }
+
+            busy = true;
+
+            int8_t direction = ( remaining > 0 ) ? 1 : -1;
+
+            if( direction != s->direction )
+            {
+                hal_stepper_write_direction( s, direction );
+                continue;
+            }
+
+            // Accumulator overflow means a step is due. As the increment is
+            // at most 2^31, this can't happen on the tick after a pulse.
+            uint32_t previous = s->phase;
+            s->phase += s->increment;
+
+            if( s->phase < previous )
+            {
+                *s->step_bsrr = s->step_mask;
+                s->pulse_high = true;
+                s->position += direction;
+            }
+        }
+
+        if( !busy )
+        {
+            LL_TIM_DisableCounter( TIM7 );
+        }
+    }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_STEPPER, start );
+}
+
+/* ----- End ---------------------------------------------------------------- */
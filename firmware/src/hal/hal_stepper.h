@@ -0,0 +1,89 @@
+#ifndef HAL_STEPPER_H
+#define HAL_STEPPER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+#include "hal_gpio.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+// Step generator tick rate. Each step pulse is high for one tick, so the
+// highest usable step rate is half the tick rate.
+#define HAL_STEPPER_TICK_HZ      50000UL
+#define HAL_STEPPER_RATE_MAX_HZ  ( HAL_STEPPER_TICK_HZ / 2U )
+
+#define HAL_STEPPER_NUM_CHANNELS 4U
+
+/* ----- Public Functions -------------------------------------------------- */
+
+/** Setup the step generation timer. Channels are configured separately */
+
+PUBLIC void
+hal_stepper_init( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Bind a channel to its step and direction outputs.
+ *  dir_positive is the direction pin level used when stepping towards
+ *  a larger position value. */
+
+PUBLIC void
+hal_stepper_configure( uint8_t          channel,
+                       HalGpioPortPin_t pin_step,
+                       HalGpioPortPin_t pin_direction,
+                       bool             dir_positive );
+
+/* -------------------------------------------------------------------------- */
+
+/** Post a new absolute target position and step rate for a channel.
+ *  The timer ISR generates the pulses, so this returns immediately. */
+
+PUBLIC void
+hal_stepper_set_target( uint8_t channel, int32_t target_steps, uint32_t rate_hz );
+
+/* -------------------------------------------------------------------------- */
+
+/** Overwrite the position counter (i.e. after homing), target follows it */
+
+PUBLIC void
+hal_stepper_set_position( uint8_t channel, int32_t position_steps );
+
+/* -------------------------------------------------------------------------- */
+
+/** Position as counted by pulses already emitted */
+
+PUBLIC int32_t
+hal_stepper_get_position( uint8_t channel );
+
+/* -------------------------------------------------------------------------- */
+
+/** Returns true when the channel has reached its target */
+
+PUBLIC bool
+hal_stepper_get_done( uint8_t channel );
+
+/* -------------------------------------------------------------------------- */
+
+/** Abandon the rest of the move, holds at the current position */
+
+PUBLIC void
+hal_stepper_stop( uint8_t channel );
+
+/* -------------------------------------------------------------------------- */
+
+void TIM7_IRQHandler( void );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_STEPPER_H */
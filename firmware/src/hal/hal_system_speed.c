@@ -25,6 +25,10 @@ PRIVATE volatile uint32_t cc_asleep_time = 0;    //duration of 'sleep'
 
 PRIVATE SystemSpeed_RCC_PLL_t pll_working;
 
+// Written by CRITICAL_SECTION_START/END, see global.h
+uint32_t critical_section_entered    = 0;    //timestamp the outermost section masked interrupts
+uint32_t critical_section_cycles_max = 0;    //longest interrupts have been masked
+
 /* ----- Public Functions --------------------------------------------------- */
 
 PUBLIC void
@@ -152,6 +156,9 @@ hal_system_speed_sleep( void )
     cc_asleep_time += DWT->CYCCNT - cc_when_sleeping;
     cc_when_woken = DWT->CYCCNT;
 
+    // The wake-up interrupt runs as soon as we leave, so don't count the sleep as masked
+    critical_section_entered = cc_when_woken;
+
     CRITICAL_SECTION_END();
 }
 
@@ -183,6 +190,29 @@ hal_system_speed_get_speed( void )
 
 /* -------------------------------------------------------------------------- */
 
+PUBLIC uint32_t
+hal_system_speed_get_cycles( void )
+{
+    return DWT->CYCCNT;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint32_t
+hal_system_speed_get_masked_cycles( bool clear_peak )
+{
+    uint32_t cycles = critical_section_cycles_max;
+
+    if( clear_peak )
+    {
+        critical_section_cycles_max = 0;
+    }
+
+    return cycles;
+}
+
+/* -------------------------------------------------------------------------- */
+
 PUBLIC void
 hal_system_speed_high( void )
 {
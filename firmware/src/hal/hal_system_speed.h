@@ -76,6 +76,20 @@ hal_system_speed_get_speed( void );
 
 /* -------------------------------------------------------------------------- */
 
+/** Free running DWT cycle counter, for timing short sections of code */
+
+PUBLIC uint32_t
+hal_system_speed_get_cycles( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Longest time in cycles any critical section kept interrupts masked */
+
+PUBLIC uint32_t
+hal_system_speed_get_masked_cycles( bool clear_peak );
+
+/* -------------------------------------------------------------------------- */
+
 PUBLIC void
 hal_system_speed_high( void );
 
@@ -5,6 +5,7 @@
 /* -------------------------------------------------------------------------- */
 
 #include "hal_systick.h"
+#include "hal_profiler.h"
 #include "qassert.h"
 #include "stm32f4xx_ll_cortex.h"
 #include "stm32f4xx_ll_rcc.h"
@@ -125,8 +126,12 @@ hal_systick_callback( void )
 
 void SysTick_Handler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     tick_timer++;
     hal_systick_callback();
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_SYSTICK, start );
 }
 
 /* ----- End ---------------------------------------------------------------- */
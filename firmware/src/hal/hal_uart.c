@@ -16,6 +16,7 @@
 #include "fifo.h"
 #include "global.h"
 #include "hal_gpio.h"
+#include "hal_profiler.h"
 #include "hal_uart.h"
 #include "qassert.h"
 
@@ -26,7 +27,7 @@ DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
 /* ----- Defines ------------------------------------------------------------ */
 
 #define HAL_UART_RX_FIFO_SIZE 250
-#define HAL_UART_TX_FIFO_SIZE 250
+#define HAL_UART_TX_FIFO_SIZE UART_TX_BUFFER_BYTES
 
 #define HAL_UART_RX_DMA_BUFFER_SIZE 64
 
@@ -45,9 +46,10 @@ typedef struct
     uint32_t     dma_channel_rx;
 
     // User-space buffers are serviced outside IRQ
-    fifo_t   tx_fifo;
-    uint8_t  tx_buffer[HAL_UART_TX_FIFO_SIZE];
-    uint16_t tx_sneak_bytes;
+    fifo_t         tx_fifo;
+    uint8_t        tx_buffer[HAL_UART_TX_FIFO_SIZE];
+    uint16_t       tx_sneak_bytes;
+    HalUartStats_t stats;
 
     fifo_t  rx_fifo;
     uint8_t rx_buffer[HAL_UART_RX_FIFO_SIZE];
@@ -85,6 +87,9 @@ hal_uart_completed_tx( HalUart_t *h );
 PRIVATE void
 hal_usart_irq_rx_handler( HalUart_t *h );
 
+PRIVATE void
+hal_uart_tx_queued( HalUart_t *h, uint32_t length );
+
 /* ----- USART Interface ---------------------------------------------------- */
 
 PUBLIC void
@@ -261,7 +266,13 @@ hal_uart_write( HalUartPort_t port, const uint8_t *data, uint32_t length )
     if( fifo_free( &h->tx_fifo ) >= length )
     {
         sent = fifo_write( &h->tx_fifo, data, length );
-        hal_uart_start_tx( h );
+        hal_uart_tx_queued( h, sent );
+    }
+    else
+    {
+        h->stats.tx_dropped++;
+        h->stats.tx_dropped_bytes += length;
+        h->stats.tx_backpressure++;
     }
 
     return sent;
@@ -269,6 +280,22 @@ hal_uart_write( HalUartPort_t port, const uint8_t *data, uint32_t length )
 
 /* -------------------------------------------------------------------------- */
 
+PUBLIC void
+hal_uart_get_statistics( HalUartPort_t port, HalUartStats_t *stats, bool clear )
+{
+    HalUart_t *h = &hal_uart[port];
+
+    h->stats.tx_capacity = (uint16_t)fifo_size( &h->tx_fifo );
+    memcpy( stats, &h->stats, sizeof( HalUartStats_t ) );
+
+    if( clear )
+    {
+        memset( &h->stats, 0, sizeof( HalUartStats_t ) );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
 /* Returns number of available characters in the RX FIFO queue. */
 
 PUBLIC uint32_t
@@ -315,6 +342,33 @@ hal_uart_read( HalUartPort_t port, uint8_t *data, uint32_t maxlength )
 
 /* -------------------------------------------------------------------------- */
 
+/* The RX DMA interrupt only moves the fifo head, so the span from the tail
+ * stays valid until it is consumed.
+ */
+
+PUBLIC uint32_t
+hal_uart_rx_peek_linear( HalUartPort_t port, const uint8_t **data )
+{
+    HalUart_t *h = &hal_uart[port];
+
+    uint32_t length = fifo_used_linear( &h->rx_fifo );
+    *data           = (const uint8_t *)fifo_get_tail_ptr( &h->rx_fifo, length );
+
+    return length;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_uart_rx_consume( HalUartPort_t port, uint32_t length )
+{
+    HalUart_t *h = &hal_uart[port];
+
+    fifo_skip( &h->rx_fifo, length );
+}
+
+/* -------------------------------------------------------------------------- */
+
 PRIVATE void
 hal_uart_dma_init( HalUartPort_t port )
 {
@@ -568,14 +622,10 @@ hal_uart_start_tx( HalUart_t *h )
     /* If transfer is not on-going */
     if( !LL_DMA_IsEnabledStream( h->dma_peripheral, h->dma_stream_tx ) )
     {
+        // Send everything up to the end of the ring in one transfer, the
+        // completion interrupt chains the part that wrapped to the start
         h->tx_sneak_bytes = fifo_used_linear( &h->tx_fifo );
 
-        // Limit maximum size to transmit at a time
-        if( h->tx_sneak_bytes > 32 )
-        {
-            h->tx_sneak_bytes = 32;
-        }
-
         // Transmit remaining data
         if( h->tx_sneak_bytes > 0 )
         {
@@ -603,6 +653,23 @@ hal_uart_completed_tx( HalUart_t *h )
 
 /* ------------------------------------------------------------------*/
 
+PRIVATE void
+hal_uart_tx_queued( HalUart_t *h, uint32_t length )
+{
+    h->stats.tx_bytes += length;
+
+    uint32_t used = fifo_used( &h->tx_fifo );
+
+    if( used > h->stats.tx_peak_used )
+    {
+        h->stats.tx_peak_used = (uint16_t)used;
+    }
+
+    hal_uart_start_tx( h );
+}
+
+/* ------------------------------------------------------------------*/
+
 // Tracks data handled by RX DMA and passes data off for higher-level storage/parsing etc.
 // Called when the RX DMA interrupts for half or full buffer fire, and when line-idle occurs
 
@@ -647,6 +714,8 @@ hal_usart_irq_rx_handler( HalUart_t *h )
 PUBLIC void
 UART5_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     // Idle line interrupt occurs when the UART RX line has been high for more than one frame
     if( LL_USART_IsEnabledIT_IDLE( UART5 ) && LL_USART_IsActiveFlag_IDLE( UART5 ) )
     {
@@ -656,11 +725,15 @@ UART5_IRQHandler( void )
         // Check for data to process
         hal_usart_irq_rx_handler( &hal_uart[HAL_UART_PORT_EXTERNAL] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 // RX
 void DMA1_Stream0_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     // Half transfer complete
     if( LL_DMA_IsEnabledIT_HT( DMA1, LL_DMA_STREAM_0 ) && LL_DMA_IsActiveFlag_HT0( DMA1 ) )
     {
@@ -676,11 +749,15 @@ void DMA1_Stream0_IRQHandler( void )
         LL_DMA_ClearFlag_TC0( DMA1 );
         hal_usart_irq_rx_handler( &hal_uart[HAL_UART_PORT_EXTERNAL] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 // TX
 void DMA1_Stream7_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     // Transfer complete
     if( LL_DMA_IsEnabledIT_TC( DMA1, LL_DMA_STREAM_7 ) && LL_DMA_IsActiveFlag_TC7( DMA1 ) )
     {
@@ -689,22 +766,30 @@ void DMA1_Stream7_IRQHandler( void )
         // Flush the data we just finished transferring, and send more as needed
         hal_uart_completed_tx( &hal_uart[HAL_UART_PORT_EXTERNAL] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 /* -------------------------------------------------------------------------- */
 
 void USART1_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     if( LL_USART_IsEnabledIT_IDLE( USART1 ) && LL_USART_IsActiveFlag_IDLE( USART1 ) )
     {
         LL_USART_ClearFlag_IDLE( USART1 );
         hal_usart_irq_rx_handler( &hal_uart[HAL_UART_PORT_INTERNAL] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 // RX
 void DMA2_Stream2_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     // Half transfer complete
     if( LL_DMA_IsEnabledIT_HT( DMA2, LL_DMA_STREAM_2 ) && LL_DMA_IsActiveFlag_HT2( DMA2 ) )
     {
@@ -718,33 +803,45 @@ void DMA2_Stream2_IRQHandler( void )
         LL_DMA_ClearFlag_TC2( DMA2 );
         hal_usart_irq_rx_handler( &hal_uart[HAL_UART_PORT_INTERNAL] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 // TX
 void DMA2_Stream7_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     if( LL_DMA_IsEnabledIT_TC( DMA2, LL_DMA_STREAM_7 ) && LL_DMA_IsActiveFlag_TC7( DMA2 ) )
     {
         LL_DMA_ClearFlag_TC7( DMA2 );
         hal_uart_completed_tx( &hal_uart[HAL_UART_PORT_INTERNAL] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 /* -------------------------------------------------------------------------- */
 
 void USART2_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     /* Check for IDLE line interrupt */
     if( LL_USART_IsEnabledIT_IDLE( USART2 ) && LL_USART_IsActiveFlag_IDLE( USART2 ) )
     {
         LL_USART_ClearFlag_IDLE( USART2 );
         hal_usart_irq_rx_handler( &hal_uart[HAL_UART_PORT_MODULE] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 // RX
 void DMA1_Stream5_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     // Half-transfer complete interrupt
     if( LL_DMA_IsEnabledIT_HT( DMA1, LL_DMA_STREAM_5 ) && LL_DMA_IsActiveFlag_HT5( DMA1 ) )
     {
@@ -758,17 +855,23 @@ void DMA1_Stream5_IRQHandler( void )
         LL_DMA_ClearFlag_TC5( DMA1 );
         hal_usart_irq_rx_handler( &hal_uart[HAL_UART_PORT_MODULE] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 // TX
 void DMA1_Stream6_IRQHandler( void )
 {
+    uint32_t start = hal_profiler_start();
+
     // Check transfer-complete interrupt
     if( LL_DMA_IsEnabledIT_TC( DMA1, LL_DMA_STREAM_6 ) && LL_DMA_IsActiveFlag_TC6( DMA1 ) )
     {
         LL_DMA_ClearFlag_TC6( DMA1 );
         hal_uart_completed_tx( &hal_uart[HAL_UART_PORT_MODULE] );
     }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_UART, start );
 }
 
 /* ----- End ---------------------------------------------------------------- */
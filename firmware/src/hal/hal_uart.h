@@ -22,6 +22,16 @@ typedef enum
     HAL_UART_NUM_PORTS
 } HalUartPort_t;
 
+typedef struct
+{
+    uint32_t tx_bytes;            // bytes accepted into the tx ring
+    uint32_t tx_dropped;          // writes refused whole because the ring was too full
+    uint32_t tx_dropped_bytes;    // bytes in the refused writes
+    uint32_t tx_backpressure;     // writes and reservations that found less space than they asked for
+    uint16_t tx_peak_used;        // most bytes waiting in the ring since the last clear
+    uint16_t tx_capacity;         // usable size of the ring
+} HalUartStats_t;
+
 /* -------------------------------------------------------------------------- */
 /* --- UART INTERFACE                                                     --- */
 /* -------------------------------------------------------------------------- */
@@ -67,7 +77,12 @@ hal_uart_put_blocking( HalUartPort_t port, uint8_t c );
 /* -------------------------------------------------------------------------- */
 
 /* Non-blocking send for a number of characters to the UART tx FIFO queue.
- * Returns true when successful. false when queue was full.
+ * The write is all or nothing, so a frame is never sent in part.
+ * Returns the number of characters queued, 0 when the queue was too full.
+ *
+ * eUI hands over each frame already encoded in its own buffer, so this is
+ * the one copy a frame takes. Encoding straight into the ring would need
+ * the eUI library itself changed.
  */
 
 PUBLIC uint32_t
@@ -75,6 +90,13 @@ hal_uart_write( HalUartPort_t port, const uint8_t *data, uint32_t length );
 
 /* -------------------------------------------------------------------------- */
 
+/* Copy out the transmit counters, optionally clearing them */
+
+PUBLIC void
+hal_uart_get_statistics( HalUartPort_t port, HalUartStats_t *stats, bool clear );
+
+/* -------------------------------------------------------------------------- */
+
 /* Returns number of available characters in the RX FIFO queue. */
 
 PUBLIC uint32_t
@@ -100,6 +122,23 @@ hal_uart_read( HalUartPort_t port, uint8_t *buffer, uint32_t bufferlen );
 
 /* -------------------------------------------------------------------------- */
 
+/* Access the oldest received bytes in place, without copying them out.
+ * Returns the number of bytes that are contiguous in the rx FIFO from *data,
+ * release them with hal_uart_rx_consume once they have been handled.
+ */
+
+PUBLIC uint32_t
+hal_uart_rx_peek_linear( HalUartPort_t port, const uint8_t **data );
+
+/* -------------------------------------------------------------------------- */
+
+/* Release bytes returned by hal_uart_rx_peek_linear */
+
+PUBLIC void
+hal_uart_rx_consume( HalUartPort_t port, uint32_t length );
+
+/* -------------------------------------------------------------------------- */
+
 void UART5_IRQHandler( void );
 
 void USART1_IRQHandler( void );
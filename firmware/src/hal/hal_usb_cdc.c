@@ -0,0 +1,1073 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "stm32f4xx_ll_bus.h"
+
+#include "app_config.h"
+#include "app_times.h"
+#include "fifo.h"
+#include "global.h"
+#include "hal_delay.h"
+#include "hal_gpio.h"
+#include "hal_profiler.h"
+#include "hal_usb_cdc.h"
+#include "hal_uuid.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+// Register blocks the CMSIS header only gives offsets for
+#define USB_BASE          USB_OTG_FS_PERIPH_BASE
+#define USB_DEVICE        ( (USB_OTG_DeviceTypeDef *)( USB_BASE + USB_OTG_DEVICE_BASE ) )
+#define USB_INEP( _ep_ )  ( (USB_OTG_INEndpointTypeDef *)( USB_BASE + USB_OTG_IN_ENDPOINT_BASE + ( _ep_ ) * USB_OTG_EP_REG_SIZE ) )
+#define USB_OUTEP( _ep_ ) ( (USB_OTG_OUTEndpointTypeDef *)( USB_BASE + USB_OTG_OUT_ENDPOINT_BASE + ( _ep_ ) * USB_OTG_EP_REG_SIZE ) )
+#define USB_PCGCCTL       ( *(__IO uint32_t *)( USB_BASE + USB_OTG_PCGCCTL_BASE ) )
+
+// The host tests swap the data FIFO window for a model of the push/pop port
+#ifndef USB_FIFO
+#define USB_FIFO( _ep_ ) ( *(__IO uint32_t *)( USB_BASE + USB_OTG_FIFO_BASE + ( _ep_ ) * USB_OTG_FIFO_SIZE ) )
+#endif
+
+#define USB_ENDPOINTS 4U    // endpoints the FS core provides in each direction
+
+// Endpoint layout, EP1 carries the serial data and EP2 the (unused) CDC notifications
+#define CDC_EP_CONTROL 0U
+#define CDC_EP_DATA    1U
+#define CDC_EP_NOTIFY  2U
+
+#define EP0_PACKET_BYTES        64U
+#define CDC_DATA_PACKET_BYTES   64U
+#define CDC_NOTIFY_PACKET_BYTES 8U
+
+#define CDC_TX_TRANSFER_BYTES ( 4U * CDC_DATA_PACKET_BYTES )    // largest IN transfer loaded into the endpoint fifo at once
+
+// Dedicated FIFO RAM, in 32-bit words out of the 320 the FS core has
+#define FIFO_RX_WORDS     128U
+#define FIFO_EP0_TX_WORDS 32U
+#define FIFO_EP1_TX_WORDS 128U
+#define FIFO_EP2_TX_WORDS 16U
+
+#define EP_TYPE_BULK      2U
+#define EP_TYPE_INTERRUPT 3U
+
+// Receive status packet types
+#define PKTSTS_OUT_DATA   2U
+#define PKTSTS_SETUP_DATA 6U
+
+// Standard requests
+#define REQUEST_TYPE_MASK     0x60U
+#define REQUEST_TYPE_STANDARD 0x00U
+#define REQUEST_TYPE_CLASS    0x20U
+
+#define REQUEST_GET_STATUS        0x00U
+#define REQUEST_CLEAR_FEATURE     0x01U
+#define REQUEST_SET_FEATURE       0x03U
+#define REQUEST_SET_ADDRESS       0x05U
+#define REQUEST_GET_DESCRIPTOR    0x06U
+#define REQUEST_GET_CONFIGURATION 0x08U
+#define REQUEST_SET_CONFIGURATION 0x09U
+#define REQUEST_GET_INTERFACE     0x0AU
+#define REQUEST_SET_INTERFACE     0x0BU
+
+#define DESCRIPTOR_DEVICE        0x01U
+#define DESCRIPTOR_CONFIGURATION 0x02U
+#define DESCRIPTOR_STRING        0x03U
+
+// CDC class requests
+#define CDC_SET_LINE_CODING        0x20U
+#define CDC_GET_LINE_CODING        0x21U
+#define CDC_SET_CONTROL_LINE_STATE 0x22U
+#define CDC_SEND_BREAK             0x23U
+
+#define CDC_LINE_CODING_BYTES 7U
+
+#define STRING_LANGUAGE     0U
+#define STRING_MANUFACTURER 1U
+#define STRING_PRODUCT      2U
+#define STRING_SERIAL       3U
+
+#define USB_PRODUCT_NAME "Delta Robot"
+
+/* ----- Types -------------------------------------------------------------- */
+
+typedef struct
+{
+    uint8_t  request_type;
+    uint8_t  request;
+    uint16_t value;
+    uint16_t index;
+    uint16_t length;
+} UsbSetup_t;
+
+typedef struct
+{
+    // Device state, changed from the interrupt
+    volatile bool configured;
+    volatile bool suspended;
+
+    // Control endpoint
+    UsbSetup_t     setup;
+    const uint8_t *ep0_data;
+    uint16_t       ep0_remaining;
+    bool           ep0_zlp;           // data stage ends on a full packet shorter than the host asked for
+    uint8_t        ep0_out_request;    // class request waiting for its data stage
+    uint8_t        ep0_buffer[EP0_PACKET_BYTES];
+    uint8_t        line_coding[CDC_LINE_CODING_BYTES];
+
+    // User-space buffers are serviced outside IRQ
+    fifo_t         tx_fifo;
+    uint8_t        tx_buffer[USB_CDC_TX_BUFFER_BYTES];
+    uint16_t       tx_in_flight;    // bytes loaded into the endpoint, skipped once they're sent
+    bool           tx_busy;
+    bool           tx_zlp;          // last transfer ended on a full packet
+    HalUartStats_t stats;
+
+    fifo_t        rx_fifo;
+    uint8_t       rx_buffer[USB_CDC_RX_BUFFER_BYTES];
+    volatile bool rx_paused;    // OUT endpoint left NAKing until there's room for a packet
+} HalUsbCdc_t;
+
+/* ----- Variables ---------------------------------------------------------- */
+
+PRIVATE HalUsbCdc_t hal_usb;
+
+PRIVATE const uint8_t usb_device_descriptor[] = {
+    18,                   // bLength
+    DESCRIPTOR_DEVICE,    // bDescriptorType
+    0x00, 0x02,           // bcdUSB 2.00
+    0x02,                 // bDeviceClass CDC
+    0x00,                 // bDeviceSubClass
+    0x00,                 // bDeviceProtocol
+    EP0_PACKET_BYTES,     // bMaxPacketSize0
+    0x83, 0x04,           // idVendor, ST
+    0x40, 0x57,           // idProduct, virtual COM port
+    0x00, 0x02,           // bcdDevice
+    STRING_MANUFACTURER,
+    STRING_PRODUCT,
+    STRING_SERIAL,
+    1,    // bNumConfigurations
+};
+
+PRIVATE const uint8_t usb_configuration_descriptor[] = {
+    9, DESCRIPTOR_CONFIGURATION, 67, 0, 2, 1, 0, 0xC0, 50,    // 2 interfaces, self powered, 100mA
+
+    // Communication interface, ACM
+    9, 0x04, 0, 0, 1, 0x02, 0x02, 0x01, 0,
+    5, 0x24, 0x00, 0x10, 0x01,    // header, CDC 1.10
+    5, 0x24, 0x01, 0x00, 1,       // call management, data interface 1
+    4, 0x24, 0x02, 0x02,          // ACM, line coding and control line state supported
+    5, 0x24, 0x06, 0, 1,          // union, master 0 slave 1
+    7, 0x05, 0x80 | CDC_EP_NOTIFY, EP_TYPE_INTERRUPT, CDC_NOTIFY_PACKET_BYTES, 0, 16,
+
+    // Data interface
+    9, 0x04, 1, 0, 2, 0x0A, 0x00, 0x00, 0,
+    7, 0x05, CDC_EP_DATA, EP_TYPE_BULK, CDC_DATA_PACKET_BYTES, 0, 0,
+    7, 0x05, 0x80 | CDC_EP_DATA, EP_TYPE_BULK, CDC_DATA_PACKET_BYTES, 0, 0,
+};
+
+PRIVATE const uint8_t usb_default_line_coding[CDC_LINE_CODING_BYTES] = {
+    0x00, 0xC2, 0x01, 0x00,    // 115200 baud, meaningless on USB but hosts ask for it back
+    0,                         // 1 stop bit
+    0,                         // no parity
+    8,                         // data bits
+};
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+usb_core_reset( void );
+
+PRIVATE void
+usb_flush_fifos( void );
+
+PRIVATE void
+usb_bus_reset( void );
+
+PRIVATE void
+usb_read_packet( void );
+
+PRIVATE void
+usb_out_endpoint_irq( void );
+
+PRIVATE void
+usb_in_endpoint_irq( void );
+
+PRIVATE void
+usb_setup( void );
+
+PRIVATE bool
+usb_standard_request( void );
+
+PRIVATE bool
+usb_class_request( void );
+
+PRIVATE uint16_t
+usb_string_descriptor( uint8_t index );
+
+PRIVATE void
+usb_set_configuration( uint16_t value );
+
+PRIVATE void
+usb_ep0_send( const uint8_t *data, uint16_t length );
+
+PRIVATE void
+usb_ep0_transmit_next( void );
+
+PRIVATE void
+usb_ep0_out_arm( void );
+
+PRIVATE void
+usb_ep0_stall( void );
+
+PRIVATE void
+usb_rx_arm( void );
+
+PRIVATE void
+usb_start_tx( void );
+
+PRIVATE void
+usb_tx_queued( uint32_t length );
+
+PRIVATE void
+usb_fifo_write( uint8_t ep, const uint8_t *data, uint32_t length );
+
+PRIVATE void
+usb_fifo_read( uint8_t *data, uint32_t length );
+
+/* ----- USB CDC Interface -------------------------------------------------- */
+
+PUBLIC void
+hal_usb_cdc_init( void )
+{
+    HalUsbCdc_t *h = &hal_usb;
+    memset( h, 0, sizeof( HalUsbCdc_t ) );
+
+    fifo_init( &h->tx_fifo, h->tx_buffer, USB_CDC_TX_BUFFER_BYTES );
+    fifo_init( &h->rx_fifo, h->rx_buffer, USB_CDC_RX_BUFFER_BYTES );
+    memcpy( h->line_coding, usb_default_line_coding, CDC_LINE_CODING_BYTES );
+
+    LL_AHB2_GRP1_EnableClock( LL_AHB2_GRP1_PERIPH_OTGFS );
+
+    hal_gpio_init_alternate( _USB_DM, LL_GPIO_AF_10, LL_GPIO_SPEED_FREQ_VERY_HIGH, LL_GPIO_PULL_NO );
+    hal_gpio_init_alternate( _USB_DP, LL_GPIO_AF_10, LL_GPIO_SPEED_FREQ_VERY_HIGH, LL_GPIO_PULL_NO );
+
+    // Embedded full-speed PHY
+    USB_OTG_FS->GUSBCFG |= USB_OTG_GUSBCFG_PHYSEL;
+    usb_core_reset();
+
+    // The board is self powered and VBUS isn't routed for sensing
+    USB_OTG_FS->GCCFG = USB_OTG_GCCFG_PWRDWN | USB_OTG_GCCFG_NOVBUSSENS;
+
+    // Force device mode, turnaround time for an AHB clock above 32MHz
+    USB_OTG_FS->GUSBCFG = ( USB_OTG_FS->GUSBCFG & ~( USB_OTG_GUSBCFG_FHMOD | USB_OTG_GUSBCFG_FDMOD | USB_OTG_GUSBCFG_TRDT ) )
+                          | USB_OTG_GUSBCFG_FDMOD
+                          | ( 6U << USB_OTG_GUSBCFG_TRDT_Pos );
+    hal_delay_ms( 50 );    // mode change takes at least 25ms
+
+    USB_PCGCCTL = 0;
+    USB_DEVICE->DCTL |= USB_OTG_DCTL_SDIS;    // stay off the bus until setup is finished
+    USB_DEVICE->DCFG |= USB_OTG_DCFG_DSPD;    // full speed on the embedded PHY
+
+    // Split the FIFO RAM between RX and the IN endpoints
+    uint32_t fifo_start = FIFO_RX_WORDS;
+
+    USB_OTG_FS->GRXFSIZ            = FIFO_RX_WORDS;
+    USB_OTG_FS->DIEPTXF0_HNPTXFSIZ = ( FIFO_EP0_TX_WORDS << USB_OTG_TX0FD_Pos ) | fifo_start;
+    fifo_start += FIFO_EP0_TX_WORDS;
+    USB_OTG_FS->DIEPTXF[CDC_EP_DATA - 1] = ( FIFO_EP1_TX_WORDS << USB_OTG_DIEPTXF_INEPTXFD_Pos ) | fifo_start;
+    fifo_start += FIFO_EP1_TX_WORDS;
+    USB_OTG_FS->DIEPTXF[CDC_EP_NOTIFY - 1] = ( FIFO_EP2_TX_WORDS << USB_OTG_DIEPTXF_INEPTXFD_Pos ) | fifo_start;
+    usb_flush_fifos();
+
+    USB_DEVICE->DIEPMSK  = 0;
+    USB_DEVICE->DOEPMSK  = 0;
+    USB_DEVICE->DAINTMSK = 0;
+
+    USB_OTG_FS->GINTSTS = 0xFFFFFFFFU;
+    USB_OTG_FS->GINTMSK = USB_OTG_GINTMSK_USBRST
+                          | USB_OTG_GINTMSK_ENUMDNEM
+                          | USB_OTG_GINTMSK_RXFLVLM
+                          | USB_OTG_GINTMSK_IEPINT
+                          | USB_OTG_GINTMSK_OEPINT
+                          | USB_OTG_GINTMSK_USBSUSPM
+                          | USB_OTG_GINTMSK_WUIM;
+    USB_OTG_FS->GAHBCFG |= USB_OTG_GAHBCFG_GINT;
+
+    NVIC_SetPriority( OTG_FS_IRQn, NVIC_EncodePriority( NVIC_GetPriorityGrouping(), 5, 2 ) );
+    NVIC_EnableIRQ( OTG_FS_IRQn );
+
+    // Pull up D+, the host sees the device arrive
+    USB_DEVICE->DCTL &= ~USB_OTG_DCTL_SDIS;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+hal_usb_cdc_is_configured( void )
+{
+    return hal_usb.configured && !hal_usb.suspended;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint32_t
+hal_usb_cdc_write( const uint8_t *data, uint32_t length )
+{
+    HalUsbCdc_t *h    = &hal_usb;
+    uint32_t     sent = 0;
+
+    if( hal_usb_cdc_is_configured() && fifo_free( &h->tx_fifo ) >= length )
+    {
+        sent = fifo_write( &h->tx_fifo, data, length );
+        usb_tx_queued( sent );
+    }
+    else
+    {
+        h->stats.tx_dropped++;
+        h->stats.tx_dropped_bytes += length;
+        h->stats.tx_backpressure++;
+    }
+
+    return sent;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_usb_cdc_get_statistics( HalUartStats_t *stats, bool clear )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    h->stats.tx_capacity = (uint16_t)fifo_size( &h->tx_fifo );
+    memcpy( stats, &h->stats, sizeof( HalUartStats_t ) );
+
+    if( clear )
+    {
+        memset( &h->stats, 0, sizeof( HalUartStats_t ) );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint32_t
+hal_usb_cdc_rx_data_available( void )
+{
+    return fifo_used( &hal_usb.rx_fifo );
+}
+
+/* -------------------------------------------------------------------------- */
+
+/* The OUT endpoint interrupt only moves the fifo head, so the span from the
+ * tail stays valid until it is consumed.
+ */
+
+PUBLIC uint32_t
+hal_usb_cdc_rx_peek_linear( const uint8_t **data )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    uint32_t length = fifo_used_linear( &h->rx_fifo );
+    *data           = (const uint8_t *)fifo_get_tail_ptr( &h->rx_fifo, length );
+
+    return length;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+hal_usb_cdc_rx_consume( uint32_t length )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    fifo_skip( &h->rx_fifo, length );
+
+    if( h->rx_paused && fifo_free( &h->rx_fifo ) >= CDC_DATA_PACKET_BYTES )
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+
+        // A bus reset may have happened in between
+        if( h->rx_paused && h->configured )
+        {
+            h->rx_paused = false;
+            usb_rx_arm();
+        }
+
+        __set_PRIMASK( primask );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void OTG_FS_IRQHandler( void )
+{
+    uint32_t start = hal_profiler_start();
+
+    uint32_t status = USB_OTG_FS->GINTSTS & USB_OTG_FS->GINTMSK;
+
+    if( status & USB_OTG_GINTSTS_USBRST )
+    {
+        USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_USBRST;
+        usb_bus_reset();
+    }
+
+    if( status & USB_OTG_GINTSTS_ENUMDNE )
+    {
+        USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_ENUMDNE;
+
+        // Only full speed is possible, EP0 max packet 64 is the reset value
+        USB_INEP( CDC_EP_CONTROL )->DIEPCTL &= ~USB_OTG_DIEPCTL_MPSIZ;
+        USB_DEVICE->DCTL |= USB_OTG_DCTL_CGINAK;
+    }
+
+    // Not clearable, reads until the receive status queue is empty
+    while( USB_OTG_FS->GINTSTS & USB_OTG_GINTSTS_RXFLVL )
+    {
+        usb_read_packet();
+    }
+
+    if( status & USB_OTG_GINTSTS_OEPINT )
+    {
+        usb_out_endpoint_irq();
+    }
+
+    if( status & USB_OTG_GINTSTS_IEPINT )
+    {
+        usb_in_endpoint_irq();
+    }
+
+    if( status & USB_OTG_GINTSTS_USBSUSP )
+    {
+        USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_USBSUSP;
+        hal_usb.suspended   = true;
+    }
+
+    if( status & USB_OTG_GINTSTS_WKUINT )
+    {
+        USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_WKUINT;
+        hal_usb.suspended   = false;
+    }
+
+    hal_profiler_stop( HAL_PROFILER_IRQ_USB, start );
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+usb_core_reset( void )
+{
+    while( !( USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_AHBIDL ) ) {}
+
+    USB_OTG_FS->GRSTCTL |= USB_OTG_GRSTCTL_CSRST;
+
+    while( USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_CSRST ) {}
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_flush_fifos( void )
+{
+    USB_OTG_FS->GRSTCTL = USB_OTG_GRSTCTL_TXFFLSH | ( 0x10U << USB_OTG_GRSTCTL_TXFNUM_Pos );    // all tx fifos
+    while( USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH ) {}
+
+    USB_OTG_FS->GRSTCTL = USB_OTG_GRSTCTL_RXFFLSH;
+    while( USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_RXFFLSH ) {}
+}
+
+/* -------------------------------------------------------------------------- */
+
+// The host reset the bus, go back to the default state on address 0
+PRIVATE void
+usb_bus_reset( void )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    h->configured      = false;
+    h->suspended       = false;
+    h->rx_paused       = false;
+    h->tx_busy         = false;
+    h->tx_zlp          = false;
+    h->ep0_out_request = 0;
+
+    // Anything queued was meant for the previous session, a skip stops at the end of the ring
+    while( fifo_skip( &h->tx_fifo, fifo_used_linear( &h->tx_fifo ) ) )
+    {
+    }
+
+    for( uint8_t ep = 0; ep < USB_ENDPOINTS; ep++ )
+    {
+        USB_INEP( ep )->DIEPINT  = 0xFFFFFFFFU;
+        USB_OUTEP( ep )->DOEPINT = 0xFFFFFFFFU;
+
+        if( ep != CDC_EP_CONTROL )
+        {
+            USB_INEP( ep )->DIEPCTL  = USB_OTG_DIEPCTL_SNAK;
+            USB_OUTEP( ep )->DOEPCTL = USB_OTG_DOEPCTL_SNAK;
+        }
+    }
+
+    usb_flush_fifos();
+
+    USB_DEVICE->DCFG &= ~USB_OTG_DCFG_DAD;
+    USB_DEVICE->DAINTMSK = ( 1U << CDC_EP_CONTROL ) | ( 1U << ( 16U + CDC_EP_CONTROL ) );
+    USB_DEVICE->DOEPMSK  = USB_OTG_DOEPINT_STUP | USB_OTG_DOEPINT_XFRC;
+    USB_DEVICE->DIEPMSK  = USB_OTG_DIEPINT_XFRC;
+
+    usb_ep0_out_arm();
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Pop one entry from the receive status queue and read its data out of the shared RX FIFO
+PRIVATE void
+usb_read_packet( void )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    uint32_t status = USB_OTG_FS->GRXSTSP;
+    uint8_t  ep     = (uint8_t)( status & USB_OTG_GRXSTSP_EPNUM );
+    uint16_t count  = (uint16_t)( ( status & USB_OTG_GRXSTSP_BCNT ) >> USB_OTG_GRXSTSP_BCNT_Pos );
+    uint8_t  type   = (uint8_t)( ( status & USB_OTG_GRXSTSP_PKTSTS ) >> USB_OTG_GRXSTSP_PKTSTS_Pos );
+
+    if( type == PKTSTS_SETUP_DATA )
+    {
+        uint8_t raw[8];
+        usb_fifo_read( raw, sizeof( raw ) );
+
+        h->setup.request_type = raw[0];
+        h->setup.request      = raw[1];
+        h->setup.value        = (uint16_t)( raw[2] | ( raw[3] << 8 ) );
+        h->setup.index        = (uint16_t)( raw[4] | ( raw[5] << 8 ) );
+        h->setup.length       = (uint16_t)( raw[6] | ( raw[7] << 8 ) );
+    }
+    else if( type == PKTSTS_OUT_DATA && count )
+    {
+        if( ep == CDC_EP_DATA )
+        {
+            // The endpoint is only armed with room for a full packet
+            uint8_t *slot = fifo_reserve_linear( &h->rx_fifo, count );
+
+            if( slot )
+            {
+                usb_fifo_read( slot, count );
+                fifo_commit( &h->rx_fifo, count );
+            }
+            else
+            {
+                uint8_t packet[CDC_DATA_PACKET_BYTES];
+                usb_fifo_read( packet, MIN( count, sizeof( packet ) ) );
+                fifo_write( &h->rx_fifo, packet, MIN( count, sizeof( packet ) ) );
+            }
+        }
+        else
+        {
+            usb_fifo_read( h->ep0_buffer, MIN( count, sizeof( h->ep0_buffer ) ) );
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_out_endpoint_irq( void )
+{
+    HalUsbCdc_t *h      = &hal_usb;
+    uint32_t     active = ( USB_DEVICE->DAINT & USB_DEVICE->DAINTMSK ) >> 16;
+
+    for( uint8_t ep = 0; ep < USB_ENDPOINTS; ep++ )
+    {
+        if( !( active & ( 1U << ep ) ) )
+        {
+            continue;
+        }
+
+        uint32_t flags           = USB_OUTEP( ep )->DOEPINT & USB_DEVICE->DOEPMSK;
+        USB_OUTEP( ep )->DOEPINT = flags;
+
+        if( ep == CDC_EP_CONTROL )
+        {
+            if( flags & USB_OTG_DOEPINT_XFRC )
+            {
+                // Data stage of a class request finished, ack it with the status stage
+                if( h->ep0_out_request == CDC_SET_LINE_CODING )
+                {
+                    memcpy( h->line_coding, h->ep0_buffer, CDC_LINE_CODING_BYTES );
+                    usb_ep0_send( NULL, 0 );
+                }
+
+                h->ep0_out_request = 0;
+                usb_ep0_out_arm();
+            }
+
+            if( flags & USB_OTG_DOEPINT_STUP )
+            {
+                usb_setup();
+                usb_ep0_out_arm();
+            }
+        }
+        else if( ep == CDC_EP_DATA && ( flags & USB_OTG_DOEPINT_XFRC ) )
+        {
+            // Leave the endpoint NAKing when the next packet might not fit,
+            // the host retries until hal_usb_cdc_rx_consume makes room
+            if( fifo_free( &h->rx_fifo ) >= CDC_DATA_PACKET_BYTES )
+            {
+                usb_rx_arm();
+            }
+            else
+            {
+                h->rx_paused = true;
+            }
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_in_endpoint_irq( void )
+{
+    HalUsbCdc_t *h      = &hal_usb;
+    uint32_t     active = USB_DEVICE->DAINT & USB_DEVICE->DAINTMSK & 0xFFFFU;
+
+    for( uint8_t ep = 0; ep < USB_ENDPOINTS; ep++ )
+    {
+        if( !( active & ( 1U << ep ) ) )
+        {
+            continue;
+        }
+
+        uint32_t flags          = USB_INEP( ep )->DIEPINT & USB_DEVICE->DIEPMSK;
+        USB_INEP( ep )->DIEPINT = flags;
+
+        if( !( flags & USB_OTG_DIEPINT_XFRC ) )
+        {
+            continue;
+        }
+
+        if( ep == CDC_EP_CONTROL )
+        {
+            if( h->ep0_remaining || h->ep0_zlp )
+            {
+                h->ep0_zlp = false;
+                usb_ep0_transmit_next();
+            }
+        }
+        else if( ep == CDC_EP_DATA )
+        {
+            fifo_skip( &h->tx_fifo, h->tx_in_flight );
+            h->tx_in_flight = 0;
+            h->tx_busy      = false;
+            usb_start_tx();
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_setup( void )
+{
+    HalUsbCdc_t *h       = &hal_usb;
+    bool         handled = false;
+
+    h->ep0_remaining   = 0;
+    h->ep0_zlp         = false;
+    h->ep0_out_request = 0;
+
+    switch( h->setup.request_type & REQUEST_TYPE_MASK )
+    {
+        case REQUEST_TYPE_STANDARD:
+            handled = usb_standard_request();
+            break;
+
+        case REQUEST_TYPE_CLASS:
+            handled = usb_class_request();
+            break;
+
+        default:
+            break;
+    }
+
+    if( !handled )
+    {
+        usb_ep0_stall();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+usb_standard_request( void )
+{
+    HalUsbCdc_t *h     = &hal_usb;
+    uint16_t     value = h->setup.value;
+
+    switch( h->setup.request )
+    {
+        case REQUEST_GET_DESCRIPTOR:
+            switch( value >> 8 )
+            {
+                case DESCRIPTOR_DEVICE:
+                    usb_ep0_send( usb_device_descriptor, sizeof( usb_device_descriptor ) );
+                    return true;
+
+                case DESCRIPTOR_CONFIGURATION:
+                    usb_ep0_send( usb_configuration_descriptor, sizeof( usb_configuration_descriptor ) );
+                    return true;
+
+                case DESCRIPTOR_STRING: {
+                    uint16_t length = usb_string_descriptor( (uint8_t)value );
+
+                    if( length )
+                    {
+                        usb_ep0_send( h->ep0_buffer, length );
+                        return true;
+                    }
+                    return false;
+                }
+
+                default:
+                    return false;    // device qualifier and friends, full speed only
+            }
+
+        case REQUEST_SET_ADDRESS:
+            // Takes effect straight away, the core answers the status stage on the old address
+            USB_DEVICE->DCFG = ( USB_DEVICE->DCFG & ~USB_OTG_DCFG_DAD ) | ( ( value & 0x7FU ) << USB_OTG_DCFG_DAD_Pos );
+            usb_ep0_send( NULL, 0 );
+            return true;
+
+        case REQUEST_SET_CONFIGURATION:
+            if( value > 1 )
+            {
+                return false;
+            }
+            usb_set_configuration( value );
+            usb_ep0_send( NULL, 0 );
+            return true;
+
+        case REQUEST_GET_CONFIGURATION:
+            h->ep0_buffer[0] = h->configured ? 1 : 0;
+            usb_ep0_send( h->ep0_buffer, 1 );
+            return true;
+
+        case REQUEST_GET_STATUS:
+            h->ep0_buffer[0] = 0;
+            h->ep0_buffer[1] = 0;
+            usb_ep0_send( h->ep0_buffer, 2 );
+            return true;
+
+        case REQUEST_GET_INTERFACE:
+            h->ep0_buffer[0] = 0;
+            usb_ep0_send( h->ep0_buffer, 1 );
+            return true;
+
+        case REQUEST_CLEAR_FEATURE:
+        case REQUEST_SET_FEATURE:
+        case REQUEST_SET_INTERFACE:
+            usb_ep0_send( NULL, 0 );
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+usb_class_request( void )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    switch( h->setup.request )
+    {
+        case CDC_SET_LINE_CODING:
+            // The status stage is sent once the data stage arrives
+            h->ep0_out_request = CDC_SET_LINE_CODING;
+            return true;
+
+        case CDC_GET_LINE_CODING:
+            usb_ep0_send( h->line_coding, CDC_LINE_CODING_BYTES );
+            return true;
+
+        case CDC_SET_CONTROL_LINE_STATE:
+        case CDC_SEND_BREAK:
+            usb_ep0_send( NULL, 0 );
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Build a UTF-16LE string descriptor in the EP0 buffer, returns the length or 0 when there's no such string
+PRIVATE uint16_t
+usb_string_descriptor( uint8_t index )
+{
+    HalUsbCdc_t *h          = &hal_usb;
+    uint8_t *    descriptor = h->ep0_buffer;
+    char         serial[25];
+    const char * text;
+
+    switch( index )
+    {
+        case STRING_LANGUAGE:
+            descriptor[0] = 4;
+            descriptor[1] = DESCRIPTOR_STRING;
+            descriptor[2] = 0x09;    // English (US)
+            descriptor[3] = 0x04;
+            return 4;
+
+        case STRING_MANUFACTURER:
+            text = MANUFACTURER_NAME;
+            break;
+
+        case STRING_PRODUCT:
+            text = USB_PRODUCT_NAME;
+            break;
+
+        case STRING_SERIAL:
+            // Same 96-bit UUID the eUI identifier uses, as hex
+            for( uint8_t i = 0; i < 24; i++ )
+            {
+                uint8_t nibble = (uint8_t)( ( HAL_UUID[i / 8] >> ( 28 - 4 * ( i % 8 ) ) ) & 0x0F );
+                serial[i]      = (char)( nibble < 10 ? '0' + nibble : 'A' + nibble - 10 );
+            }
+            serial[24] = '\0';
+            text       = serial;
+            break;
+
+        default:
+            return 0;
+    }
+
+    uint16_t chars = (uint16_t)MIN( strlen( text ), ( sizeof( h->ep0_buffer ) - 2 ) / 2 );
+
+    descriptor[0] = (uint8_t)( 2 + chars * 2 );
+    descriptor[1] = DESCRIPTOR_STRING;
+
+    for( uint16_t i = 0; i < chars; i++ )
+    {
+        descriptor[2 + i * 2]     = (uint8_t)text[i];
+        descriptor[2 + i * 2 + 1] = 0;
+    }
+
+    return descriptor[0];
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_set_configuration( uint16_t value )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    if( value == 0 )
+    {
+        h->configured = false;
+        USB_INEP( CDC_EP_DATA )->DIEPCTL &= ~USB_OTG_DIEPCTL_USBAEP;
+        USB_OUTEP( CDC_EP_DATA )->DOEPCTL &= ~USB_OTG_DOEPCTL_USBAEP;
+        USB_INEP( CDC_EP_NOTIFY )->DIEPCTL &= ~USB_OTG_DIEPCTL_USBAEP;
+        return;
+    }
+
+    // Each IN endpoint sends from the tx fifo with its own number
+    USB_INEP( CDC_EP_DATA )->DIEPCTL = CDC_DATA_PACKET_BYTES
+                                       | ( EP_TYPE_BULK << USB_OTG_DIEPCTL_EPTYP_Pos )
+                                       | ( CDC_EP_DATA << USB_OTG_DIEPCTL_TXFNUM_Pos )
+                                       | USB_OTG_DIEPCTL_SD0PID_SEVNFRM
+                                       | USB_OTG_DIEPCTL_USBAEP;
+
+    USB_OUTEP( CDC_EP_DATA )->DOEPCTL = CDC_DATA_PACKET_BYTES
+                                        | ( EP_TYPE_BULK << USB_OTG_DOEPCTL_EPTYP_Pos )
+                                        | USB_OTG_DOEPCTL_SD0PID_SEVNFRM
+                                        | USB_OTG_DOEPCTL_USBAEP;
+
+    USB_INEP( CDC_EP_NOTIFY )->DIEPCTL = CDC_NOTIFY_PACKET_BYTES
+                                         | ( EP_TYPE_INTERRUPT << USB_OTG_DIEPCTL_EPTYP_Pos )
+                                         | ( CDC_EP_NOTIFY << USB_OTG_DIEPCTL_TXFNUM_Pos )
+                                         | USB_OTG_DIEPCTL_SD0PID_SEVNFRM
+                                         | USB_OTG_DIEPCTL_USBAEP;
+
+    USB_DEVICE->DAINTMSK |= ( 1U << CDC_EP_DATA ) | ( 1U << ( 16U + CDC_EP_DATA ) );
+
+    h->configured = true;
+    h->rx_paused  = false;
+    usb_rx_arm();
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Start the data stage of a control IN request, trimmed to what the host asked for
+PRIVATE void
+usb_ep0_send( const uint8_t *data, uint16_t length )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    length = MIN( length, h->setup.length );
+
+    h->ep0_data      = data;
+    h->ep0_remaining = length;
+
+    // A short transfer ending on a packet boundary needs a zero length packet to finish it
+    h->ep0_zlp = ( length && length < h->setup.length && ( length % EP0_PACKET_BYTES ) == 0 );
+
+    usb_ep0_transmit_next();
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_ep0_transmit_next( void )
+{
+    HalUsbCdc_t *h     = &hal_usb;
+    uint16_t     chunk = MIN( h->ep0_remaining, EP0_PACKET_BYTES );
+
+    USB_INEP( CDC_EP_CONTROL )->DIEPTSIZ = ( 1U << USB_OTG_DIEPTSIZ_PKTCNT_Pos ) | chunk;
+    USB_INEP( CDC_EP_CONTROL )->DIEPCTL |= USB_OTG_DIEPCTL_EPENA | USB_OTG_DIEPCTL_CNAK;
+
+    if( chunk )
+    {
+        usb_fifo_write( CDC_EP_CONTROL, h->ep0_data, chunk );
+        h->ep0_data += chunk;
+        h->ep0_remaining -= chunk;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Ready EP0 for a data or status stage, back-to-back SETUPs are taken regardless
+PRIVATE void
+usb_ep0_out_arm( void )
+{
+    USB_OUTEP( CDC_EP_CONTROL )->DOEPTSIZ = ( 3U << USB_OTG_DOEPTSIZ_STUPCNT_Pos )
+                                            | ( 1U << USB_OTG_DOEPTSIZ_PKTCNT_Pos )
+                                            | EP0_PACKET_BYTES;
+    USB_OUTEP( CDC_EP_CONTROL )->DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Refuse the request, the core clears the stall when the next SETUP arrives
+PRIVATE void
+usb_ep0_stall( void )
+{
+    USB_INEP( CDC_EP_CONTROL )->DIEPCTL |= USB_OTG_DIEPCTL_STALL;
+    USB_OUTEP( CDC_EP_CONTROL )->DOEPCTL |= USB_OTG_DOEPCTL_STALL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_rx_arm( void )
+{
+    USB_OUTEP( CDC_EP_DATA )->DOEPTSIZ = ( 1U << USB_OTG_DOEPTSIZ_PKTCNT_Pos ) | CDC_DATA_PACKET_BYTES;
+    USB_OUTEP( CDC_EP_DATA )->DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_start_tx( void )
+{
+    HalUsbCdc_t *h = &hal_usb;
+    uint32_t     primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if( h->configured && !h->tx_busy )
+    {
+        // Send up to the end of the ring, the completion interrupt chains the rest
+        uint32_t length = MIN( fifo_used_linear( &h->tx_fifo ), CDC_TX_TRANSFER_BYTES );
+
+        if( length || h->tx_zlp )
+        {
+            uint32_t packets = length ? ( length + CDC_DATA_PACKET_BYTES - 1 ) / CDC_DATA_PACKET_BYTES : 1;
+
+            USB_INEP( CDC_EP_DATA )->DIEPTSIZ = ( packets << USB_OTG_DIEPTSIZ_PKTCNT_Pos ) | length;
+            USB_INEP( CDC_EP_DATA )->DIEPCTL |= USB_OTG_DIEPCTL_EPENA | USB_OTG_DIEPCTL_CNAK;
+
+            if( length )
+            {
+                usb_fifo_write( CDC_EP_DATA, (const uint8_t *)fifo_get_tail_ptr( &h->tx_fifo, length ), length );
+            }
+
+            // The host only sees the end of a transfer on a short packet, so
+            // follow a full final packet with a zero length one if nothing else comes
+            h->tx_zlp       = length && ( length % CDC_DATA_PACKET_BYTES ) == 0;
+            h->tx_in_flight = (uint16_t)length;
+            h->tx_busy      = true;
+        }
+    }
+
+    __set_PRIMASK( primask );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_tx_queued( uint32_t length )
+{
+    HalUsbCdc_t *h = &hal_usb;
+
+    h->stats.tx_bytes += length;
+
+    uint32_t used = fifo_used( &h->tx_fifo );
+
+    if( used > h->stats.tx_peak_used )
+    {
+        h->stats.tx_peak_used = (uint16_t)used;
+    }
+
+    usb_start_tx();
+}
+
+/* -------------------------------------------------------------------------- */
+
+// The endpoint FIFOs are word wide, pad the last partial word
+PRIVATE void
+usb_fifo_write( uint8_t ep, const uint8_t *data, uint32_t length )
+{
+    uint32_t word;
+
+    for( ; length >= 4; length -= 4, data += 4 )
+    {
+        memcpy( &word, data, 4 );
+        USB_FIFO( ep ) = word;
+    }
+
+    if( length )
+    {
+        word = 0;
+        memcpy( &word, data, length );
+        USB_FIFO( ep ) = word;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+usb_fifo_read( uint8_t *data, uint32_t length )
+{
+    uint32_t word;
+
+    for( ; length >= 4; length -= 4, data += 4 )
+    {
+        word = USB_FIFO( 0 );
+        memcpy( data, &word, 4 );
+    }
+
+    if( length )
+    {
+        word = USB_FIFO( 0 );
+        memcpy( data, &word, length );
+    }
+}
+
+/* ----- End ---------------------------------------------------------------- */
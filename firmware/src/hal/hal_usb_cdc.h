@@ -0,0 +1,89 @@
+#ifndef HAL_USB_CDC_H
+#define HAL_USB_CDC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+#include "hal_uart.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- USB CDC-ACM INTERFACE                                              --- */
+/* -------------------------------------------------------------------------- */
+
+/** Initialise the USB FS core as a CDC-ACM (virtual serial port) device and
+ *  connect to the host. Received and transmitted bytes go through FIFOs with
+ *  the same semantics as the UARTs.
+ */
+
+PUBLIC void
+hal_usb_cdc_init( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** True once the host has configured the device, data can flow */
+
+PUBLIC bool
+hal_usb_cdc_is_configured( void );
+
+/* -------------------------------------------------------------------------- */
+
+/* Non-blocking send for a number of characters to the USB tx FIFO queue.
+ * The write is all or nothing, so a frame is never sent in part, and is
+ * refused while the host hasn't configured the device.
+ * Returns the number of characters queued, 0 when the queue was too full.
+ * Like the UART, an eUI frame is copied in once from eUI's encode buffer.
+ */
+
+PUBLIC uint32_t
+hal_usb_cdc_write( const uint8_t *data, uint32_t length );
+
+/* -------------------------------------------------------------------------- */
+
+/* Copy out the transmit counters, optionally clearing them */
+
+PUBLIC void
+hal_usb_cdc_get_statistics( HalUartStats_t *stats, bool clear );
+
+/* -------------------------------------------------------------------------- */
+
+/* Returns number of available characters in the RX FIFO queue. */
+
+PUBLIC uint32_t
+hal_usb_cdc_rx_data_available( void );
+
+/* -------------------------------------------------------------------------- */
+
+/* Access the oldest received bytes in place, without copying them out.
+ * Returns the number of bytes that are contiguous in the rx FIFO from *data,
+ * release them with hal_usb_cdc_rx_consume once they have been handled.
+ */
+
+PUBLIC uint32_t
+hal_usb_cdc_rx_peek_linear( const uint8_t **data );
+
+/* -------------------------------------------------------------------------- */
+
+/* Release bytes returned by hal_usb_cdc_rx_peek_linear. Reception resumes
+ * once there is room for a full packet again.
+ */
+
+PUBLIC void
+hal_usb_cdc_rx_consume( uint32_t length );
+
+/* -------------------------------------------------------------------------- */
+
+void OTG_FS_IRQHandler( void );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USB_CDC_H */
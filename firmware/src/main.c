@@ -117,6 +117,7 @@ void system_clock_config( void )
     }
 
     LL_RCC_PLL_ConfigDomain_SYS( LL_RCC_PLLSOURCE_HSE, LL_RCC_PLLM_DIV_4, 168, LL_RCC_PLLP_DIV_2 );
+    LL_RCC_PLL_ConfigDomain_48M( LL_RCC_PLLSOURCE_HSE, LL_RCC_PLLM_DIV_4, 168, LL_RCC_PLLQ_DIV_7 );    // 48MHz for USB
     LL_RCC_PLL_Enable();
 
     while( LL_RCC_PLL_IsReady() != 1 )
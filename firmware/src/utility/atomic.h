@@ -0,0 +1,230 @@
+/**
+ * @file    atomic.h
+ *
+ * @brief   Lock-free primitives for sharing data between interrupts and the
+ *          main loop without masking interrupts.
+ *
+ * On the Cortex-M4 these map onto the LDREX/STREX exclusive access pair. The
+ * local exclusive monitor is cleared on every exception entry and return, so
+ * a store-conditional fails whenever an interrupt ran between it and the
+ * matching load-link. That makes a load-link/store-conditional retry loop
+ * safe against the ABA problem without tagging the pointers.
+ *
+ * Host builds fall back to the GCC __atomic builtins, with the store-
+ * conditional emulated as a compare and swap against the value seen by the
+ * load-link. That is good enough to exercise the queues from threads, but
+ * loses the ABA protection the exclusive monitor gives on the target.
+ *
+ * Only one load-link may be outstanding at a time, and the code between it
+ * and the store-conditional should be a handful of instructions.
+ *
+ * @author  Marco Hess <marcoh@applidyne.com.au>
+ *
+ * @copyright (c) 2013-2018 Applidyne Australia Pty. Ltd. - All rights reserved.
+ */
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+#ifdef STM32F429xx
+#include "stm32f4xx.h"
+#endif
+
+/* ----------------------- Inline Functions --------------------------------- */
+
+#ifdef STM32F429xx
+
+//! Load a word and open an exclusive access on it
+static inline uint32_t
+atomicLoadLink( volatile uint32_t *address )
+{
+    return __LDREXW( address );
+}
+
+//! Store the word when nothing touched it since the load-link.
+/// Returns false when the store has to be retried.
+static inline bool
+atomicStoreConditional( volatile uint32_t *address, uint32_t value )
+{
+    return __STREXW( value, address ) == 0;
+}
+
+//! Pointer flavour of the load-link, for lock-free lists
+static inline void *
+atomicLoadLinkPointer( void * volatile *address )
+{
+    return (void *)__LDREXW( (volatile uint32_t *)address );
+}
+
+//! Pointer flavour of the store-conditional
+static inline bool
+atomicStoreConditionalPointer( void * volatile *address, void *value )
+{
+    return __STREXW( (uint32_t)value, (volatile uint32_t *)address ) == 0;
+}
+
+//! Abandon a load-link without storing
+static inline void
+atomicClearLink( void )
+{
+    __CLREX();
+}
+
+//! Make all earlier memory writes visible before any later ones
+static inline void
+atomicBarrier( void )
+{
+    __DMB();
+}
+
+//! True when called from an exception or interrupt handler
+static inline bool
+atomicInInterrupt( void )
+{
+    return __get_IPSR() != 0;
+}
+
+#else
+
+// Values the last load-link saw, the store-conditional only succeeds while
+// the word still holds it
+static __thread uint32_t atomicLinked;
+static __thread void     *atomicLinkedPointer;
+
+static inline uint32_t
+atomicLoadLink( volatile uint32_t *address )
+{
+    atomicLinked = __atomic_load_n( address, __ATOMIC_ACQUIRE );
+    return atomicLinked;
+}
+
+static inline bool
+atomicStoreConditional( volatile uint32_t *address, uint32_t value )
+{
+    uint32_t expected = atomicLinked;
+    return __atomic_compare_exchange_n( address, &expected, value, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+}
+
+static inline void *
+atomicLoadLinkPointer( void * volatile *address )
+{
+    atomicLinkedPointer = __atomic_load_n( address, __ATOMIC_ACQUIRE );
+    return atomicLinkedPointer;
+}
+
+static inline bool
+atomicStoreConditionalPointer( void * volatile *address, void *value )
+{
+    void *expected = atomicLinkedPointer;
+    return __atomic_compare_exchange_n( address, &expected, value, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+}
+
+static inline void
+atomicClearLink( void )
+{
+}
+
+static inline void
+atomicBarrier( void )
+{
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+static inline bool
+atomicInInterrupt( void )
+{
+    return false;
+}
+
+#endif
+
+/* -------------------------------------------------------------------------- */
+
+//! Add to a counter shared with interrupts, returns the new value
+static inline uint32_t
+atomicAdd( volatile uint32_t *counter, int32_t delta )
+{
+    uint32_t value;
+
+    do
+    {
+        value = atomicLoadLink( counter ) + (uint32_t)delta;
+    } while( !atomicStoreConditional( counter, value ) );
+
+    return value;
+}
+
+//! Lower a shared low-water mark to value when it is below it
+static inline void
+atomicMinimum( volatile uint32_t *mark, uint32_t value )
+{
+    do
+    {
+        if( atomicLoadLink( mark ) <= value )
+        {
+            atomicClearLink();
+            return;
+        }
+    } while( !atomicStoreConditional( mark, value ) );
+}
+
+//! Raise a shared high-water mark to value when it is above it
+static inline void
+atomicMaximum( volatile uint32_t *mark, uint32_t value )
+{
+    do
+    {
+        if( atomicLoadLink( mark ) >= value )
+        {
+            atomicClearLink();
+            return;
+        }
+    } while( !atomicStoreConditional( mark, value ) );
+}
+
+//! Set bits in a flag word shared with interrupts
+static inline void
+atomicSetBits( volatile uint32_t *flags, uint32_t mask )
+{
+    uint32_t value;
+
+    do
+    {
+        value = atomicLoadLink( flags ) | mask;
+    } while( !atomicStoreConditional( flags, value ) );
+}
+
+//! Clear bits in a flag word shared with interrupts
+static inline void
+atomicClearBits( volatile uint32_t *flags, uint32_t mask )
+{
+    uint32_t value;
+
+    do
+    {
+        value = atomicLoadLink( flags ) & ~mask;
+    } while( !atomicStoreConditional( flags, value ) );
+}
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ATOMIC_H */
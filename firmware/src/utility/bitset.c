@@ -16,56 +16,19 @@
 
 #include "bitset.h"
 
-/* ----------------------- Private Data ------------------------------------- */
-
-/** Log 2 lookup table to determine the highest set bit from a byte value. */
-PRIVATE const uint8_t bitsetLookup[] =
-{
-    0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
-    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8
-};
-
 /* ----- Public Functions --------------------------------------------------- */
 
+//! The Cortex-M4 counts leading zeros in a single CLZ instruction, which
+/// GCC emits for __builtin_clz, so finding the highest bit takes constant
+/// time whatever the pattern.
 PUBLIC uint8_t
 bitsetHighest( const BitSet_t * bitPattern )
 {
-    register uint8_t bitNumber = 0;
-
     if( *bitPattern )
     {
-        if( *bitPattern & 0xFF000000 )
-        {
-            bitNumber = (uint8_t)(bitsetLookup[*bitPattern >> 24] + 24U);
-        }
-        else if( *bitPattern & 0xFF0000 )
-        {
-            bitNumber = (uint8_t)(bitsetLookup[*bitPattern >> 16] + 16U);
-        }
-        else if( *bitPattern & 0xFF00 )
-        {
-            bitNumber = (uint8_t)(bitsetLookup[*bitPattern >> 8] + 8U);
-        }
-        else
-        {
-            bitNumber = (uint8_t)bitsetLookup[*bitPattern & 0xFF];
-        }
+        return (uint8_t)( 32U - (uint8_t)__builtin_clz( *bitPattern ) );
     }
-    return bitNumber;
+    return 0;
 }
 
 /* ----- End ---------------------------------------------------------------- */
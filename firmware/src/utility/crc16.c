@@ -0,0 +1,40 @@
+/**
+ * @file    crc16.c
+ *
+ * @brief   CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, no reflection) for
+ *          checking blocks of data received over the UI link.
+ *
+ *          Nibble-wise table, 32 bytes of flash and two lookups per byte.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "crc16.h"
+
+/* ----------------------- Private Data ------------------------------------- */
+
+/** CRC of each 4-bit value shifted through the top of the register */
+PRIVATE const uint16_t crc16Nibble[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC uint16_t
+crc16Update( uint16_t crc, const uint8_t *data, size_t length )
+{
+    while( length-- )
+    {
+        crc = (uint16_t)( ( crc << 4 ) ^ crc16Nibble[( ( crc >> 12 ) ^ ( *data >> 4 ) ) & 0x0F] );
+        crc = (uint16_t)( ( crc << 4 ) ^ crc16Nibble[( ( crc >> 12 ) ^ ( *data & 0x0F ) ) & 0x0F] );
+        data++;
+    }
+
+    return crc;
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,41 @@
+/**
+ * @file    crc16.h
+ *
+ * @brief   CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, no reflection) for
+ *          checking blocks of data received over the UI link.
+ */
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define CRC16_INIT 0xFFFFU
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/** Continue a CRC over another block of data, start with CRC16_INIT */
+
+PUBLIC uint16_t
+crc16Update( uint16_t crc, const uint8_t *data, size_t length );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC16_H */
@@ -15,6 +15,7 @@
 /* ----- Local Includes ----------------------------------------------------- */
 
 #include "event_pool.h"
+#include "atomic.h"
 #include "qassert.h"
 #include "state_task.h"
 
@@ -22,6 +23,16 @@
 
 DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
 
+/* -------------------------------------------------------------------------- */
+
+//! The reference count shares its word with the pool id, so it is updated
+/// by exchanging the whole word.
+typedef union
+{
+    Dynamic  dynamic;
+    uint32_t word;
+} DynamicWord;
+
 /* ----------------------- Private Functions Declarations ------------------- */
 
 PRIVATE EventPool *
@@ -80,6 +91,7 @@ eventPoolInit( EventPool eventPools[],
 
     REQUIRE( eventPools );
     REQUIRE( numberOfPools > 0 );
+    REQUIRE( sizeof( Dynamic ) == sizeof( uint32_t ) );
 
     // Init the EventPool structures for the whole array
     for( i = 0; i < numberOfPools; i++ )
@@ -127,6 +139,30 @@ eventPoolAddStorage( StateEvent     *poolStorage,
 
 /* -------------------------------------------------------------------------- */
 
+PUBLIC bool
+eventPoolGetStatistics( uint8_t poolId, EventPoolStatistics *stats )
+{
+    REQUIRE( stats );
+
+    if( poolId == 0 || poolId > eventPoolMax || eventPool[poolId-1].eventSize == 0 )
+    {
+        return false;
+    }
+
+    EventPool *p = &eventPool[poolId-1];
+
+    stats->eventSize     = p->eventSize;
+    stats->totalEvents   = p->totalEvents;
+    stats->freeEvents    = (uint16_t)p->freeEvents;
+    stats->minimumEvents = (uint16_t)p->minimumEvents;
+    stats->largestEvent  = (uint16_t)p->largestEvent;
+    stats->failedEvents  = p->failedEvents;
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
 //! Allocate a new event memory block from a set of pools
 /// Could be returning NULL if no event was available from the pools
 PUBLIC StateEvent *
@@ -154,8 +190,12 @@ eventPoolNewEvent( uint16_t eventSize, Signal signal )
                 e->signal           = signal; // set signal for this event
                 e->dynamic.poolId   = i + 1;  // to know where to recycle this event
                 e->dynamic.useCount = 0;      // this event is new, not used yet
+
+                atomicMaximum( &p->largestEvent, eventSize );
                 return e;
             }
+
+            atomicAdd( &p->failedEvents, 1 );
         }
     }
 
@@ -196,6 +236,29 @@ eventPoolDeleteEvent( StateEvent *e )
 
 /* -------------------------------------------------------------------------- */
 
+PUBLIC uint8_t
+eventPoolReference( StateEvent *e, int8_t delta )
+{
+    volatile uint32_t *word = (volatile uint32_t *)&e->dynamic;
+    DynamicWord       update;
+
+    if( e->dynamic.poolId == 0 )
+    {
+        return 0;
+    }
+
+    // Tasks at different priorities may hold the same published event
+    do
+    {
+        update.word = atomicLoadLink( word );
+        update.dynamic.useCount += delta;
+    } while( !atomicStoreConditional( word, update.word ) );
+
+    return update.dynamic.useCount;
+}
+
+/* -------------------------------------------------------------------------- */
+
 /** After a state machine has executed an event, this function decrements
  *  the usage counter on the event and deletes it when usage becomes 0.
  */
@@ -207,11 +270,9 @@ eventPoolGarbageCollect( StateEvent *e )
         // It must have been in use
         REQUIRE(e->dynamic.useCount > 0);
 
-        // One less reference for this event
-        e->dynamic.useCount--;
-
-        // If no more references, deallocate the event
-        if(e->dynamic.useCount == 0)
+        // One less reference for this event, and if no more
+        // references, deallocate the event
+        if( eventPoolReference( e, -1 ) == 0 )
         {
             eventPoolDeleteEvent( e );
         }
@@ -237,7 +298,8 @@ eventPoolCreate( EventPool  *pool,
     pool->totalEvents      = numberOfEvents; // store total number of events
     pool->freeEvents       = numberOfEvents; // store number of free events
     pool->minimumEvents    = numberOfEvents; // the minimum number of free events
-    pool->minimumEventSize = 0;              // the actual used maximum size for events in this pool
+    pool->largestEvent     = 0;              // the actual used maximum size for events in this pool
+    pool->failedEvents     = 0;              // no allocation has failed yet
 
     block = (char *)poolStorage;
     while (--numberOfEvents != 0)          // chain all blocks in the free-list...
@@ -252,54 +314,50 @@ eventPoolCreate( EventPool  *pool,
 
 /* -------------------------------------------------------------------------- */
 
+//! Pop the head of the free list. An interrupt that takes or returns an
+/// event between the load-link and the store-conditional makes the store
+/// fail, so the link read from the old head is never written back stale.
 PRIVATE StateEvent *
 eventPoolGet( EventPool *pool )
 {
     register StateEvent *e;
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
-
-    if( pool->freeEvents > 0 )             // free block available?
+    do
     {
-        e = (StateEvent*)pool->free__;          // get free block
-        pool->free__ = *(void **)e;        // adjust ptr to new free list
-
-        --pool->freeEvents;                // one less event
+        e = (StateEvent *)atomicLoadLinkPointer( &pool->free__ );
 
-        // remember the minimum so far for
-        // later storage optimisation
-        if (pool->freeEvents < pool->minimumEvents)
+        if( e == NULL )                    // allocation failed
         {
-            pool->minimumEvents = pool->freeEvents;
+            atomicClearLink();
+            return NULL;
         }
-    }
-    else                                 // allocation failed
-    {
-        e = 0;
-    }
+    } while( !atomicStoreConditionalPointer( &pool->free__, *(void **)e ) );
 
-    CRITICAL_SECTION_END();
+    // one less event, and remember the minimum so far for
+    // later storage optimisation
+    atomicMinimum( &pool->minimumEvents, atomicAdd( &pool->freeEvents, -1 ) );
 
-    return e;         // return event or NULL pointer to the caller */
+    return e;         // return event to the caller
 }
 
 /* -------------------------------------------------------------------------- */
 
+//! Push a released event back on the head of the free list
 PRIVATE void
 eventPoolPut( EventPool *pool, StateEvent *e )
 {
+    void *head;
+
     // #of free blks must be < total
     REQUIRE( pool->freeEvents < pool->totalEvents );
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
-
-    *(void **)e = pool->free__;   // insert released block into free list
-    pool->free__ = e;             // set as new head of the free list
-    ++pool->freeEvents;           // one more block in this pool
+    do
+    {
+        head = atomicLoadLinkPointer( &pool->free__ );
+        *(void **)e = head;               // link released block to the free list
+    } while( !atomicStoreConditionalPointer( &pool->free__, e ) );
 
-    CRITICAL_SECTION_END();
+    atomicAdd( &pool->freeEvents, 1 );    // one more block in this pool
 }
 
 /* ----- End ---------------------------------------------------------------- */
@@ -44,19 +44,41 @@ extern "C" {
 #include "global.h"
 #include "state_event.h"
 
+/* ----- Defines ------------------------------------------------------------ */
+
+//! Events hold their pool id in two bits, so at most three pools
+#define EVENT_POOL_MAX 3
+
 /* ----- Types -------------------------------------------------------------- */
 
+//! Events are taken from and returned to the free list lock-free, so
+/// interrupts can allocate and recycle events without masking each other.
 typedef struct EventPool EventPool;
 struct EventPool
 {
-  void     *free__;          //!< linked list of free blocks
-  uint16_t eventSize;        //!< maximum event size (in bytes)
-  uint16_t totalEvents;      //!< total number of events in pool
-  uint16_t freeEvents;       //!< number of free blocks remaining
-  uint16_t minimumEvents;    //!< minimum number of free blocks
-  uint16_t minimumEventSize; //!< minimum used size for event (in bytes)
+  void     * volatile free__;        //!< linked list of free blocks
+  uint16_t eventSize;                //!< maximum event size (in bytes)
+  uint16_t totalEvents;              //!< total number of events in pool
+  volatile uint32_t freeEvents;      //!< number of free blocks remaining
+  volatile uint32_t minimumEvents;   //!< minimum number of free blocks
+  volatile uint32_t largestEvent;    //!< largest event allocated from the pool (in bytes)
+  volatile uint32_t failedEvents;    //!< # of allocations that found the pool empty
 };
 
+//! Usage of a pool since start up, to size the pools from field data.
+/// A request that finds its pool empty is counted as failed there and then
+/// tried on the next larger pool, so the failures of the largest pool are
+/// the requests that returned NULL.
+typedef struct
+{
+  uint16_t eventSize;                //!< maximum event size (in bytes)
+  uint16_t totalEvents;              //!< total number of events in pool
+  uint16_t freeEvents;               //!< number of free blocks remaining
+  uint16_t minimumEvents;            //!< minimum number of free blocks
+  uint16_t largestEvent;             //!< largest event allocated (in bytes)
+  uint32_t failedEvents;             //!< # of allocations that found the pool empty
+} EventPoolStatistics;
+
 /* ----- Public Functions --------------------------------------------------- */
 
 /** Initialise a event pool table.
@@ -83,6 +105,15 @@ eventPoolAddStorage( StateEvent   *poolStorage,
 
 /* -------------------------------------------------------------------------- */
 
+/** Copy out the usage of the pool with the given Id, as returned by
+ *  eventPoolAddStorage. Returns false when there is no such pool.
+ */
+
+PUBLIC bool
+eventPoolGetStatistics( uint8_t poolId, EventPoolStatistics *stats );
+
+/* -------------------------------------------------------------------------- */
+
 /** Returns a pointer to an allocated event memory block of the required
  *  size. The event is allocated on a smallest available fit from the set
  *  of available event pools. Primarily called through the EVENT_NEW macro.
@@ -119,6 +150,15 @@ eventPoolDeleteEvent( StateEvent *e );
 
 /* -------------------------------------------------------------------------- */
 
+/** Add delta to the reference count of a pool event and return the new
+ *  count. Safe to use from any task or interrupt, static events are not
+ *  counted and always return 0.
+ */
+PUBLIC uint8_t
+eventPoolReference( StateEvent *e, int8_t delta );
+
+/* -------------------------------------------------------------------------- */
+
 /** After a state machine has executed an event, this function decrements
  *  the usage counter on the event and deletes it when usage becomes 0.
  */
@@ -8,6 +8,10 @@
  *          Events need to be allocated from the event-pool, or statically
  *          allocated (like the standard events in event.c
  *
+ * @note    The queues are only used from the main loop, so they need no
+ *          critical sections. Interrupts post to a task through its
+ *          lock-free EventRing instead, see stateTaskPostFIFO.
+ *
  * @author  Marco Hess <marcoh@applidyne.com.au>
  *
  * @copyright (c) 2013-2015 Applidyne Australia Pty. Ltd. - All rights reserved.
@@ -94,9 +98,6 @@ eventQueueGet( EventQueue * restrict queue )
     // Must actually have queue storage
     REQUIRE( (queue->entries) && (queue->size > 0) );
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
-
     // Get the front event
     e = queue->front;
 
@@ -117,8 +118,6 @@ eventQueueGet( EventQueue * restrict queue )
         queue->front = NULL;
     }
 
-    CRITICAL_SECTION_END();
-
     return e;
 }
 
@@ -134,6 +133,31 @@ eventQueuePeek( EventQueue * restrict queue )
 
 /* -------------------------------------------------------------------------- */
 
+//! Look further into the queue. Index 0 is the front event, and the rest
+/// are counted from the tail of the ring-buffer. Returns NULL when the
+/// queue doesn't hold that many events.
+PUBLIC StateEvent *
+eventQueuePeekAt( EventQueue * restrict queue, uint8_t index )
+{
+    StateEvent *e = NULL;
+
+    REQUIRE( queue );
+
+    if( index == 0 )
+    {
+        return queue->front;
+    }
+
+    if( queue->front && index <= queue->used )
+    {
+        e = queue->entries[( queue->tail + index - 1U ) % queue->size];
+    }
+
+    return e;
+}
+
+/* -------------------------------------------------------------------------- */
+
 //! Deposit an event in the queue and return true when this was successful
 /// returns false when the queue was full. The frontEvt pointer keeps a
 /// shortcut to the most front event which speeds up access when there
@@ -149,15 +173,9 @@ eventQueuePutFIFO( EventQueue * restrict queue, StateEvent * restrict e )
     REQUIRE( (queue->entries) && (queue->size > 0) );
     REQUIRE( e );
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
-
     // If this is a dynamic allocated event,
     // update the reference count for this event
-    if( e->dynamic.poolId != 0 )
-    {
-        e->dynamic.useCount++;
-    }
+    eventPoolReference( e, 1 );
 
     // Insert into the queue
     if( queue->front == NULL )  // is the queue empty?
@@ -188,14 +206,10 @@ eventQueuePutFIFO( EventQueue * restrict queue, StateEvent * restrict e )
         {
             // If this is a dynamic allocated event,
             // undo the reference count increase we did earlier for this event
-            if( e->dynamic.poolId != 0 )
-            {
-                e->dynamic.useCount--;
-            }
+            eventPoolReference( e, -1 );
             eventQueued = false;
         }
     }
-    CRITICAL_SECTION_END();
     return eventQueued;
 }
 
@@ -215,13 +229,9 @@ eventQueuePutLIFO( EventQueue * restrict queue, StateEvent * restrict e )
     // Must actually have queue storage
     REQUIRE(queue->entries);
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
-
     // If this is a dynamic allocated event,
     // update the reference count for this event
-    if(e->dynamic.poolId != 0)
-        e->dynamic.useCount++;
+    eventPoolReference( e, 1 );
 
     // Insert into the queue
     if( queue->front == NULL ) // is the queue empty?
@@ -259,14 +269,10 @@ eventQueuePutLIFO( EventQueue * restrict queue, StateEvent * restrict e )
         {
             // If this is a dynamic allocated event,
             // decrement the reference count for this event
-            if( e->dynamic.poolId != 0 )
-            {
-                e->dynamic.useCount--;
-            }
+            eventPoolReference( e, -1 );
             eventQueued = false;
         }
     }
-    CRITICAL_SECTION_END();
     return eventQueued;
 }
 
@@ -282,15 +288,10 @@ eventQueueFlush( EventQueue * restrict queue )
     ASSERT(0);  // TBD This should really recycle the events that are in the
                 // queue instead of just resetting the pointers.
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
-
     queue->head  = 0;
     queue->tail  = 0;
     queue->front = NULL;
     queue->used  = 0;
-
-    CRITICAL_SECTION_END();
 }
 
 /* ----- End ---------------------------------------------------------------- */
@@ -8,6 +8,10 @@
  *          Events need to be allocated from the event-pool, or statically
  *          allocated (like the standard events in event.c
  *
+ * @note    The queues are only used from the main loop, so they need no
+ *          critical sections. Interrupts post to a task through its
+ *          lock-free EventRing instead, see stateTaskPostFIFO.
+ *
  * @author  Marco Hess <marcoh@applidyne.com.au>
  *
  * @copyright (c) 2013-2015 Applidyne Australia Pty. Ltd. - All rights reserved.
@@ -66,6 +70,10 @@ eventQueueGet( EventQueue * restrict queue );
 PUBLIC StateEvent *
 eventQueuePeek( EventQueue * restrict queue );
 
+//! Return the event at a position in the queue (0 is the front) without removing it
+PUBLIC StateEvent *
+eventQueuePeekAt( EventQueue * restrict queue, uint8_t index );
+
 //! Add an event to the tail of the queue so it comes out after existing events
 PUBLIC bool
 eventQueuePutFIFO( EventQueue * restrict queue, StateEvent * restrict e );
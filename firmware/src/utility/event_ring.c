@@ -0,0 +1,135 @@
+/**
+ * @file    event_ring.c
+ *
+ * @brief   Lock-free ring of event pointers that interrupts post into and
+ *          the main loop drains, without either side masking interrupts.
+ *
+ * @author  Marco Hess <marcoh@applidyne.com.au>
+ *
+ * @copyright (c) 2013-2018 Applidyne Australia Pty. Ltd. - All rights reserved.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "qassert.h"
+#include "atomic.h"
+#include "event_ring.h"
+#include "event_pool.h"
+
+/* -------------------------------------------------------------------------- */
+
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC EventRing *
+eventRingInit( EventRing  *me,
+               StateEvent * volatile ringStorage[],
+               uint8_t    num_entries )
+{
+    REQUIRE( me );
+    REQUIRE( ringStorage );
+    REQUIRE( num_entries > 1 );
+
+    me->entries = ringStorage;
+    me->size    = num_entries;
+    me->head    = 0;
+    me->tail    = 0;
+    me->max     = 0;
+    me->dropped = 0;
+
+    for( uint8_t i = 0; i < num_entries; i++ )
+    {
+        me->entries[i] = NULL;
+    }
+
+    return me;
+}
+
+/* -------------------------------------------------------------------------- */
+
+//! Claim the slot at the head and then fill it. A slot is claimed by
+/// exactly one producer, and only becomes visible to the consumer once the
+/// event pointer is stored into it. When the event can't be queued the
+/// caller needs to ensure that the event is properly deallocated.
+PUBLIC bool
+eventRingPut( EventRing *ring, StateEvent *e )
+{
+    uint32_t head;
+    uint32_t next;
+
+    REQUIRE( ring );
+    REQUIRE( ring->entries );
+    REQUIRE( e );
+
+    do
+    {
+        head = atomicLoadLink( &ring->head );
+        next = ( head + 1 < ring->size ) ? head + 1 : 0;
+
+        if( next == ring->tail )      // queue is full, return failure
+        {
+            atomicClearLink();
+            atomicAdd( &ring->dropped, 1 );
+            return false;
+        }
+    } while( !atomicStoreConditional( &ring->head, next ) );
+
+    // If this is a dynamic allocated event,
+    // update the reference count for this event
+    eventPoolReference( e, 1 );
+
+    // Remember the maximum, a nested post may briefly lower it again
+    uint32_t used = eventRingUsed( ring );
+    if( used > ring->max )
+    {
+        ring->max = used;
+    }
+
+    // Publish the event, the consumer stops at the first empty slot
+    atomicBarrier();
+    ring->entries[head] = e;
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+//! Retrieve the oldest event, or NULL when it is empty or the producer that
+/// claimed the oldest slot hasn't filled it yet.
+PUBLIC StateEvent *
+eventRingGet( EventRing *ring )
+{
+    REQUIRE( ring );
+    REQUIRE( ring->entries );
+
+    uint32_t   tail = ring->tail;
+    StateEvent *e   = ring->entries[tail];
+
+    if( e )
+    {
+        // Free the slot before moving past it, so a producer that sees the
+        // new tail always finds its claimed slot empty
+        ring->entries[tail] = NULL;
+        atomicBarrier();
+        ring->tail = ( tail + 1 < ring->size ) ? tail + 1 : 0;
+    }
+
+    return e;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint32_t
+eventRingUsed( EventRing *ring )
+{
+    uint32_t head = ring->head;
+    uint32_t tail = ring->tail;
+
+    return ( head >= tail ) ? head - tail : head + ring->size - tail;
+}
+
+/* ----- End ---------------------------------------------------------------- */
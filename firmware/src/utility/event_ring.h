@@ -0,0 +1,78 @@
+/**
+ * @file    event_ring.h
+ *
+ * @brief   Lock-free ring of event pointers that interrupts post into and
+ *          the main loop drains, without either side masking interrupts.
+ *
+ * @note    Any number of interrupts, at any priorities, may put into a ring.
+ *          They claim a slot by advancing the head with a load-link/store-
+ *          conditional and then store the event pointer, which is what makes
+ *          the slot visible. Only one context may get from a ring, it clears
+ *          each slot it takes before moving the tail past it. With a single
+ *          interrupt posting this reduces to a plain index ordered SPSC ring.
+ *
+ *          Like the event queues the ring holds a reference on pool events
+ *          while they wait.
+ *
+ * @author  Marco Hess <marcoh@applidyne.com.au>
+ *
+ * @copyright (c) 2013-2018 Applidyne Australia Pty. Ltd. - All rights reserved.
+ */
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+#include "state_event.h" // for Event type
+
+/* ----- Types -------------------------------------------------------------- */
+
+typedef struct EventRing EventRing;
+struct EventRing
+{
+    StateEvent  * volatile *entries;    ///< pointer to event pointer array, NULL when free
+    uint32_t    size;                   ///< number of entries, one is always left free
+    volatile uint32_t head;             ///< where producers insert the next event
+    volatile uint32_t tail;             ///< where the consumer takes the next event
+    volatile uint32_t max;              ///< maximum # of events ever in the ring
+    volatile uint32_t dropped;          ///< # of events refused as the ring was full
+};
+
+/* ----- Public Functions --------------------------------------------------- */
+
+//! Initialise the ring structure, the storage is cleared
+PUBLIC EventRing *
+eventRingInit( EventRing  *ring,
+               StateEvent * volatile ringStorage[],
+               uint8_t    num_entries );
+
+//! Add an event to the ring from any context. Returns false when full.
+PUBLIC bool
+eventRingPut( EventRing *ring, StateEvent *e );
+
+//! Take the oldest event from the ring, NULL when empty. Single consumer only.
+PUBLIC StateEvent *
+eventRingGet( EventRing *ring );
+
+//! Return the number of events in the ring, 0 when none
+PUBLIC uint32_t
+eventRingUsed( EventRing *ring );
+
+/* ----------------------- End --------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVENT_RING_H */
@@ -59,10 +59,9 @@ eventSubscribe( StateTask    *t,
     REQUIRE( signal < locMaxSignal );       // Signal is within bounds
     REQUIRE( t->tasker );                   // Is this an active task?
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
+    // Only the main loop changes subscriptions, interrupts publishing read
+    // the whole word in one go and see it either before or after the change
     bitsetSet( &eventSubscribersList[signal], t->id );
-    CRITICAL_SECTION_END();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -77,10 +76,8 @@ eventUnsubscribe( StateTask    *t,
     REQUIRE( signal < locMaxSignal );       // Signal is within bounds
     REQUIRE( t->tasker );                   // Is this an active task?
 
-    CRITICAL_SECTION_VAR();
-    CRITICAL_SECTION_START();
+    // No critical section needed, see eventSubscribe
     bitsetClear( &eventSubscribersList[signal], t->id );
-    CRITICAL_SECTION_END();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -105,46 +102,32 @@ eventPublish( const StateEvent *e )
 
     if( e ) // Silently ignore NULL events if asserts are not used.
     {
+        // Hold a reference while delivering, so a subscriber that preempts
+        // us can't recycle the event before every subscriber has it
+        eventPoolReference( (StateEvent *)e, 1 );
+
         // Lookup the subscribers list for this event
         eventSubscribers = eventSubscribersList[e->signal];
 
-        if( eventSubscribers != 0 ) // any subscribers?
+        while( eventSubscribers > 0 )
         {
-            bool success = false;
-
-            while( eventSubscribers > 0 )
-            {
-                register uint8_t p;
-                p = bitsetHighest( &eventSubscribers );
-                bitsetClear( &eventSubscribers, p );
-                ASSERT( eventTaskTable[p] );  // check if task is active
-                                              // check queue can take event
-                if( stateTaskPostFIFO( eventTaskTable[ p ], e ) )
-                {
-                    // Keep track that event is in on a task queue now.
-                    // So we don't have to recycle it below.
-                    success = true;
-                }
-                else
-                {
-                    // Failed to deliver event to subscribed queue
-                    // (queue is full)
-                    fully_delivered = false;
-//                    ASSERT_PRINTF( false, "e=%d, t=%d", e->signal, p );
-                }
-            }
-
-            // None of the publishing queues were able to take the event
-            // so ensure that we recycle it
-            if( !success )
+            register uint8_t p;
+            p = bitsetHighest( &eventSubscribers );
+            bitsetClear( &eventSubscribers, p );
+            ASSERT( eventTaskTable[p] );  // check if task is active
+                                          // check queue can take event
+            if( !stateTaskPostFIFO( eventTaskTable[ p ], e ) )
             {
-                EVENT_DELETE( e );
+                // Failed to deliver event to subscribed queue
+                // (queue is full)
+                fully_delivered = false;
+//                ASSERT_PRINTF( false, "e=%d, t=%d", e->signal, p );
             }
         }
-        else // no subscribers, recycle immediately
-        {
-            EVENT_DELETE( e );
-        }
+
+        // Drop our reference. When there were no subscribers, or none of
+        // the subscriber queues were able to take the event, this recycles it
+        eventPoolGarbageCollect( (StateEvent *)e );
     }
     return fully_delivered;
 }
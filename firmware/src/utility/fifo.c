@@ -12,6 +12,7 @@
 
 /* ----- System Includes ---------------------------------------------------- */
 
+#include <string.h>
 
 /* ----- Local Includes ----------------------------------------------------- */
 
@@ -162,18 +163,28 @@ fifo_peek( fifo_t * restrict f )
 PUBLIC uint32_t
 fifo_write( fifo_t * restrict f, const uint8_t * buf, uint32_t nbytes )
 {
-     uint32_t count = 0;
-     for( uint32_t i = 0; i < nbytes; i++ )
-     {
-         if( fifo_put( f, buf[i] ) )
-         {
-             count++;
-         }
-         else
-         {
-             break;
-         }
+    uint32_t count = 0;
+
+    // At most two copies, up to the end of the buffer then from the start
+    while( count < nbytes )
+    {
+        uint32_t span = fifo_free_linear( f );
+
+        if( span == 0 )
+        {
+            break;
+        }
+
+        if( span > nbytes - count )
+        {
+            span = nbytes - count;
+        }
+
+        memcpy( &f->buf[f->head], &buf[count], span );
+        fifo_commit( f, span );
+        count += span;
     }
+
     return count;
 }
 
@@ -220,6 +231,60 @@ fifo_get_tail_ptr( fifo_t * restrict f, uint32_t nbytes )
 
 /* -------------------------------------------------------------------------- */
 
+/** Returns the free space ahead of the head that is contiguous in memory.
+ *  The byte before the tail always stays empty to tell full from empty.
+ */
+
+PUBLIC uint32_t
+fifo_free_linear( fifo_t * restrict f )
+{
+    uint32_t tail = f->tail;
+
+    if( f->head >= tail )
+    {
+        // up to the end of the buffer, stopping short of it when the tail is at the start
+        return f->capacity - f->head - ( ( tail == 0 ) ? 1 : 0 );
+    }
+
+    return tail - f->head - 1;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/** Get the pointer to the head to fill nbytes in place, if they fit contiguously.
+ *  Returns NULL when they don't, the data becomes visible with fifo_commit.
+ */
+
+PUBLIC uint8_t *
+fifo_reserve_linear( fifo_t * restrict f, uint32_t nbytes )
+{
+    if( nbytes <= fifo_free_linear( f ) )
+    {
+        return &f->buf[f->head];
+    }
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/** Moves the head forward by nbytes once they have been written in place */
+
+PUBLIC void
+fifo_commit( fifo_t * restrict f, uint32_t nbytes )
+{
+    uint32_t head = f->head + nbytes;
+
+    if( head >= f->capacity )
+    {
+        head -= f->capacity;
+    }
+
+    f->head = head;
+}
+
+/* -------------------------------------------------------------------------- */
+
 /** Moves/flushes the tail forward by nbytes */
 
 PUBLIC uint32_t
@@ -127,6 +127,30 @@ fifo_get_tail_ptr( fifo_t * restrict f, uint32_t nbytes );
 PUBLIC uint32_t
 fifo_skip( fifo_t * restrict f, uint32_t nbytes );
 
+/* -------------------------------------------------------------------------- */
+
+/** Returns the free space ahead of the head in a sequential block of memory. */
+
+PUBLIC uint32_t
+fifo_free_linear( fifo_t * restrict f );
+
+/* -------------------------------------------------------------------------- */
+
+/** Get the pointer to the head to write nbytes in place, if they fit in a
+ *  sequential block. Returns NULL when they don't.
+ *  Only the producer may use this, and it must fifo_commit the bytes after.
+ */
+
+PUBLIC uint8_t *
+fifo_reserve_linear( fifo_t * restrict f, uint32_t nbytes );
+
+/* -------------------------------------------------------------------------- */
+
+/** Publish nbytes written in place at the head to the consumer */
+
+PUBLIC void
+fifo_commit( fifo_t * restrict f, uint32_t nbytes );
+
 /* ----- End ---------------------------------------------------------------- */
 
 #ifdef    __cplusplus
@@ -0,0 +1,99 @@
+/**
+ * @file    id_hash.c
+ *
+ * @brief   Small open-addressed hash from message ID strings to table indexes.
+ *
+ *          Linear probing, with the table kept at most half full so a miss
+ *          ends at an empty slot within a probe or two.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "id_hash.h"
+
+/* ----------------------- Private Functions Declarations ------------------- */
+
+PRIVATE uint32_t
+idHashSlot( const char *id );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+idHashInit( IdHash_t *hash )
+{
+    memset( hash, 0, sizeof( IdHash_t ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+idHashInsert( IdHash_t *hash, const char *id, uint8_t index )
+{
+    uint32_t used = 0;
+
+    for( uint32_t i = 0; i < ID_HASH_SLOTS; i++ )
+    {
+        used += ( hash->id[i] != 0 );
+    }
+
+    if( ( used + 1 ) * 2 > ID_HASH_SLOTS )
+    {
+        return false;
+    }
+
+    uint32_t slot = idHashSlot( id );
+
+    // Linear probe past any earlier ID that landed in the same slot
+    while( hash->id[slot] )
+    {
+        slot = ( slot + 1 ) & ( ID_HASH_SLOTS - 1 );
+    }
+
+    hash->id[slot]    = id;
+    hash->index[slot] = index;
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC int16_t
+idHashFind( const IdHash_t *hash, const char *id )
+{
+    uint32_t slot = idHashSlot( id );
+
+    while( hash->id[slot] )
+    {
+        if( strcmp( hash->id[slot], id ) == 0 )
+        {
+            return hash->index[slot];
+        }
+
+        slot = ( slot + 1 ) & ( ID_HASH_SLOTS - 1 );
+    }
+
+    return ID_HASH_NOT_FOUND;
+}
+
+/* ----------------------- Private Functions ------------------------------- */
+
+/** FNV-1a over the ID, folded down to the slot count */
+PRIVATE uint32_t
+idHashSlot( const char *id )
+{
+    uint32_t hash = 2166136261UL;
+
+    while( *id )
+    {
+        hash ^= (uint8_t)*id++;
+        hash *= 16777619UL;
+    }
+
+    return ( hash ^ ( hash >> 16 ) ) & ( ID_HASH_SLOTS - 1 );
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,68 @@
+/**
+ * @file    id_hash.h
+ *
+ * @brief   Small open-addressed hash from message ID strings to table indexes,
+ *          so inbound packets can find their handler without comparing every
+ *          name. Built once at init, lookups are one FNV-1a pass over the ID
+ *          and usually a single confirming strcmp.
+ */
+
+#ifndef ID_HASH_H
+#define ID_HASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define ID_HASH_SLOTS     32U    // power of two
+#define ID_HASH_NOT_FOUND -1
+
+/* ----- Types -------------------------------------------------------------- */
+
+typedef struct
+{
+    const char *id[ID_HASH_SLOTS];       // NULL marks an empty slot
+    uint8_t     index[ID_HASH_SLOTS];    // caller's table index for the ID in the same slot
+} IdHash_t;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/** Empty the hash */
+
+PUBLIC void
+idHashInit( IdHash_t *hash );
+
+/* -------------------------------------------------------------------------- */
+
+/** Add an ID and the index it maps to. The ID string is referenced, not
+ *  copied. Returns false once the hash is half full, past which probe
+ *  chains get long. */
+
+PUBLIC bool
+idHashInsert( IdHash_t *hash, const char *id, uint8_t index );
+
+/* -------------------------------------------------------------------------- */
+
+/** Index stored for an ID, or ID_HASH_NOT_FOUND */
+
+PUBLIC int16_t
+idHashFind( const IdHash_t *hash, const char *id );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ID_HASH_H */
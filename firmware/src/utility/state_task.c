@@ -14,12 +14,14 @@
 /* ----- Local Includes ----------------------------------------------------- */
 
 #include "state_task.h"
+#include "state_tasker.h"
+#include "atomic.h"
 #include "qassert.h"
 #include "state_event.h"
 
 /* -------------------------------------------------------------------------- */
 
-//DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
+DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
 
 /* ----- Private Functions -------------------------------------------------- */
 
@@ -45,6 +47,9 @@ stateTaskCreate( StateTask    * restrict me,
     // Add the event queues.
     eventQueueInit( &me->eventQueue,   eventQueueData,   eventQueueSize );
     eventQueueInit( &me->requestQueue, requestQueueData, requestQueueSize );
+    eventRingInit( &me->interruptQueue,
+                   me->interruptEntries,
+                   DIM( me->interruptEntries ) );
 
     return me;
 }
@@ -58,9 +63,25 @@ stateTaskPostFIFO( StateTask *t, const StateEvent *e )
     {
         if( t )
         {
-            if( eventQueuePutFIFO( &t->eventQueue, (StateEvent*)e ) )
+            bool queued;
+
+#if STATE_TASKER_PREEMPTIVE
+            // Only the task's own interrupt takes from its event queue
+            queued = eventRingPut( &t->interruptQueue, (StateEvent*)e );
+#else
+            if( atomicInInterrupt() )
+            {
+                queued = eventRingPut( &t->interruptQueue, (StateEvent*)e );
+            }
+            else
             {
-                t->ready = true;
+                queued = eventQueuePutFIFO( &t->eventQueue, (StateEvent*)e );
+            }
+#endif
+
+            if( queued )
+            {
+                stateTaskerReady( (StateTasker_t*)t->tasker, t );
                 return true;
             }
         }
@@ -77,9 +98,15 @@ stateTaskPostLIFO( StateTask *t, const StateEvent *e )
     {
         if( t )
         {
+#if STATE_TASKER_PREEMPTIVE
+            REQUIRE( t == ( (StateTasker_t*)t->tasker )->current );
+#else
+            REQUIRE( !atomicInInterrupt() );
+#endif
+
             if( eventQueuePutLIFO( &t->eventQueue, (StateEvent*)e ) )
             {
-                t->ready = true;
+                stateTaskerReady( (StateTasker_t*)t->tasker, t );
                 return true;
             }
         }
@@ -87,4 +114,34 @@ stateTaskPostLIFO( StateTask *t, const StateEvent *e )
     return false;    // Failed to queue the event (also for a NULL event).
 }
 
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+stateTaskCollectInterruptEvents( StateTask *t )
+{
+    StateEvent *e;
+
+    while( ( e = eventRingGet( &t->interruptQueue ) ) != NULL )
+    {
+        // The event queue takes its own reference, then the one the
+        // interrupt queue held is dropped. An event that doesn't fit is
+        // counted and recycled here, as a full interrupt queue would be.
+        if( !eventQueuePutFIFO( &t->eventQueue, e ) )
+        {
+            t->dropped++;
+        }
+
+        eventPoolGarbageCollect( e );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC bool
+stateTaskHasEvents( StateTask *t )
+{
+    return ( eventQueueUsed( &t->eventQueue ) > 0 )
+           || ( eventRingUsed( &t->interruptQueue ) > 0 );
+}
+
 /* ----- End ---------------------------------------------------------------- */
@@ -26,10 +26,15 @@ extern "C" {
 #include "state_hsm.h"
 #include "state_event.h"
 #include "event_queue.h"
+#include "event_ring.h"
 #include "event_pool.h"
 
 /* ----- Defines ------------------------------------------------------------ */
 
+//! Events posted from interrupts wait here until the tasker moves them into
+/// the task's event queue. The main loop normally empties it every pass.
+#define STATE_TASK_INTERRUPT_QUEUE_SIZE 16
+
 /* ----- Types -------------------------------------------------------------- */
 
 /** StateTask Control Block */
@@ -39,14 +44,20 @@ typedef struct
     Hsm           super;                /** State machine super structure */
     uint8_t       id;
     const char  * name;
-    bool          ready;                /** true when ready to run */
+    volatile bool ready;                /** true when ready to run, also set from interrupts */
     uint32_t      burst;
     uint32_t      waiting;
     uint32_t      burst_max;
     uint32_t      waiting_max;
+    uint32_t      ready_at;             /** cycle count since when the task waited to run */
+    uint32_t      latency_max;          /** longest a ready task waited to run, in cycles */
+    uint32_t      dispatch_max;         /** longest single event dispatch, in cycles */
+    uint32_t      dropped;              /** interrupt posts that didn't fit the event queue, since boot */
     void *        tasker;
     EventQueue    eventQueue;
     EventQueue    requestQueue;
+    EventRing     interruptQueue;       /** Posts from interrupt handlers */
+    StateEvent    * volatile interruptEntries[STATE_TASK_INTERRUPT_QUEUE_SIZE];
 } StateTask;
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
@@ -57,12 +68,25 @@ typedef struct
 /// successful and false when the event failed to be queued (which should be
 /// a fatal error but is a return status here to allow checking at higher
 /// levels so it is easier to debug which queue and where the problem is).
+/// Posts made from interrupt handlers go to the lock-free interrupt queue,
+/// so the event queues themselves are only ever touched by the main loop.
 PUBLIC bool
 stateTaskPostFIFO( StateTask *t, const StateEvent *e );
 
+//! LIFO posting is only available from the main loop, or in preemptive
+/// mode from the task posting to itself
 PUBLIC bool
 stateTaskPostLIFO( StateTask *t, const StateEvent *e );
 
+//! Move events posted from interrupts into the event queue, in the order
+/// they were posted. Called by the tasker from the main loop.
+PUBLIC void
+stateTaskCollectInterruptEvents( StateTask *t );
+
+//! True when there are events waiting in either of the task's queues
+PUBLIC bool
+stateTaskHasEvents( StateTask *t );
+
 //! Flush/discard all request on the request queue
 PUBLIC void
 stateTaskFlushRequests( StateTask *t );
@@ -12,9 +12,14 @@
 
 #include <string.h>
 
+#ifndef STM32F429xx
+#include <time.h>
+#endif
+
 /* ----- Local Includes ----------------------------------------------------- */
 
 #include "state_tasker.h"
+#include "atomic.h"
 #include "qassert.h"
 #include "event_queue.h"
 #include "state_event.h"
@@ -23,14 +28,43 @@
 
 DEFINE_THIS_FILE; /* Used for ASSERT checks to define __FILE__ only once */
 
+/* ----- Defines ------------------------------------------------------------ */
+
+//! Cycle counter used for the task latency statistics, host builds count
+/// nanoseconds instead
+#ifdef STM32F429xx
+#define STATE_TASKER_CYCLES() CRITICAL_SECTION_CYCLES
+#else
+#define STATE_TASKER_CYCLES() stateTaskerHostClock()
+#endif
+
+//! Ready bit for a task, task ids are numbered from 1 like the bitset
+#define STATE_TASKER_BIT( id_ ) ( (BitSet_t)1U << ( (id_) - 1U ) )
+
 
 /* ----- Private Prototypes ------------------------------------------------- */
 
+#ifndef STM32F429xx
+PRIVATE uint32_t
+stateTaskerHostClock( void );
+#endif
+
+PRIVATE void
+stateTaskerDispatch( StateTask *task, StateEvent *e );
+
+PRIVATE bool
+stateTaskerIdle( StateTasker_t * me, StateTask *task );
+
+#if !STATE_TASKER_PREEMPTIVE
+PRIVATE void
+stateTaskerCollect( StateTasker_t * me );
+
 PRIVATE void
 stateTaskerBumpWaiting( StateTasker_t * me );
 
 PRIVATE StateTask  *
 stateTaskerNext( StateTasker_t * me );
+#endif
 
 /* ----- Public Functions --------------------------------------------------- */
 
@@ -61,15 +95,19 @@ stateTaskerAddTask( StateTasker_t *me,
     REQUIRE( priority < me->max_tasks );  /* Less than num_task */
     REQUIRE( me->tasks[priority] == (StateTask*)0 ); /* Not init yet */
 
-    task->id          = priority;
-    task->ready       = false;
-    task->name        = name;
-    task->burst       = 0;
-    task->waiting     = 0;
-    task->burst_max   = 0;
-    task->waiting_max = 0;
+    task->id           = priority;
+    task->ready        = false;
+    task->name         = name;
+    task->burst        = 0;
+    task->waiting      = 0;
+    task->burst_max    = 0;
+    task->waiting_max  = 0;
+    task->ready_at     = 0;
+    task->latency_max  = 0;
+    task->dispatch_max = 0;
+    task->dropped      = 0;
 
-    task->tasker      = me;     /* Keep reference to tasker */
+    task->tasker       = me;     /* Keep reference to tasker */
 
     me->tasks[priority] = task;
 }
@@ -99,18 +137,21 @@ stateTaskerStartTask( StateTasker_t * me __attribute__((__unused__)),
 PUBLIC bool
 stateTaskerRunEvent( StateTasker_t * me )
 {
+#if STATE_TASKER_PREEMPTIVE
+    // The tasks run from their own interrupts, which leaves the main
+    // loop with only the background work
+    (void)me;
+    return false;
+#else
+    stateTaskerCollect( me );
     stateTaskerBumpWaiting( me );
     me->current = stateTaskerNext( me );
     if( me->current )
     {
-        StateEvent *e;
+        // Only the main loop touches the event queue, interrupts post
+        // through the interrupt queue collected above.
+        StateEvent *e = eventQueueGet( &me->current->eventQueue );
 
-        {
-            CRITICAL_SECTION_VAR();
-            CRITICAL_SECTION_START();
-            e = eventQueueGet( &me->current->eventQueue );
-            CRITICAL_SECTION_END();
-        }
         me->current->waiting = 0;
         if( me->previous == me->current )
         {
@@ -120,23 +161,100 @@ stateTaskerRunEvent( StateTasker_t * me )
                 me->current->burst_max = me->current->burst;
             }
         }
-        hsmDispatch( (Hsm*)me->current, e );
-        eventPoolGarbageCollect( e );
 
+        if( e )
+        {
+            stateTaskerDispatch( me->current, e );
+        }
+
+        if( eventQueueUsed( &me->current->eventQueue ) == 0 )
         {
-            CRITICAL_SECTION_VAR();
-            CRITICAL_SECTION_START();
-            if( eventQueueUsed( &me->current->eventQueue ) == 0 )
+            if( stateTaskerIdle( me, me->current ) )
             {
                 me->current->burst = 0;
-                me->current->ready = false;
             }
-            CRITICAL_SECTION_END();
         }
     }
 
     me->previous = me->current;
     return stateTaskerNext( me ) != NULL;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+stateTaskerReady( StateTasker_t * me, StateTask *task )
+{
+    REQUIRE( me );
+
+    // Latency counts from the first event, not the latest
+    if( !task->ready )
+    {
+        task->ready_at = STATE_TASKER_CYCLES();
+    }
+
+    task->ready = true;
+    atomicSetBits( &me->ready, STATE_TASKER_BIT( task->id ) );
+
+    if( me->activate )
+    {
+        me->activate( task->id );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+stateTaskerSetActivateHook( StateTasker_t * me, StateTaskerActivate activate )
+{
+    me->activate = activate;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+stateTaskerSetProfileHook( StateTasker_t * me, StateTaskerProfile profile )
+{
+    me->profile = profile;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/** Runs in the task's interrupt, which a higher priority task's interrupt
+ *  can preempt. The preempted task is restored as current on the way out.
+ */
+
+PUBLIC void
+stateTaskerRunTask( StateTasker_t * me, StateTask *task )
+{
+    StateTask *preempted = me->current;
+
+    REQUIRE( task );
+
+    me->current = task;
+    task->burst = 0;
+
+    do
+    {
+        StateEvent *e;
+
+        stateTaskCollectInterruptEvents( task );
+
+        while( ( e = eventQueueGet( &task->eventQueue ) ) != NULL )
+        {
+            if( ++task->burst > task->burst_max )
+            {
+                task->burst_max = task->burst;
+            }
+
+            stateTaskerDispatch( task, e );
+            stateTaskCollectInterruptEvents( task );
+        }
+    } while( !stateTaskerIdle( me, task ) );
+
+    task->burst = 0;
+    me->current = preempted;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -177,45 +295,148 @@ stateTaskerClearStatistics( StateTasker_t *me )
         {
             me->tasks[id]->burst_max = 0;
             me->tasks[id]->waiting_max = 0;
+            me->tasks[id]->latency_max = 0;
+            me->tasks[id]->dispatch_max = 0;
         }
     }
 }
 
 /* ----- Private Functions -------------------------------------------------- */
 
+/** Run one event through the task's state machine and recycle it, keeping
+ *  the latency and dispatch time statistics. */
+
+PRIVATE void
+stateTaskerDispatch( StateTask *task, StateEvent *e )
+{
+    uint32_t start   = STATE_TASKER_CYCLES();
+    uint32_t latency = start - task->ready_at;
+
+    if( latency > task->latency_max )
+    {
+        task->latency_max = latency;
+    }
+
+    hsmDispatch( (Hsm*)task, e );
+    eventPoolGarbageCollect( e );
+
+    // Any further event has been waiting since this one finished
+    task->ready_at = STATE_TASKER_CYCLES();
+
+    StateTasker_t *tasker = (StateTasker_t*)task->tasker;
+    uint32_t      cycles  = task->ready_at - start;
+
+    if( cycles > task->dispatch_max )
+    {
+        task->dispatch_max = cycles;
+    }
+
+    if( tasker->profile )
+    {
+        tasker->profile( task->id, cycles );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+/** The task's event queue is empty. Clear its ready bit before looking at
+ *  the interrupt queue again, so an event posted in between either shows up
+ *  now or sets the bit again. Returns false when the task is still ready. */
+
+PRIVATE bool
+stateTaskerIdle( StateTasker_t * me, StateTask *task )
+{
+    task->ready = false;
+    atomicClearBits( &me->ready, STATE_TASKER_BIT( task->id ) );
+    atomicBarrier();
+
+    if( stateTaskHasEvents( task ) )
+    {
+        task->ready = true;
+        atomicSetBits( &me->ready, STATE_TASKER_BIT( task->id ) );
+        return false;
+    }
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+#if !STATE_TASKER_PREEMPTIVE
+
+/** Move the events interrupts posted since the last run into the task event
+ *  queues, so they are dispatched in order with the events posted from the
+ *  main loop. */
+
+PRIVATE void
+stateTaskerCollect( StateTasker_t * me )
+{
+    BitSet_t ready = me->ready;
+
+    while( ready )
+    {
+        uint8_t id = bitsetHighest( &ready );
+        bitsetClear( &ready, id );
+
+        stateTaskCollectInterruptEvents( me->tasks[id] );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
 /** Bump the waiting counter for any ready to run tasks */
 
 PRIVATE void
 stateTaskerBumpWaiting( StateTasker_t * me )
 {
-    for( uint8_t id = me->max_tasks-1; id > 0; id-- )
+    BitSet_t ready = me->ready;
+
+    while( ready )
     {
-        if( ( me->tasks[id] ) && ( me->tasks[id]->ready ) )
+        uint8_t id = bitsetHighest( &ready );
+        bitsetClear( &ready, id );
+
+        me->tasks[id]->waiting++;
+        if( me->tasks[id]->waiting > me->tasks[id]->waiting_max )
         {
-            me->tasks[id]->waiting++;
-            if( me->tasks[id]->waiting > me->tasks[id]->waiting_max )
-            {
-                me->tasks[id]->waiting_max = me->tasks[id]->waiting;
-            }
+            me->tasks[id]->waiting_max = me->tasks[id]->waiting;
         }
     }
 }
 
 /* -------------------------------------------------------------------------- */
 
-/** Return the task * that is the next to run */
+/** Return the task * that is the next to run, the highest ready task id
+ *  found with a count leading zeros over the ready bits. */
 
 PRIVATE StateTask  *
 stateTaskerNext( StateTasker_t * me )
 {
-    for( uint8_t id = me->max_tasks-1; id > 0; id-- )
+    BitSet_t ready = me->ready;
+
+    if( ready )
     {
-        if( ( me->tasks[id] ) && ( me->tasks[id]->ready ) )
-        {
-            return me->tasks[id];
-        }
+        return me->tasks[bitsetHighest( &ready )];
     }
     return NULL;
 }
 
+#endif
+
+/* -------------------------------------------------------------------------- */
+
+#ifndef STM32F429xx
+
+/** Monotonic nanoseconds, wrapping like the cycle counter does */
+
+PRIVATE uint32_t
+stateTaskerHostClock( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint32_t)( (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec );
+}
+
+#endif
+
 /* ----- End ---------------------------------------------------------------- */
@@ -4,6 +4,19 @@
  * @brief     The tasker is responsible for executing the events for
  *            state tasks and managing priorities.
  *
+ *            By default the tasker is cooperative. The main loop calls
+ *            stateTaskerRunEvent, which runs one event for the highest
+ *            priority ready task, so a long dispatch in a low priority
+ *            task delays every other task.
+ *
+ *            Building with STATE_TASKER_PREEMPTIVE set to 1 runs each task
+ *            from its own interrupt instead, at an NVIC priority matching
+ *            its task priority. Posting to a task pends its interrupt via
+ *            the activate hook, so a higher priority task preempts a lower
+ *            one and runs its events to completion before returning to it.
+ *            Tasks then share data at different priorities, so anything
+ *            two tasks touch needs to be made safe for preemption first.
+ *
  * @author    Marco Hess <marcoh@applidyne.com.au>
  *
  * @copyright (c) 2017 Applidyne Australia Pty. Ltd. - All rights reserved.
@@ -24,6 +37,7 @@ extern "C" {
 /* ----- Local Includes ----------------------------------------------------- */
 
 #include "global.h"
+#include "bitset.h"
 #include "state_task.h"
 
 /* ----- Defines ------------------------------------------------------------ */
@@ -32,14 +46,27 @@ extern "C" {
   #define STATE_TASKER_MAX_TASKS      16     //!< Maximum number of tasks supported
 #endif
 
+#ifndef STATE_TASKER_PREEMPTIVE
+  #define STATE_TASKER_PREEMPTIVE     0      //!< Run tasks from prioritised interrupts
+#endif
+
 /* ----- Types -------------------------------------------------------------- */
 
+//! Called with the task id when a task becomes ready, pends its interrupt
+typedef void ( *StateTaskerActivate )( uint8_t id );
+
+//! Called with the task id and the cycles each dispatch took, for profiling
+typedef void ( *StateTaskerProfile )( uint8_t id, uint32_t cycles );
+
 typedef struct
 {
     uint8_t                max_tasks;       /** maximum number of tasks */
     StateTask              *current;        /** current running task */
     StateTask              *previous;       /** previous running task */
     StateTask              **tasks;         /** Table of tasks pointers */
+    volatile BitSet_t      ready;           /** bit per task id with events waiting */
+    StateTaskerActivate    activate;        /** preemptive mode, pends a task's interrupt */
+    StateTaskerProfile     profile;         /** optional, told how long each dispatch took */
 } StateTasker_t;
 
 /* -------------------------------------------------------------------------- */
@@ -84,6 +111,41 @@ stateTaskerRunEvent( StateTasker_t * me );
 
 /* -------------------------------------------------------------------------- */
 
+/** Mark a task as having events waiting. Called when events are posted to
+ *  the task, from any context.
+ */
+
+PUBLIC void
+stateTaskerReady( StateTasker_t * me, StateTask *task );
+
+/* -------------------------------------------------------------------------- */
+
+/** Preemptive mode: set the hook that pends a task's interrupt. Set it
+ *  before the tasks are started so their initial posts activate them.
+ */
+
+PUBLIC void
+stateTaskerSetActivateHook( StateTasker_t * me, StateTaskerActivate activate );
+
+/* -------------------------------------------------------------------------- */
+
+/** Set the hook told how many cycles each event dispatch took
+ */
+
+PUBLIC void
+stateTaskerSetProfileHook( StateTasker_t * me, StateTaskerProfile profile );
+
+/* -------------------------------------------------------------------------- */
+
+/** Preemptive mode: run all the events waiting for a task. Called from the
+ *  task's interrupt handler.
+ */
+
+PUBLIC void
+stateTaskerRunTask( StateTasker_t * me, StateTask *task );
+
+/* -------------------------------------------------------------------------- */
+
 /** Return the name of the task with the indicated ID.
  */
 
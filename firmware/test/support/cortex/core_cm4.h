@@ -0,0 +1,119 @@
+/*
+ * Host stand-in for the CMSIS Cortex-M4 core header, so the device header and
+ * LL drivers can be compiled into the host tests. Only the access qualifiers
+ * and the handful of intrinsics the hal uses are provided.
+ *
+ * There are no interrupts on the host, the tests call the handlers directly,
+ * so masking only tracks PRIMASK and the NVIC calls do nothing.
+ */
+
+#ifndef __CORE_CM4_H_GENERIC
+#define __CORE_CM4_H_GENERIC
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdint.h>
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define __CM4_REV 0x0001U
+
+#define __I   volatile const
+#define __IO  volatile
+#define __IM  volatile const
+#define __OM  volatile
+#define __IOM volatile
+
+#define __STATIC_INLINE       static inline
+#define __STATIC_FORCEINLINE  static inline __attribute__( ( always_inline ) )
+
+/* ----- Inline Functions --------------------------------------------------- */
+
+static uint32_t cortex_host_primask = 0;
+
+static inline uint32_t
+__get_PRIMASK( void )
+{
+    return cortex_host_primask;
+}
+
+static inline void
+__set_PRIMASK( uint32_t primask )
+{
+    cortex_host_primask = primask;
+}
+
+static inline void
+__disable_irq( void )
+{
+    cortex_host_primask = 1;
+}
+
+static inline void
+__enable_irq( void )
+{
+    cortex_host_primask = 0;
+}
+
+static inline uint32_t
+__CLZ( uint32_t value )
+{
+    return ( value ) ? (uint32_t)__builtin_clz( value ) : 32U;
+}
+
+static inline uint32_t
+__RBIT( uint32_t value )
+{
+    uint32_t reversed = 0;
+
+    for( uint8_t bit = 0; bit < 32U; bit++, value >>= 1 )
+    {
+        reversed = ( reversed << 1 ) | ( value & 1U );
+    }
+
+    return reversed;
+}
+
+static inline uint32_t
+NVIC_GetPriorityGrouping( void )
+{
+    return 0;
+}
+
+static inline uint32_t
+NVIC_EncodePriority( uint32_t group, uint32_t preempt, uint32_t sub )
+{
+    (void)group;
+    return ( preempt << 4U ) | sub;
+}
+
+static inline void
+NVIC_SetPriority( IRQn_Type irq, uint32_t priority )
+{
+    (void)irq;
+    (void)priority;
+}
+
+static inline void
+NVIC_EnableIRQ( IRQn_Type irq )
+{
+    (void)irq;
+}
+
+static inline void
+NVIC_DisableIRQ( IRQn_Type irq )
+{
+    (void)irq;
+}
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CORE_CM4_H_GENERIC */
@@ -0,0 +1,24 @@
+/*
+ * Host stand-in for the Electric UI library header, which isn't vendored.
+ * Only what the firmware headers name is declared, so drivers that include
+ * configuration.h can be compiled into the host tests.
+ */
+
+#ifndef ELECTRICUI_H
+#define ELECTRICUI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- Defines ------------------------------------------------------------ */
+
+typedef struct eui_interface eui_interface_t;
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ELECTRICUI_H */
@@ -0,0 +1,64 @@
+/*
+ * Stand-ins for the configuration and DWT calls kinematics.c makes, so the
+ * solver can be linked into the host tests without the rest of the firmware.
+ */
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "configuration.h"
+#include "hal_system_speed.h"
+#include "host_kinematics.h"
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE float rotation_z = 0.0f;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+host_kinematics_set_rotation_z( float degrees )
+{
+    rotation_z = degrees;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC float
+config_get_rotation_z( void )
+{
+    return rotation_z;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+config_set_kinematics_mechanism_info( float shoulder_radius, float bicep_len, float forearm_len, float effector_radius )
+{
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+config_set_kinematics_limits( int32_t radius, int32_t zmin, int32_t zmax )
+{
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC void
+config_set_kinematics_flips( int8_t x, int8_t y, int8_t z )
+{
+}
+
+/* -------------------------------------------------------------------------- */
+
+// A counter rather than the clock, so benchmarks time the solve and not the stand-in
+PUBLIC uint32_t
+hal_system_speed_get_cycles( void )
+{
+    static uint32_t cycles = 0;
+
+    return cycles++;
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,25 @@
+#ifndef HOST_KINEMATICS_H
+#define HOST_KINEMATICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/** Set the Z rotation the solver reads back through config_get_rotation_z() */
+
+PUBLIC void
+host_kinematics_set_rotation_z( float degrees );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_KINEMATICS_H */
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for the LL GPIO header. hal_uart.h includes it but names
+ * nothing from it, so drivers that pull in the hal headers through
+ * configuration.h can be built for the host without the device headers.
+ */
+
+#ifndef __STM32F4xx_LL_GPIO_H
+#define __STM32F4xx_LL_GPIO_H
+
+#endif /* __STM32F4xx_LL_GPIO_H */
@@ -0,0 +1,68 @@
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "test_support.h"
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE uint32_t test_failures = 0;
+
+/* ----- Public Functions --------------------------------------------------- */
+
+PUBLIC void
+test_check( bool passed, const char *expression, const char *file, unsigned line )
+{
+    if( !passed )
+    {
+        printf( "FAIL %s:%u %s\n", file, line, expression );
+        test_failures++;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC int
+test_result( void )
+{
+    printf( "%s, %u failed checks\n", ( test_failures ) ? "FAILED" : "PASSED", test_failures );
+    return ( test_failures ) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PUBLIC uint64_t
+test_clock_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// A firmware assertion is a test failure, there's no sensible way to carry on
+void
+onAssert__( const char *file, unsigned line, const char *fmt, ... )
+{
+    printf( "ASSERT %s:%u ", file, line );
+
+    if( fmt )
+    {
+        va_list args;
+        va_start( args, fmt );
+        vprintf( fmt, args );
+        va_end( args );
+    }
+
+    printf( "\n" );
+    abort();
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,49 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "global.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+// Record a check, the test keeps going so every failure gets printed
+#define TEST_CHECK( test_ ) test_check( ( test_ ), #test_, __FILE__, __LINE__ )
+
+/* ----- Public Functions --------------------------------------------------- */
+
+/** Count and print a failed check */
+
+PUBLIC void
+test_check( bool passed, const char *expression, const char *file, unsigned line );
+
+/* -------------------------------------------------------------------------- */
+
+/** Exit code for main, non-zero when any check failed */
+
+PUBLIC int
+test_result( void );
+
+/* -------------------------------------------------------------------------- */
+
+/** Monotonic time in nanoseconds, for the benchmarks */
+
+PUBLIC uint64_t
+test_clock_ns( void );
+
+/* ----- End ---------------------------------------------------------------- */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_SUPPORT_H */
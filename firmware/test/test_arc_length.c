@@ -0,0 +1,211 @@
+/*
+ * Effector speed along curved moves evaluated through the arc length table.
+ *
+ * A move is stepped at even fractions of its length, the way the motion
+ * loop steps the planner's distance, and the spread of the step lengths is
+ * compared against stepping the raw curve parameter. The table's length is
+ * checked against a dense chord sum of the same curve.
+ *
+ * Inside each table segment the parameter is interpolated linearly, so the
+ * step length still saw-tooths between the knots wherever the curve's speed
+ * changes quickly. The worst single step is reported alongside the RMS
+ * spread, but only the RMS is held to a limit.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "motion_types.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define SPEED_STEPS     500U      // motion ticks across a move
+#define REFERENCE_STEPS 2000U     // chords in the reference length, long enough that micron rounding stays out of it
+
+#define SPEED_SPREAD_MAX  0.10    // RMS of the step lengths about their mean, through the table
+#define SPEED_GAIN_MIN    4.0     // RMS spread stepping the parameter over the spread through the table
+#define LENGTH_ERROR_MAX  0.001   // of the reference length
+#define BENCH_LOOKUPS     1000000U
+
+typedef struct
+{
+    const char *name;
+    Movement_t  move;
+} ArcCase_t;
+
+typedef struct
+{
+    double rms;      // fraction of the mean step
+    double worst;    // fraction of the mean step
+} StepSpread_t;
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE StepSpread_t
+step_spread( Movement_t *move, ArcLengthTable_t *table );
+
+PRIVATE double
+reference_length( Movement_t *move );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    ArcCase_t cases[] = {
+        { "cubic, bunched controls",
+          { _BEZIER_CUBIC, _POS_ABSOLUTE, 1, 1000, 4, { { 0, 0, 0 }, { 5000, 2000, 0 }, { 10000, 4000, 0 }, { 90000, -30000, 10000 } } } },
+        { "cubic, s-bend",
+          { _BEZIER_CUBIC, _POS_ABSOLUTE, 2, 1000, 4, { { -40000, 0, 0 }, { 40000, 60000, 0 }, { -40000, -60000, 0 }, { 40000, 0, -5000 } } } },
+        { "quadratic",
+          { _BEZIER_QUADRATIC, _POS_ABSOLUTE, 3, 1000, 3, { { 0, 0, 0 }, { 70000, 0, 0 }, { 75000, 50000, 0 } } } },
+        { "catmull",
+          { _CATMULL_SPLINE, _POS_ABSOLUTE, 4, 1000, 4, { { -60000, -60000, 0 }, { 0, 0, 0 }, { 30000, 5000, 0 }, { 30000, 80000, 0 } } } },
+        { "smoothed line",
+          { _LINE, _POS_ABSOLUTE, 5, 1000, 2, { { 0, 0, 0 }, { 80000, 40000, -20000 } } } },
+    };
+
+    // The smoothed line is a cubic with both controls near the ends, it
+    // crawls at the ends and rushes through the middle when stepped by parameter
+    TEST_CHECK( cartesian_plan_smoothed_line( &cases[4].move, 0.05f, 0.05f ) == SOLUTION_VALID );
+
+    printf( "%-24s %10s %8s %12s %12s %12s\n", "move", "length um", "error", "rms table", "worst table", "rms param" );
+
+    for( uint8_t i = 0; i < DIM( cases ); i++ )
+    {
+        Movement_t *     move = &cases[i].move;
+        ArcLengthTable_t table;
+        ArcLengthTable_t identity;
+
+        cartesian_move_build_arc_table( move, &table );
+
+        bool monotonic = ( table.parameter[0] == 0.0f && table.parameter[ARC_LENGTH_TABLE_SIZE - 1] == 1.0f );
+
+        for( uint8_t j = 1; j < ARC_LENGTH_TABLE_SIZE; j++ )
+        {
+            monotonic = monotonic && ( table.parameter[j] >= table.parameter[j - 1] );
+        }
+        TEST_CHECK( monotonic );
+
+        // The same move stepped straight through its curve parameter
+        identity.length = table.length;
+
+        for( uint8_t j = 0; j < ARC_LENGTH_TABLE_SIZE; j++ )
+        {
+            identity.parameter[j] = (float)j / ( ARC_LENGTH_TABLE_SIZE - 1 );
+        }
+
+        double       reference = reference_length( move );
+        double       error     = fabs( table.length - reference ) / reference;
+        StepSpread_t spread    = step_spread( move, &table );
+        StepSpread_t raw       = step_spread( move, &identity );
+
+        printf( "%-24s %10.0f %7.3f%% %11.1f%% %11.1f%% %11.1f%%\n",
+                cases[i].name,
+                reference,
+                error * 100.0,
+                spread.rms * 100.0,
+                spread.worst * 100.0,
+                raw.rms * 100.0 );
+
+        TEST_CHECK( error < LENGTH_ERROR_MAX );
+        TEST_CHECK( spread.rms < SPEED_SPREAD_MAX );
+        TEST_CHECK( spread.rms * SPEED_GAIN_MIN < raw.rms );
+    }
+
+    // The lookup runs every motion tick
+    ArcLengthTable_t table;
+    volatile float   sink  = 0.0f;
+    uint64_t         start = test_clock_ns();
+
+    cartesian_move_build_arc_table( &cases[0].move, &table );
+
+    for( uint32_t i = 0; i < BENCH_LOOKUPS; i++ )
+    {
+        sink = cartesian_arc_table_lookup( &table, (float)i / BENCH_LOOKUPS );
+    }
+
+    printf( "lookup %.1f ns\n", (double)( test_clock_ns() - start ) / BENCH_LOOKUPS );
+    (void)sink;
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// Deviation of the step lengths from their mean, stepping evenly through the table
+PRIVATE StepSpread_t
+step_spread( Movement_t *move, ArcLengthTable_t *table )
+{
+    double           steps[SPEED_STEPS];
+    double           total  = 0.0;
+    double           square = 0.0;
+    StepSpread_t     spread = { 0.0, 0.0 };
+    CartesianPoint_t previous;
+    CartesianPoint_t point;
+
+    cartesian_point_on_move( move, 0.0f, &previous );
+
+    for( uint32_t i = 1; i <= SPEED_STEPS; i++ )
+    {
+        float parameter = cartesian_arc_table_lookup( table, (float)i / SPEED_STEPS );
+
+        cartesian_point_on_move( move, parameter, &point );
+
+        double dx = point.x - previous.x;
+        double dy = point.y - previous.y;
+        double dz = point.z - previous.z;
+
+        steps[i - 1] = sqrt( dx * dx + dy * dy + dz * dz );
+        total += steps[i - 1];
+        previous = point;
+    }
+
+    double mean = total / SPEED_STEPS;
+
+    for( uint32_t i = 0; i < SPEED_STEPS; i++ )
+    {
+        double deviation = ( steps[i] - mean ) / mean;
+
+        square += deviation * deviation;
+        spread.worst = fmax( spread.worst, fabs( deviation ) );
+    }
+
+    spread.rms = sqrt( square / SPEED_STEPS );
+
+    return spread;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE double
+reference_length( Movement_t *move )
+{
+    CartesianPoint_t previous;
+    CartesianPoint_t point;
+    double           length = 0.0;
+
+    cartesian_point_on_move( move, 0.0f, &previous );
+
+    for( uint32_t i = 1; i <= REFERENCE_STEPS; i++ )
+    {
+        cartesian_point_on_move( move, (float)i / REFERENCE_STEPS, &point );
+
+        double dx = point.x - previous.x;
+        double dy = point.y - previous.y;
+        double dz = point.z - previous.z;
+
+        length += sqrt( dx * dx + dy * dy + dz * dz );
+        previous = point;
+    }
+
+    return length;
+}
+
+/* ----- End ---------------------------------------------------------------- */
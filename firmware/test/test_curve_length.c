@@ -0,0 +1,234 @@
+/*
+ * Curve length and peak curvature from cartesian_move_analyse(), against
+ * references worked out in double precision from the curves' control points.
+ *
+ * Catmull segments are converted to the equivalent cubic bezier, so every
+ * curve is checked through the same bezier derivative. The reference length
+ * integrates the speed densely, and the reference curvature is the maximum of
+ * |B' x B''| / |B'|^3 over a dense sweep of the parameter. The hook and the
+ * dropping catmull put their tightest turn between the quadrature nodes.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "motion_types.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define REFERENCE_STEPS 100000U
+
+#define LENGTH_ERROR_MAX_UM    2.0     // the analysis rounds to the micron and stops within 1um
+#define CURVATURE_OVERSHOOT    1.001   // samples sit on the curve, so can't exceed the true peak
+#define CURVATURE_COVERAGE_MIN 0.99    // of the true peak, found by the search
+#define BENCH_ITERATIONS       100000U
+
+typedef struct
+{
+    const char *name;
+    Movement_t  move;
+} CurveCase_t;
+
+typedef struct
+{
+    double x;
+    double y;
+    double z;
+} Vector_t;
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+reference_controls( Movement_t *move, Vector_t controls[4] );
+
+PRIVATE void
+reference_analyse( Movement_t *move, double *length, double *curvature );
+
+PRIVATE double
+bench_ns( Movement_t *move, bool quadrature );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    CurveCase_t cases[] = {
+        { "cubic, bunched controls",
+          { _BEZIER_CUBIC, _POS_ABSOLUTE, 1, 1000, 4, { { 0, 0, 0 }, { 5000, 2000, 0 }, { 10000, 4000, 0 }, { 90000, -30000, 10000 } } } },
+        { "cubic, s-bend",
+          { _BEZIER_CUBIC, _POS_ABSOLUTE, 2, 1000, 4, { { -40000, 0, 0 }, { 40000, 60000, 0 }, { -40000, -60000, 0 }, { 40000, 0, -5000 } } } },
+        { "cubic, tight hook",
+          { _BEZIER_CUBIC, _POS_ABSOLUTE, 3, 1000, 4, { { 0, 0, 0 }, { 60000, 0, 0 }, { 60000, 2000, 0 }, { 0, 2000, 0 } } } },
+        { "quadratic",
+          { _BEZIER_QUADRATIC, _POS_ABSOLUTE, 4, 1000, 3, { { 0, 0, 0 }, { 70000, 0, 0 }, { 75000, 50000, 0 } } } },
+        { "quadratic, shallow",
+          { _BEZIER_QUADRATIC, _POS_ABSOLUTE, 5, 1000, 3, { { 0, 0, 0 }, { 20000, 500, 0 }, { 40000, 0, 0 } } } },
+        { "catmull",
+          { _CATMULL_SPLINE, _POS_ABSOLUTE, 6, 1000, 4, { { -60000, -60000, 0 }, { 0, 0, 0 }, { 30000, 5000, 0 }, { 30000, 80000, 0 } } } },
+        { "catmull, with drop",
+          { _CATMULL_SPLINE, _POS_ABSOLUTE, 7, 1000, 4, { { 0, 0, 0 }, { 10000, 0, 0 }, { 20000, 0, -30000 }, { 30000, 0, -30000 } } } },
+    };
+
+    printf( "%-24s %10s %9s %12s %12s %9s %12s\n", "move", "length um", "error um", "k mm^-1", "reference", "coverage", "analyse ns" );
+
+    for( uint8_t i = 0; i < DIM( cases ); i++ )
+    {
+        Movement_t *       move     = &cases[i].move;
+        MovementAnalysis_t analysis = { 0 };
+        double             length;
+        double             curvature;
+
+        cartesian_move_analyse( move, &analysis );
+        reference_analyse( move, &length, &curvature );
+
+        double error    = fabs( analysis.length - length );
+        double coverage = analysis.curvature_peak / curvature;
+
+        printf( "%-24s %10.0f %9.2f %12.5f %12.5f %8.1f%% %12.1f\n",
+                cases[i].name,
+                length,
+                error,
+                analysis.curvature_peak,
+                curvature,
+                coverage * 100.0,
+                bench_ns( move, true ) );
+
+        TEST_CHECK( error < LENGTH_ERROR_MAX_UM );
+        TEST_CHECK( coverage < CURVATURE_OVERSHOOT );
+        TEST_CHECK( coverage > CURVATURE_COVERAGE_MIN );
+        TEST_CHECK( cartesian_move_distance( move ) == analysis.length );
+    }
+
+    // For scale, sampling the curve 64 times for the arc length table
+    printf( "arc table build %.1f ns\n", bench_ns( &cases[0].move, false ) );
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// The move as cubic bezier control points, in microns
+PRIVATE void
+reference_controls( Movement_t *move, Vector_t controls[4] )
+{
+    Vector_t p[4];
+
+    for( uint8_t i = 0; i < 4; i++ )
+    {
+        p[i] = (Vector_t){ move->points[i].x, move->points[i].y, move->points[i].z };
+    }
+
+    switch( move->type )
+    {
+        case _BEZIER_QUADRATIC:
+            // degree elevation
+            controls[0] = p[0];
+            controls[1] = (Vector_t){ p[0].x + 2.0 * ( p[1].x - p[0].x ) / 3.0,
+                                      p[0].y + 2.0 * ( p[1].y - p[0].y ) / 3.0,
+                                      p[0].z + 2.0 * ( p[1].z - p[0].z ) / 3.0 };
+            controls[2] = (Vector_t){ p[2].x + 2.0 * ( p[1].x - p[2].x ) / 3.0,
+                                      p[2].y + 2.0 * ( p[1].y - p[2].y ) / 3.0,
+                                      p[2].z + 2.0 * ( p[1].z - p[2].z ) / 3.0 };
+            controls[3] = p[2];
+            break;
+
+        case _CATMULL_SPLINE:
+            // the segment between p1 and p2, tangents from the neighbouring points
+            controls[0] = p[1];
+            controls[1] = (Vector_t){ p[1].x + ( p[2].x - p[0].x ) / 6.0,
+                                      p[1].y + ( p[2].y - p[0].y ) / 6.0,
+                                      p[1].z + ( p[2].z - p[0].z ) / 6.0 };
+            controls[2] = (Vector_t){ p[2].x - ( p[3].x - p[1].x ) / 6.0,
+                                      p[2].y - ( p[3].y - p[1].y ) / 6.0,
+                                      p[2].z - ( p[3].z - p[1].z ) / 6.0 };
+            controls[3] = p[2];
+            break;
+
+        case _BEZIER_CUBIC:
+        default:
+            memcpy( controls, p, sizeof( p ) );
+            break;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Midpoint rule on the speed for the length, and the largest curvature seen, in 1/mm
+PRIVATE void
+reference_analyse( Movement_t *move, double *length, double *curvature )
+{
+    Vector_t c[4];
+
+    reference_controls( move, c );
+
+    // B'(t) = a t^2 + b t + d, B''(t) = 2 a t + b
+    Vector_t a = { 3.0 * ( -c[0].x + 3.0 * c[1].x - 3.0 * c[2].x + c[3].x ),
+                   3.0 * ( -c[0].y + 3.0 * c[1].y - 3.0 * c[2].y + c[3].y ),
+                   3.0 * ( -c[0].z + 3.0 * c[1].z - 3.0 * c[2].z + c[3].z ) };
+    Vector_t b = { 6.0 * ( c[0].x - 2.0 * c[1].x + c[2].x ),
+                   6.0 * ( c[0].y - 2.0 * c[1].y + c[2].y ),
+                   6.0 * ( c[0].z - 2.0 * c[1].z + c[2].z ) };
+    Vector_t d = { 3.0 * ( c[1].x - c[0].x ), 3.0 * ( c[1].y - c[0].y ), 3.0 * ( c[1].z - c[0].z ) };
+
+    *length    = 0.0;
+    *curvature = 0.0;
+
+    for( uint32_t i = 0; i < REFERENCE_STEPS; i++ )
+    {
+        double t = ( i + 0.5 ) / REFERENCE_STEPS;
+
+        Vector_t v = { ( a.x * t + b.x ) * t + d.x, ( a.y * t + b.y ) * t + d.y, ( a.z * t + b.z ) * t + d.z };
+        Vector_t w = { 2.0 * a.x * t + b.x, 2.0 * a.y * t + b.y, 2.0 * a.z * t + b.z };
+
+        double speed   = sqrt( v.x * v.x + v.y * v.y + v.z * v.z );
+        double cross_x = v.y * w.z - v.z * w.y;
+        double cross_y = v.z * w.x - v.x * w.z;
+        double cross_z = v.x * w.y - v.y * w.x;
+
+        *length += speed / REFERENCE_STEPS;
+
+        if( speed > 0.0 )
+        {
+            double k = sqrt( cross_x * cross_x + cross_y * cross_y + cross_z * cross_z ) / ( speed * speed * speed );
+
+            *curvature = fmax( *curvature, k * 1000.0 );
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE double
+bench_ns( Movement_t *move, bool quadrature )
+{
+    MovementAnalysis_t analysis = { 0 };
+    ArcLengthTable_t   table;
+    volatile int32_t   sink  = 0;
+    uint64_t           start = test_clock_ns();
+
+    for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+    {
+        if( quadrature )
+        {
+            cartesian_move_analyse( move, &analysis );
+            sink = analysis.length;
+        }
+        else
+        {
+            cartesian_move_build_arc_table( move, &table );
+            sink = (int32_t)table.length;
+        }
+    }
+
+    (void)sink;
+
+    return (double)( test_clock_ns() - start ) / BENCH_ITERATIONS;
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,331 @@
+/*
+ * Lock-free event ring and pool free list under contention.
+ *
+ * Threads stand in for interrupts at different priorities, but run truly in
+ * parallel, which is harsher than preemption on the target.
+ *
+ * - Several producers post numbered static events into one small ring while
+ *   the main thread drains it. Every event has to arrive once, in order for
+ *   its producer, with full rings counted rather than lost.
+ * - Several threads allocate and free pool events, stamping each one while
+ *   they hold it. A block handed to two threads at once shows up as a
+ *   clobbered stamp, and every block has to be back on the free list after.
+ * - Producers allocate pool events and post them through the ring, and the
+ *   consumer garbage collects them, so the reference counts cross threads.
+ *
+ * The host emulates the store-conditional with a compare and swap, which
+ * loses the ABA protection of the exclusive monitor. With three or more
+ * threads on the free list a pop can in principle still hand out a block
+ * another thread holds. The window is a few instructions wide, so a shared
+ * block reported here on the host needs checking against that before the
+ * pool code is blamed.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "event_pool.h"
+#include "event_ring.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define PRODUCERS      4U
+#define RING_ENTRIES   16U
+#define RING_EVENTS    1000000U    // per producer
+#define POOL_THREADS   4U
+#define POOL_CYCLES    1000000U    // per thread
+#define POOL_EVENTS    64U
+#define POSTERS        2U
+#define POSTED_EVENTS  500000U     // per poster, through the pool and the ring
+
+typedef struct
+{
+    StateEvent super;
+    uint32_t   owner;
+    uint32_t   sequence;
+} StressEvent_t;
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t clobbered;
+    uint32_t exhausted;
+} PoolWorker_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE EventRing              ring;
+PRIVATE StateEvent * volatile  ring_storage[RING_ENTRIES];
+PRIVATE StressEvent_t          ring_events[PRODUCERS][RING_EVENTS];
+
+PRIVATE EventPool     pools[1];
+PRIVATE StressEvent_t pool_storage[POOL_EVENTS];
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void *
+ring_producer( void *arg );
+
+PRIVATE void *
+pool_worker( void *arg );
+
+PRIVATE void *
+pool_producer( void *arg );
+
+PRIVATE void
+post( StateEvent *e );
+
+PRIVATE uint32_t
+drain( uint32_t expected, uint32_t per_producer, uint32_t producers, bool pooled );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    pthread_t threads[PRODUCERS > POOL_THREADS ? PRODUCERS : POOL_THREADS];
+
+    // Static events from several producers through one ring
+    eventRingInit( &ring, ring_storage, RING_ENTRIES );
+
+    uint64_t start = test_clock_ns();
+
+    for( uintptr_t i = 0; i < PRODUCERS; i++ )
+    {
+        pthread_create( &threads[i], NULL, ring_producer, (void *)i );
+    }
+
+    uint32_t misordered = drain( PRODUCERS * RING_EVENTS, RING_EVENTS, PRODUCERS, false );
+
+    for( uint32_t i = 0; i < PRODUCERS; i++ )
+    {
+        pthread_join( threads[i], NULL );
+    }
+
+    double per_event = (double)( test_clock_ns() - start ) / ( PRODUCERS * RING_EVENTS );
+
+    printf( "ring: %u events from %u producers, %u out of order, %.1f ns each\n",
+            PRODUCERS * RING_EVENTS,
+            PRODUCERS,
+            misordered,
+            per_event );
+    printf( "ring: deepest %u of %u, %u puts refused as full\n", ring.max, RING_ENTRIES - 1, ring.dropped );
+
+    TEST_CHECK( misordered == 0 );
+    TEST_CHECK( eventRingUsed( &ring ) == 0 );
+    TEST_CHECK( eventRingGet( &ring ) == NULL );
+    TEST_CHECK( ring.max <= RING_ENTRIES - 1 );
+
+    // Allocate and free from several threads at once
+    PoolWorker_t workers[POOL_THREADS];
+
+    eventPoolInit( pools, DIM( pools ) );
+    eventPoolAddStorage( (StateEvent *)pool_storage, POOL_EVENTS, sizeof( StressEvent_t ) );
+
+    start = test_clock_ns();
+
+    for( uint32_t i = 0; i < POOL_THREADS; i++ )
+    {
+        workers[i] = (PoolWorker_t){ .id = i };
+        pthread_create( &threads[i], NULL, pool_worker, &workers[i] );
+    }
+
+    uint32_t clobbered = 0;
+    uint32_t exhausted = 0;
+
+    for( uint32_t i = 0; i < POOL_THREADS; i++ )
+    {
+        pthread_join( threads[i], NULL );
+        clobbered += workers[i].clobbered;
+        exhausted += workers[i].exhausted;
+    }
+
+    per_event = (double)( test_clock_ns() - start ) / ( POOL_THREADS * POOL_CYCLES );
+
+    EventPoolStatistics stats;
+
+    TEST_CHECK( eventPoolGetStatistics( 1, &stats ) );
+
+    printf( "pool: %u allocations from %u threads, %u shared blocks, %.1f ns each\n",
+            POOL_THREADS * POOL_CYCLES,
+            POOL_THREADS,
+            clobbered,
+            per_event );
+    printf( "pool: %u of %u free after, fewest free %u\n", stats.freeEvents, stats.totalEvents, stats.minimumEvents );
+
+    TEST_CHECK( clobbered == 0 );
+    TEST_CHECK( exhausted == 0 );
+    TEST_CHECK( stats.freeEvents == POOL_EVENTS );
+    TEST_CHECK( stats.minimumEvents >= POOL_EVENTS - POOL_THREADS );
+    TEST_CHECK( stats.failedEvents == 0 );
+
+    // Pool events posted through the ring and collected by the consumer
+    eventRingInit( &ring, ring_storage, RING_ENTRIES );
+
+    for( uintptr_t i = 0; i < POSTERS; i++ )
+    {
+        pthread_create( &threads[i], NULL, pool_producer, (void *)i );
+    }
+
+    misordered = drain( POSTERS * POSTED_EVENTS, POSTED_EVENTS, POSTERS, true );
+
+    for( uint32_t i = 0; i < POSTERS; i++ )
+    {
+        pthread_join( threads[i], NULL );
+    }
+
+    TEST_CHECK( eventPoolGetStatistics( 1, &stats ) );
+
+    printf( "pool through ring: %u events, %u out of order, %u of %u free after, fewest free %u\n",
+            POSTERS * POSTED_EVENTS,
+            misordered,
+            stats.freeEvents,
+            stats.totalEvents,
+            stats.minimumEvents );
+
+    TEST_CHECK( misordered == 0 );
+    TEST_CHECK( stats.freeEvents == POOL_EVENTS );
+    TEST_CHECK( stats.failedEvents == 0 );
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void *
+ring_producer( void *arg )
+{
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+
+    for( uint32_t i = 0; i < RING_EVENTS; i++ )
+    {
+        StressEvent_t *e = &ring_events[id][i];
+
+        e->owner    = id;
+        e->sequence = i;
+        post( &e->super );
+    }
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Hold one block at a time, and check nobody else wrote to it meanwhile
+PRIVATE void *
+pool_worker( void *arg )
+{
+    PoolWorker_t *worker = arg;
+
+    for( uint32_t i = 0; i < POOL_CYCLES; i++ )
+    {
+        StressEvent_t *e = EVENT_NEW( StressEvent_t, 1 );
+
+        if( !e )
+        {
+            worker->exhausted++;
+            continue;
+        }
+
+        e->owner    = worker->id;
+        e->sequence = i;
+
+        // Taking and dropping a reference frees the block, the same as a
+        // task consuming it
+        eventPoolReference( &e->super, 1 );
+
+        if( e->owner != worker->id || e->sequence != i )
+        {
+            worker->clobbered++;
+        }
+
+        eventPoolGarbageCollect( &e->super );
+    }
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void *
+pool_producer( void *arg )
+{
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+
+    for( uint32_t i = 0; i < POSTED_EVENTS; i++ )
+    {
+        StressEvent_t *e = EVENT_NEW( StressEvent_t, 1 );
+
+        e->owner    = id;
+        e->sequence = i;
+        post( &e->super );
+    }
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Retry until the consumer makes room, so every event can be accounted for.
+// On the target a full ring fails the post back to the caller instead
+PRIVATE void
+post( StateEvent *e )
+{
+    while( !eventRingPut( &ring, e ) )
+    {
+        sched_yield();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Take events until all arrived, counting any that skip ahead of their
+// producer's previous one. Pool events are garbage collected as a task would
+PRIVATE uint32_t
+drain( uint32_t expected, uint32_t per_producer, uint32_t producers, bool pooled )
+{
+    int64_t  last[PRODUCERS];
+    uint32_t misordered = 0;
+
+    for( uint32_t i = 0; i < producers; i++ )
+    {
+        last[i] = -1;
+    }
+
+    for( uint32_t received = 0; received < expected; )
+    {
+        StressEvent_t *e = (StressEvent_t *)eventRingGet( &ring );
+
+        if( !e )
+        {
+            sched_yield();
+            continue;
+        }
+
+        if( e->owner >= producers || e->sequence != last[e->owner] + 1 || e->sequence >= per_producer )
+        {
+            misordered++;
+        }
+        else
+        {
+            last[e->owner] = e->sequence;
+        }
+
+        if( pooled )
+        {
+            eventPoolGarbageCollect( &e->super );
+        }
+
+        received++;
+    }
+
+    return misordered;
+}
+
+/* ----- End ---------------------------------------------------------------- */
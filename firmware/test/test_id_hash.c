@@ -0,0 +1,211 @@
+/*
+ * The message ID hash used to dispatch tracked UI packets.
+ *
+ * The IDs are the tracked handler table from configuration.c, including the
+ * expansion servo. Every one has to come back with its own index, and IDs the
+ * UI sends that aren't tracked, or that only share a prefix, must miss. The
+ * lookup is then timed against the strcmp chain it replaced, over a stream
+ * that is mostly bulk movement packets as during a toolpath upload, and over
+ * one that cycles through every tracked ID.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdio.h>
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "id_hash.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define BENCH_LOOKUPS 10000000U
+#define STREAM_LENGTH 64U    // power of two
+
+/* ----- Private Variables -------------------------------------------------- */
+
+// Same order as tracked_handlers
+PRIVATE const char *tracked_ids[] = {
+    "inmvb", "inmv", "inlt", "tpos", "req_mode", "exp_ang", "hsv", "ledset", "capture", "capt", "capnx",
+};
+
+// Tracked by electricui but dispatched elsewhere, and near misses
+PRIVATE const char *untracked_ids[] = {
+    "estop", "arm", "disarm", "home", "rotZ", "save", "capst", "in", "inm", "inmvbb", "cap", "",
+};
+
+PRIVATE const char *stream[STREAM_LENGTH];
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE int16_t
+strcmp_find( const char *id );
+
+PRIVATE void
+bench( const char *name, IdHash_t *hash );
+
+PRIVATE double
+bench_ns( bool hashed, IdHash_t *hash );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    IdHash_t hash;
+
+    idHashInit( &hash );
+
+    for( uint8_t i = 0; i < DIM( tracked_ids ); i++ )
+    {
+        TEST_CHECK( idHashInsert( &hash, tracked_ids[i], i ) );
+    }
+
+    for( uint8_t i = 0; i < DIM( tracked_ids ); i++ )
+    {
+        TEST_CHECK( idHashFind( &hash, tracked_ids[i] ) == i );
+    }
+
+    for( uint8_t i = 0; i < DIM( untracked_ids ); i++ )
+    {
+        TEST_CHECK( idHashFind( &hash, untracked_ids[i] ) == ID_HASH_NOT_FOUND );
+    }
+
+    // Lookups compare the string content, not the pointer
+    char copy[] = "capnx";
+
+    TEST_CHECK( idHashFind( &hash, copy ) == 10 );
+
+    // Probe chain length for each ID, counting the home slot
+    uint32_t occupied = 0;
+    uint32_t longest  = 0;
+
+    for( uint32_t slot = 0; slot < ID_HASH_SLOTS; slot++ )
+    {
+        occupied += ( hash.id[slot] != 0 );
+    }
+
+    for( uint8_t i = 0; i < DIM( tracked_ids ); i++ )
+    {
+        for( uint32_t slot = 0; slot < ID_HASH_SLOTS; slot++ )
+        {
+            if( hash.id[slot] == tracked_ids[i] )
+            {
+                IdHash_t single;
+                uint32_t home;
+
+                // The home slot is where the ID lands in an otherwise empty hash
+                idHashInit( &single );
+                idHashInsert( &single, tracked_ids[i], i );
+
+                for( home = 0; !single.id[home]; home++ )
+                {
+                }
+
+                uint32_t probes = ( ( slot - home ) & ( ID_HASH_SLOTS - 1 ) ) + 1;
+
+                longest = ( probes > longest ) ? probes : longest;
+            }
+        }
+    }
+
+    printf( "%u of %u slots used, longest probe %u\n", occupied, ID_HASH_SLOTS, longest );
+    TEST_CHECK( occupied == DIM( tracked_ids ) );
+
+    // Fills to half the slots, then refuses
+    IdHash_t full;
+    char     names[ID_HASH_SLOTS][4];
+    uint32_t accepted = 0;
+
+    idHashInit( &full );
+
+    for( uint32_t i = 0; i < ID_HASH_SLOTS; i++ )
+    {
+        snprintf( names[i], sizeof( names[i] ), "%u", i );
+        accepted += idHashInsert( &full, names[i], (uint8_t)i );
+    }
+
+    TEST_CHECK( accepted == ID_HASH_SLOTS / 2 );
+
+    for( uint32_t i = 0; i < ID_HASH_SLOTS; i++ )
+    {
+        TEST_CHECK( idHashFind( &full, names[i] ) == ( ( i < accepted ) ? (int16_t)i : ID_HASH_NOT_FOUND ) );
+    }
+
+    // Seven in eight packets are bulk movement, with the other tracked IDs mixed in
+    for( uint32_t i = 0; i < STREAM_LENGTH; i++ )
+    {
+        stream[i] = ( i % 8 ) ? "inmvb" : tracked_ids[1 + ( i / 8 ) % ( DIM( tracked_ids ) - 1 )];
+    }
+
+    bench( "upload", &hash );
+
+    for( uint32_t i = 0; i < STREAM_LENGTH; i++ )
+    {
+        stream[i] = tracked_ids[i % DIM( tracked_ids )];
+    }
+
+    bench( "every id", &hash );
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// The dispatch this replaced, compare against each ID in table order
+PRIVATE int16_t
+strcmp_find( const char *id )
+{
+    for( uint8_t i = 0; i < DIM( tracked_ids ); i++ )
+    {
+        if( strcmp( tracked_ids[i], id ) == 0 )
+        {
+            return i;
+        }
+    }
+
+    return ID_HASH_NOT_FOUND;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+bench( const char *name, IdHash_t *hash )
+{
+    double hashed  = bench_ns( true, hash );
+    double compare = bench_ns( false, hash );
+
+    printf( "%-8s lookup %.1f ns hashed, %.1f ns strcmp chain\n", name, hashed, compare );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE double
+bench_ns( bool hashed, IdHash_t *hash )
+{
+    // Copies, so neither path can match on the pointer
+    char ids[STREAM_LENGTH][12];
+
+    for( uint32_t i = 0; i < STREAM_LENGTH; i++ )
+    {
+        strcpy( ids[i], stream[i] );
+    }
+
+    volatile int16_t sink  = 0;
+    uint64_t         start = test_clock_ns();
+
+    for( uint32_t i = 0; i < BENCH_LOOKUPS; i++ )
+    {
+        const char *id = ids[i & ( STREAM_LENGTH - 1 )];
+
+        sink = hashed ? idHashFind( hash, id ) : strcmp_find( id );
+    }
+
+    (void)sink;
+
+    return (double)( test_clock_ns() - start ) / BENCH_LOOKUPS;
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,183 @@
+/*
+ * kinematics_solve_batch() against the single point solver, and the FK
+ * against the IK.
+ *
+ * A random path through the workspace, including points outside it that
+ * get clamped, is solved in one batch and point by point, with and without
+ * a Z rotation. The results have to match exactly. Every reachable point on
+ * a 10 mm grid is then solved and fed back through the FK. The FK reports
+ * the mechanism frame, so the point is offset and flipped into it first.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "host_kinematics.h"
+#include "kinematics.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define PATH_POINTS 20000U
+#define PATH_SPAN   MM_TO_MICRONS( 300 )    // either side of the axis, past the 225 mm volume
+
+#define GRID_PITCH_UM MM_TO_MICRONS( 10 )
+#define GRID_RADIUS   MM_TO_MICRONS( 225 )
+#define GRID_Z_MAX    MM_TO_MICRONS( 200 )
+
+#define ROUND_TRIP_ERROR_MAX_UM 1.0    // on any axis, the FK truncates to whole microns
+#define MECHANISM_OFFSET_Z      MM_TO_MICRONS( 190 )
+
+#define BENCH_PASSES 50U
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE CartesianPoint_t path[PATH_POINTS];
+PRIVATE JointAngles_t    batch[PATH_POINTS];
+PRIVATE JointAngles_t    single[PATH_POINTS];
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+check_batch_matches( float rotation );
+
+PRIVATE double
+worst_round_trip( uint32_t *checked );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    kinematics_init();
+    srand( 1 );
+
+    for( uint32_t i = 0; i < PATH_POINTS; i++ )
+    {
+        path[i].x = ( rand() % ( 2 * PATH_SPAN ) ) - PATH_SPAN;
+        path[i].y = ( rand() % ( 2 * PATH_SPAN ) ) - PATH_SPAN;
+        path[i].z = ( rand() % ( 2 * GRID_Z_MAX ) ) - GRID_Z_MAX / 2;
+    }
+
+    check_batch_matches( 0.0f );
+    check_batch_matches( 30.0f );
+
+    // An empty batch solves nothing
+    TEST_CHECK( kinematics_solve_batch( path, batch, 0 ) == 0 );
+
+    uint32_t checked = 0;
+    double   error   = worst_round_trip( &checked );
+
+    printf( "IK to FK round trip over %u points, worst axis %.2f um\n", checked, error );
+    TEST_CHECK( error <= ROUND_TRIP_ERROR_MAX_UM );
+
+    // The batch skips the per-solve timing and looks the rotation up once
+    volatile float sink  = 0.0f;
+    uint64_t       start = test_clock_ns();
+
+    for( uint32_t pass = 0; pass < BENCH_PASSES; pass++ )
+    {
+        kinematics_solve_batch( path, batch, PATH_POINTS );
+        sink = batch[PATH_POINTS - 1].a1;
+    }
+
+    double batched = (double)( test_clock_ns() - start ) / ( BENCH_PASSES * PATH_POINTS );
+
+    start = test_clock_ns();
+
+    for( uint32_t pass = 0; pass < BENCH_PASSES; pass++ )
+    {
+        for( uint32_t i = 0; i < PATH_POINTS; i++ )
+        {
+            kinematics_point_to_angle( path[i], &single[i] );
+        }
+        sink = single[PATH_POINTS - 1].a1;
+    }
+
+    double each = (double)( test_clock_ns() - start ) / ( BENCH_PASSES * PATH_POINTS );
+
+    (void)sink;
+
+    printf( "per point %.1f ns batched, %.1f ns one at a time\n", batched, each );
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+check_batch_matches( float rotation )
+{
+    host_kinematics_set_rotation_z( rotation );
+
+    memset( batch, 0, sizeof( batch ) );
+
+    size_t solved     = kinematics_solve_batch( path, batch, PATH_POINTS );
+    size_t mismatched = 0;
+
+    for( uint32_t i = 0; i < solved; i++ )
+    {
+        TEST_CHECK( kinematics_point_to_angle( path[i], &single[i] ) == SOLUTION_VALID );
+
+        if( memcmp( &batch[i], &single[i], sizeof( JointAngles_t ) ) != 0 )
+        {
+            mismatched++;
+        }
+    }
+
+    printf( "batch with %.0f deg rotation solved %zu of %u, %zu differ from single solves\n",
+            rotation,
+            solved,
+            PATH_POINTS,
+            mismatched );
+
+    // Clamping pulls every point back into the envelope, so the whole path solves
+    TEST_CHECK( solved == PATH_POINTS );
+    TEST_CHECK( mismatched == 0 );
+
+    host_kinematics_set_rotation_z( 0.0f );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE double
+worst_round_trip( uint32_t *checked )
+{
+    double worst = 0.0;
+
+    for( int32_t x = -GRID_RADIUS; x <= GRID_RADIUS; x += GRID_PITCH_UM )
+    {
+        for( int32_t y = -GRID_RADIUS; y <= GRID_RADIUS; y += GRID_PITCH_UM )
+        {
+            for( int32_t z = 0; z <= GRID_Z_MAX; z += GRID_PITCH_UM )
+            {
+                CartesianPoint_t point = { x, y, z };
+                CartesianPoint_t solved;
+                JointAngles_t    angles;
+
+                if( !kinematics_point_reachable( point ) )
+                {
+                    continue;
+                }
+
+                TEST_CHECK( kinematics_point_to_angle( point, &angles ) == SOLUTION_VALID );
+                TEST_CHECK( kinematics_angle_to_point( angles, &solved ) == SOLUTION_VALID );
+
+                worst = fmax( worst, abs( solved.x - point.x ) );
+                worst = fmax( worst, abs( solved.y - point.y ) );
+                worst = fmax( worst, abs( solved.z + ( point.z + MECHANISM_OFFSET_Z ) ) );
+                ( *checked )++;
+            }
+        }
+    }
+
+    return worst;
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,188 @@
+/*
+ * The reachable envelope grid built by kinematics_init().
+ *
+ * Random points across the cylindrical volume are checked with
+ * kinematics_point_reachable(). Any point it accepts has to solve with every
+ * arm inside the servo limits. A point it rejects is counted as lost
+ * workspace when it solves within the limits without being clamped, found by
+ * taking the solved angles back through the FK. The build and the lookup are
+ * timed.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "app_times.h"
+#include "host_kinematics.h"
+#include "kinematics.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define RANDOM_POINTS 200000U
+#define VOLUME_RADIUS MM_TO_MICRONS( 225 )
+#define VOLUME_Z_MAX  MM_TO_MICRONS( 200 )
+
+#define MECHANISM_OFFSET_Z MM_TO_MICRONS( 190 )
+#define UNCLAMPED_UM       2    // FK truncation, plus a micron of slack
+
+#define LOST_FRACTION_MAX 0.01    // of the points that solve, rejected by the grid
+#define BENCH_LOOKUPS     1000000U
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE CartesianPoint_t
+random_point( void );
+
+PRIVATE bool
+within_limits( const JointAngles_t *angles );
+
+PRIVATE bool
+solves_unclamped( CartesianPoint_t point );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    uint64_t start = test_clock_ns();
+
+    kinematics_init();
+
+    double build_ms = (double)( test_clock_ns() - start ) / 1e6;
+
+    srand( 1 );
+
+    uint32_t reachable  = 0;
+    uint32_t violations = 0;
+    uint32_t lost       = 0;
+    uint32_t solvable   = 0;
+
+    for( uint32_t i = 0; i < RANDOM_POINTS; i++ )
+    {
+        CartesianPoint_t point = random_point();
+
+        if( kinematics_point_reachable( point ) )
+        {
+            JointAngles_t angles;
+
+            reachable++;
+            solvable++;
+
+            if( kinematics_point_to_angle( point, &angles ) != SOLUTION_VALID || !within_limits( &angles ) )
+            {
+                violations++;
+            }
+        }
+        else if( solves_unclamped( point ) )
+        {
+            solvable++;
+            lost++;
+        }
+    }
+
+    double lost_fraction = (double)lost / solvable;
+
+    printf( "envelope built in %.2f ms\n", build_ms );
+    printf( "%u of %u points reachable, %u outside the servo limits\n", reachable, RANDOM_POINTS, violations );
+    printf( "%u solvable points rejected, %.1f%% of the solvable volume\n", lost, lost_fraction * 100.0 );
+
+    TEST_CHECK( violations == 0 );
+    TEST_CHECK( lost_fraction < LOST_FRACTION_MAX );
+
+    // Home
+    CartesianPoint_t origin = { 0, 0, 0 };
+
+    TEST_CHECK( kinematics_point_reachable( origin ) );
+
+    // Outside the cylinder, above and below it
+    CartesianPoint_t outside = { VOLUME_RADIUS + 1000, 0, MM_TO_MICRONS( 100 ) };
+    CartesianPoint_t above   = { 0, 0, VOLUME_Z_MAX + 1 };
+    CartesianPoint_t below   = { 0, 0, -1 };
+
+    TEST_CHECK( !kinematics_point_reachable( outside ) );
+    TEST_CHECK( !kinematics_point_reachable( above ) );
+    TEST_CHECK( !kinematics_point_reachable( below ) );
+
+    volatile bool sink = false;
+
+    start = test_clock_ns();
+
+    for( uint32_t i = 0; i < BENCH_LOOKUPS; i++ )
+    {
+        CartesianPoint_t point = { (int32_t)( i % 400000U ) - 200000, (int32_t)( i % 300000U ) - 150000, (int32_t)( i % 200000U ) };
+
+        sink = kinematics_point_reachable( point );
+    }
+
+    (void)sink;
+
+    printf( "reachable lookup %.1f ns\n", (double)( test_clock_ns() - start ) / BENCH_LOOKUPS );
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// Uniform over the cylinder's bounding box, keeping the points inside the cylinder
+PRIVATE CartesianPoint_t
+random_point( void )
+{
+    for( ;; )
+    {
+        CartesianPoint_t point = {
+            .x = ( rand() % ( 2 * VOLUME_RADIUS + 1 ) ) - VOLUME_RADIUS,
+            .y = ( rand() % ( 2 * VOLUME_RADIUS + 1 ) ) - VOLUME_RADIUS,
+            .z = rand() % ( VOLUME_Z_MAX + 1 ),
+        };
+
+        if( (double)point.x * point.x + (double)point.y * point.y <= (double)VOLUME_RADIUS * VOLUME_RADIUS )
+        {
+            return point;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+within_limits( const JointAngles_t *angles )
+{
+    const float low  = -(float)SERVO_MIN_ANGLE;
+    const float high = (float)SERVO_MAX_ANGLE;
+
+    return angles->a1 >= low && angles->a1 <= high
+           && angles->a2 >= low && angles->a2 <= high
+           && angles->a3 >= low && angles->a3 <= high;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// The point solves inside the limits, and the FK puts the effector where it was asked to be
+PRIVATE bool
+solves_unclamped( CartesianPoint_t point )
+{
+    JointAngles_t    angles;
+    CartesianPoint_t solved;
+
+    if( kinematics_point_to_angle( point, &angles ) != SOLUTION_VALID || !within_limits( &angles ) )
+    {
+        return false;
+    }
+
+    if( kinematics_angle_to_point( angles, &solved ) != SOLUTION_VALID )
+    {
+        return false;
+    }
+
+    return abs( solved.x - point.x ) <= UNCLAMPED_UM
+           && abs( solved.y - point.y ) <= UNCLAMPED_UM
+           && abs( solved.z + ( point.z + MECHANISM_OFFSET_Z ) ) <= UNCLAMPED_UM;
+}
+
+/* ----- End ---------------------------------------------------------------- */
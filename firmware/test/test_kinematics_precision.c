@@ -0,0 +1,223 @@
+/*
+ * The single precision IK against the double precision solver it replaced.
+ *
+ * The reference below is the previous kinematics_point_to_angle() carried
+ * over in double, with its atan and yj > y1 branch, and with the Z rotation
+ * done properly. Every reachable point on a 10 mm grid of the workspace is
+ * solved by both, and the time per solve is reported for each.
+ *
+ * The host has a double precision FPU, so the timings only show the cost of
+ * the solve, not the saving on the Cortex-M4F.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <math.h>
+#include <stdio.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "host_kinematics.h"
+#include "kinematics.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define GRID_PITCH_UM MM_TO_MICRONS( 10 )
+#define GRID_RADIUS   MM_TO_MICRONS( 225 )
+#define GRID_Z_MAX    MM_TO_MICRONS( 200 )
+
+#define ANGLE_ERROR_MAX    1e-4    // degrees, against the double precision solver
+#define ROTATION_ERROR_MAX 1e-3    // degrees, the rotated point is stored back in whole microns
+#define ROTATION_TEST      30.0f   // degrees
+
+#define BENCH_PASSES 20U
+
+// Geometry and frame of the previous solver, in microns
+#define REF_F        50000.0
+#define REF_RF       180000.0
+#define REF_RE       340000.0
+#define REF_E        34000.0
+#define REF_OFFSET_Z 190000.0
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE CartesianPoint_t grid[50000];
+PRIVATE size_t           grid_count = 0;
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE bool
+reference_plane( double x0, double y0, double z0, double *theta );
+
+PRIVATE bool
+reference_point_to_angle( CartesianPoint_t input, double degrees, double angles[3] );
+
+PRIVATE double
+worst_error( double degrees );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    kinematics_init();
+
+    // Only the points inside the envelope, so neither solver clamps
+    for( int32_t x = -GRID_RADIUS; x <= GRID_RADIUS; x += GRID_PITCH_UM )
+    {
+        for( int32_t y = -GRID_RADIUS; y <= GRID_RADIUS; y += GRID_PITCH_UM )
+        {
+            for( int32_t z = 0; z <= GRID_Z_MAX; z += GRID_PITCH_UM )
+            {
+                CartesianPoint_t point = { x, y, z };
+
+                if( kinematics_point_reachable( point ) && grid_count < DIM( grid ) )
+                {
+                    grid[grid_count++] = point;
+                }
+            }
+        }
+    }
+
+    TEST_CHECK( grid_count > 10000 );
+
+    double error = worst_error( 0.0 );
+
+    printf( "%zu reachable grid points\n", grid_count );
+    printf( "worst angle difference %.2e deg\n", error );
+    TEST_CHECK( error < ANGLE_ERROR_MAX );
+
+    // The previous rotation skewed the workspace, compare against a true rotation
+    host_kinematics_set_rotation_z( ROTATION_TEST );
+    error = worst_error( ROTATION_TEST );
+    host_kinematics_set_rotation_z( 0.0f );
+
+    printf( "worst angle difference with a %.0f deg rotation %.2e deg\n", ROTATION_TEST, error );
+    TEST_CHECK( error < ROTATION_ERROR_MAX );
+
+    // Time both solvers over the same points
+    KinematicsTiming_t timing;
+    JointAngles_t      angles;
+    double             reference[3];
+    volatile float     sink   = 0.0f;
+    volatile double    sink_d = 0.0;
+
+    kinematics_get_timing( &timing, true );
+
+    uint32_t solves = timing.solves;
+    uint64_t start  = test_clock_ns();
+
+    for( uint32_t pass = 0; pass < BENCH_PASSES; pass++ )
+    {
+        for( size_t i = 0; i < grid_count; i++ )
+        {
+            kinematics_point_to_angle( grid[i], &angles );
+            sink = angles.a1;
+        }
+    }
+
+    double single = (double)( test_clock_ns() - start ) / ( BENCH_PASSES * grid_count );
+
+    start = test_clock_ns();
+
+    for( uint32_t pass = 0; pass < BENCH_PASSES; pass++ )
+    {
+        for( size_t i = 0; i < grid_count; i++ )
+        {
+            reference_point_to_angle( grid[i], 0.0, reference );
+            sink_d = reference[0];
+        }
+    }
+
+    double twice = (double)( test_clock_ns() - start ) / ( BENCH_PASSES * grid_count );
+
+    (void)sink;
+    (void)sink_d;
+
+    printf( "solve %.1f ns single precision, %.1f ns double precision reference\n", single, twice );
+
+    kinematics_get_timing( &timing, true );
+    TEST_CHECK( timing.solves - solves == BENCH_PASSES * grid_count );
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+// Largest difference on any arm across the grid, with the solver's rotation set to match.
+// Points the rotation carries out of the envelope would be clamped, so they're skipped
+PRIVATE double
+worst_error( double degrees )
+{
+    double worst = 0.0;
+
+    for( size_t i = 0; i < grid_count; i++ )
+    {
+        JointAngles_t angles;
+        double        reference[3];
+
+        if( !kinematics_point_reachable( grid[i] ) )
+        {
+            continue;
+        }
+
+        bool solved           = ( kinematics_point_to_angle( grid[i], &angles ) == SOLUTION_VALID );
+        bool reference_solved = reference_point_to_angle( grid[i], degrees, reference );
+
+        TEST_CHECK( solved && reference_solved );
+
+        worst = fmax( worst, fabs( angles.a1 - reference[0] ) );
+        worst = fmax( worst, fabs( angles.a2 - reference[1] ) );
+        worst = fmax( worst, fabs( angles.a3 - reference[2] ) );
+    }
+
+    return worst;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+reference_point_to_angle( CartesianPoint_t input, double degrees, double angles[3] )
+{
+    const double sin120 = sqrt( 3.0 ) / 2.0;
+    const double cos120 = -0.5;
+
+    double radians = degrees * M_PI / 180.0;
+    double x       = input.x * cos( radians ) - input.y * sin( radians );
+    double y       = input.x * sin( radians ) + input.y * cos( radians );
+    double z       = -( input.z + REF_OFFSET_Z );
+
+    return reference_plane( x, y, z, &angles[0] )
+           && reference_plane( x * cos120 + y * sin120, y * cos120 - x * sin120, z, &angles[1] )
+           && reference_plane( x * cos120 - y * sin120, y * cos120 + x * sin120, z, &angles[2] );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE bool
+reference_plane( double x0, double y0, double z0, double *theta )
+{
+    const double tan30 = 1.0 / sqrt( 3.0 );
+
+    double y1 = -0.5 * tan30 * REF_F;
+    y0 -= 0.5 * tan30 * REF_E;
+
+    double a = ( x0 * x0 + y0 * y0 + z0 * z0 + REF_RF * REF_RF - REF_RE * REF_RE - y1 * y1 ) / ( 2.0 * z0 );
+    double b = ( y1 - y0 ) / z0;
+    double d = -( a + b * y1 ) * ( a + b * y1 ) + REF_RF * ( b * b * REF_RF + REF_RF );
+
+    if( d < 0 )
+    {
+        return false;
+    }
+
+    double yj = ( y1 - a * b - sqrt( d ) ) / ( b * b + 1 );
+    double zj = a + b * yj;
+
+    *theta = 180.0 * atan( -zj / ( y1 - yj ) ) / M_PI + ( ( yj > y1 ) ? 180.0 : 0.0 );
+
+    return true;
+}
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,442 @@
+/*
+ * Bulk movement uploads encoded the way the UI encodes them, then validated
+ * and decoded by the firmware.
+ *
+ * encode_delta() follows MovementDeltaEncoder in the UI's codecs.tsx byte for
+ * byte, and encode_fixed() the older fixed record layout. Toolpaths are split
+ * into batches the way the UI fills them, every decoded movement has to match
+ * its source exactly, and damaged batches have to be refused whole.
+ *
+ * The encoded size of each toolpath and the decode time per movement are
+ * reported.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "crc16.h"
+#include "movement_batch.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define TOOLPATH_MOVES   4000U
+#define BENCH_PASSES     200U
+#define VARINT_BYTES_MAX 5U
+
+typedef struct
+{
+    CartesianPoint_t last;
+    uint16_t         identifier;
+} DeltaEncoder_t;
+
+// A toolpath split into upload batches
+typedef struct
+{
+    MovementBatch_t batches[TOOLPATH_MOVES];
+    uint32_t        count;
+    uint32_t        bytes;    // record bytes across all the batches
+} Upload_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE Movement_t toolpath[TOOLPATH_MOVES];
+PRIVATE Upload_t   upload;
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint16_t
+encode_delta( DeltaEncoder_t *encoder, const Movement_t *move, uint8_t *bytes );
+
+PRIVATE uint16_t
+encode_fixed( const Movement_t *move, uint8_t *bytes );
+
+PRIVATE void
+build_upload( MovementBatchFormat_t format );
+
+PRIVATE uint32_t
+check_upload( void );
+
+PRIVATE void
+check_damage( void );
+
+PRIVATE void
+make_chained_lines( void );
+
+PRIVATE void
+make_random_moves( void );
+
+PRIVATE double
+bench_decode_ns( void );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    srand( 1 );
+
+    const struct
+    {
+        const char *name;
+        void ( *make )( void );
+    } toolpaths[] = {
+        { "chained lines", make_chained_lines },
+        { "random moves", make_random_moves },
+    };
+
+    printf( "%-16s %-6s %8s %10s %10s %12s\n", "toolpath", "format", "batches", "bytes", "per move", "decode ns" );
+
+    for( uint8_t i = 0; i < DIM( toolpaths ); i++ )
+    {
+        toolpaths[i].make();
+
+        for( MovementBatchFormat_t format = BATCH_FORMAT_FIXED; format <= BATCH_FORMAT_DELTA; format++ )
+        {
+            build_upload( format );
+
+            uint32_t decoded = check_upload();
+
+            TEST_CHECK( decoded == TOOLPATH_MOVES );
+
+            printf( "%-16s %-6s %8u %10u %10.1f %12.1f\n",
+                    toolpaths[i].name,
+                    ( format == BATCH_FORMAT_DELTA ) ? "delta" : "fixed",
+                    upload.count,
+                    upload.bytes,
+                    (double)upload.bytes / TOOLPATH_MOVES,
+                    bench_decode_ns() );
+        }
+    }
+
+    check_damage();
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE uint16_t
+write_varint( uint8_t *bytes, uint32_t value )
+{
+    uint16_t used = 0;
+
+    while( value >= 0x80U )
+    {
+        bytes[used++] = (uint8_t)( ( value & 0x7FU ) | 0x80U );
+        value >>= 7;
+    }
+
+    bytes[used++] = (uint8_t)value;
+
+    return used;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE uint16_t
+write_zigzag( uint8_t *bytes, int32_t value )
+{
+    return write_varint( bytes, ( (uint32_t)value << 1 ) ^ (uint32_t)( value >> 31 ) );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// MovementDeltaEncoder.record()
+PRIVATE uint16_t
+encode_delta( DeltaEncoder_t *encoder, const Movement_t *move, uint8_t *bytes )
+{
+    const CartesianPoint_t *points = move->points;
+
+    bool chained = ( points[0].x == encoder->last.x && points[0].y == encoder->last.y && points[0].z == encoder->last.z );
+    bool next_id = ( move->identifier == (uint16_t)( encoder->identifier + 1 ) );
+
+    uint16_t used = 0;
+
+    bytes[used++] = (uint8_t)( ( move->type & 0x07U )
+                               | ( ( move->num_pts - 1 ) << 3 )
+                               | ( move->ref << 5 )
+                               | ( chained ? BATCH_DELTA_CHAINED : 0 )
+                               | ( next_id ? BATCH_DELTA_NEXT_ID : 0 ) );
+
+    if( !next_id )
+    {
+        used += write_varint( &bytes[used], move->identifier );
+    }
+
+    used += write_varint( &bytes[used], move->duration );
+
+    for( uint8_t i = chained ? 1 : 0; i < move->num_pts; i++ )
+    {
+        used += write_zigzag( &bytes[used], (int32_t)( (uint32_t)points[i].x - (uint32_t)encoder->last.x ) );
+        used += write_zigzag( &bytes[used], (int32_t)( (uint32_t)points[i].y - (uint32_t)encoder->last.y ) );
+        used += write_zigzag( &bytes[used], (int32_t)( (uint32_t)points[i].z - (uint32_t)encoder->last.z ) );
+
+        encoder->last = points[i];
+    }
+
+    encoder->last       = points[move->num_pts - 1];
+    encoder->identifier = move->identifier;
+
+    return used;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE uint16_t
+encode_fixed( const Movement_t *move, uint8_t *bytes )
+{
+    uint16_t used = 0;
+
+    bytes[used++] = (uint8_t)( move->type | ( move->ref << 4 ) );
+    bytes[used++] = (uint8_t)move->num_pts;
+    bytes[used++] = (uint8_t)( move->identifier & 0xFFU );
+    bytes[used++] = (uint8_t)( move->identifier >> 8 );
+    bytes[used++] = (uint8_t)( move->duration & 0xFFU );
+    bytes[used++] = (uint8_t)( move->duration >> 8 );
+
+    for( uint8_t i = 0; i < move->num_pts; i++ )
+    {
+        int32_t axes[3] = { move->points[i].x, move->points[i].y, move->points[i].z };
+
+        for( uint8_t axis = 0; axis < 3; axis++ )
+        {
+            for( uint8_t shift = 0; shift < 32; shift += 8 )
+            {
+                bytes[used++] = (uint8_t)( (uint32_t)axes[axis] >> shift );
+            }
+        }
+    }
+
+    return used;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Fill each batch until the next record doesn't fit, restarting the encoder per batch
+PRIVATE void
+build_upload( MovementBatchFormat_t format )
+{
+    DeltaEncoder_t encoder = { 0 };
+    uint8_t        record[1 + ( 2 + MOVEMENT_POINTS_COUNT * 3 ) * VARINT_BYTES_MAX];
+
+    memset( &upload, 0, sizeof( upload ) );
+
+    MovementBatch_t *batch = &upload.batches[0];
+
+    for( uint32_t i = 0; i < TOOLPATH_MOVES; i++ )
+    {
+        uint16_t length = ( format == BATCH_FORMAT_DELTA ) ? encode_delta( &encoder, &toolpath[i], record )
+                                                           : encode_fixed( &toolpath[i], record );
+
+        if( batch->length + length > MOVEMENT_BATCH_BYTES || batch->count == MOVEMENT_BATCH_RECORDS_MAX )
+        {
+            batch = &upload.batches[++upload.count];
+
+            // Encode again against a fresh batch
+            memset( &encoder, 0, sizeof( encoder ) );
+            length = ( format == BATCH_FORMAT_DELTA ) ? encode_delta( &encoder, &toolpath[i], record )
+                                                      : encode_fixed( &toolpath[i], record );
+        }
+
+        memcpy( &batch->records[batch->length], record, length );
+        batch->length = (uint16_t)( batch->length + length );
+        batch->count++;
+        upload.bytes += length;
+    }
+
+    upload.count++;
+
+    for( uint32_t i = 0; i < upload.count; i++ )
+    {
+        upload.batches[i].sequence = (uint16_t)i;
+        upload.batches[i].format   = (uint8_t)format;
+        upload.batches[i].crc      = crc16Update( CRC16_INIT, upload.batches[i].records, upload.batches[i].length );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Validate and decode every batch, returns how many movements matched their source
+PRIVATE uint32_t
+check_upload( void )
+{
+    uint32_t matched = 0;
+    uint32_t index   = 0;
+
+    for( uint32_t i = 0; i < upload.count; i++ )
+    {
+        const MovementBatch_t *batch    = &upload.batches[i];
+        uint16_t               received = (uint16_t)( MOVEMENT_BATCH_HEADER_BYTES + batch->length );
+
+        TEST_CHECK( movement_batch_validate( batch, received ) == BATCH_ACCEPTED );
+
+        MovementBatchReader_t reader;
+        Movement_t            movement;
+
+        movement_batch_reader_init( &reader );
+
+        while( movement_batch_read( batch, &reader, &movement ) && index < TOOLPATH_MOVES )
+        {
+            const Movement_t *source = &toolpath[index++];
+
+            bool same = movement.type == source->type
+                        && movement.ref == source->ref
+                        && movement.identifier == source->identifier
+                        && movement.duration == source->duration
+                        && movement.num_pts == source->num_pts
+                        && memcmp( movement.points, source->points, source->num_pts * sizeof( CartesianPoint_t ) ) == 0;
+
+            matched += same;
+        }
+    }
+
+    return matched;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Damaged batches are refused without anything decoding from them
+PRIVATE void
+check_damage( void )
+{
+    MovementBatch_t batch    = upload.batches[0];
+    uint16_t        received = (uint16_t)( MOVEMENT_BATCH_HEADER_BYTES + batch.length );
+
+    TEST_CHECK( movement_batch_validate( &batch, received ) == BATCH_ACCEPTED );
+
+    // Every single bit flip in the records is caught by the CRC
+    uint32_t missed = 0;
+
+    for( uint16_t bit = 0; bit < batch.length * 8U; bit++ )
+    {
+        batch.records[bit / 8] ^= (uint8_t)( 1U << ( bit % 8 ) );
+        missed += ( movement_batch_validate( &batch, received ) != BATCH_CRC_ERROR );
+        batch.records[bit / 8] ^= (uint8_t)( 1U << ( bit % 8 ) );
+    }
+
+    TEST_CHECK( missed == 0 );
+
+    // The link delivered fewer bytes than the header claims
+    TEST_CHECK( movement_batch_validate( &batch, received - 1 ) == BATCH_MALFORMED );
+
+    // A count that disagrees with the records
+    batch.count++;
+    TEST_CHECK( movement_batch_validate( &batch, received ) == BATCH_MALFORMED );
+    batch.count--;
+
+    // A record cut short, with a CRC that matches the shorter length
+    batch.length--;
+    batch.crc = crc16Update( CRC16_INIT, batch.records, batch.length );
+    TEST_CHECK( movement_batch_validate( &batch, received ) == BATCH_MALFORMED );
+
+    // An unknown format
+    batch        = upload.batches[0];
+    batch.format = BATCH_FORMAT_DELTA + 1;
+    TEST_CHECK( movement_batch_validate( &batch, received ) == BATCH_MALFORMED );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Short lines each starting where the last ended, numbered in order, like a traced drawing
+PRIVATE void
+make_chained_lines( void )
+{
+    CartesianPoint_t at = { 0, 0, MM_TO_MICRONS( 50 ) };
+
+    for( uint32_t i = 0; i < TOOLPATH_MOVES; i++ )
+    {
+        Movement_t *move = &toolpath[i];
+
+        memset( move, 0, sizeof( Movement_t ) );
+        move->type       = _LINE;
+        move->ref        = _POS_ABSOLUTE;
+        move->identifier = (uint16_t)( i + 1 );
+        move->duration   = (uint16_t)( 20 + rand() % 80 );
+        move->num_pts    = 2;
+        move->points[0]  = at;
+
+        at.x += ( rand() % 4001 ) - 2000;
+        at.y += ( rand() % 4001 ) - 2000;
+        at.z += ( rand() % 201 ) - 100;
+
+        move->points[1] = at;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Every type and reference, some chained, some with jumps in the identifier,
+// and points anywhere in the int32 range so the deltas wrap
+PRIVATE void
+make_random_moves( void )
+{
+    const uint8_t point_counts[] = { 2, 2, 4, 3, 4 };    // by MotionAdjective_t
+
+    CartesianPoint_t last       = { 0, 0, 0 };
+    uint16_t         identifier = 0;
+
+    for( uint32_t i = 0; i < TOOLPATH_MOVES; i++ )
+    {
+        Movement_t *move = &toolpath[i];
+
+        memset( move, 0, sizeof( Movement_t ) );
+        move->type       = (MotionAdjective_t)( rand() % ( _BEZIER_CUBIC + 1 ) );
+        move->ref        = (MotionReference_t)( rand() % 2 );
+        move->num_pts    = point_counts[move->type];
+        move->duration   = (uint16_t)rand();
+        move->identifier = ( rand() % 4 ) ? (uint16_t)( identifier + 1 ) : (uint16_t)rand();
+
+        for( uint8_t p = 0; p < move->num_pts; p++ )
+        {
+            bool wide = ( rand() % 8 ) == 0;
+
+            move->points[p].x = wide ? (int32_t)( (uint32_t)rand() << 1 ) : ( rand() % 400001 ) - 200000;
+            move->points[p].y = wide ? (int32_t)( (uint32_t)rand() << 1 ) : ( rand() % 400001 ) - 200000;
+            move->points[p].z = wide ? INT32_MIN + rand() % 3 : rand() % 200001;
+        }
+
+        if( rand() % 2 )
+        {
+            move->points[0] = last;
+        }
+
+        last       = move->points[move->num_pts - 1];
+        identifier = move->identifier;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE double
+bench_decode_ns( void )
+{
+    MovementBatchReader_t reader;
+    Movement_t            movement;
+    volatile int32_t      sink  = 0;
+    uint64_t              start = test_clock_ns();
+
+    for( uint32_t pass = 0; pass < BENCH_PASSES; pass++ )
+    {
+        for( uint32_t i = 0; i < upload.count; i++ )
+        {
+            movement_batch_reader_init( &reader );
+
+            while( movement_batch_read( &upload.batches[i], &reader, &movement ) )
+            {
+                sink = movement.points[0].x;
+            }
+        }
+    }
+
+    (void)sink;
+
+    return (double)( test_clock_ns() - start ) / ( (double)BENCH_PASSES * TOOLPATH_MOVES );
+}
+
+/* ----- End ---------------------------------------------------------------- */
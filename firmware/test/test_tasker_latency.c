@@ -0,0 +1,228 @@
+/*
+ * Worst case event latency of a high priority task while a low priority task
+ * is part way through a long dispatch, for each tasker mode.
+ *
+ * The test is built twice. Cooperatively the high task can't run until the
+ * dispatch it was posted during has finished, so its latency follows the
+ * longest dispatch of any other task. The preemptive build stands in for the
+ * NVIC with an activate hook which runs a readied task straight away when it
+ * outranks the task running, like the task interrupts do on the target.
+ *
+ * Times are host nanoseconds, see stateTaskerHostClock().
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "state_task.h"
+#include "state_tasker.h"
+#include "test_support.h"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define TASK_LOW   1    // stands in for the supervisor
+#define TASK_HIGH  3    // stands in for motion
+#define TASK_COUNT 4
+
+#define BENCH_RUNS 200    // dispatches timed for each length
+
+enum
+{
+    BUSY_SIGNAL = STATE_USER_SIGNAL,    // spin for busy_ns, posting to the high task half way
+    PING_SIGNAL,
+};
+
+typedef struct
+{
+    StateTask super;
+} BenchTask;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE BenchTask     low;
+PRIVATE BenchTask     high;
+PRIVATE StateEvent *  low_queue[4];
+PRIVATE StateEvent *  high_queue[4];
+PRIVATE StateTasker_t tasker;
+PRIVATE StateTask *   task_table[TASK_COUNT];
+
+PRIVATE const StateEvent busy_event = { BUSY_SIGNAL, { 0, 0 } };
+PRIVATE const StateEvent ping_event = { PING_SIGNAL, { 0, 0 } };
+
+PRIVATE uint64_t busy_ns = 0;
+
+#if STATE_TASKER_PREEMPTIVE
+PRIVATE uint8_t  running_level = 0;    // task id of the emulated interrupt running, 0 for the main loop
+PRIVATE BitSet_t pending       = 0;
+#endif
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+bench_initial( BenchTask *me, const StateEvent *e );
+
+PRIVATE STATE
+bench_run( BenchTask *me, const StateEvent *e );
+
+PRIVATE void
+bench_task_start( BenchTask *task, StateEvent **queue, uint8_t size, uint8_t id, const char *name );
+
+PRIVATE int
+bench_compare( const void *a, const void *b );
+
+#if STATE_TASKER_PREEMPTIVE
+PRIVATE void
+bench_activate( uint8_t id );
+#endif
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    static const uint64_t lengths_ns[] = { 10000, 100000, 1000000 };
+    uint32_t              latency[BENCH_RUNS];
+
+    stateTaskerInit( &tasker, task_table, TASK_COUNT );
+
+#if STATE_TASKER_PREEMPTIVE
+    stateTaskerSetActivateHook( &tasker, bench_activate );
+    printf( "preemptive tasker\n" );
+#else
+    printf( "cooperative tasker\n" );
+#endif
+
+    bench_task_start( &low, low_queue, DIM( low_queue ), TASK_LOW, "Low" );
+    bench_task_start( &high, high_queue, DIM( high_queue ), TASK_HIGH, "High" );
+
+    printf( "%12s %12s %12s %12s\n", "dispatch ns", "median ns", "p99 ns", "max ns" );
+
+    for( uint8_t i = 0; i < DIM( lengths_ns ); i++ )
+    {
+        busy_ns = lengths_ns[i];
+
+        for( uint32_t run = 0; run < BENCH_RUNS; run++ )
+        {
+            stateTaskerClearStatistics( &tasker );
+            stateTaskPostFIFO( &low.super, &busy_event );
+
+            // The preemptive build has already run both tasks from the hook
+            while( stateTaskerRunEvent( &tasker ) )
+            {
+            }
+
+            latency[run] = high.super.latency_max;
+        }
+
+        qsort( latency, BENCH_RUNS, sizeof( uint32_t ), bench_compare );
+
+        uint32_t median = latency[BENCH_RUNS / 2];
+
+        printf( "%12u %12u %12u %12u\n",
+                (uint32_t)busy_ns,
+                median,
+                latency[BENCH_RUNS * 99 / 100],
+                latency[BENCH_RUNS - 1] );
+
+#if STATE_TASKER_PREEMPTIVE
+        // Runs as soon as it is posted, whatever the low task is doing
+        TEST_CHECK( median < busy_ns / 4 );
+#else
+        // Waits out the rest of the dispatch it was posted in the middle of
+        TEST_CHECK( median >= busy_ns * 2 / 5 );
+#endif
+    }
+
+    return test_result();
+}
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+bench_initial( BenchTask *me, const StateEvent *e __attribute__( ( __unused__ ) ) )
+{
+    STATE_INIT( &bench_run );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE STATE
+bench_run( BenchTask *me __attribute__( ( __unused__ ) ), const StateEvent *e )
+{
+    switch( e->signal )
+    {
+        case BUSY_SIGNAL: {
+            uint64_t start  = test_clock_ns();
+            bool     posted = false;
+
+            for( uint64_t elapsed = 0; elapsed < busy_ns; elapsed = test_clock_ns() - start )
+            {
+                if( !posted && elapsed >= busy_ns / 2 )
+                {
+                    stateTaskPostFIFO( &high.super, &ping_event );
+                    posted = true;
+                }
+            }
+            return 0;
+        }
+
+        case PING_SIGNAL:
+            return 0;
+    }
+    return (STATE)hsmTop;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+bench_task_start( BenchTask *task, StateEvent **queue, uint8_t size, uint8_t id, const char *name )
+{
+    memset( task, 0, sizeof( BenchTask ) );
+    stateTaskCtor( &task->super, (State)&bench_initial );
+    stateTaskCreate( &task->super, queue, size, 0, 0 );
+    stateTaskerAddTask( &tasker, &task->super, id, name );
+    stateTaskerStartTask( &tasker, &task->super );
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE int
+bench_compare( const void *a, const void *b )
+{
+    uint32_t left  = *(const uint32_t *)a;
+    uint32_t right = *(const uint32_t *)b;
+
+    return ( left > right ) - ( left < right );
+}
+
+/* -------------------------------------------------------------------------- */
+
+#if STATE_TASKER_PREEMPTIVE
+
+// Pend the task's interrupt, and take every pending one which outranks the
+// interrupt running, highest first, like the NVIC would
+PRIVATE void
+bench_activate( uint8_t id )
+{
+    pending |= (BitSet_t)1U << id;
+
+    while( pending >> ( running_level + 1U ) )
+    {
+        uint8_t next      = (uint8_t)( 31U - (uint8_t)__builtin_clz( pending ) );
+        uint8_t preempted = running_level;
+
+        pending &= ~( (BitSet_t)1U << next );
+        running_level = next;
+        stateTaskerRunTask( &tasker, task_table[next] );
+        running_level = preempted;
+    }
+}
+
+#endif
+
+/* ----- End ---------------------------------------------------------------- */
@@ -0,0 +1,651 @@
+/*
+ * Enumeration, loopback and framing of the USB CDC driver, run against a
+ * model of the OTG FS core.
+ *
+ * The driver is compiled into this file, with its registers in anonymous
+ * memory mapped at the peripheral addresses. Plain memory can't stand in for
+ * the push/pop data FIFO port, so USB_FIFO is swapped for usb_model_fifo(),
+ * and a thread clears the self-clearing reset bits the driver spins on.
+ *
+ * The test plays the host: it feeds SETUP and OUT packets through the
+ * receive status queue, takes what the driver loaded into the IN endpoints
+ * apart into packets, and raises the interrupts the core would.
+ */
+
+/* ----- System Includes ---------------------------------------------------- */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* ----- Local Includes ----------------------------------------------------- */
+
+#include "test_support.h"
+
+// The driver pushes and pops the data FIFOs through the model
+#define USB_FIFO( _ep_ ) ( *usb_model_fifo( _ep_ ) )
+
+static volatile uint32_t *
+usb_model_fifo( uint8_t ep );
+
+#include "hal_usb_cdc.c"
+
+/* ----- Defines ------------------------------------------------------------ */
+
+#define MODEL_UUID_PAGE       0x1FFF7000UL
+#define MODEL_PERIPHERAL_SIZE 0x80000UL    // APB1, APB2 and AHB1, for RCC
+#define MODEL_OTG_FS_SIZE     0x40000UL
+
+#define MODEL_TX_WORDS  ( ( CDC_TX_TRANSFER_BYTES + 3U ) / 4U )
+#define MODEL_RX_WORDS  ( ( CDC_DATA_PACKET_BYTES + 3U ) / 4U )
+#define MODEL_PACKETS   32768U
+#define LOOPBACK_BYTES  200000U
+#define LOOPBACK_ROUNDS 100000U    // gives up on a stalled loopback
+
+/* ----- Private Types ------------------------------------------------------ */
+
+typedef struct
+{
+    // Words the driver pushed into each IN endpoint fifo
+    uint32_t tx[USB_ENDPOINTS][MODEL_TX_WORDS];
+    uint32_t tx_words[USB_ENDPOINTS];
+
+    // Packet at the top of the receive status queue, being popped
+    uint32_t rx[MODEL_RX_WORDS];
+    uint32_t rx_words;
+    uint32_t rx_read;
+
+    // Sizes of the data IN packets the host has taken, in order
+    uint16_t packets[MODEL_PACKETS];
+    uint32_t packet_count;
+
+    volatile bool running;
+} UsbModel_t;
+
+/* ----- Private Variables -------------------------------------------------- */
+
+PRIVATE UsbModel_t model;
+
+PRIVATE const uint32_t model_uuid[3] = { 0x12345678U, 0x9ABCDEF0U, 0x0F1E2D3CU };
+
+/* ----- Private Functions -------------------------------------------------- */
+
+PRIVATE void
+model_map( uintptr_t base, size_t size );
+
+PRIVATE void *
+model_core_thread( void *arg );
+
+PRIVATE void
+model_interrupt( uint32_t flags );
+
+PRIVATE void
+model_rx_push( uint8_t ep, uint8_t type, const uint8_t *data, uint16_t length );
+
+PRIVATE uint16_t
+model_control_in( uint8_t request_type, uint8_t request, uint16_t value, uint16_t length, uint8_t *data );
+
+PRIVATE void
+model_setup( uint8_t request_type, uint8_t request, uint16_t value, uint16_t length );
+
+PRIVATE bool
+model_out( uint8_t ep, const uint8_t *data, uint16_t length );
+
+PRIVATE int32_t
+model_in( uint8_t ep, uint8_t *data );
+
+PRIVATE uint32_t
+model_collect( uint8_t *data );
+
+PRIVATE void
+test_enumeration( void );
+
+PRIVATE void
+test_zero_length_packets( void );
+
+PRIVATE void
+test_loopback( void );
+
+PRIVATE void
+test_bus_reset( void );
+
+/* ----- Public Functions --------------------------------------------------- */
+
+int
+main( void )
+{
+    pthread_t core;
+
+    model_map( MODEL_UUID_PAGE, 0x1000UL );
+    model_map( PERIPH_BASE, MODEL_PERIPHERAL_SIZE );
+    model_map( USB_OTG_FS_PERIPH_BASE, MODEL_OTG_FS_SIZE );
+    memcpy( HAL_UUID, model_uuid, sizeof( model_uuid ) );
+
+    model.running = true;
+    pthread_create( &core, NULL, model_core_thread, NULL );
+
+    test_enumeration();
+    test_zero_length_packets();
+    test_loopback();
+    test_bus_reset();
+
+    model.running = false;
+    pthread_join( core, NULL );
+
+    return test_result();
+}
+
+/* ----- Host Stubs --------------------------------------------------------- */
+
+PUBLIC void
+hal_gpio_init_alternate( HalGpioPortPin_t gpio_port_pin_nr, uint32_t alternative_function, uint32_t speed,
+                         uint32_t pull )
+{
+    (void)gpio_port_pin_nr;
+    (void)alternative_function;
+    (void)speed;
+    (void)pull;
+}
+
+PUBLIC void
+hal_delay_ms( uint32_t delay_ms )
+{
+    (void)delay_ms;
+}
+
+PUBLIC uint32_t
+hal_profiler_start( void )
+{
+    return 0;
+}
+
+PUBLIC void
+hal_profiler_stop( HalProfilerProbe_t probe, uint32_t start )
+{
+    (void)probe;
+    (void)start;
+}
+
+/* ----- Tests -------------------------------------------------------------- */
+
+PRIVATE void
+test_enumeration( void )
+{
+    uint8_t data[256];
+
+    hal_usb_cdc_init();
+    USB_OTG_FS->GINTSTS = 0;
+
+    TEST_CHECK( !( USB_DEVICE->DCTL & USB_OTG_DCTL_SDIS ) );    // D+ pulled up
+    TEST_CHECK( !hal_usb_cdc_is_configured() );
+
+    model_interrupt( USB_OTG_GINTSTS_USBRST );
+    model_interrupt( USB_OTG_GINTSTS_ENUMDNE );
+    TEST_CHECK( USB_OUTEP( CDC_EP_CONTROL )->DOEPCTL & USB_OTG_DOEPCTL_EPENA );
+
+    // Hosts first ask for 64 bytes of the device descriptor on address 0
+    TEST_CHECK( model_control_in( 0x80, REQUEST_GET_DESCRIPTOR, DESCRIPTOR_DEVICE << 8, 64, data ) == 18 );
+    TEST_CHECK( data[0] == 18 && data[1] == DESCRIPTOR_DEVICE );
+    TEST_CHECK( data[7] == EP0_PACKET_BYTES );
+    TEST_CHECK( data[8] == 0x83 && data[9] == 0x04 );
+
+    TEST_CHECK( model_control_in( 0x00, REQUEST_SET_ADDRESS, 7, 0, data ) == 0 );
+    TEST_CHECK( ( ( USB_DEVICE->DCFG & USB_OTG_DCFG_DAD ) >> USB_OTG_DCFG_DAD_Pos ) == 7 );
+
+    // The configuration header alone, then all of it over two packets
+    TEST_CHECK( model_control_in( 0x80, REQUEST_GET_DESCRIPTOR, DESCRIPTOR_CONFIGURATION << 8, 9, data ) == 9 );
+    uint16_t total = (uint16_t)( data[2] | ( data[3] << 8 ) );
+    TEST_CHECK( total == sizeof( usb_configuration_descriptor ) );
+    TEST_CHECK( model_control_in( 0x80, REQUEST_GET_DESCRIPTOR, DESCRIPTOR_CONFIGURATION << 8, 255, data ) == total );
+
+    // The descriptors chain up to the total, with both bulk endpoints on 64 byte packets
+    uint16_t offset    = 0;
+    uint8_t  bulk_eps  = 0;
+    uint8_t  notify_ep = 0;
+
+    while( offset < total && data[offset] )
+    {
+        if( data[offset + 1] == 0x05 )
+        {
+            uint8_t  address = data[offset + 2];
+            uint16_t size    = (uint16_t)( data[offset + 4] | ( data[offset + 5] << 8 ) );
+
+            if( data[offset + 3] == EP_TYPE_BULK && size == CDC_DATA_PACKET_BYTES
+                && ( address & 0x7FU ) == CDC_EP_DATA )
+            {
+                bulk_eps++;
+            }
+            if( data[offset + 3] == EP_TYPE_INTERRUPT && address == ( 0x80U | CDC_EP_NOTIFY ) )
+            {
+                notify_ep++;
+            }
+        }
+        offset = (uint16_t)( offset + data[offset] );
+    }
+    TEST_CHECK( offset == total );
+    TEST_CHECK( bulk_eps == 2 && notify_ep == 1 );
+
+    TEST_CHECK( model_control_in( 0x80, REQUEST_GET_DESCRIPTOR, DESCRIPTOR_STRING << 8, 255, data ) == 4 );
+    TEST_CHECK( data[2] == 0x09 && data[3] == 0x04 );
+
+    // The serial number is the UUID in hex
+    const char *serial = "123456789ABCDEF00F1E2D3C";
+    uint16_t    length = model_control_in( 0x80, REQUEST_GET_DESCRIPTOR, ( DESCRIPTOR_STRING << 8 ) | STRING_SERIAL, 255, data );
+    bool        same   = ( length == 2 + 2 * strlen( serial ) );
+
+    for( uint16_t i = 0; same && serial[i]; i++ )
+    {
+        same = ( data[2 + 2 * i] == (uint8_t)serial[i] && data[3 + 2 * i] == 0 );
+    }
+    TEST_CHECK( same );
+
+    // No device qualifier on a full speed only device
+    model_setup( 0x80, REQUEST_GET_DESCRIPTOR, 0x06 << 8, 10 );
+    TEST_CHECK( USB_INEP( CDC_EP_CONTROL )->DIEPCTL & USB_OTG_DIEPCTL_STALL );
+    USB_INEP( CDC_EP_CONTROL )->DIEPCTL &= ~USB_OTG_DIEPCTL_STALL;
+    USB_OUTEP( CDC_EP_CONTROL )->DOEPCTL &= ~USB_OTG_DOEPCTL_STALL;
+
+    TEST_CHECK( model_control_in( 0x00, REQUEST_SET_CONFIGURATION, 1, 0, data ) == 0 );
+    TEST_CHECK( hal_usb_cdc_is_configured() );
+    TEST_CHECK( USB_OUTEP( CDC_EP_DATA )->DOEPCTL & USB_OTG_DOEPCTL_EPENA );
+    TEST_CHECK( model_control_in( 0x80, REQUEST_GET_CONFIGURATION, 0, 1, data ) == 1 && data[0] == 1 );
+
+    // Line coding is stored from the data stage and read back unchanged
+    static const uint8_t coding[CDC_LINE_CODING_BYTES] = { 0x80, 0x25, 0x00, 0x00, 0, 0, 8 };
+
+    model_setup( 0x21, CDC_SET_LINE_CODING, 0, CDC_LINE_CODING_BYTES );
+    TEST_CHECK( model_out( CDC_EP_CONTROL, coding, CDC_LINE_CODING_BYTES ) );
+    TEST_CHECK( model_in( CDC_EP_CONTROL, data ) == 0 );    // status stage
+    TEST_CHECK( model_control_in( 0xA1, CDC_GET_LINE_CODING, 0, CDC_LINE_CODING_BYTES, data ) == CDC_LINE_CODING_BYTES );
+    TEST_CHECK( memcmp( data, coding, CDC_LINE_CODING_BYTES ) == 0 );
+
+    TEST_CHECK( model_control_in( 0x21, CDC_SET_CONTROL_LINE_STATE, 0x03, 0, data ) == 0 );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// A write ending on a full packet is closed off with a zero length packet,
+// otherwise the host keeps waiting for the rest of the transfer
+PRIVATE void
+test_zero_length_packets( void )
+{
+    static const struct
+    {
+        uint16_t length;
+        uint8_t  packets;
+        bool     zlp;
+    } cases[] = {
+        { 10, 1, false },
+        { 64, 2, true },
+        { 128, 3, true },
+        { 100, 2, false },
+        { CDC_TX_TRANSFER_BYTES, 5, true },
+        { CDC_TX_TRANSFER_BYTES + 44, 5, false },    // the second transfer is short
+    };
+
+    uint8_t out[CDC_TX_TRANSFER_BYTES * 2];
+    uint8_t in[CDC_TX_TRANSFER_BYTES * 2];
+
+    for( uint16_t i = 0; i < sizeof( out ); i++ )
+    {
+        out[i] = (uint8_t)( i * 7U );
+    }
+
+    for( uint8_t i = 0; i < DIM( cases ); i++ )
+    {
+        model.packet_count = 0;
+
+        TEST_CHECK( hal_usb_cdc_write( out, cases[i].length ) == cases[i].length );
+        TEST_CHECK( model_collect( in ) == cases[i].length );
+        TEST_CHECK( memcmp( in, out, cases[i].length ) == 0 );
+        TEST_CHECK( model.packet_count == cases[i].packets );
+        TEST_CHECK( ( model.packets[model.packet_count - 1] == 0 ) == cases[i].zlp );
+        TEST_CHECK( model.packets[model.packet_count - 1] < CDC_DATA_PACKET_BYTES );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// The host streams packets of every size at the device, which echoes them
+// back, until both rings have wrapped many times over
+PRIVATE void
+test_loopback( void )
+{
+    static uint8_t sent[LOOPBACK_BYTES];
+    static uint8_t received[LOOPBACK_BYTES + CDC_TX_TRANSFER_BYTES];
+
+    uint32_t sent_bytes     = 0;
+    uint32_t received_bytes = 0;
+    uint32_t naks           = 0;
+    uint32_t refused        = 0;
+    uint32_t rounds         = 0;
+    uint32_t seed           = 1;
+
+    for( uint32_t i = 0; i < LOOPBACK_BYTES; i++ )
+    {
+        sent[i] = (uint8_t)( i ^ ( i >> 8 ) );
+    }
+
+    model.packet_count = 0;
+
+    while( received_bytes < LOOPBACK_BYTES && rounds++ < LOOPBACK_ROUNDS )
+    {
+        // A burst of OUT packets, until the device NAKs
+        for( uint8_t burst = 0; burst < 12 && sent_bytes < LOOPBACK_BYTES; burst++ )
+        {
+            seed            = seed * 1103515245U + 12345U;
+            uint16_t length = (uint16_t)MIN( 1U + ( seed >> 16 ) % CDC_DATA_PACKET_BYTES, LOOPBACK_BYTES - sent_bytes );
+
+            if( !model_out( CDC_EP_DATA, &sent[sent_bytes], length ) )
+            {
+                naks++;
+                break;
+            }
+            sent_bytes += length;
+        }
+
+        // The application echoes a little at a time, the tx ring pushes back when full
+        for( uint8_t chunk = 0; chunk < 4; chunk++ )
+        {
+            const uint8_t *data;
+            uint32_t       length = MIN( hal_usb_cdc_rx_peek_linear( &data ), 100U );
+
+            if( !length )
+            {
+                break;
+            }
+
+            if( !hal_usb_cdc_write( data, length ) )
+            {
+                refused++;
+                break;
+            }
+            hal_usb_cdc_rx_consume( length );
+        }
+
+        // The host only polls the IN endpoint every few rounds
+        if( rounds % 4 == 0 )
+        {
+            received_bytes += model_collect( &received[received_bytes] );
+        }
+    }
+
+    printf( "loopback %u bytes, %u packets in, %u OUT NAKs, %u writes refused\n",
+            received_bytes,
+            model.packet_count,
+            naks,
+            refused );
+
+    TEST_CHECK( received_bytes == LOOPBACK_BYTES );
+    TEST_CHECK( memcmp( received, sent, LOOPBACK_BYTES ) == 0 );
+    TEST_CHECK( naks > 0 );       // the rx ring filled, the endpoint was paused
+    TEST_CHECK( refused > 0 );    // and the tx ring
+    TEST_CHECK( !hal_usb.rx_paused );
+    TEST_CHECK( model.packets[model.packet_count - 1] < CDC_DATA_PACKET_BYTES );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// A bus reset drops whatever was queued for the old session, even when it
+// wraps around the end of the ring
+PRIVATE void
+test_bus_reset( void )
+{
+    static const uint8_t data[32] = { 1, 2, 3 };
+    uint8_t              in[USB_CDC_TX_BUFFER_BYTES];
+
+    while( hal_usb.tx_fifo.tail < USB_CDC_TX_BUFFER_BYTES / 2 )
+    {
+        hal_usb_cdc_write( data, sizeof( data ) );
+        model_collect( in );
+    }
+
+    // The host doesn't collect the first transfer
+    TEST_CHECK( hal_usb_cdc_write( data, sizeof( data ) ) == sizeof( data ) );
+
+    while( fifo_used_linear( &hal_usb.tx_fifo ) == fifo_used( &hal_usb.tx_fifo ) )
+    {
+        TEST_CHECK( hal_usb_cdc_write( data, sizeof( data ) ) == sizeof( data ) );
+    }
+
+    model_interrupt( USB_OTG_GINTSTS_USBRST );
+    USB_INEP( CDC_EP_DATA )->DIEPCTL &= ~USB_OTG_DIEPCTL_EPENA;    // flushed by the core
+    model.tx_words[CDC_EP_DATA] = 0;
+
+    TEST_CHECK( !hal_usb_cdc_is_configured() );
+    TEST_CHECK( hal_usb_cdc_write( data, sizeof( data ) ) == 0 );
+    TEST_CHECK( fifo_used( &hal_usb.tx_fifo ) == 0 );
+
+    model_interrupt( USB_OTG_GINTSTS_ENUMDNE );
+    TEST_CHECK( model_control_in( 0x00, REQUEST_SET_CONFIGURATION, 1, 0, in ) == 0 );
+    TEST_CHECK( hal_usb_cdc_write( data, sizeof( data ) ) == sizeof( data ) );
+    TEST_CHECK( model_collect( in ) == sizeof( data ) );
+}
+
+/* ----- Core Model --------------------------------------------------------- */
+
+PRIVATE void
+model_map( uintptr_t base, size_t size )
+{
+    void *memory = mmap( (void *)base, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+
+    if( memory != (void *)base )
+    {
+        printf( "can't map the registers at 0x%08lx\n", (unsigned long)base );
+        exit( EXIT_FAILURE );
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// The core clears the reset and flush bits when it's done, and is always idle
+PRIVATE void *
+model_core_thread( void *arg __attribute__( ( __unused__ ) ) )
+{
+    const uint32_t self_clearing = USB_OTG_GRSTCTL_CSRST | USB_OTG_GRSTCTL_TXFFLSH | USB_OTG_GRSTCTL_RXFFLSH;
+
+    while( model.running )
+    {
+        uint32_t reset = USB_OTG_FS->GRSTCTL;
+
+        if( ( reset & self_clearing ) || !( reset & USB_OTG_GRSTCTL_AHBIDL ) )
+        {
+            USB_OTG_FS->GRSTCTL = ( reset & ~self_clearing ) | USB_OTG_GRSTCTL_AHBIDL;
+        }
+
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Each access through the port pops the next word of the packet being read,
+// or pushes one into the endpoint's transmit fifo
+static volatile uint32_t *
+usb_model_fifo( uint8_t ep )
+{
+    if( model.rx_read < model.rx_words )
+    {
+        volatile uint32_t *word = &model.rx[model.rx_read++];
+
+        if( model.rx_read == model.rx_words )
+        {
+            USB_OTG_FS->GINTSTS &= ~USB_OTG_GINTSTS_RXFLVL;
+        }
+
+        return word;
+    }
+
+    if( ep >= USB_ENDPOINTS || model.tx_words[ep] >= MODEL_TX_WORDS )
+    {
+        printf( "push past the end of the ep%u fifo\n", ep );
+        abort();
+    }
+
+    return &model.tx[ep][model.tx_words[ep]++];
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Raise core interrupts and take them, the flags don't outlive the handler
+PRIVATE void
+model_interrupt( uint32_t flags )
+{
+    USB_OTG_FS->GINTSTS |= flags;
+    OTG_FS_IRQHandler();
+
+    USB_OTG_FS->GINTSTS = 0;
+    USB_DEVICE->DAINT   = 0;
+
+    for( uint8_t ep = 0; ep < USB_ENDPOINTS; ep++ )
+    {
+        USB_INEP( ep )->DIEPINT  = 0;
+        USB_OUTEP( ep )->DOEPINT = 0;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+model_rx_push( uint8_t ep, uint8_t type, const uint8_t *data, uint16_t length )
+{
+    memset( model.rx, 0, sizeof( model.rx ) );
+    memcpy( model.rx, data, length );
+    model.rx_words = ( length + 3U ) / 4U;
+    model.rx_read  = 0;
+
+    USB_OTG_FS->GRXSTSP = ep
+                          | ( (uint32_t)length << USB_OTG_GRXSTSP_BCNT_Pos )
+                          | ( (uint32_t)type << USB_OTG_GRXSTSP_PKTSTS_Pos );
+    USB_OTG_FS->GINTSTS |= USB_OTG_GINTSTS_RXFLVL;
+}
+
+/* -------------------------------------------------------------------------- */
+
+PRIVATE void
+model_setup( uint8_t request_type, uint8_t request, uint16_t value, uint16_t length )
+{
+    const uint8_t setup[8] = {
+        request_type, request, (uint8_t)value, (uint8_t)( value >> 8 ), 0, 0, (uint8_t)length, (uint8_t)( length >> 8 ),
+    };
+
+    model_rx_push( CDC_EP_CONTROL, PKTSTS_SETUP_DATA, setup, sizeof( setup ) );
+
+    USB_OUTEP( CDC_EP_CONTROL )->DOEPINT = USB_OTG_DOEPINT_STUP;
+    USB_DEVICE->DAINT                    = 1U << ( 16U + CDC_EP_CONTROL );
+    model_interrupt( USB_OTG_GINTSTS_OEPINT );
+}
+
+/* -------------------------------------------------------------------------- */
+
+// A control transfer with an IN data or status stage. The data stage ends on
+// a short packet or once the host has what it asked for.
+PRIVATE uint16_t
+model_control_in( uint8_t request_type, uint8_t request, uint16_t value, uint16_t length, uint8_t *data )
+{
+    uint16_t total = 0;
+    int32_t  packet;
+
+    model_setup( request_type, request, value, length );
+
+    do
+    {
+        packet = model_in( CDC_EP_CONTROL, &data[total] );
+        TEST_CHECK( packet >= 0 && packet <= EP0_PACKET_BYTES );
+        total = (uint16_t)( total + MAX( packet, 0 ) );
+    } while( packet == EP0_PACKET_BYTES && total < length );
+
+    return total;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Send a packet to an OUT endpoint, false when it's NAKed
+PRIVATE bool
+model_out( uint8_t ep, const uint8_t *data, uint16_t length )
+{
+    if( !( USB_OUTEP( ep )->DOEPCTL & USB_OTG_DOEPCTL_EPENA ) )
+    {
+        return false;
+    }
+
+    TEST_CHECK( length <= ( USB_OUTEP( ep )->DOEPTSIZ & USB_OTG_DOEPTSIZ_XFRSIZ ) );
+    USB_OUTEP( ep )->DOEPCTL &= ~USB_OTG_DOEPCTL_EPENA;
+
+    model_rx_push( ep, PKTSTS_OUT_DATA, data, length );
+
+    USB_OUTEP( ep )->DOEPINT = USB_OTG_DOEPINT_XFRC;
+    USB_DEVICE->DAINT        = 1U << ( 16U + ep );
+    model_interrupt( USB_OTG_GINTSTS_OEPINT );
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Take the transfer loaded into an IN endpoint, -1 when there's none. Data
+// transfers are split into packets and logged, EP0 only ever loads one.
+PRIVATE int32_t
+model_in( uint8_t ep, uint8_t *data )
+{
+    if( !( USB_INEP( ep )->DIEPCTL & USB_OTG_DIEPCTL_EPENA ) )
+    {
+        return -1;
+    }
+
+    uint32_t size    = USB_INEP( ep )->DIEPTSIZ & USB_OTG_DIEPTSIZ_XFRSIZ;
+    uint32_t packets = ( USB_INEP( ep )->DIEPTSIZ & USB_OTG_DIEPTSIZ_PKTCNT ) >> USB_OTG_DIEPTSIZ_PKTCNT_Pos;
+
+    // The packet count has to agree with the size, and the fifo hold all of it
+    TEST_CHECK( packets == ( size ? ( size + CDC_DATA_PACKET_BYTES - 1 ) / CDC_DATA_PACKET_BYTES : 1 ) );
+    TEST_CHECK( model.tx_words[ep] == ( size + 3U ) / 4U );
+
+    memcpy( data, model.tx[ep], size );
+    model.tx_words[ep] = 0;
+
+    if( ep == CDC_EP_DATA )
+    {
+        uint32_t sent = 0;
+
+        do
+        {
+            TEST_CHECK( model.packet_count < MODEL_PACKETS );
+            model.packets[model.packet_count++ % MODEL_PACKETS] = (uint16_t)MIN( size - sent, CDC_DATA_PACKET_BYTES );
+            sent += CDC_DATA_PACKET_BYTES;
+        } while( sent < size );
+    }
+
+    USB_INEP( ep )->DIEPCTL &= ~USB_OTG_DIEPCTL_EPENA;
+    USB_INEP( ep )->DIEPINT = USB_OTG_DIEPINT_XFRC;
+    USB_DEVICE->DAINT       = 1U << ep;
+    model_interrupt( USB_OTG_GINTSTS_IEPINT );
+
+    return (int32_t)size;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Poll the data IN endpoint until the device has nothing more to send
+PRIVATE uint32_t
+model_collect( uint8_t *data )
+{
+    uint32_t total = 0;
+    int32_t  size;
+
+    while( ( size = model_in( CDC_EP_DATA, &data[total] ) ) >= 0 )
+    {
+        total += (uint32_t)size;
+    }
+
+    return total;
+}
+
+/* ----- End ---------------------------------------------------------------- */
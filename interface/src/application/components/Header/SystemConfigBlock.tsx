@@ -9,7 +9,6 @@ import {
   HTMLTable,
 } from '@blueprintjs/core'
 import {
-  IntervalRequester,
   useDeviceConnect,
   useDeviceConnectionRequested,
   useDeviceDisconnect,
@@ -358,7 +357,6 @@ const PowerCalibrationCard = () => {
         <h2>Power Calibration</h2>
       </Box>
       <Box>
-        <IntervalRequester variables={['sys', 'servo']} interval={250} />
         <HTMLTable striped style={{ minWidth: '100%' }}>
           <thead>
             <tr>
@@ -1,12 +1,9 @@
 import { HTMLTable, Icon, Intent } from '@blueprintjs/core'
-import {
-  IntervalRequester,
-  useHardwareState,
-} from '@electricui/components-core'
+import { useHardwareState } from '@electricui/components-core'
 
 import React from 'react'
 import { Composition, Box } from 'atomic-layout'
-import { Statistic } from '@electricui/components-desktop-blueprint'
+import { Button, Statistic } from '@electricui/components-desktop-blueprint'
 import { Printer } from '@electricui/components-desktop'
 
 const SensorsActive = () => {
@@ -49,9 +46,147 @@ const CPUClockText = () => {
   return <div>Error getting CPU clockspeed</div>
 }
 
+const InterruptsMaskedText = () => {
+  const masked = useHardwareState(state => state.sys.irq_masked_cycles)
+  const cpu_clock = useHardwareState(state => state.sys.cpu_clock)
+
+  if (cpu_clock) {
+    return (
+      <div>
+        IRQs masked: {masked} cycles ({(masked / cpu_clock).toFixed(2)}us)
+      </div>
+    )
+  }
+
+  return <div>Error getting interrupt masking</div>
+}
+
+// In the order of HalProfilerProbe_t in the firmware
+const PROFILER_PROBE_NAMES = [
+  'Supervisor',
+  'Motion',
+  'Lighting',
+  'Communication',
+  'Communication USB',
+  'ADC',
+  'Fan',
+  'LED Interpolator',
+  'Path Compile',
+  'Servo 1',
+  'Servo 2',
+  'Servo 3',
+  'Servo 4',
+  'IRQ SysTick',
+  'IRQ Stepper',
+  'IRQ ADC',
+  'IRQ Motion',
+  'IRQ UART',
+  'IRQ USB',
+  'IRQ Capture',
+]
+
+const ProfilerTable = () => {
+  const probes = useHardwareState(state => state.prof) || []
+
+  return (
+    <HTMLTable striped style={{ minWidth: '100%' }}>
+      <thead>
+        <tr>
+          <th>Section</th>
+          <th>Runs</th>
+          <th>Min</th>
+          <th>Mean</th>
+          <th>Max</th>
+          <th>
+            Histogram (&lt;256, 1k, 4k, 16k, 64k, 256k, 1M, more cycles)
+          </th>
+        </tr>
+      </thead>
+      <tbody>
+        {probes.map((probe, index) => (
+          <tr key={index}>
+            <td>
+              <b>{PROFILER_PROBE_NAMES[index] || index}</b>
+            </td>
+            <td>{probe.count}</td>
+            <td>{probe.min}</td>
+            <td>{probe.mean}</td>
+            <td>{probe.max}</td>
+            <td>{probe.histogram.join(' / ')}</td>
+          </tr>
+        ))}
+      </tbody>
+    </HTMLTable>
+  )
+}
+
+const EVENT_POOL_NAMES = ['Small', 'Medium', 'Large']
+
+// Spare events to keep above the worst use seen, as a fraction of it
+const EVENT_POOL_HEADROOM = 0.25
+
+// Sizing report, suggests a pool size from the low-water mark and shows
+// the RAM that would be freed (or needed) to get there
+const EventPoolTable = () => {
+  const pools = useHardwareState(state => state.pools) || []
+
+  return (
+    <HTMLTable striped style={{ minWidth: '100%' }}>
+      <thead>
+        <tr>
+          <th>Event Pool</th>
+          <th>Event Size</th>
+          <th>Largest Event</th>
+          <th>Free</th>
+          <th>Min Free</th>
+          <th>Failed</th>
+          <th>Suggested Size</th>
+          <th>RAM Change</th>
+        </tr>
+      </thead>
+      <tbody>
+        {pools.map((pool, index) => {
+          // A pool that ran dry has an unknown peak, so no suggestion
+          const peak = pool.total - pool.free_min
+          const suggested = Math.max(
+            peak + Math.ceil(peak * EVENT_POOL_HEADROOM),
+            2,
+          )
+          const saving = (pool.total - suggested) * pool.event_size
+
+          return (
+            <tr key={index}>
+              <td>
+                <b>{EVENT_POOL_NAMES[index] || index}</b>
+              </td>
+              <td>{pool.event_size} B</td>
+              <td>{pool.largest} B</td>
+              <td>
+                {pool.free} / {pool.total}
+              </td>
+              <td>{pool.free_min}</td>
+              <td>{pool.failed}</td>
+              <td>{pool.failed > 0 ? `> ${pool.total}` : suggested}</td>
+              <td>
+                {pool.failed > 0
+                  ? '-'
+                  : saving >= 0
+                  ? `${saving} B freed`
+                  : `${-saving} B more`}
+              </td>
+            </tr>
+          )
+        })}
+      </tbody>
+    </HTMLTable>
+  )
+}
+
 const SystemInfoLayout = `
 Stats Build
 Tasks Tasks
+Pools Pools
+Profile Profile
 `
 
 export const CoreSystemsInfoCard = () => {
@@ -69,7 +204,6 @@ export const CoreSystemsInfoCard = () => {
       {Areas => (
         <React.Fragment>
           <Areas.Stats>
-            <IntervalRequester interval={200} variables={['sys', 'tasks']} />
             <h3>System Configuration</h3>
             <SensorsActive />
             <br />
@@ -78,6 +212,8 @@ export const CoreSystemsInfoCard = () => {
             <LastResetReason />
             <br />
             <CPUClockText />
+            <br />
+            <InterruptsMaskedText />
           </Areas.Stats>
           <Areas.Build>
             <HTMLTable striped style={{ minWidth: '100%' }}>
@@ -143,6 +279,9 @@ export const CoreSystemsInfoCard = () => {
                   <th>Queue Usage</th>
                   <th>Waiting Max</th>
                   <th>Burst Max</th>
+                  <th>Latency Max</th>
+                  <th>Dispatch Max</th>
+                  <th>Dropped</th>
                 </tr>
               </thead>
               <tbody>
@@ -181,12 +320,35 @@ export const CoreSystemsInfoCard = () => {
                           accessor={state => state.tasks[index].burst_max}
                         />
                       </td>
+                      <td>
+                        <Printer
+                          accessor={state => state.tasks[index].latency_max}
+                        />
+                      </td>
+                      <td>
+                        <Printer
+                          accessor={state => state.tasks[index].dispatch_max}
+                        />
+                      </td>
+                      <td>
+                        <Printer
+                          accessor={state => state.tasks[index].dropped}
+                        />
+                      </td>
                     </tr>
                   </>
                 ))}
               </tbody>
             </HTMLTable>
           </Areas.Tasks>
+          <Areas.Pools>
+            <EventPoolTable />
+          </Areas.Pools>
+          <Areas.Profile>
+            <ProfilerTable />
+            <br />
+            <Button callback="profclr">Clear Profiler</Button>
+          </Areas.Profile>
         </React.Fragment>
       )}
     </Composition>
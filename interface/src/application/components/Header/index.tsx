@@ -5,10 +5,7 @@ import {
   Tooltip,
   Colors,
 } from '@blueprintjs/core'
-import {
-  IntervalRequester,
-  useHardwareState,
-} from '@electricui/components-core'
+import { useHardwareState } from '@electricui/components-core'
 
 import { Button } from '@electricui/components-desktop-blueprint'
 
@@ -42,7 +39,6 @@ const CPULoadSparkline = () => {
 
   return (
     <div>
-      <IntervalRequester interval={200} variables={['sys']} />
       <Composition templateCols="1fr 2fr" alignItems="center">
         <div
           style={{
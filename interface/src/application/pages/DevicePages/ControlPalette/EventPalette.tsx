@@ -2,7 +2,6 @@ import React from 'react'
 
 import {
   useDeviceMetadataKey,
-  IntervalRequester,
   useHardwareState,
 } from '@electricui/components-core'
 
@@ -14,10 +13,13 @@ const QueueText = () => {
   const queue_depth = useHardwareState(state => state.queue.movements)
   const is_moving = useHardwareState(state => state.moStat.pathing_state) == 1
   const queue_depth_ui = useDeviceMetadataKey('uiSideMovementQueueDepth')
+  const dropped = useDeviceMetadataKey('uiSideMovementsDropped') || 0
 
   let iconColour: Intent
 
-  if (queue_depth == 0) {
+  if (dropped > 0) {
+    iconColour = Intent.DANGER
+  } else if (queue_depth == 0) {
     iconColour = Intent.NONE
   } else if (queue_depth > 0 && queue_depth < 25) {
     if (is_moving) {
@@ -32,6 +34,7 @@ const QueueText = () => {
   return (
     <div>
       <Icon icon="move" intent={iconColour} /> {queue_depth} ({queue_depth_ui})
+      {dropped > 0 && ` ${dropped} moves dropped`}
     </div>
   )
 }
@@ -77,7 +80,6 @@ const EventPalette = () => {
 
   return (
     <>
-      <IntervalRequester interval={100} variables={['rgb']} />
       <h3>Load Event Sequence from File</h3>
       <SceneController key={sceneFilePath} />
       <CurrentRGB />
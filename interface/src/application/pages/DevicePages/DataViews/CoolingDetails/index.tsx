@@ -18,11 +18,7 @@ import {
   Text,
   Tab,
 } from '@blueprintjs/core'
-import {
-  IntervalRequester,
-  StateTree,
-  useHardwareState,
-} from '@electricui/components-core'
+import { StateTree, useHardwareState } from '@electricui/components-core'
 
 import {
   ChartContainer,
@@ -70,8 +66,6 @@ export const CoolingDetails = () => {
 
   return (
     <div>
-      <IntervalRequester variables={['temp']} interval={500} />
-      <IntervalRequester variables={['fan']} interval={250} />
 
       {/* <RollingStorageRequest
         dataSource={temperatureDataSource}
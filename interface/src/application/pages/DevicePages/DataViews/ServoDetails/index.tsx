@@ -13,10 +13,7 @@ import {
 import { Statistic, Statistics } from '@electricui/components-desktop-blueprint'
 import { Colors, Callout, Tooltip, Position, Intent } from '@blueprintjs/core'
 import { IconNames, IconName } from '@blueprintjs/icons'
-import {
-  IntervalRequester,
-  useHardwareState,
-} from '@electricui/components-core'
+import { useHardwareState } from '@electricui/components-core'
 
 import {
   MessageDataSource,
@@ -211,7 +208,6 @@ export const ServoDetails = () => {
 
   return (
     <div>
-      <IntervalRequester variables={['servo']} interval={50} />
       {/* <RollingStorageRequest
         dataSource={servoTelemetryDataSource}
         maxItems={250}
@@ -22,6 +22,7 @@ export type SystemStatus = {
   cpu_load: number
   cpu_clock: number
   input_voltage: number
+  irq_masked_cycles: number
 }
 
 export type TaskStatistics = {
@@ -31,9 +32,69 @@ export type TaskStatistics = {
   queue_max: number
   waiting_max: number
   burst_max: number
+  latency_max: number
+  dispatch_max: number
+  dropped: number
   name: string
 }
 
+// Cycle counts for one profiled section, in the order of HalProfilerProbe_t.
+// Histogram bucket n counts runs under 256 << 2n cycles, the last everything longer.
+export type ProfilerProbe = {
+  count: number
+  min: number
+  mean: number
+  max: number
+  histogram: number[]
+}
+
+// Event pool usage since start up, in the order small, medium, large
+export type EventPoolStatistics = {
+  event_size: number
+  total: number
+  free: number
+  free_min: number
+  largest: number
+  failed: number
+}
+
+export type MotionLoopStatistics = {
+  rate_hz: number
+  exec_us: number
+  exec_us_max: number
+  load: number
+  ticks: number
+  overruns: number
+}
+
+// Transmit counters for one UART, in the order external, internal, module
+export type UartStatistics = {
+  tx_bytes: number
+  tx_dropped: number
+  tx_dropped_bytes: number
+  tx_backpressure: number
+  tx_peak_used: number
+  tx_capacity: number
+}
+
+export type KinematicsTiming = {
+  cycles: number
+  cycles_max: number
+  solves: number
+  unsolved: number
+}
+
+export type MovementQueueStatistics = {
+  slot_bytes: number
+  capacity: number
+  queued: number
+  queued_max: number
+  enqueue_cycles: number
+  enqueue_cycles_max: number
+  enqueued: number
+  refused: number
+}
+
 export type FirmwareBuildInfo = {
   branch: string
   info: string
@@ -80,6 +141,11 @@ export type QueueDepthInfo = {
   lighting: number
 }
 
+export type FlowCredits = {
+  movements: number
+  lighting: number
+}
+
 
 
 export type ServoInfo = {
@@ -155,6 +221,87 @@ export type MovementMove = {
   num_points?: number
 }
 
+// Several movements sent as one 'inmvb' bulk upload
+export type MovementBatch = {
+  sequence: number
+  moves: Array<MovementMove>
+}
+
+// A bulk upload delta encoded ahead of time by the toolpath streamer, sent
+// flagged as streamed so the firmware only queues it in sequence
+export type EncodedMovementBatch = {
+  sequence: number
+  count: number
+  records: Uint8Array
+}
+
+export enum MovementBatchStatus {
+  ACCEPTED = 0,
+  DUPLICATE,
+  CRC_ERROR,
+  MALFORMED,
+  QUEUE_FULL,
+  OUT_OF_ORDER,
+  REFUSED,
+}
+
+export type MovementBatchAck = {
+  sequence: number
+  status: MovementBatchStatus
+  accepted: number
+  movement_credits: number
+  lighting_credits: number
+}
+
+export enum CaptureState {
+  IDLE = 0,
+  ARMED,
+  RECORDING,
+  DONE,
+}
+
+export enum CaptureSampleFlags {
+  MOVE_START = 1 << 0,
+  LAST = 1 << 1,
+  SERVO_OFF = 1 << 2,
+}
+
+// Written to 'capt', records from the first tick of start_id to the last of stop_id
+export type CaptureArm = {
+  start_id: number
+  stop_id: number
+  divider: number
+}
+
+export type CaptureStatus = {
+  state: CaptureState
+  divider: number
+  start_id: number
+  stop_id: number
+  waiting: number
+  captured: number
+  dropped: number
+}
+
+// One sampled motion loop tick
+export type CaptureSample = {
+  tick: number
+  target: CartesianPoint
+  steps: [number, number, number]
+  feedback: [number, number, number]
+  rgb: [number, number, number]
+  progress: number
+  flags: number
+}
+
+// Reply to a 'capnx' request, samples with ticks unwrapped against first
+export type CaptureBlock = {
+  sequence: number
+  state: CaptureState
+  first: number
+  samples: Array<CaptureSample>
+}
+
 export enum LightMoveType {
   IMMEDIATE,
   RAMP,
@@ -3,11 +3,18 @@ import { Codec, Message } from '@electricui/core'
 import {
   SystemStatus,
   TaskStatistics,
+  ProfilerProbe,
+  EventPoolStatistics,
+  MotionLoopStatistics,
+  KinematicsTiming,
+  MovementQueueStatistics,
+  UartStatistics,
   KinematicsInfo,
   FirmwareBuildInfo,
   TemperatureSensors,
   FanStatus,
   QueueDepthInfo,
+  FlowCredits,
   ServoInfo,
   MotionState,
   SUPERVISOR_STATES,
@@ -18,6 +25,13 @@ import {
   MovementPoint,
   CartesianPoint,
   MovementMove,
+  MovementBatch,
+  EncodedMovementBatch,
+  MovementBatchAck,
+  CaptureArm,
+  CaptureStatus,
+  CaptureSample,
+  CaptureBlock,
   LightMoveType,
   LightMove,
   LightPoint,
@@ -46,6 +60,7 @@ export class SystemDataCodec extends Codec {
       cpu_load: reader.readUInt8(),
       cpu_clock: reader.readUInt8(),
       input_voltage: reader.readFloatLE(),
+      irq_masked_cycles: reader.readUInt32LE(),
     }
   }
 }
@@ -72,6 +87,9 @@ export class TaskStatisticsCodec extends Codec {
         queue_max: reader.readUInt8(),
         waiting_max: reader.readUInt32LE(),
         burst_max: reader.readUInt32LE(),
+        latency_max: reader.readUInt32LE(),
+        dispatch_max: reader.readUInt32LE(),
+        dropped: reader.readUInt32LE(),
         name: reader.readString(12, 'utf8'),
       }
       taskStats.push(task)
@@ -81,6 +99,168 @@ export class TaskStatisticsCodec extends Codec {
   }
 }
 
+export class ProfilerCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'prof'
+  }
+
+  encode(payload: Array<ProfilerProbe>): Buffer {
+    throw new Error('Profiler statistics are read-only')
+  }
+
+  decode(payload: Buffer): Array<ProfilerProbe> {
+    const reader = SmartBuffer.fromBuffer(payload)
+    const probes: Array<ProfilerProbe> = []
+
+    while (reader.remaining() >= 32) {
+      const probe: ProfilerProbe = {
+        count: reader.readUInt32LE(),
+        min: reader.readUInt32LE(),
+        mean: reader.readUInt32LE(),
+        max: reader.readUInt32LE(),
+        histogram: [],
+      }
+
+      for (let bucket = 0; bucket < 8; bucket++) {
+        probe.histogram.push(reader.readUInt16LE())
+      }
+
+      probes.push(probe)
+    }
+
+    return probes
+  }
+}
+
+export class EventPoolStatisticsCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'pools'
+  }
+
+  encode(payload: Array<EventPoolStatistics>): Buffer {
+    throw new Error('Event pool statistics are read-only')
+  }
+
+  decode(payload: Buffer): Array<EventPoolStatistics> {
+    const reader = SmartBuffer.fromBuffer(payload)
+    const pools: Array<EventPoolStatistics> = []
+
+    while (reader.remaining() >= 16) {
+      const pool: EventPoolStatistics = {
+        event_size: reader.readUInt16LE(),
+        total: reader.readUInt16LE(),
+        free: reader.readUInt16LE(),
+        free_min: reader.readUInt16LE(),
+        largest: reader.readUInt16LE(),
+        failed: 0,
+      }
+      reader.readUInt16LE() // reserved
+      pool.failed = reader.readUInt32LE()
+
+      pools.push(pool)
+    }
+
+    return pools
+  }
+}
+
+export class MotionLoopStatisticsCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'mloop'
+  }
+
+  encode(payload: MotionLoopStatistics): Buffer {
+    throw new Error('Motion loop statistics are read-only')
+  }
+
+  decode(payload: Buffer): MotionLoopStatistics {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    return {
+      rate_hz: reader.readUInt16LE(),
+      exec_us: reader.readUInt16LE(),
+      exec_us_max: reader.readUInt16LE(),
+      load: reader.readUInt16LE(),
+      ticks: reader.readUInt32LE(),
+      overruns: reader.readUInt32LE(),
+    }
+  }
+}
+
+export class KinematicsTimingCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'ik'
+  }
+
+  encode(payload: KinematicsTiming): Buffer {
+    throw new Error('Kinematics timing is read-only')
+  }
+
+  decode(payload: Buffer): KinematicsTiming {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    return {
+      cycles: reader.readUInt32LE(),
+      cycles_max: reader.readUInt32LE(),
+      solves: reader.readUInt32LE(),
+      unsolved: reader.readUInt32LE(),
+    }
+  }
+}
+
+export class MovementQueueStatisticsCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'mvq'
+  }
+
+  encode(payload: MovementQueueStatistics): Buffer {
+    throw new Error('Movement queue statistics are read-only')
+  }
+
+  decode(payload: Buffer): MovementQueueStatistics {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    return {
+      slot_bytes: reader.readUInt16LE(),
+      capacity: reader.readUInt16LE(),
+      queued: reader.readUInt16LE(),
+      queued_max: reader.readUInt16LE(),
+      enqueue_cycles: reader.readUInt32LE(),
+      enqueue_cycles_max: reader.readUInt32LE(),
+      enqueued: reader.readUInt32LE(),
+      refused: reader.readUInt32LE(),
+    }
+  }
+}
+
+export class UartStatisticsCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'uart'
+  }
+
+  encode(payload: Array<UartStatistics>): Buffer {
+    throw new Error('UART statistics are read-only')
+  }
+
+  decode(payload: Buffer): Array<UartStatistics> {
+    const reader = SmartBuffer.fromBuffer(payload)
+    const ports: Array<UartStatistics> = []
+
+    while (reader.remaining() >= 20) {
+      ports.push({
+        tx_bytes: reader.readUInt32LE(),
+        tx_dropped: reader.readUInt32LE(),
+        tx_dropped_bytes: reader.readUInt32LE(),
+        tx_backpressure: reader.readUInt32LE(),
+        tx_peak_used: reader.readUInt16LE(),
+        tx_capacity: reader.readUInt16LE(),
+      })
+    }
+
+    return ports
+  }
+}
+
 export function splitBufferByLength(toSplit: Buffer, splitLength: number) {
   const chunks = []
   const n = toSplit.length
@@ -216,6 +396,25 @@ export class QueueDepthCodec extends Codec {
   }
 }
 
+export class FlowCreditsCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'crdt'
+  }
+
+  encode(payload: FlowCredits): Buffer {
+    throw new Error('flow credits are read-only')
+  }
+
+  decode(payload: Buffer): FlowCredits {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    return {
+      movements: reader.readUInt8(),
+      lighting: reader.readUInt8(),
+    }
+  }
+}
+
 export class MotorDataCodec extends Codec {
   filter(message: Message): boolean {
     return message.messageID === 'servo'
@@ -374,6 +573,271 @@ export class InboundMotionCodec extends Codec {
   }
 }
 
+// Must match MOVEMENT_BATCH_BYTES and MOVEMENT_BATCH_RECORDS_MAX in the firmware
+export const MOVEMENT_BATCH_BYTES = 240
+export const MOVEMENT_BATCH_RECORDS_MAX = 16
+
+// CRC-16/CCITT-FALSE, matches crc16Update() in the firmware
+export function crc16(data: Buffer) {
+  let crc = 0xffff
+
+  for (const byte of data) {
+    crc ^= byte << 8
+
+    for (let bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? ((crc << 1) ^ 0x1021) & 0xffff : (crc << 1) & 0xffff
+    }
+  }
+
+  return crc
+}
+
+const BATCH_FORMAT_DELTA = 1
+const BATCH_STREAMED = 0x80
+const BATCH_DELTA_CHAINED = 0x40
+const BATCH_DELTA_NEXT_ID = 0x80
+
+function writeVarint(bytes: Array<number>, value: number) {
+  value = value >>> 0
+
+  while (value >= 0x80) {
+    bytes.push((value & 0x7f) | 0x80)
+    value = value >>> 7
+  }
+
+  bytes.push(value)
+}
+
+function writeZigzag(bytes: Array<number>, value: number) {
+  writeVarint(bytes, (value << 1) ^ (value >> 31))
+}
+
+/**
+ * Delta encodes consecutive movements of one bulk upload, see movement_batch.h.
+ * Points are sent as zig-zag varint micron differences from the previous point,
+ * a move starting where the last one ended doesn't repeat its start point.
+ */
+export class MovementDeltaEncoder {
+  last: [number, number, number] = [0, 0, 0]
+  id = 0
+
+  record(move: MovementMove): Buffer {
+    const points = move.points.map(
+      point =>
+        point.map(axis => Math.round(axis * 1000) | 0) as [
+          number,
+          number,
+          number
+        ],
+    )
+
+    if (points.length < 1 || points.length > 4) {
+      throw new Error('movements carry 1 to 4 points')
+    }
+
+    const chained =
+      points[0][0] === this.last[0] &&
+      points[0][1] === this.last[1] &&
+      points[0][2] === this.last[2]
+    const nextId = move.id === ((this.id + 1) & 0xffff)
+
+    const bytes: Array<number> = []
+
+    bytes.push(
+      (move.type & 0x07) |
+        ((points.length - 1) << 3) |
+        (move.reference << 5) |
+        (chained ? BATCH_DELTA_CHAINED : 0) |
+        (nextId ? BATCH_DELTA_NEXT_ID : 0),
+    )
+
+    if (!nextId) {
+      writeVarint(bytes, move.id)
+    }
+
+    writeVarint(bytes, move.duration)
+
+    for (const point of chained ? points.slice(1) : points) {
+      for (let axis = 0; axis < 3; axis++) {
+        writeZigzag(bytes, (point[axis] - this.last[axis]) | 0)
+      }
+
+      this.last = point
+    }
+
+    this.last = points[points.length - 1]
+    this.id = move.id
+
+    return Buffer.from(bytes)
+  }
+}
+
+export class InboundMotionBatchCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'inmvb'
+  }
+
+  encode(payload: MovementBatch | EncodedMovementBatch): Buffer {
+    let records: Buffer
+    let count: number
+    let format = BATCH_FORMAT_DELTA
+
+    if ('records' in payload) {
+      // pre-encoded by the toolpath streamer
+      records = Buffer.from(payload.records)
+      count = payload.count
+      format |= BATCH_STREAMED
+    } else {
+      const encoder = new MovementDeltaEncoder()
+      records = Buffer.concat(payload.moves.map(move => encoder.record(move)))
+      count = payload.moves.length
+    }
+
+    if (
+      records.length > MOVEMENT_BATCH_BYTES ||
+      count > MOVEMENT_BATCH_RECORDS_MAX
+    ) {
+      throw new Error('movement batch is too large')
+    }
+
+    const packet = new SmartBuffer()
+
+    packet.writeUInt16LE(payload.sequence)
+    packet.writeUInt16LE(crc16(records))
+    packet.writeUInt16LE(records.length)
+    packet.writeUInt8(count)
+    packet.writeUInt8(format)
+    packet.writeBuffer(records)
+
+    return packet.toBuffer()
+  }
+
+  decode(payload: Buffer): MovementBatch {
+    throw new Error('movement batches are write-only')
+  }
+}
+
+export class MovementBatchAckCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'mvack'
+  }
+
+  encode(payload: MovementBatchAck): Buffer {
+    throw new Error('movement batch acks are read-only')
+  }
+
+  decode(payload: Buffer): MovementBatchAck {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    return {
+      sequence: reader.readUInt16LE(),
+      status: reader.readUInt8(),
+      accepted: reader.readUInt8(),
+      movement_credits: reader.readUInt8(),
+      lighting_credits: reader.readUInt8(),
+    }
+  }
+}
+
+export class CaptureArmCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'capt'
+  }
+
+  encode(payload: CaptureArm): Buffer {
+    const packet = new SmartBuffer()
+
+    packet.writeUInt16LE(payload.start_id)
+    packet.writeUInt16LE(payload.stop_id)
+    packet.writeUInt16LE(payload.divider)
+
+    return packet.toBuffer()
+  }
+
+  decode(payload: Buffer): CaptureArm {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    return {
+      start_id: reader.readUInt16LE(),
+      stop_id: reader.readUInt16LE(),
+      divider: reader.readUInt16LE(),
+    }
+  }
+}
+
+export class CaptureStatusCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'capst'
+  }
+
+  encode(payload: CaptureStatus): Buffer {
+    throw new Error('Capture status is read-only')
+  }
+
+  decode(payload: Buffer): CaptureStatus {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    return {
+      state: reader.readUInt8(),
+      divider: reader.readUInt8(),
+      start_id: reader.readUInt16LE(),
+      stop_id: reader.readUInt16LE(),
+      waiting: reader.readUInt16LE(),
+      captured: reader.readUInt32LE(),
+      dropped: reader.readUInt32LE(),
+    }
+  }
+}
+
+export class CaptureBlockCodec extends Codec {
+  filter(message: Message): boolean {
+    return message.messageID === 'capblk'
+  }
+
+  encode(payload: CaptureBlock): Buffer {
+    throw new Error('Capture blocks are read-only')
+  }
+
+  decode(payload: Buffer): CaptureBlock {
+    const reader = SmartBuffer.fromBuffer(payload)
+
+    const sequence = reader.readUInt16LE()
+    const count = reader.readUInt8()
+    const state = reader.readUInt8()
+    const first = reader.readUInt32LE()
+    const samples: Array<CaptureSample> = []
+
+    for (let i = 0; i < count; i++) {
+      const x = reader.readInt32LE() / 1000
+      const y = reader.readInt32LE() / 1000
+      const z = reader.readInt32LE() / 1000
+      const tick = reader.readUInt16LE()
+
+      samples.push({
+        // Only the low 16 bits of the tick are sent
+        tick: first + ((tick - first) & 0xffff),
+        target: { x, y, z },
+        steps: [
+          reader.readInt16LE(),
+          reader.readInt16LE(),
+          reader.readInt16LE(),
+        ],
+        feedback: [reader.readInt8(), reader.readInt8(), reader.readInt8()],
+        rgb: [reader.readUInt8(), reader.readUInt8(), reader.readUInt8()],
+        progress: reader.readUInt8(),
+        flags: reader.readUInt8(),
+      })
+    }
+
+    return {
+      sequence,
+      state,
+      first,
+      samples,
+    }
+  }
+}
+
 export class InboundFadeCodec extends Codec {
   filter(message: Message): boolean {
     return message.messageID === 'inlt'
@@ -558,16 +1022,28 @@ export class PowerCalibrationCodec extends Codec {
 export const customCodecs = [
   new SystemDataCodec(),
   new TaskStatisticsCodec(),
+  new ProfilerCodec(),
+  new EventPoolStatisticsCodec(),
+  new MotionLoopStatisticsCodec(),
+  new KinematicsTimingCodec(),
+  new MovementQueueStatisticsCodec(),
+  new UartStatisticsCodec(),
   new FirmwareInfoCodec(),
   new KinematicsInfoCodec(),
   new TempSensorCodec(),
   new FanCodec(),
   new QueueDepthCodec(),
+  new FlowCreditsCodec(),
   new MotorDataCodec(),
   new MotionDataCodec(),
   new TargetPositionCodec(),
   new SupervisorInfoCodec(),
   new InboundMotionCodec(),
+  new InboundMotionBatchCodec(),
+  new MovementBatchAckCodec(),
+  new CaptureArmCodec(),
+  new CaptureStatusCodec(),
+  new CaptureBlockCodec(),
   new InboundFadeCodec(),
   new LEDCodec(),
   new HSVManualControl(),
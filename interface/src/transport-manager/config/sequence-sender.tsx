@@ -24,11 +24,23 @@ export type IncomingQueueDepthMessageTransform = (
   message: Message,
 ) => number
 
+export type IncomingCreditMessageTransform = (
+  deviceManager: DeviceManager,
+  message: Message,
+) => number
+
 export type QueueDepthChangeCallback = (
   deviceManager: DeviceManager,
   depth: number,
 ) => void
 
+export type ChunkBatcher = (queue: Array<any>, limit: number) => number
+
+export type ChunkReplyFilter = (
+  deviceManager: DeviceManager,
+  message: Message,
+) => boolean
+
 export interface SequenceSenderPluginOptions {
   /**
    * A function that writes a chunk to the device
@@ -50,11 +62,39 @@ export interface SequenceSenderPluginOptions {
    */
   incomingQueueDepthMessageTransform: IncomingQueueDepthMessageTransform
 
+  /**
+   * Transforms a message into a credit grant, the number of items the hardware
+   * could accept when it sent the message. When provided, filtered messages are
+   * treated as grants instead of queue depths, and the sender never writes
+   * more than it has been granted.
+   */
+  incomingCreditMessageTransform?: IncomingCreditMessageTransform
+
+  /**
+   * Asks the hardware for a fresh credit grant, used when the sender is
+   * unpaused with nothing granted
+   */
+  creditRequester?: QueueDepthRequester
+
   /**
    * Do something with the device manager when the queue depth changes
    */
   queueDepthChangeCallback: QueueDepthChangeCallback
 
+  /**
+   * Returns how many chunks from the front of the queue to send in one write,
+   * at most limit. When provided the chunk writer is handed an array of chunks.
+   */
+  chunkBatcher?: ChunkBatcher
+
+  /**
+   * Returns if a message is the hardware's reply to the last chunk written.
+   * When provided, only one chunk is outstanding at a time and the next is
+   * written once the reply has been handled, so chunks put back with
+   * requeueItems are resent before anything queued behind them.
+   */
+  chunkReplyFilter?: ChunkReplyFilter
+
   /**
    * Provide a name for the sequence sender
    */
@@ -70,7 +110,14 @@ export class SequenceSenderPlugin extends DeviceManagerProxyPlugin {
   deviceManagerChunkWriter: DeviceManagerChunkWriter
   incomingQueueDepthMessageFilter: IncomingQueueDepthMessageFilter
   incomingQueueDepthMessageTransform: IncomingQueueDepthMessageTransform
+  incomingCreditMessageTransform?: IncomingCreditMessageTransform
+  creditRequester?: QueueDepthRequester
   queueDepthChangeCallback: QueueDepthChangeCallback
+  chunkBatcher?: ChunkBatcher
+  chunkReplyFilter?: ChunkReplyFilter
+  awaitingReply: boolean = false
+  credits: number = 0
+  inFlight: number = 0
   paused: boolean = true
   name: string
 
@@ -85,7 +132,11 @@ export class SequenceSenderPlugin extends DeviceManagerProxyPlugin {
     this.deviceManagerChunkWriter = options.deviceManagerChunkWriter
     this.incomingQueueDepthMessageFilter = options.incomingQueueDepthMessageFilter // prettier-ignore
     this.incomingQueueDepthMessageTransform = options.incomingQueueDepthMessageTransform // prettier-ignore
+    this.incomingCreditMessageTransform = options.incomingCreditMessageTransform // prettier-ignore
+    this.creditRequester = options.creditRequester
     this.queueDepthChangeCallback = options.queueDepthChangeCallback
+    this.chunkBatcher = options.chunkBatcher
+    this.chunkReplyFilter = options.chunkReplyFilter
 
     this.name = options.name || '?'
 
@@ -93,13 +144,29 @@ export class SequenceSenderPlugin extends DeviceManagerProxyPlugin {
   }
 
   onMessage = (device: Device, message: Message) => {
-    if (this.incomingQueueDepthMessageFilter(this.deviceManager!, message)) {
-      const currentQueueDepth = this.incomingQueueDepthMessageTransform(
-        this.deviceManager!,
-        message,
-      )
+    if (
+      this.chunkReplyFilter &&
+      this.chunkReplyFilter(this.deviceManager!, message)
+    ) {
+      this.awaitingReply = false
+    }
 
-      this.currentQueueDepth = currentQueueDepth
+    if (this.incomingQueueDepthMessageFilter(this.deviceManager!, message)) {
+      if (this.incomingCreditMessageTransform) {
+        const granted = this.incomingCreditMessageTransform(
+          this.deviceManager!,
+          message,
+        )
+
+        // Writes still waiting on their ack may have arrived after the grant
+        // was counted, hold them back so the hardware queue can't overflow
+        this.credits = Math.max(0, granted - this.inFlight)
+      } else {
+        this.currentQueueDepth = this.incomingQueueDepthMessageTransform(
+          this.deviceManager!,
+          message,
+        )
+      }
 
       this.writeSomethingIfWeCan()
     }
@@ -124,29 +191,69 @@ export class SequenceSenderPlugin extends DeviceManagerProxyPlugin {
     this.writeSomethingIfWeCan()
   }
 
+  /**
+   * Put chunks the hardware refused back at the front of the queue
+   */
+  public requeueItems = (chunks: Array<any>) => {
+    this.queue.unshift(...chunks)
+
+    this.setQueueRemaining(this.queue.length)
+  }
+
   /**
    * Checks if we can write anything
    */
   private writeSomethingIfWeCan = async () => {
+    const available = this.incomingCreditMessageTransform
+      ? this.credits
+      : this.maxQueueDepth - this.currentQueueDepth
+
     // If we have allowable queue depth and there's something in the queue, write it
     if (
-      this.currentQueueDepth < this.maxQueueDepth &&
+      available > 0 &&
       this.queue.length > 0 &&
-      !this.paused
+      !this.paused &&
+      !this.awaitingReply
     ) {
-      const item = this.queue.shift()
-
-      // optimistically increase the queue depth, it'll get reset quickly
-      this.currentQueueDepth += 1
+      const count = this.chunkBatcher
+        ? Math.max(1, this.chunkBatcher(this.queue, available))
+        : 1
+      const items = this.queue.splice(0, count)
+
+      if (this.incomingCreditMessageTransform) {
+        // spend the credits, they're only replaced by a fresh grant
+        this.credits -= items.length
+        this.inFlight += items.length
+      } else {
+        // optimistically increase the queue depth, it'll get reset quickly
+        this.currentQueueDepth += items.length
+      }
+
+      if (this.chunkReplyFilter) {
+        this.awaitingReply = true
+      }
 
       // tell the UI how much is left in _our_ queue
       this.setQueueRemaining(this.queue.length)
 
       this.debug(
-        `Writing item, UI queue length: ${this.queue.length}, HW queue depth: ${this.currentQueueDepth}`,
+        `Writing item, UI queue length: ${this.queue.length}, HW queue depth: ${this.getQueueDepth()}`,
       )
 
-      await this.deviceManagerChunkWriter(this.deviceManager!, item)
+      try {
+        await this.deviceManagerChunkWriter(
+          this.deviceManager!,
+          this.chunkBatcher ? items : items[0],
+        )
+      } catch (e) {
+        // the write failed, don't hold the queue for a reply that may not come
+        this.awaitingReply = false
+        throw e
+      } finally {
+        if (this.incomingCreditMessageTransform) {
+          this.inFlight -= items.length
+        }
+      }
 
       this.writeSomethingIfWeCan()
     }
@@ -166,6 +273,10 @@ export class SequenceSenderPlugin extends DeviceManagerProxyPlugin {
    * Returns the current queue depth
    */
   public getQueueDepth = () => {
+    if (this.incomingCreditMessageTransform) {
+      return this.maxQueueDepth - this.credits
+    }
+
     return this.currentQueueDepth
   }
 
@@ -187,6 +298,10 @@ export class SequenceSenderPlugin extends DeviceManagerProxyPlugin {
   public setPaused = (paused: boolean) => {
     this.paused = paused
     if (!paused) {
+      if (this.creditRequester && this.credits === 0 && this.inFlight === 0) {
+        this.creditRequester(this.deviceManager!)
+      }
+
       this.writeSomethingIfWeCan()
     }
   }
@@ -198,6 +313,7 @@ export class SequenceSenderPlugin extends DeviceManagerProxyPlugin {
     console.log('The sequence sender for', this.name, 'has cleared')
 
     this.queue = []
+    this.awaitingReply = false
 
     // Tell the UI the queue has been cleared
     this.setQueueRemaining(this.queue.length)
@@ -8,18 +8,75 @@ import {
 import { DeviceManagerProxyPlugin } from '@electricui/components-core'
 import { SequenceSenderPlugin } from './sequence-sender'
 import { getDelta } from './actions/utils'
+import {
+  MovementDeltaEncoder,
+  MOVEMENT_BATCH_BYTES,
+  MOVEMENT_BATCH_RECORDS_MAX,
+} from './codecs'
+import {
+  MovementBatchStatus,
+  MovementBatchAck,
+  MovementMove,
+  FlowCredits,
+} from '../../application/typedState'
+
+// Batches written to the delta and not yet acknowledged, by sequence number
+const pendingMovementBatches: Map<number, Array<MovementMove>> = new Map()
+let movementBatchSequence = 0
+
+// Moves in batches the hardware couldn't decode, which resending can't fix
+let movementsDropped = 0
+
+// Ask for the current credits, the reply arrives as a 'crdt' grant
+const requestCredits = (deviceManager: DeviceManager) => {
+  const delta = getDelta(deviceManager)
+
+  const message = new Message('crdt', null)
+  message.metadata.query = true
+
+  return delta.write(message)
+}
 
 export const movementQueueSequencer = new SequenceSenderPlugin({
-  maxQueueDepth: 75,
+  maxQueueDepth: 150,
   name: 'mv',
+  chunkBatcher: (queue: Array<MovementMove>, limit: number) => {
+    // take as many movements as fit in one bulk upload
+    const encoder = new MovementDeltaEncoder()
+    let bytes = 0
+    let count = 0
+
+    while (
+      count < queue.length &&
+      count < limit &&
+      count < MOVEMENT_BATCH_RECORDS_MAX
+    ) {
+      const recordBytes = encoder.record(queue[count]).length
+
+      if (bytes + recordBytes > MOVEMENT_BATCH_BYTES) {
+        break
+      }
+
+      bytes += recordBytes
+      count++
+    }
+
+    return count
+  },
   deviceManagerChunkWriter: async (
     deviceManager: DeviceManager,
     chunk: any,
   ) => {
-    // chunk is a momement
+    // chunk is an array of movements, sent as one bulk upload
     const delta = getDelta(deviceManager)
 
-    const message = new Message('inmv', chunk)
+    movementBatchSequence = (movementBatchSequence + 1) & 0xffff
+    pendingMovementBatches.set(movementBatchSequence, chunk)
+
+    const message = new Message('inmvb', {
+      sequence: movementBatchSequence,
+      moves: chunk,
+    })
     message.metadata.ack = true
 
     return delta.write(message)
@@ -36,7 +93,10 @@ export const movementQueueSequencer = new SequenceSenderPlugin({
       return false
     }
 
-    return message.deviceID === delta.deviceID && message.messageID === 'queue'
+    return (
+      message.deviceID === delta.deviceID &&
+      (message.messageID === 'crdt' || message.messageID === 'mvack')
+    )
   },
   incomingQueueDepthMessageTransform: (
     deviceManager: DeviceManager,
@@ -44,6 +104,61 @@ export const movementQueueSequencer = new SequenceSenderPlugin({
   ) => {
     return message.payload.movements
   },
+  creditRequester: requestCredits,
+  // Plain uploads carry no ordering the firmware checks, so a refused batch
+  // has to be resent before anything behind it is written
+  chunkReplyFilter: (deviceManager: DeviceManager, message: Message) => {
+    let delta = null
+
+    try {
+      delta = getDelta(deviceManager)
+    } catch (e) {
+      return false
+    }
+
+    return message.deviceID === delta.deviceID && message.messageID === 'mvack'
+  },
+  incomingCreditMessageTransform: (
+    deviceManager: DeviceManager,
+    message: Message,
+  ) => {
+    if (message.messageID !== 'mvack') {
+      const credits: FlowCredits = message.payload
+      return credits.movements
+    }
+
+    // The bulk upload reply carries a credit grant, resend anything refused
+    const ack: MovementBatchAck = message.payload
+    const moves = pendingMovementBatches.get(ack.sequence)
+    pendingMovementBatches.delete(ack.sequence)
+
+    if (moves) {
+      switch (ack.status) {
+        case MovementBatchStatus.CRC_ERROR:
+          movementQueueSequencer.requeueItems(moves)
+          break
+        case MovementBatchStatus.MALFORMED: {
+          // The same moves encode to the same bytes, resending would loop
+          movementsDropped += moves.length
+          console.error(
+            `The hardware couldn't decode upload ${ack.sequence}, dropped ${moves.length} moves`,
+          )
+
+          getDelta(deviceManager).addMetadata({
+            uiSideMovementsDropped: movementsDropped,
+          })
+          break
+        }
+        case MovementBatchStatus.QUEUE_FULL:
+          movementQueueSequencer.requeueItems(moves.slice(ack.accepted))
+          break
+        default:
+          break
+      }
+    }
+
+    return ack.movement_credits
+  },
   queueDepthChangeCallback: (deviceManager: DeviceManager, depth: number) => {
     const delta = getDelta(deviceManager)
 
@@ -54,7 +169,7 @@ export const movementQueueSequencer = new SequenceSenderPlugin({
 })
 
 export const lightQueueSequencer = new SequenceSenderPlugin({
-  maxQueueDepth: 125,
+  maxQueueDepth: 250,
   name: 'li',
   deviceManagerChunkWriter: async (
     deviceManager: DeviceManager,
@@ -80,7 +195,10 @@ export const lightQueueSequencer = new SequenceSenderPlugin({
       return false
     }
 
-    return message.deviceID === delta.deviceID && message.messageID === 'queue'
+    return (
+      message.deviceID === delta.deviceID &&
+      (message.messageID === 'crdt' || message.messageID === 'mvack')
+    )
   },
   incomingQueueDepthMessageTransform: (
     deviceManager: DeviceManager,
@@ -88,6 +206,19 @@ export const lightQueueSequencer = new SequenceSenderPlugin({
   ) => {
     return message.payload.lighting
   },
+  creditRequester: requestCredits,
+  incomingCreditMessageTransform: (
+    deviceManager: DeviceManager,
+    message: Message,
+  ) => {
+    if (message.messageID === 'mvack') {
+      const ack: MovementBatchAck = message.payload
+      return ack.lighting_credits
+    }
+
+    const credits: FlowCredits = message.payload
+    return credits.lighting
+  },
   queueDepthChangeCallback: (deviceManager: DeviceManager, depth: number) => {
     const delta = getDelta(deviceManager)
 
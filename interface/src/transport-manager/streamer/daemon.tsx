@@ -0,0 +1,164 @@
+import { CancellationToken, Device } from '@electricui/core'
+
+import { getDelta } from '../config/actions/utils'
+import { DeviceStreamerLink } from './device-link'
+import { SimulatedStreamerLink } from './simulated-link'
+import { ToolpathStreamer } from './toolpath-streamer'
+
+/**
+ * Headless toolpath streaming, run with `yarn run stream <collection.json>`.
+ *
+ * Finds and connects to the delta, streams every movement in the collection
+ * and reports progress once a second. Lighting and the scene sequencing stay
+ * with the UI.
+ *
+ * `yarn run stream --simulate [--latency ms] [--loss fraction] [--rate moves/s]
+ * <collection.json>` streams to a simulated delta instead, to measure the
+ * streamer's own throughput.
+ */
+
+const REPORT_INTERVAL_MS = 1000
+const POLL_INTERVAL_MS = 500
+const POLL_TIMEOUT_MS = 5000
+const CONNECT_TIMEOUT_MS = 10_000
+
+// Held on the delta while streaming, like the UI holds 'ui'
+const USAGE_REQUEST = 'streamer'
+
+type DaemonOptions = {
+  filePath: string
+  simulate: boolean
+  latency: number
+  lossRate: number
+  movesPerSecond: number
+}
+
+function parseArguments(args: Array<string>): DaemonOptions | null {
+  const options: DaemonOptions = {
+    filePath: '',
+    simulate: false,
+    latency: 0,
+    lossRate: 0,
+    movesPerSecond: 0,
+  }
+
+  for (let i = 0; i < args.length; i++) {
+    switch (args[i]) {
+      case '--simulate':
+        options.simulate = true
+        break
+      case '--latency':
+        options.latency = Number(args[++i])
+        break
+      case '--loss':
+        options.lossRate = Number(args[++i])
+        break
+      case '--rate':
+        options.movesPerSecond = Number(args[++i])
+        break
+      default:
+        options.filePath = args[i]
+        break
+    }
+  }
+
+  const numbers = [options.latency, options.lossRate, options.movesPerSecond]
+
+  if (!options.filePath || numbers.some(value => !isFinite(value))) {
+    return null
+  }
+
+  return options
+}
+
+/**
+ * The startup poll in the transport manager gives up after ten seconds, and
+ * discovery only reads the device's name. Keep polling until the delta turns
+ * up, then ask for a connection of our own.
+ */
+async function connectToDelta() {
+  // Importing the transport manager starts the serial discovery
+  const { deviceManager } = await import('../config')
+
+  for (;;) {
+    let delta: Device | null = null
+
+    try {
+      delta = getDelta(deviceManager)
+    } catch (e) {
+      const poll = new CancellationToken('streamer poll').deadline(POLL_TIMEOUT_MS) // prettier-ignore
+
+      await deviceManager.poll(poll).catch(() => {})
+      await new Promise(res => setTimeout(res, POLL_INTERVAL_MS))
+      continue
+    }
+
+    const connect = new CancellationToken('streamer connect').deadline(CONNECT_TIMEOUT_MS) // prettier-ignore
+
+    try {
+      await delta.addUsageRequest(USAGE_REQUEST, connect)
+      return { deviceManager, delta }
+    } catch (e) {
+      console.log('Connecting to the delta failed, retrying', e)
+    }
+  }
+}
+
+async function main() {
+  const options = parseArguments(process.argv.slice(2))
+
+  if (!options) {
+    console.error(
+      'usage: stream [--simulate [--latency ms] [--loss fraction] [--rate moves/s]] <collection.json>', // prettier-ignore
+    )
+    process.exit(1)
+    return
+  }
+
+  let link: DeviceStreamerLink | SimulatedStreamerLink
+  let release = async () => {}
+
+  if (options.simulate) {
+    link = new SimulatedStreamerLink(options)
+  } else {
+    console.log('Waiting for the delta')
+    const { deviceManager, delta } = await connectToDelta()
+
+    link = new DeviceStreamerLink(deviceManager, delta)
+    release = () => {
+      const cancel = new CancellationToken('streamer release').deadline(1000)
+      return delta.removeUsageRequest(USAGE_REQUEST, cancel).catch(() => {})
+    }
+  }
+
+  const streamer = new ToolpathStreamer({ link })
+
+  link.attach(streamer)
+
+  const report = setInterval(() => {
+    const stats = streamer.getStats()
+
+    console.log(
+      `${stats.acknowledged}/${stats.moves}${stats.encoded ? '' : '+'} moves`,
+      `${stats.movesPerSecond.toFixed(1)} moves/s`,
+      `in flight ${stats.inFlight}, credits ${stats.credits}`,
+      `resends ${stats.resends}, last id ${stats.lastAcknowledgedId}`,
+    )
+  }, REPORT_INTERVAL_MS)
+
+  try {
+    await streamer.stream(options.filePath)
+    console.log('Streamed', streamer.getStats())
+  } finally {
+    clearInterval(report)
+    link.detach()
+    await release()
+  }
+
+  process.exit(0)
+}
+
+main().catch(err => {
+  console.error(err)
+  process.exit(1)
+})
@@ -0,0 +1,70 @@
+import { Device, DeviceManager, MANAGER_EVENTS, Message } from '@electricui/core'
+
+import {
+  EncodedMovementBatch,
+  FlowCredits,
+  MovementBatchAck,
+} from '../../application/typedState'
+import { StreamerLink } from './types'
+import { ToolpathStreamer } from './toolpath-streamer'
+
+/**
+ * Connects a ToolpathStreamer to the delta through the eUI device manager.
+ * The delta has to be connected already, see connectToDelta in the daemon.
+ */
+export class DeviceStreamerLink implements StreamerLink {
+  deviceManager: DeviceManager
+  delta: Device
+  streamer: ToolpathStreamer | null = null
+
+  constructor(deviceManager: DeviceManager, delta: Device) {
+    this.deviceManager = deviceManager
+    this.delta = delta
+  }
+
+  attach(streamer: ToolpathStreamer) {
+    this.streamer = streamer
+    this.deviceManager.on(MANAGER_EVENTS.DATA, this.onMessage)
+  }
+
+  detach() {
+    this.deviceManager.removeListener(MANAGER_EVENTS.DATA, this.onMessage)
+    this.streamer = null
+  }
+
+  onMessage = (device: any, message: Message) => {
+    if (!this.streamer || message.deviceID !== this.delta.deviceID) {
+      return
+    }
+
+    if (message.messageID === 'mvack') {
+      const ack: MovementBatchAck = message.payload
+      this.streamer.handleAck(ack)
+    } else if (message.messageID === 'crdt') {
+      const credits: FlowCredits = message.payload
+      this.streamer.handleCredits(credits.movements)
+    }
+  }
+
+  async writeBatch(batch: EncodedMovementBatch) {
+    // The 'mvack' reply is the acknowledgement, a lost batch is resent by the streamer
+    const message = new Message('inmvb', batch)
+
+    return this.delta.write(message)
+  }
+
+  async requestCredits() {
+    const message = new Message('crdt', null)
+    message.metadata.query = true
+
+    return this.delta.write(message)
+  }
+
+  async clearQueues() {
+    const message = new Message('clmv', null)
+    message.metadata.type = 0 // TYPES.CALLBACK
+    message.metadata.ack = true
+
+    return this.delta.write(message)
+  }
+}
@@ -0,0 +1,113 @@
+import { parentPort, workerData } from 'worker_threads'
+
+import fs from 'fs'
+import {
+  MovementDeltaEncoder,
+  MOVEMENT_BATCH_BYTES,
+  MOVEMENT_BATCH_RECORDS_MAX,
+} from '../config/codecs'
+import { MovementMove } from '../../application/typedState'
+import { SceneFormat } from '../config/actions/loadCollection'
+import { EncoderWorkerData, EncoderWorkerMessage, StreamBatch } from './types'
+
+/**
+ * Runs off the main thread, parses a collection export and delta encodes its
+ * movements into bulk uploads, posting them back a few at a time so the
+ * streamer can start sending before the whole file is encoded.
+ */
+
+const POST_EVERY_BATCHES = 64
+
+const { filePath } = workerData as EncoderWorkerData
+
+function post(message: EncoderWorkerMessage, transfer: Array<ArrayBuffer> = []) {
+  parentPort!.postMessage(message, transfer)
+}
+
+// Copy out of the Buffer pool so the bytes can be transferred, not cloned
+function toBatch(records: Array<Buffer>, ids: Array<number>): StreamBatch {
+  const length = records.reduce((sum, record) => sum + record.length, 0)
+  const bytes = new Uint8Array(length)
+  let offset = 0
+
+  for (const record of records) {
+    bytes.set(record, offset)
+    offset += record.length
+  }
+
+  return { count: ids.length, ids, records: bytes }
+}
+
+function encode() {
+  const scene: SceneFormat = JSON.parse(fs.readFileSync(filePath).toString())
+
+  let pending: Array<StreamBatch> = []
+  let records: Array<Buffer> = []
+  let ids: Array<number> = []
+  let bytes = 0
+  let moves = 0
+  let encoder = new MovementDeltaEncoder()
+
+  const flushBatch = () => {
+    if (ids.length > 0) {
+      pending.push(toBatch(records, ids))
+    }
+
+    records = []
+    ids = []
+    bytes = 0
+    encoder = new MovementDeltaEncoder()
+  }
+
+  const flushPending = () => {
+    post(
+      { type: 'batches', batches: pending },
+      pending.map(batch => batch.records.buffer as ArrayBuffer),
+    )
+    pending = []
+  }
+
+  // Movements run in file order, lighting fades are left to the UI
+  for (const group of scene.actions) {
+    for (const key of Object.keys(group)) {
+      for (const action of group[key]) {
+        if (action.action !== 'queue_movement') {
+          continue
+        }
+
+        const move: MovementMove = action.payload
+        let record = encoder.record(move)
+
+        // Each batch is decoded from a fresh state, so a move that doesn't
+        // fit is encoded again at the start of the next one
+        if (
+          bytes + record.length > MOVEMENT_BATCH_BYTES ||
+          ids.length >= MOVEMENT_BATCH_RECORDS_MAX
+        ) {
+          flushBatch()
+          record = encoder.record(move)
+        }
+
+        records.push(record)
+        ids.push(move.id)
+        bytes += record.length
+        moves++
+
+        if (pending.length >= POST_EVERY_BATCHES) {
+          flushPending()
+        }
+      }
+    }
+  }
+
+  flushBatch()
+  flushPending()
+
+  post({ type: 'done', moves })
+}
+
+try {
+  encode()
+} catch (e) {
+  post({ type: 'error', message: e instanceof Error ? e.message : String(e) })
+}
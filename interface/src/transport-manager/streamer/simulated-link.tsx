@@ -0,0 +1,208 @@
+import {
+  EncodedMovementBatch,
+  MovementBatchStatus,
+} from '../../application/typedState'
+import { StreamerLink } from './types'
+import { ToolpathStreamer } from './toolpath-streamer'
+
+// Mirrors of the firmware's limits in app_times.h
+const MOVEMENT_QUEUE_DEPTH_MAX = 150
+const MOVEMENT_BATCH_RESEND_WINDOW = 8
+const FLOW_CREDIT_GRANT_STEP = 16
+
+const DRAIN_INTERVAL_MS = 5
+
+export interface SimulatedStreamerLinkOptions {
+  /**
+   * One way delay of the link in milliseconds
+   */
+  latency?: number
+
+  /**
+   * Fraction of packets dropped in each direction
+   */
+  lossRate?: number
+
+  /**
+   * Movements the simulated delta runs per second, 0 to take them off the
+   * queue as soon as they arrive
+   */
+  movesPerSecond?: number
+}
+
+/**
+ * Stands in for the delta behind a ToolpathStreamer, so the streamer's
+ * throughput can be measured without hardware.
+ *
+ * Batches are ordered, acknowledged and credited the way movement_batch_event
+ * does in the firmware, the queue drains at a fixed rate, and packets can be
+ * delayed and dropped to exercise the resend path.
+ */
+export class SimulatedStreamerLink implements StreamerLink {
+  latency: number
+  lossRate: number
+  movesPerSecond: number
+
+  streamer: ToolpathStreamer | null = null
+  drainTimer: NodeJS.Timeout | null = null
+  lastDrain: number = 0
+  draining: number = 0 // fraction of a movement run since the last drain
+
+  queued: number = 0
+  executed: number = 0
+  granted: number = 0
+
+  batchSeen: boolean = false
+  lastSequence: number = 0
+  lastCount: number = 0
+  lastAccepted: number = 0
+
+  constructor(options: SimulatedStreamerLinkOptions = {}) {
+    this.latency = options.latency || 0
+    this.lossRate = options.lossRate || 0
+    this.movesPerSecond = options.movesPerSecond || 0
+  }
+
+  attach(streamer: ToolpathStreamer) {
+    this.streamer = streamer
+    this.lastDrain = Date.now()
+    this.drainTimer = setInterval(this.drain, DRAIN_INTERVAL_MS)
+  }
+
+  detach() {
+    if (this.drainTimer) {
+      clearInterval(this.drainTimer)
+      this.drainTimer = null
+    }
+
+    this.streamer = null
+  }
+
+  async writeBatch(batch: EncodedMovementBatch) {
+    this.deliver(() => this.receiveBatch(batch))
+  }
+
+  async requestCredits() {
+    this.deliver(() => {
+      this.granted = this.credits()
+      this.reply(streamer => streamer.handleCredits(this.granted))
+    })
+  }
+
+  async clearQueues() {
+    await new Promise(res => setTimeout(res, this.latency * 2))
+
+    this.batchSeen = false
+    this.queued = 0
+  }
+
+  /**
+   * Movements the simulated hardware has run
+   */
+  getExecuted() {
+    return this.executed
+  }
+
+  /**
+   * What the firmware does with a batch that passed its checks, see
+   * movement_batch_order
+   */
+  private receiveBatch = (batch: EncodedMovementBatch) => {
+    const behind = (this.lastSequence - batch.sequence) & 0xffff
+    const complete = this.lastAccepted >= this.lastCount
+
+    let status = MovementBatchStatus.ACCEPTED
+    let skip = 0
+
+    if (this.batchSeen) {
+      if (behind === 0 && !complete) {
+        skip = this.lastAccepted
+      } else if (behind < MOVEMENT_BATCH_RESEND_WINDOW) {
+        status = MovementBatchStatus.DUPLICATE
+      } else if (
+        batch.sequence !== ((this.lastSequence + 1) & 0xffff) ||
+        !complete
+      ) {
+        status = MovementBatchStatus.OUT_OF_ORDER
+      }
+    }
+
+    let accepted = 0
+
+    if (status === MovementBatchStatus.ACCEPTED) {
+      const fits = Math.min(batch.count - skip, this.credits())
+
+      this.queued += fits
+      accepted = skip + fits
+
+      if (accepted < batch.count) {
+        status = MovementBatchStatus.QUEUE_FULL
+      }
+
+      this.batchSeen = true
+      this.lastSequence = batch.sequence
+      this.lastCount = batch.count
+      this.lastAccepted = accepted
+    }
+
+    // Every ack is also a grant
+    this.granted = this.credits()
+
+    const ack = {
+      sequence: batch.sequence,
+      status,
+      accepted,
+      movement_credits: this.granted,
+      lighting_credits: 0,
+    }
+
+    this.reply(streamer => streamer.handleAck(ack))
+  }
+
+  /**
+   * Run the queue down, and push a fresh grant once enough has been freed,
+   * like flow_credits_grant_freed
+   */
+  private drain = () => {
+    const now = Date.now()
+    const elapsed = now - this.lastDrain
+
+    this.lastDrain = now
+    this.draining += this.movesPerSecond
+      ? (elapsed * this.movesPerSecond) / 1000
+      : this.queued
+
+    const ran = Math.min(Math.floor(this.draining), this.queued)
+
+    this.draining = this.queued > ran ? this.draining - ran : 0
+    this.queued -= ran
+    this.executed += ran
+
+    const credits = this.credits()
+
+    this.granted = Math.min(this.granted, credits)
+
+    if (credits >= this.granted + FLOW_CREDIT_GRANT_STEP) {
+      this.granted = credits
+      this.reply(streamer => streamer.handleCredits(credits))
+    }
+  }
+
+  private credits = () => {
+    return Math.min(MOVEMENT_QUEUE_DEPTH_MAX - this.queued, 255)
+  }
+
+  private deliver = (receive: () => void) => {
+    if (Math.random() >= this.lossRate) {
+      setTimeout(receive, this.latency)
+    }
+  }
+
+  private reply = (handle: (streamer: ToolpathStreamer) => void) => {
+    this.deliver(() => {
+      if (this.streamer) {
+        handle(this.streamer)
+      }
+    })
+  }
+}
@@ -0,0 +1,400 @@
+import { Worker } from 'worker_threads'
+
+import path from 'path'
+import {
+  MovementBatchAck,
+  MovementBatchStatus,
+} from '../../application/typedState'
+import {
+  EncoderWorkerMessage,
+  StreamBatch,
+  StreamerLink,
+  StreamerStats,
+} from './types'
+
+// Must stay under MOVEMENT_BATCH_RESEND_WINDOW in the firmware, so every batch
+// resent after a lost ack is still recognised as a duplicate
+const RESEND_WINDOW = 8
+
+export interface ToolpathStreamerOptions {
+  /**
+   * Where batches are written to and credits requested from
+   */
+  link: StreamerLink
+
+  /**
+   * Batches allowed on the wire before the oldest is acknowledged
+   */
+  maxInFlight?: number
+
+  /**
+   * Milliseconds without an acknowledgement or grant, while there's still
+   * something to send, before the link is assumed to have dropped out
+   */
+  ackTimeout?: number
+}
+
+/**
+ * Streams a collection export to the hardware as pre-encoded bulk uploads.
+ *
+ * Several batches are kept in flight against the credits the firmware grants.
+ * Batches are sent flagged as streamed, so the firmware only queues the one
+ * following the last it accepted. When an upload is lost, refused or its ack
+ * times out the streamer goes back to the oldest unacknowledged batch and sends
+ * everything from there again with the same sequence numbers, the firmware
+ * drops the ones it already has and carries on from the last movement it queued.
+ */
+export class ToolpathStreamer {
+  link: StreamerLink
+  maxInFlight: number
+  ackTimeout: number
+
+  batches: Array<StreamBatch> = []
+  acked: number = 0 // batches before this index are queued by the hardware
+  next: number = 0 // the next batch to send
+  sent: number = 0 // batches sent at least once
+  outstanding: Array<number> = [] // sends of each batch without a reply yet
+  granted: number = 0
+  firstSequence: number = 1
+
+  moves: number = 0
+  encoded: boolean = false
+  acknowledged: number = 0
+  lastAcknowledgedId: number | null = null
+  resends: number = 0
+
+  running: boolean = false
+  startedAt: number = 0
+  lastProgress: number = 0
+  watchdog: NodeJS.Timeout | null = null
+  worker: Worker | null = null
+
+  resolveFinished: () => void = () => {}
+  rejectFinished: (err: Error) => void = () => {}
+
+  debug: (msg: string) => void
+
+  constructor(options: ToolpathStreamerOptions) {
+    this.link = options.link
+    this.maxInFlight = Math.min(options.maxInFlight || 4, RESEND_WINDOW)
+    this.ackTimeout = options.ackTimeout || 500
+
+    this.debug = require('debug')('electricui-toolpath-streamer')
+  }
+
+  /**
+   * Encode and stream a collection file, resolves once every movement in it
+   * has been queued by the hardware
+   */
+  public stream = async (filePath: string) => {
+    if (this.running) {
+      throw new Error('the streamer is already running')
+    }
+
+    this.reset()
+
+    const finished = new Promise<void>((resolve, reject) => {
+      this.resolveFinished = resolve
+      this.rejectFinished = reject
+    })
+
+    // A fresh stream needs the firmware to forget the last sequence it saw
+    await this.link.clearQueues()
+
+    this.running = true
+    this.startedAt = Date.now()
+    this.lastProgress = this.startedAt
+    this.watchdog = setInterval(this.checkProgress, this.ackTimeout / 2)
+
+    this.startEncoder(filePath)
+    this.link.requestCredits().catch(() => {})
+
+    try {
+      await finished
+    } finally {
+      this.stop()
+    }
+  }
+
+  /**
+   * Stop sending, anything already queued on the hardware is left to run
+   */
+  public stop = () => {
+    this.running = false
+
+    if (this.watchdog) {
+      clearInterval(this.watchdog)
+      this.watchdog = null
+    }
+
+    if (this.worker) {
+      this.worker.terminate()
+      this.worker = null
+    }
+  }
+
+  /**
+   * Handle the firmware's reply to a bulk upload
+   */
+  public handleAck = (ack: MovementBatchAck) => {
+    if (!this.running) {
+      return
+    }
+
+    const index = this.indexOfSequence(ack.sequence)
+
+    if (index >= 0) {
+      this.outstanding[index] = Math.max(0, this.outstanding[index] - 1)
+
+      switch (ack.status) {
+        case MovementBatchStatus.ACCEPTED:
+        case MovementBatchStatus.DUPLICATE:
+          // Streamed batches are only queued in order, so every batch up to
+          // this one is on the hardware even if its own ack went missing
+          this.acknowledge(index + 1, 0)
+          break
+        case MovementBatchStatus.QUEUE_FULL:
+          this.acknowledge(index, ack.accepted)
+          this.goBack(index)
+          break
+        case MovementBatchStatus.REFUSED:
+          // Resending won't help until the hardware is armed in event mode
+          this.rejectFinished(
+            new Error('the hardware refused movements, arm it in event mode'),
+          )
+          return
+        default:
+          this.goBack(index)
+          break
+      }
+    }
+
+    this.grant(ack.movement_credits)
+  }
+
+  /**
+   * Handle an unsolicited or requested credit grant
+   */
+  public handleCredits = (movements: number) => {
+    if (!this.running) {
+      return
+    }
+
+    this.grant(movements)
+  }
+
+  public getStats = (): StreamerStats => {
+    const seconds = (Date.now() - this.startedAt) / 1000
+
+    return {
+      moves: this.moves,
+      encoded: this.encoded,
+      acknowledged: this.acknowledged,
+      lastAcknowledgedId: this.lastAcknowledgedId,
+      inFlight: this.next - this.acked,
+      credits: this.available(),
+      resends: this.resends,
+      movesPerSecond: seconds > 0 ? this.acknowledged / seconds : 0,
+    }
+  }
+
+  private reset = () => {
+    this.batches = []
+    this.outstanding = []
+    this.acked = 0
+    this.next = 0
+    this.sent = 0
+    this.granted = 0
+    this.moves = 0
+    this.encoded = false
+    this.acknowledged = 0
+    this.lastAcknowledgedId = null
+    this.resends = 0
+  }
+
+  private startEncoder = (filePath: string) => {
+    // Under ts-node the worker has to load the TypeScript source as well
+    const extension = path.extname(__filename)
+    const worker = new Worker(
+      path.join(__dirname, `encoder-worker${extension}`),
+      {
+        workerData: { filePath },
+        execArgv:
+          extension === '.js' ? undefined : ['--require', 'ts-node/register'],
+      },
+    )
+
+    worker.on('message', (message: EncoderWorkerMessage) => {
+      switch (message.type) {
+        case 'batches':
+          for (const batch of message.batches) {
+            this.batches.push(batch)
+            this.outstanding.push(0)
+            this.moves += batch.count
+          }
+          this.pump()
+          break
+        case 'done':
+          this.encoded = true
+          this.debug(`Encoded ${message.moves} moves in ${this.batches.length} batches`) // prettier-ignore
+          this.pump()
+          break
+        case 'error':
+          this.rejectFinished(new Error(message.message))
+          break
+      }
+    })
+
+    worker.on('error', err => this.rejectFinished(err))
+
+    this.worker = worker
+  }
+
+  /**
+   * Send as many batches as the credits and the in flight limit allow
+   */
+  private pump = () => {
+    while (
+      this.running &&
+      this.next < this.batches.length &&
+      this.next - this.acked < this.maxInFlight
+    ) {
+      const batch = this.batches[this.next]
+
+      if (batch.count > this.available()) {
+        break
+      }
+
+      this.send(this.next++)
+    }
+
+    if (this.running && this.encoded && this.acked === this.batches.length) {
+      this.resolveFinished()
+    }
+  }
+
+  private send = (index: number) => {
+    const batch = this.batches[index]
+
+    if (index < this.sent) {
+      this.resends++
+    }
+
+    this.sent = Math.max(this.sent, index + 1)
+    this.outstanding[index]++
+
+    // Failed writes are noticed by the watchdog like any other lost packet
+    this.link
+      .writeBatch({
+        sequence: this.sequenceOf(index),
+        count: batch.count,
+        records: batch.records,
+      })
+      .catch(err => this.debug(`Batch ${index} write failed: ${err}`))
+  }
+
+  /**
+   * Record that the hardware holds every batch before index, plus accepted
+   * movements of the batch at index
+   */
+  private acknowledge = (index: number, accepted: number) => {
+    this.lastProgress = Date.now()
+
+    for (; this.acked < index; this.acked++) {
+      const batch = this.batches[this.acked]
+
+      this.acknowledged += batch.count
+      this.lastAcknowledgedId = batch.ids[batch.count - 1]
+    }
+
+    // Partly queued batches are resent whole, the firmware skips what it has
+    if (
+      index < this.batches.length &&
+      accepted > 0 &&
+      accepted < this.batches[index].count
+    ) {
+      this.lastAcknowledgedId = this.batches[index].ids[accepted - 1]
+    }
+
+    // A late ack can cover batches that were about to be resent
+    if (this.next < this.acked) {
+      this.next = this.acked
+    }
+  }
+
+  /**
+   * Resend everything from the oldest unacknowledged batch. Replies to sends
+   * made before an earlier go back are stale and don't rewind a second time.
+   */
+  private goBack = (index: number) => {
+    if (this.outstanding[index] > 0) {
+      return
+    }
+
+    this.debug(`Going back to batch ${this.acked} from ${this.next}`)
+    this.next = this.acked
+  }
+
+  private grant = (movements: number) => {
+    this.lastProgress = Date.now()
+    this.granted = movements
+    this.pump()
+  }
+
+  /**
+   * Credits left once movements still on the wire are taken off the last
+   * grant, they may have been sent after the hardware counted it
+   */
+  private available = () => {
+    let inFlight = 0
+
+    for (let i = this.acked; i < this.next; i++) {
+      inFlight += this.batches[i].count
+    }
+
+    return Math.max(0, this.granted - inFlight)
+  }
+
+  /**
+   * Nothing heard for too long with work left, assume the link dropped out.
+   * Go back to the last acknowledged batch and ask for credits again, the
+   * grant restarts sending once the link is back.
+   */
+  private checkProgress = () => {
+    const waiting = !this.encoded || this.acked < this.batches.length
+
+    if (!waiting || Date.now() - this.lastProgress < this.ackTimeout) {
+      return
+    }
+
+    this.debug(`No reply for ${this.ackTimeout}ms, resuming after id ${this.lastAcknowledgedId}`) // prettier-ignore
+
+    // Earlier sends are written off, a late reply to one costs another go back
+    for (let i = this.acked; i < this.next; i++) {
+      this.outstanding[i] = 0
+    }
+
+    this.next = this.acked
+    this.granted = 0
+    this.lastProgress = Date.now()
+
+    this.link.requestCredits().catch(() => {})
+  }
+
+  private sequenceOf = (index: number) => {
+    return (this.firstSequence + index) & 0xffff
+  }
+
+  private indexOfSequence = (sequence: number) => {
+    // Only batches sent and not yet acknowledged can be replied to
+    const end = Math.max(this.next, this.acked + this.maxInFlight)
+
+    for (let i = this.acked; i < end && i < this.batches.length; i++) {
+      if (this.sequenceOf(i) === sequence) {
+        return i
+      }
+    }
+
+    return -1
+  }
+}
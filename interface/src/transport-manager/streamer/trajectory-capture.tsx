@@ -0,0 +1,166 @@
+import { DeviceManager, MANAGER_EVENTS, Message } from '@electricui/core'
+
+import { getDelta } from '../config/actions/utils'
+import {
+  CaptureArm,
+  CaptureBlock,
+  CaptureSample,
+  CaptureState,
+} from '../../application/typedState'
+
+export interface TrajectoryCaptureOptions {
+  /**
+   * Milliseconds to wait for a block before asking for it again
+   */
+  replyTimeout?: number
+
+  /**
+   * Milliseconds between requests while the capture has nothing new
+   */
+  pollInterval?: number
+}
+
+/**
+ * Reads a trajectory capture back from the delta.
+ *
+ * The firmware holds the samples in RAM until they're read, so the same loop
+ * streams the capture while the move runs or dumps it once the move is done.
+ * Each block is requested by sequence, asking for the next sequence tells the
+ * firmware the previous block arrived, a lost reply is asked for again.
+ */
+export class TrajectoryCapture {
+  deviceManager: DeviceManager
+  replyTimeout: number
+  pollInterval: number
+
+  samples: Array<CaptureSample> = []
+  sequence: number = 0
+
+  waitingFor: ((block: CaptureBlock) => void) | null = null
+
+  constructor(
+    deviceManager: DeviceManager,
+    options: TrajectoryCaptureOptions = {},
+  ) {
+    this.deviceManager = deviceManager
+    this.replyTimeout = options.replyTimeout || 250
+    this.pollInterval = options.pollInterval || 20
+  }
+
+  attach() {
+    this.deviceManager.on(MANAGER_EVENTS.DATA, this.onMessage)
+  }
+
+  detach() {
+    this.deviceManager.removeListener(MANAGER_EVENTS.DATA, this.onMessage)
+    this.waitingFor = null
+  }
+
+  /**
+   * Discard whatever the firmware holds and record from the first tick of
+   * start_id to the last tick of stop_id
+   */
+  public arm = async (arm: CaptureArm) => {
+    const delta = getDelta(this.deviceManager)
+
+    this.samples = []
+    this.sequence = 0
+
+    const message = new Message('capt', arm)
+    message.metadata.ack = true
+
+    return delta.write(message)
+  }
+
+  /**
+   * End the capture before the stop move
+   */
+  public stop = async () => {
+    const delta = getDelta(this.deviceManager)
+
+    const message = new Message('capstp', null)
+    message.metadata.type = 0 // TYPES.CALLBACK
+    message.metadata.ack = true
+
+    return delta.write(message)
+  }
+
+  /**
+   * Read blocks until the capture is done and drained, resolves with every
+   * sample in tick order. onSamples sees them as they arrive.
+   */
+  public collect = async (
+    onSamples?: (samples: Array<CaptureSample>) => void,
+  ) => {
+    for (;;) {
+      const block = await this.request(this.sequence)
+
+      if (block === null) {
+        continue
+      }
+
+      if (block.sequence !== this.sequence) {
+        throw new Error(`capture was re-armed, expected block ${this.sequence} got ${block.sequence}`) // prettier-ignore
+      }
+
+      this.sequence = (this.sequence + 1) & 0xffff
+
+      if (block.samples.length > 0) {
+        this.samples.push(...block.samples)
+
+        if (onSamples) {
+          onSamples(block.samples)
+        }
+        continue
+      }
+
+      // An empty block was read after the last sample, nothing more will come
+      if (
+        block.state === CaptureState.DONE ||
+        block.state === CaptureState.IDLE
+      ) {
+        return this.samples
+      }
+
+      await new Promise(res => setTimeout(res, this.pollInterval))
+    }
+  }
+
+  private request = (sequence: number) => {
+    return new Promise<CaptureBlock | null>(resolve => {
+      const timeout = setTimeout(() => {
+        this.waitingFor = null
+        resolve(null)
+      }, this.replyTimeout)
+
+      this.waitingFor = (block: CaptureBlock) => {
+        clearTimeout(timeout)
+        this.waitingFor = null
+        resolve(block)
+      }
+
+      const delta = getDelta(this.deviceManager)
+      delta.write(new Message('capnx', sequence)).catch(() => {})
+    })
+  }
+
+  onMessage = (device: any, message: Message) => {
+    if (message.messageID !== 'capblk' || !this.waitingFor) {
+      return
+    }
+
+    let delta = null
+
+    try {
+      delta = getDelta(this.deviceManager)
+    } catch (e) {
+      return
+    }
+
+    if (message.deviceID !== delta.deviceID) {
+      return
+    }
+
+    this.waitingFor(message.payload)
+  }
+}
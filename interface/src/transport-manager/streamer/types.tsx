@@ -0,0 +1,54 @@
+import { EncodedMovementBatch } from '../../application/typedState'
+
+/**
+ * A bulk upload encoded by the worker, ids are the movement identifiers in the
+ * order they appear in records
+ */
+export type StreamBatch = {
+  count: number
+  ids: Array<number>
+  records: Uint8Array
+}
+
+export type EncoderWorkerData = {
+  filePath: string
+}
+
+export type EncoderWorkerMessage =
+  | { type: 'batches'; batches: Array<StreamBatch> }
+  | { type: 'done'; moves: number }
+  | { type: 'error'; message: string }
+
+/**
+ * How the streamer reaches the hardware. Replies are handed back through
+ * ToolpathStreamer.handleAck and handleCredits, so anything that speaks the
+ * batch protocol (the eUI device, a simulated firmware) can sit behind it.
+ */
+export interface StreamerLink {
+  /**
+   * Send one batch, the streamer doesn't wait on the returned promise and
+   * treats a failed write the same as a lost packet
+   */
+  writeBatch(batch: EncodedMovementBatch): Promise<any>
+
+  /**
+   * Ask for a fresh credit grant
+   */
+  requestCredits(): Promise<any>
+
+  /**
+   * Empty the hardware queues so a new stream can start from any sequence
+   */
+  clearQueues(): Promise<any>
+}
+
+export type StreamerStats = {
+  moves: number // encoded so far
+  encoded: boolean // the worker has finished the file
+  acknowledged: number // movements the hardware has queued
+  lastAcknowledgedId: number | null
+  inFlight: number // batches sent and not yet acknowledged
+  credits: number
+  resends: number // batches sent again after a lost or refused upload
+  movesPerSecond: number
+}